@@ -235,6 +235,9 @@ string parseArgs(int argc, char* argv[], MegaCmdShellCommunications& comsManager
 
         if (!strcmp(argv[1],"get")
                 || !strcmp(argv[1],"put")
+                || !strcmp(argv[1],"rm")
+                || !strcmp(argv[1],"mv")
+                || !strcmp(argv[1],"cp")
                 || !strcmp(argv[1],"login")
                 || !strcmp(argv[1],"reload") )
         {
@@ -464,6 +467,9 @@ wstring parsewArgs(int argc, wchar_t* argv[], MegaCmdShellCommunications& comsMa
 
         if (!wcscmp(argv[1],L"get")
                 || !wcscmp(argv[1],L"put")
+                || !wcscmp(argv[1],L"rm")
+                || !wcscmp(argv[1],L"mv")
+                || !wcscmp(argv[1],L"cp")
                 || !wcscmp(argv[1],L"login")
                 || !wcscmp(argv[1],L"reload") )
         {
@@ -846,6 +852,38 @@ void statechangehandle(string statestring, MegaCmdShellCommunications & comsMana
     }
 }
 
+#ifndef _WIN32
+// Bounded: the server does not read more requests of a session while its petitions queue is full
+constexpr long long MAX_BATCH_IN_FLIGHT = 64;
+
+// mega-exec --batch [--max-in-flight=N]: executes the commands read from stdin (one per line) through a single connection
+int executeBatch(int argc, char* argv[], MegaCmdShellCommunicationsPosix &comms, OUTSTREAMTYPE &outstream, OUTSTREAMTYPE &errorOutput)
+{
+    size_t maxInFlight = 1; // as a script: each command once the previous one is done
+    for (int i = 2; i < argc; i++)
+    {
+        if (!strncmp(argv[i], "--max-in-flight=", strlen("--max-in-flight=")))
+        {
+            long long value = charstoll(argv[i] + strlen("--max-in-flight="));
+            if (value < 1 || value > MAX_BATCH_IN_FLIGHT)
+            {
+                cerr << "Invalid --max-in-flight value: expected between 1 and " << MAX_BATCH_IN_FLIGHT << endl;
+                return MCMD_EARGS;
+            }
+            maxInFlight = static_cast<size_t>(value);
+        }
+        else
+        {
+            cerr << "Unexpected argument for --batch: " << argv[i] << endl;
+            cerr << "Usage: mega-exec --batch [--max-in-flight=N] < commands" << endl;
+            return MCMD_EARGS;
+        }
+    }
+
+    return comms.executeBatch(std::cin, outstream, errorOutput, maxInFlight);
+}
+#endif
+
 int executeClient(int argc, char* argv[], OUTSTREAMTYPE & outstream, OUTSTREAMTYPE &errorOutput)
 {
 #ifdef _WIN32
@@ -891,6 +929,16 @@ int executeClient(int argc, char* argv[], OUTSTREAMTYPE & outstream, OUTSTREAMTY
         return -2;
     }
 
+#ifndef _WIN32
+    if (command == "--batch")
+    {
+        comms->waitForServerReadyOrRegistrationFailed();
+        int outcode = executeBatch(argc, argv, static_cast<MegaCmdShellCommunicationsPosix&>(*comms), outstream, errorOutput);
+        comms->shutdown();
+        return outcode < 0 ? -outcode : outcode;
+    }
+#endif
+
 #if defined _WIN32 && !defined MEGACMD_TESTING_CODE
     int wargc;
 
@@ -17,8 +17,8 @@
  */
 
 #include "comunicationsmanager.h"
+#include "megacmd_redaction.h"
 
-#include <regex>
 
 using namespace mega;
 
@@ -89,6 +89,20 @@ bool ComunicationsManager::informStateListeners(const string &s)
     return !stateListenersPetitions.empty();
 }
 
+void ComunicationsManager::serviceStateListeners(const std::function<int(CmdPetition *)> &service)
+{
+    std::lock_guard<std::recursive_mutex> g(mStateListenersMutex);
+    for (auto it = stateListenersPetitions.begin(); it != stateListenersPetitions.end();)
+    {
+        if (service(it->get()) < 0)
+        {
+            it = stateListenersPetitions.erase(it);
+            continue;
+        }
+        ++it;
+    }
+}
+
 void ComunicationsManager::informStateListenerByClientId(const string &s, int clientID)
 {
     std::lock_guard<std::recursive_mutex> g(mStateListenersMutex);
@@ -137,6 +151,7 @@ std::string ComunicationsManager::getUserResponse(CmdPetition *inf, string messa
 void CmdPetition::setLine(std::string_view line)
 {
     mLine = line;
+    mRedactedLine = getenv("MEGACMD_DO_NOT_REDACT_LINES") ? std::string() : LineRedactor::redact(mLine);
 }
 
 std::string_view CmdPetition::getLine() const
@@ -149,51 +164,13 @@ std::string_view CmdPetition::getUniformLine() const
     return ltrim(std::string_view(mLine), 'X');
 }
 
-std::string CmdPetition::getRedactedLine() const
+const std::string &CmdPetition::getRedactedLine() const
 {
-    const char* doNotRedactEnv = getenv("MEGACMD_DO_NOT_REDACT_LINES");
-    if (doNotRedactEnv)
-    {
-        return mLine;
-    }
-
-    static const std::string redacted = "$1<REDACTED>";
-    static const std::string asterisks = "$1********";
-
-    static const std::regex fullCommandRegex(R"(^((X?)(passwd|login|confirm|confirmcancel)\s+).*$)");
-    static const std::regex passwordRegex(R"((--password=)("[^"]+"|'[^']+'|\S+))");
-    static const std::regex authRegex(R"((--auth-(code|key)=)\S+)");
-    static const std::regex linkRegex(R"((https://mega\.nz/(file|folder)/[^#]+#)\S+)");
-    static const std::regex oldLinkRegex(R"((https://mega\.nz/#F?![^!]+#)\S+)");
-    static const std::regex encryptedLinkRegex(R"((https://mega\.nz/#P!)\S+)");
-
-    if (std::regex_match(mLine, fullCommandRegex))
-    {
-        return std::regex_replace(mLine, fullCommandRegex, redacted);
-    }
-
-    std::string output = mLine;
-    output = std::regex_replace(output, passwordRegex, asterisks);
-    output = std::regex_replace(output, authRegex, asterisks);
-    output = std::regex_replace(output, linkRegex, asterisks);
-    output = std::regex_replace(output, oldLinkRegex, asterisks);
-    output = std::regex_replace(output, encryptedLinkRegex, asterisks);
-
-    return output;
+    return mRedactedLine.empty() ? mLine : mRedactedLine;
 }
 
 bool CmdPetition::isFromCmdShell() const
 {
     return startsWith(mLine, "X");
 }
-
-MegaThread *CmdPetition::getPetitionThread() const
-{
-    return petitionThread;
-}
-
-void CmdPetition::setPetitionThread(MegaThread *value)
-{
-    petitionThread = value;
-}
 }//end namespace
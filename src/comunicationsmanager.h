@@ -22,13 +22,15 @@
 #include "megacmd.h"
 #include "megacmdcommonutils.h"
 
+#include <functional>
+
 namespace megacmd {
 class CmdPetition
 {
     std::string mLine;
+    std::string mRedactedLine; // (empty if lines are not to be redacted)
 
 public:
-    mega::MegaThread *petitionThread = nullptr;
     int clientID = -27;
     bool clientDisconnected = false;
 
@@ -40,13 +42,11 @@ public:
     // Remove the starting 'X' if present (petitions coming from interactive mode)
     std::string_view getUniformLine() const;
 
-    // Remove possible confidential info from the line
-    std::string getRedactedLine() const;
+    // The line without possible confidential info (redacted once, when set)
+    const std::string &getRedactedLine() const;
 
     bool isFromCmdShell() const;
 
-    mega::MegaThread *getPetitionThread() const;
-    void setPetitionThread(mega::MegaThread *value);
     virtual std::string getPetitionDetails() const { return {}; }
 };
 
@@ -58,6 +58,10 @@ private:
     std::recursive_mutex mStateListenersMutex;
     std::vector<std::unique_ptr<CmdPetition>> stateListenersPetitions;
 
+protected:
+    // Calls service for every state listener (while locked), removing those it returns -1 for
+    void serviceStateListeners(const std::function<int(CmdPetition *)> &service);
+
 public:
     ComunicationsManager();
     virtual ~ComunicationsManager() = default;
@@ -88,6 +92,20 @@ public:
     virtual void sendPartialError(CmdPetition *inf, OUTSTRING *s) = 0;
     virtual void sendPartialError(CmdPetition *inf, char *s, size_t size, bool binaryContents = false) = 0;
 
+    /**
+     * @brief Sends to the client any partial output that the implementation may be holding back
+     * Partial outputs may be buffered to reduce the number of writes. This is called on explicit flushes
+     * (e.g. endl), and must be honored before asking the client anything or returning the petition.
+     */
+    virtual void flushPartialOutputs(CmdPetition *inf) {}
+
+    /**
+     * @brief Whether the client of a petition is still there to receive its outputs
+     * Besides failed writes, implementations may check the connection itself, so that long running
+     * petitions can give up early. It is cheap, but not meant to be called for every single output.
+     */
+    virtual bool isClientConnected(CmdPetition *inf) { return !inf->clientDisconnected; }
+
 
     /**
      * @brief Sends an status message (e.g. prompt:who@/new/prompt:) to all registered listeners
@@ -0,0 +1,553 @@
+/**
+ * @file src/comunicationsmanagerepoll.cpp
+ * @brief MEGAcmd: Communications manager using Unix Domain Sockets and epoll
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+#include "megacmdcommonutils.h"
+#ifdef __linux__
+
+#include "comunicationsmanagerepoll.h"
+#include "megacmdutils.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#include <limits>
+
+using namespace mega;
+
+namespace megacmd {
+
+namespace {
+
+uint64_t toEpollData(int fd, uint32_t source)
+{
+    return (static_cast<uint64_t>(source) << 32) | static_cast<uint32_t>(fd);
+}
+
+int fdFromEpollData(uint64_t data)
+{
+    return static_cast<int>(data & 0xFFFFFFFF);
+}
+
+uint32_t sourceFromEpollData(uint64_t data)
+{
+    return static_cast<uint32_t>(data >> 32);
+}
+
+// Reads whatever is available. Returns the result of the last recv
+ssize_t receiveAvailable(int fd, std::string &received)
+{
+    char chunk[16384];
+    ssize_t n;
+    do
+    {
+        n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n > 0)
+        {
+            received.append(chunk, static_cast<size_t>(n));
+        }
+    } while (n > 0 || (n < 0 && errno == EINTR));
+    return n;
+}
+
+bool setNonBlocking(int fd, bool nonBlocking)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1)
+    {
+        return false;
+    }
+    flags = nonBlocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    return fcntl(fd, F_SETFL, flags) != -1;
+}
+
+}
+
+ComunicationsManagerEpoll::ComunicationsManagerEpoll()
+    : ComunicationsManagerFileSockets() // creates the listening socket
+{
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (mEpollFd < 0)
+    {
+        LOG_fatal << "ERROR creating epoll instance: " << errno;
+        return;
+    }
+
+    mWakeUpFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (mWakeUpFd < 0)
+    {
+        LOG_err << "ERROR creating eventfd to stop waiting: " << errno;
+    }
+    else
+    {
+        addToEpoll(mWakeUpFd, EventSource::WAKE_UP, EPOLLIN);
+    }
+
+    if (sockfd >= 0)
+    {
+        if (!setNonBlocking(sockfd, true))
+        {
+            LOG_err << "ERROR setting listening socket as non-blocking: " << errno;
+        }
+        addToEpoll(sockfd, EventSource::LISTENING_SOCKET, EPOLLIN);
+    }
+}
+
+ComunicationsManagerEpoll::~ComunicationsManagerEpoll()
+{
+    mReadyPetitions.clear();
+    mSessions.clear();
+    for (auto& [fd, received] : mPendingSockets)
+    {
+        close(fd);
+    }
+
+    if (mWakeUpFd >= 0)
+    {
+        close(mWakeUpFd);
+    }
+    if (mEpollFd >= 0)
+    {
+        close(mEpollFd);
+    }
+}
+
+bool ComunicationsManagerEpoll::addToEpoll(int fd, EventSource source, uint32_t events)
+{
+    struct epoll_event ev = {};
+    ev.events = events;
+    ev.data.u64 = toEpollData(fd, static_cast<uint32_t>(source));
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &ev) == -1)
+    {
+        LOG_err << "ERROR adding socket " << fd << " to epoll: " << errno;
+        return false;
+    }
+    return true;
+}
+
+bool ComunicationsManagerEpoll::receivedPetition()
+{
+    return !mReadyPetitions.empty();
+}
+
+int ComunicationsManagerEpoll::waitForPetition()
+{
+    if (sockfd < 0 || mEpollFd < 0)
+    {
+        LOG_fatal << "Invalid socket descriptor: " << sockfd << " or epoll descriptor: " << mEpollFd;
+        return EBADF;
+    }
+
+    constexpr int maxEvents = 64;
+    struct epoll_event events[maxEvents];
+
+    bool wokenUp = false;
+    while (mReadyPetitions.empty() && !wokenUp)
+    {
+        int n = epoll_wait(mEpollFd, events, maxEvents, -1);
+        if (n < 0)
+        {
+            if (errno == EINTR) //syscall
+            {
+                return 0;
+            }
+            LOG_fatal << "Error at epoll_wait: " << errno;
+            return errno;
+        }
+
+        for (int i = 0; i < n; ++i)
+        {
+            const int fd = fdFromEpollData(events[i].data.u64);
+            switch (static_cast<EventSource>(sourceFromEpollData(events[i].data.u64)))
+            {
+                case EventSource::LISTENING_SOCKET:
+                {
+                    if (events[i].events & (EPOLLHUP | EPOLLERR)) // shut down
+                    {
+                        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+                        wokenUp = true;
+                        break;
+                    }
+                    acceptPendingConnections();
+                    break;
+                }
+                case EventSource::WAKE_UP:
+                {
+                    eventfd_t value;
+                    eventfd_read(fd, &value);
+                    wokenUp = true;
+                    break;
+                }
+                case EventSource::PETITION_SOCKET:
+                {
+                    readPetition(fd, events[i].events);
+                    break;
+                }
+                case EventSource::SESSION_SOCKET:
+                {
+                    readSessionRequests(fd, events[i].events);
+                    break;
+                }
+                case EventSource::STATE_LISTENER_SOCKET:
+                {
+                    // Registered with EPOLLONESHOT: no more events will come for this one unless re-armed
+                    if (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                    {
+                        // The client hung up: it is removed (and closed) when failing to be informed
+                        LOG_verbose << "State listener socket " << fd << " hung up";
+                        ackStateListenersAndRemoveClosed();
+                    }
+                    else if (events[i].events & EPOLLOUT)
+                    {
+                        drainStateListenerSocket(fd);
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+void ComunicationsManagerEpoll::acceptPendingConnections()
+{
+    for (;;)
+    {
+        int newsockfd = accept4(sockfd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (newsockfd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+
+            if (errno == EMFILE || errno == ENFILE)
+            {
+                LOG_fatal << "ERROR on accept: TOO many open files.";
+                ackStateListenersAndRemoveClosed();
+                sleep(1);
+            }
+            else if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                LOG_fatal << "ERROR on accept: " << errno;
+            }
+            return;
+        }
+
+        if (!addToEpoll(newsockfd, EventSource::PETITION_SOCKET, EPOLLIN | EPOLLRDHUP))
+        {
+            close(newsockfd);
+            continue;
+        }
+        mPendingSockets.emplace(newsockfd, std::string());
+    }
+}
+
+void ComunicationsManagerEpoll::discardPendingSocket(int fd)
+{
+    epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+    mPendingSockets.erase(fd);
+    close(fd);
+}
+
+void ComunicationsManagerEpoll::readPetition(int fd, uint32_t events)
+{
+    auto it = mPendingSockets.find(fd);
+    if (it == mPendingSockets.end())
+    {
+        return;
+    }
+    std::string &received = it->second;
+
+    ssize_t n = receiveAvailable(fd, received);
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+    {
+        LOG_err << "ERROR reading from socket " << fd << ": " << errno;
+        discardPendingSocket(fd);
+        return;
+    }
+
+    const bool hungUp = n == 0 || (events & (EPOLLHUP | EPOLLERR));
+
+    std::string wholepetition;
+    uint64_t payloadSize = 0;
+    switch (parsePetitionFrameHeader(received, payloadSize))
+    {
+        case PetitionFrameStatus::FRAMED:
+        {
+            if (received.size() - PETITION_FRAME_HEADER_SIZE < payloadSize)
+            {
+                if (hungUp)
+                {
+                    LOG_err << "Client closed socket " << fd << " before sending the whole petition";
+                    discardPendingSocket(fd);
+                }
+                return; // keep waiting for the rest of the petition
+            }
+            wholepetition = received.substr(PETITION_FRAME_HEADER_SIZE, payloadSize);
+            if (wholepetition == SESSION_PETITION)
+            {
+                // whatever came after this petition are the first requests of the session
+                std::string requests = received.substr(PETITION_FRAME_HEADER_SIZE + payloadSize);
+                mPendingSockets.erase(it);
+                startSession(fd, std::move(requests), hungUp);
+                return;
+            }
+
+            if (send(fd, PETITION_FRAME_ACK, sizeof(PETITION_FRAME_ACK), MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(PETITION_FRAME_ACK)))
+            {
+                LOG_err << "ERROR acknowledging petition frame at socket " << fd << ": " << errno;
+                discardPendingSocket(fd);
+                return;
+            }
+            break;
+        }
+        case PetitionFrameStatus::RAW:
+        {
+            // Legacy clients write the whole petition at once, but nothing delimits it: it is taken to be whatever
+            // was available when the socket became readable. A raw petition arriving in pieces is thus cut short
+            // (as it always was): only framed petitions are guaranteed to be read whole
+            wholepetition = received.c_str(); // as ComunicationsManagerFileSockets, up to the first null character
+            break;
+        }
+        case PetitionFrameStatus::INCOMPLETE:
+        {
+            if (hungUp)
+            {
+                LOG_verbose << "Client closed socket " << fd << " without sending a petition";
+                discardPendingSocket(fd);
+            }
+            return;
+        }
+        case PetitionFrameStatus::INVALID:
+        {
+            LOG_err << "Received petition frame with unsupported version or size at socket " << fd;
+            discardPendingSocket(fd);
+            return;
+        }
+    }
+
+    epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+    mPendingSockets.erase(it);
+
+    // From now on the socket is used as in ComunicationsManagerFileSockets (blocking)
+    if (!setNonBlocking(fd, false))
+    {
+        LOG_err << "ERROR setting petition socket as blocking: " << errno;
+    }
+
+    auto inf = std::make_unique<CmdPetitionPosixSockets>();
+    inf->outSocket = fd;
+    inf->setLine(wholepetition);
+    mReadyPetitions.push_back(std::move(inf));
+}
+
+void ComunicationsManagerEpoll::startSession(int fd, std::string received, bool hungUp)
+{
+    // The socket stays in the event loop (and non-blocking) to keep on reading requests
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.u64 = toEpollData(fd, static_cast<uint32_t>(EventSource::SESSION_SOCKET));
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_MOD, fd, &ev) == -1)
+    {
+        LOG_err << "ERROR switching socket " << fd << " to a session: " << errno;
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        return;
+    }
+
+    auto session = std::make_shared<PetitionSession>(fd);
+    if (!session->sendFrame(0, MCMD_OK, nullptr, 0)) // acknowledge the session
+    {
+        LOG_err << "ERROR acknowledging session at socket " << fd << ": " << errno;
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+        return;
+    }
+    LOG_debug << "Started session at socket " << fd;
+
+    auto &state = mSessions[fd];
+    state.mSession = std::move(session);
+    state.mReceived = std::move(received);
+    if (!queueSessionRequests(fd, state) || hungUp) // nothing else will come: serve what was received
+    {
+        endSession(fd);
+    }
+}
+
+void ComunicationsManagerEpoll::readSessionRequests(int fd, uint32_t events)
+{
+    auto it = mSessions.find(fd);
+    if (it == mSessions.end())
+    {
+        return;
+    }
+
+    ssize_t n = receiveAvailable(fd, it->second.mReceived);
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+    {
+        LOG_err << "ERROR reading from session socket " << fd << ": " << errno;
+        endSession(fd);
+        return;
+    }
+
+    if (!queueSessionRequests(fd, it->second) || n == 0 || (events & (EPOLLHUP | EPOLLERR)))
+    {
+        endSession(fd);
+    }
+}
+
+bool ComunicationsManagerEpoll::queueSessionRequests(int fd, SessionState &state)
+{
+    const std::string &received = state.mReceived;
+
+    size_t consumed = 0;
+    SessionFrameHeader header;
+    while (received.size() - consumed >= SESSION_FRAME_HEADER_SIZE)
+    {
+        std::string_view pending(received.data() + consumed, received.size() - consumed);
+        if (!parseSessionFrameHeader(pending, header))
+        {
+            LOG_err << "Received invalid session frame at socket " << fd;
+            return false;
+        }
+
+        if (pending.size() - SESSION_FRAME_HEADER_SIZE < header.mPayloadSize)
+        {
+            break; // keep waiting for the rest of the request
+        }
+
+        auto inf = std::make_unique<CmdPetitionPosixSockets>();
+        inf->outSocket = fd;
+        inf->mSession = state.mSession;
+        inf->mRequestId = header.mRequestId;
+        inf->setLine(std::string(pending.substr(SESSION_FRAME_HEADER_SIZE, header.mPayloadSize)));
+        consumed += SESSION_FRAME_HEADER_SIZE + header.mPayloadSize;
+
+        if (takesOverConnection(inf->getUniformLine()))
+        {
+            LOG_warn << "Rejecting session request " << header.mRequestId << " at socket " << fd << ": " << inf->getRedactedLine();
+            const std::string rejection = "Not allowed within a session: use a connection of its own\n";
+            if (!state.mSession->sendFrame(header.mRequestId, MCMD_NOTPERMITTED, rejection.data(), rejection.size()))
+            {
+                LOG_err << "ERROR writing to session socket " << fd << ": " << errno;
+                return false;
+            }
+            continue;
+        }
+        mReadyPetitions.push_back(std::move(inf));
+    }
+
+    state.mReceived.erase(0, consumed);
+    return true;
+}
+
+void ComunicationsManagerEpoll::endSession(int fd)
+{
+    LOG_debug << "Ending session at socket " << fd;
+    epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+    mSessions.erase(fd); // the socket gets closed once the requests in flight are done with it
+}
+
+void ComunicationsManagerEpoll::stopWaiting()
+{
+    LOG_verbose << "Shutting down main socket ";
+
+    if (sockfd >= 0 && shutdown(sockfd, SHUT_RDWR) == -1)
+    {
+        LOG_debug << "Failed to shut down main socket: " << errno;
+    }
+
+    if (mWakeUpFd >= 0 && eventfd_write(mWakeUpFd, 1) == -1)
+    {
+        LOG_err << "ERROR waking up event loop: " << errno;
+    }
+    LOG_verbose << "Main socket shut down";
+}
+
+CmdPetition* ComunicationsManagerEpoll::registerStateListener(std::unique_ptr<CmdPetition> &&inf)
+{
+    const int socket = ((CmdPetitionPosixSockets*) inf.get())->outSocket;
+
+    auto listener = ComunicationsManagerFileSockets::registerStateListener(std::move(inf));
+    if (listener)
+    {
+        // To get notified of hang ups (state listeners don't send anything). EPOLLOUT is added while messages are queued
+        addToEpoll(socket, EventSource::STATE_LISTENER_SOCKET, EPOLLRDHUP | EPOLLONESHOT);
+    }
+    return listener;
+}
+
+void ComunicationsManagerEpoll::onStateListenerPending(int socket)
+{
+    // Wait for it to be writable too (epoll_ctl is fine while the loop is waiting)
+    struct epoll_event ev = {};
+    ev.events = EPOLLOUT | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.u64 = toEpollData(socket, static_cast<uint32_t>(EventSource::STATE_LISTENER_SOCKET));
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_MOD, socket, &ev) == -1)
+    {
+        LOG_err << "ERROR waiting for state listener socket " << socket << " to be writable: " << errno;
+    }
+}
+
+void ComunicationsManagerEpoll::drainStateListenerSocket(int fd)
+{
+    serviceStateListeners([this, fd](CmdPetition *inf)
+    {
+        auto listener = static_cast<CmdPetitionPosixSockets *>(inf);
+        if (listener->outSocket != fd)
+        {
+            return 0;
+        }
+
+        int result = drainStateListener(listener); // re-arms EPOLLOUT if it would block again
+        if (result == 0 && listener->mStateQueue.empty())
+        {
+            // Back to getting notified of hang ups only (done while listeners are locked, so no informer re-arms it meanwhile)
+            struct epoll_event ev = {};
+            ev.events = EPOLLRDHUP | EPOLLONESHOT;
+            ev.data.u64 = toEpollData(fd, static_cast<uint32_t>(EventSource::STATE_LISTENER_SOCKET));
+            epoll_ctl(mEpollFd, EPOLL_CTL_MOD, fd, &ev);
+        }
+        return result;
+    });
+}
+
+int ComunicationsManagerEpoll::getMaxStateListeners() const
+{
+    static int maxListenersAllowed = computeMaxStateListeners(std::numeric_limits<int>::max());
+
+    return maxListenersAllowed;
+}
+
+std::unique_ptr<CmdPetition> ComunicationsManagerEpoll::getPetition()
+{
+    if (mReadyPetitions.empty())
+    {
+        auto inf = std::make_unique<CmdPetitionPosixSockets>();
+        inf->setLine("ERROR");
+        return inf;
+    }
+
+    auto inf = std::move(mReadyPetitions.front());
+    mReadyPetitions.pop_front();
+    return inf;
+}
+
+}//end namespace
+#endif
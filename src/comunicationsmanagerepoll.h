@@ -0,0 +1,102 @@
+/**
+ * @file src/comunicationsmanagerepoll.h
+ * @brief MEGAcmd: Communications manager using Unix Domain Sockets and epoll
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+#pragma once
+
+#ifdef __linux__
+
+#include "comunicationsmanagerfilesockets.h"
+
+#include <deque>
+#include <unordered_map>
+
+namespace megacmd {
+
+/**
+ * @brief Same protocol as ComunicationsManagerFileSockets, but waiting with epoll instead of select.
+ *
+ * A single event loop (run within waitForPetition) takes care of:
+ *  - the listening socket, accepting every pending connection (non-blocking).
+ *  - the accepted sockets, until the whole petition has been read (without blocking the loop on slow clients).
+ *  - the state listener sockets, to get rid of the listeners as soon as their clients hang up, and to write
+ *    the state messages their sockets did not take when informed (see StateListenerQueue).
+ *  - the persistent sessions (see SESSION_PETITION), whose requests become petitions without accepting
+ *    any other connection.
+ *
+ * It is not bound to FD_SETSIZE: the number of state listeners is only limited by the limit of open files.
+ */
+class ComunicationsManagerEpoll : public ComunicationsManagerFileSockets
+{
+    int mEpollFd = -1;
+    int mWakeUpFd = -1; // eventfd used by stopWaiting
+
+    // Accepted sockets whose petition has not been read yet (and what has been received so far)
+    std::unordered_map<int, std::string> mPendingSockets;
+
+    // Petitions read and not yet retrieved with getPetition
+    std::deque<std::unique_ptr<CmdPetition>> mReadyPetitions;
+
+    struct SessionState
+    {
+        std::shared_ptr<PetitionSession> mSession;
+        std::string mReceived; // incomplete request frames
+    };
+
+    // Open sessions, still sending requests
+    std::unordered_map<int, SessionState> mSessions;
+
+    enum class EventSource : uint32_t
+    {
+        LISTENING_SOCKET,
+        WAKE_UP,
+        PETITION_SOCKET,
+        STATE_LISTENER_SOCKET,
+        SESSION_SOCKET,
+    };
+
+    bool addToEpoll(int fd, EventSource source, uint32_t events);
+    void acceptPendingConnections();
+    void readPetition(int fd, uint32_t events);
+    void discardPendingSocket(int fd);
+    void startSession(int fd, std::string received, bool hungUp);
+    void readSessionRequests(int fd, uint32_t events);
+    bool queueSessionRequests(int fd, SessionState &state); // false if the session is to be ended
+    void endSession(int fd);
+    void drainStateListenerSocket(int fd);
+
+protected:
+    void onStateListenerPending(int socket) override;
+
+public:
+    ComunicationsManagerEpoll();
+    ~ComunicationsManagerEpoll();
+
+    bool receivedPetition() override;
+
+    int waitForPetition() override;
+
+    void stopWaiting() override;
+
+    CmdPetition* registerStateListener(std::unique_ptr<CmdPetition> &&inf) override;
+
+    int getMaxStateListeners() const override;
+
+    std::unique_ptr<CmdPetition> getPetition() override;
+};
+
+}//end namespace
+#endif
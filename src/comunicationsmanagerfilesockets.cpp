@@ -22,7 +22,10 @@
 #include "megacmdutils.h"
 #include <sys/ioctl.h>
 #include <sys/resource.h>
+#include <sys/uio.h>
 #include <errno.h>
+#include <poll.h>
+#include <limits>
 
 #ifdef __MACH__
 #define MSG_NOSIGNAL 0
@@ -36,6 +39,122 @@ using namespace mega;
 
 namespace megacmd {
 
+namespace {
+
+// Reads up to size bytes (all of them if waitAll, unless the peer closes the socket first) as long as the deadline
+// is not reached. Returns the number of bytes read, or -1 (with errno ETIMEDOUT past the deadline)
+ssize_t recvUntil(int socket, char *data, size_t size, bool waitAll, std::chrono::steady_clock::time_point deadline)
+{
+    size_t received = 0;
+    while (received < size)
+    {
+        const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0)
+        {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+
+        struct pollfd pfd = {socket, POLLIN, 0};
+        auto ready = poll(&pfd, 1, static_cast<int>(std::min<decltype(remaining)>(remaining, std::numeric_limits<int>::max())));
+        if (ready < 0 && errno != EINTR)
+        {
+            return -1;
+        }
+        if (ready <= 0)
+        {
+            continue;
+        }
+
+        auto n = recv(socket, data + received, size - received, MSG_DONTWAIT);
+        if (n < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                continue;
+            }
+            return -1;
+        }
+        if (n == 0)
+        {
+            break;
+        }
+
+        received += static_cast<size_t>(n);
+        if (!waitAll)
+        {
+            break;
+        }
+    }
+    return static_cast<ssize_t>(received);
+}
+
+// Writes all of the iovecs (even with short writes). Non-blocking sockets are waited for until writable
+bool sendAll(int socket, struct iovec *iov, int iovcnt)
+{
+    struct msghdr msg = {};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
+
+    size_t pending = 0;
+    for (int i = 0; i < iovcnt; ++i)
+    {
+        pending += iov[i].iov_len;
+    }
+
+    while (pending)
+    {
+        auto n = sendmsg(socket, &msg, MSG_NOSIGNAL); // as writev, but without SIGPIPE
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                struct pollfd pfd = {socket, POLLOUT, 0};
+                poll(&pfd, 1, -1);
+                continue;
+            }
+            return false;
+        }
+
+        pending -= static_cast<size_t>(n);
+
+        // skip what was written, in case of a short write
+        while (n > 0 && msg.msg_iovlen)
+        {
+            if (static_cast<size_t>(n) < msg.msg_iov->iov_len)
+            {
+                msg.msg_iov->iov_base = static_cast<char *>(msg.msg_iov->iov_base) + n;
+                msg.msg_iov->iov_len -= static_cast<size_t>(n);
+                break;
+            }
+            n -= static_cast<decltype(n)>(msg.msg_iov->iov_len);
+            ++msg.msg_iov;
+            --msg.msg_iovlen;
+        }
+    }
+    return true;
+}
+
+}
+
+bool PetitionSession::sendFrame(uint32_t requestId, int code, const char *payload, size_t size)
+{
+    std::string header = sessionFrameHeader(requestId, code, size);
+
+    struct iovec iov[2];
+    iov[0].iov_base = header.data();
+    iov[0].iov_len = header.size();
+    iov[1].iov_base = const_cast<char *>(payload);
+    iov[1].iov_len = size;
+
+    std::lock_guard<std::mutex> g(mWriteMutex);
+    return sendAll(mSocket, iov, 2);
+}
+
 ComunicationsManagerFileSockets::ComunicationsManagerFileSockets()
 {
     count = 0;
@@ -202,32 +321,34 @@ CmdPetition* ComunicationsManagerFileSockets::registerStateListener(std::unique_
     const int socket = ((CmdPetitionPosixSockets*) inf.get())->outSocket;
     LOG_debug << "Registering state listener petition with socket: " << socket;
 
-#ifndef NDEBUG
-    // let's not be gentle with state listener sockets to prevent frozen clients from stopping the server
-    const timeval timeout { .tv_sec = 10, .tv_usec = 0};
-    if (setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) < 0)
+    // state messages are queued and written without blocking: frozen clients cannot stop the server (nor other clients)
+    int flags = fcntl(socket, F_GETFL, 0);
+    if (flags == -1 || fcntl(socket, F_SETFL, flags | O_NONBLOCK) == -1)
     {
-        LOG_err << "ERROR setting state listener socket timeout: " << errno;
+        LOG_err << "ERROR setting state listener socket as non-blocking: " << errno;
     }
-#endif
     return ComunicationsManager::registerStateListener(std::move(inf));
 }
 
-int ComunicationsManagerFileSockets::getMaxStateListeners() const
+int ComunicationsManagerFileSockets::computeMaxStateListeners(int fdCeiling) const
 {
-    static int maxListenersAllowed = [this](){
-        struct rlimit limit;
-        if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
-        {
-            LOG_err << "Failed to get ulimit -n (errno: " << errno << "); falling back to max state listeners default";
-            return ComunicationsManager::getMaxStateListeners();
-        }
-        int systemNumFilesLimit = static_cast<int>(limit.rlim_cur);
-        int maxListeners = systemNumFilesLimit - std::max(100, static_cast<int>(systemNumFilesLimit * 0.20)); // leave 20% or 100 file descriptors for libraries and other fds:
-        maxListeners = std::min(maxListeners, static_cast<int>(FD_SETSIZE * 0.4)); // we don't want to use fd with numbers > 1024: select will not digest them well: lets play a safe 60% margin.
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+    {
+        LOG_err << "Failed to get ulimit -n (errno: " << errno << "); falling back to max state listeners default";
+        return ComunicationsManager::getMaxStateListeners();
+    }
+    int systemNumFilesLimit = static_cast<int>(std::min<rlim_t>(limit.rlim_cur, std::numeric_limits<int>::max()));
+    int maxListeners = systemNumFilesLimit - std::max(100, static_cast<int>(systemNumFilesLimit * 0.20)); // leave 20% or 100 file descriptors for libraries and other fds:
+    maxListeners = std::min(maxListeners, fdCeiling);
 
-        return std::max(2/*minimum requirement*/, maxListeners); // maxListeners may be negative based on above calculations (unexpected). Let's play our chances of survival despite that.
-    }();
+    return std::max(2/*minimum requirement*/, maxListeners); // maxListeners may be negative based on above calculations (unexpected). Let's play our chances of survival despite that.
+}
+
+int ComunicationsManagerFileSockets::getMaxStateListeners() const
+{
+    // we don't want to use fd with numbers > 1024: select will not digest them well: lets play a safe 60% margin.
+    static int maxListenersAllowed = computeMaxStateListeners(static_cast<int>(FD_SETSIZE * 0.4));
 
     return maxListenersAllowed;
 }
@@ -248,8 +369,24 @@ void ComunicationsManagerFileSockets::returnAndClosePetition(std::unique_ptr<Cmd
         return;
     }
 
+    flushPartialOutputs(inf.get());
+
     string sout = s->str();
 
+    if (auto &session = ((CmdPetitionPosixSockets *) inf.get())->mSession)
+    {
+        // The out code ends the request: the socket is kept open for the rest of the session
+        if (((CmdPetitionPosixSockets *) inf.get())->mQuestionDismissed && outCode == MCMD_OK)
+        {
+            outCode = MCMD_NOTPERMITTED; // it did not go as the user would have been asked
+        }
+        if (!session->sendFrame(((CmdPetitionPosixSockets *) inf.get())->mRequestId, outCode, sout.data(), sout.size()))
+        {
+            LOG_err << "ERROR writing response to session socket: " << errno;
+        }
+        return;
+    }
+
     auto n = send(socket, &outCode, sizeof(outCode), MSG_NOSIGNAL);
     if (n < 0)
     {
@@ -295,11 +432,11 @@ void ComunicationsManagerFileSockets::sendPartialOutputImpl(CmdPetition *inf, ch
         return;
     }
 
-    int connectedsocket = ((CmdPetitionPosixSockets *)inf)->outSocket;
-    assert(connectedsocket != -1);
-    if (connectedsocket == -1)
+    auto petition = (CmdPetitionPosixSockets *)inf;
+    assert(petition->outSocket != -1);
+    if (petition->outSocket == -1)
     {
-        std::cerr << "Return and close: no valid outsocket " << ((CmdPetitionPosixSockets *)inf)->outSocket << endl;
+        std::cerr << "Return and close: no valid outsocket " << petition->outSocket << endl;
         return;
     }
 
@@ -310,34 +447,98 @@ void ComunicationsManagerFileSockets::sendPartialOutputImpl(CmdPetition *inf, ch
         return;
     }
 
-    if (size)
+    if (!size)
     {
-        int outCode = sendAsError ? MCMD_PARTIALERR : MCMD_PARTIALOUT;
-        auto n = send(connectedsocket, (void*)&outCode, sizeof( outCode ), MSG_NOSIGNAL);
-        if (n < 0)
-        {
-            std::cerr << "ERROR writing MCMD_PARTIALOUT/MCMD_PARTIALERR to socket: " << errno << endl;
-            if (errno == EPIPE)
-            {
-                std::cerr << "WARNING: Client disconnected, the rest of the output will be discarded" << endl;
-                inf->clientDisconnected = true;
-            }
-            return;
-        }
-        n = send(connectedsocket, (void*)&size, sizeof( size ), MSG_NOSIGNAL);
-        if (n < 0)
-        {
-            std::cerr << "ERROR writing size of partial output to socket: " << errno << endl;
-            return;
-        }
+        return;
+    }
 
+    int outCode = sendAsError ? MCMD_PARTIALERR : MCMD_PARTIALOUT;
 
-        n = send(connectedsocket, s, size, MSG_NOSIGNAL); // for some reason without the max recv never quits in the client for empty responses
+    std::lock_guard<std::mutex> g(petition->mPartialOutputMutex);
+    auto &buffer = petition->mPartialOutputBuffer;
 
-        if (n < 0)
+    // outputs and errors go in different frames: keep their relative order
+    if (!buffer.empty() && (petition->mPartialOutputCode != outCode || buffer.size() + size > PARTIAL_OUTPUT_FLUSH_THRESHOLD))
+    {
+        flushPartialOutputBuffer(petition);
+    }
+
+    if (size >= PARTIAL_OUTPUT_FLUSH_THRESHOLD)
+    {
+        sendPartialOutputFrame(petition, outCode, s, size); // large chunks (e.g. cat) are not worth copying
+        return;
+    }
+
+    petition->mPartialOutputCode = outCode;
+    buffer.append(s, size);
+}
+
+void ComunicationsManagerFileSockets::flushPartialOutputs(CmdPetition *inf)
+{
+    auto petition = (CmdPetitionPosixSockets *)inf;
+    std::lock_guard<std::mutex> g(petition->mPartialOutputMutex);
+    flushPartialOutputBuffer(petition);
+}
+
+bool ComunicationsManagerFileSockets::isClientConnected(CmdPetition *inf)
+{
+    auto petition = (CmdPetitionPosixSockets *)inf;
+    if (petition->clientDisconnected || petition->outSocket == -1)
+    {
+        return false;
+    }
+
+    // Only a hang up in both directions counts: session clients may stop sending while still reading
+    struct pollfd pfd = {petition->outSocket, 0, 0};
+    if (poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLHUP | POLLERR)))
+    {
+        petition->clientDisconnected = true;
+    }
+    return !petition->clientDisconnected;
+}
+
+void ComunicationsManagerFileSockets::flushPartialOutputBuffer(CmdPetitionPosixSockets *inf)
+{
+    if (inf->mPartialOutputBuffer.empty())
+    {
+        return;
+    }
+
+    if (!inf->clientDisconnected)
+    {
+        sendPartialOutputFrame(inf, inf->mPartialOutputCode, inf->mPartialOutputBuffer.data(), inf->mPartialOutputBuffer.size());
+    }
+    inf->mPartialOutputBuffer.clear(); // capacity is kept for the following outputs
+}
+
+// Note: no logging here: logs may be directed to this very petition
+void ComunicationsManagerFileSockets::sendPartialOutputFrame(CmdPetitionPosixSockets *inf, int outCode, const char *s, size_t size)
+{
+    bool sent = false;
+    if (inf->mSession)
+    {
+        sent = inf->mSession->sendFrame(inf->mRequestId, outCode, s, size);
+    }
+    else
+    {
+        // The whole frame (code, size & contents) goes in a single gathered write
+        struct iovec iov[3];
+        iov[0].iov_base = &outCode;
+        iov[0].iov_len = sizeof(outCode);
+        iov[1].iov_base = &size;
+        iov[1].iov_len = sizeof(size);
+        iov[2].iov_base = const_cast<char *>(s);
+        iov[2].iov_len = size;
+        sent = sendAll(inf->outSocket, iov, 3);
+    }
+
+    if (!sent)
+    {
+        std::cerr << "ERROR writing partial output to socket: " << errno << endl;
+        if (errno == EPIPE)
         {
-            std::cerr << "ERROR writing to socket partial output: " << errno << endl;
-            return;
+            std::cerr << "WARNING: Client disconnected, the rest of the output will be discarded" << endl;
+            inf->clientDisconnected = true;
         }
     }
 }
@@ -363,30 +564,122 @@ int ComunicationsManagerFileSockets::informStateListener(CmdPetition *inf, const
         return 0;
     }
 
-#ifdef __MACH__
-#define MSG_NOSIGNAL 0
-#endif
+    auto listener = static_cast<CmdPetitionPosixSockets *>(inf);
+    if (!listener->mStateQueue.push(s))
+    {
+        LOG_warn << "Unregistering listening client not keeping up with its state messages (" << listener->mStateQueue.getQueuedBytes()
+                 << " bytes queued). Original petition: " << inf->getRedactedLine();
+        return -1;
+    }
+    return drainStateListener(listener);
+}
 
-    auto n = send(connectedsocket, s.data(), s.size(), MSG_NOSIGNAL);
-    if (n < 0)
+int ComunicationsManagerFileSockets::drainStateListener(CmdPetitionPosixSockets *inf)
+{
+    const int socket = inf->outSocket;
+    auto result = inf->mStateQueue.drain([socket](const char *data, size_t size)
+    {
+        return send(socket, data, size, MSG_NOSIGNAL);
+    });
+
+    if (result == StateListenerQueue::DrainResult::FAILED)
     {
-        if (errno == EPIPE) //socket closed
+        if (errno == EPIPE || errno == ECONNRESET) //socket closed
         {
             LOG_verbose << "Unregistering no longer listening client. Original petition: " << inf->getRedactedLine();
-            return -1;
         }
-        else if (errno == EAGAIN || errno == EWOULDBLOCK) // timed out
+        else
+        {
+            LOG_err << "ERROR writing to state listener socket " << socket << ": " << errno << ". Unregistering it";
+        }
+        return -1;
+    }
+
+    if (result == StateListenerQueue::DrainResult::PENDING)
+    {
+        if (inf->mStateQueue.isStalled())
         {
-            LOG_warn << "Unregistering timed out listening client. Original petition: " << inf->getRedactedLine();
+            LOG_warn << "Unregistering stalled listening client (" << inf->mStateQueue.getQueuedMessages()
+                     << " messages queued). Original petition: " << inf->getRedactedLine();
             return -1;
         }
-        else
+        onStateListenerPending(socket);
+    }
+    return 0;
+}
+
+bool ComunicationsManagerFileSockets::readPetition(int socket, std::string &petition)
+{
+    // (this runs in the thread accepting petitions: a client not sending its petition must not hold up the others)
+    const auto deadline = std::chrono::steady_clock::now() + mPetitionReadTimeout;
+
+    char header[PETITION_FRAME_HEADER_SIZE];
+    auto n = recvUntil(socket, header, sizeof(header), false, deadline);
+    if (n < 0)
+    {
+        return false;
+    }
+
+    uint64_t payloadSize = 0;
+    auto status = parsePetitionFrameHeader(std::string_view(header, n), payloadSize);
+    if (status == PetitionFrameStatus::INCOMPLETE && n > 0) // header written in pieces
+    {
+        auto rest = recvUntil(socket, header + n, sizeof(header) - n, true, deadline);
+        if (rest < 0)
         {
-            LOG_err << "ERROR writing to socket: " << errno;
+            return false;
         }
+        n += rest;
+        status = parsePetitionFrameHeader(std::string_view(header, n), payloadSize);
     }
 
-    return 0;
+    if (status == PetitionFrameStatus::FRAMED)
+    {
+        petition.resize(payloadSize);
+        if (payloadSize && recvUntil(socket, petition.data(), payloadSize, true, deadline) != static_cast<ssize_t>(payloadSize))
+        {
+            return false;
+        }
+        return send(socket, PETITION_FRAME_ACK, sizeof(PETITION_FRAME_ACK), MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(PETITION_FRAME_ACK));
+    }
+
+    if (status == PetitionFrameStatus::INVALID)
+    {
+        LOG_err << "Received petition frame with unsupported version or size";
+        errno = EPROTO;
+        return false;
+    }
+
+    // Raw petition from a legacy client: read while there is data available. Nothing delimits it, so a petition
+    // arriving in pieces is cut short at the first gap (as it always was): only framed ones are read whole
+    petition.assign(header, strnlen(header, n));
+    if (n < static_cast<ssize_t>(sizeof(header)))
+    {
+        return true;
+    }
+
+    for (;;)
+    {
+        int total_available_bytes = 0; // FIONREAD writes an int
+        if (-1 == ioctl(socket, FIONREAD, &total_available_bytes))
+        {
+            LOG_err << "Failed to PeekNamedPipe. errno: " << errno;
+            return true;
+        }
+
+        if (total_available_bytes == 0)
+        {
+            return true;
+        }
+
+        n = read(socket, buffer, 1023);
+        if (n < 0)
+        {
+            return false;
+        }
+        buffer[n] = '\0';
+        petition.append(buffer);
+    }
 }
 
 /**
@@ -423,34 +716,16 @@ std::unique_ptr<CmdPetition> ComunicationsManagerFileSockets::getPetition()
     }
 
     string wholepetition;
-
-    int n = read(newsockfd, buffer, 1023);
-    while(n == 1023)
+    if (!readPetition(newsockfd, wholepetition))
     {
-        unsigned long int total_available_bytes;
-        if (-1 == ioctl(newsockfd, FIONREAD, &total_available_bytes))
+        if (errno == ETIMEDOUT)
         {
-            LOG_err << "Failed to PeekNamedPipe. errno: " << errno;
-            break;
+            LOG_warn << "Client did not send its petition in time at getPetition. Dismissing it";
         }
-
-        if (total_available_bytes == 0)
+        else
         {
-            break;
+            LOG_fatal << "ERROR reading from socket at getPetition: " << errno;
         }
-
-        buffer[n] = '\0';
-        wholepetition.append(buffer);
-        n = read(newsockfd, buffer, 1023);
-    }
-    if (n >=0 )
-    {
-        buffer[n] = '\0';
-        wholepetition.append(buffer);
-    }
-    if (n < 0)
-    {
-        LOG_fatal << "ERROR reading from socket at getPetition: " << errno;
         inf->setLine("ERROR");
         close(newsockfd);
         return inf;
@@ -462,6 +737,25 @@ std::unique_ptr<CmdPetition> ComunicationsManagerFileSockets::getPetition()
     return inf;
 }
 
+bool ComunicationsManagerFileSockets::dismissQuestionInSession(CmdPetition *inf, const string &question)
+{
+    auto petition = (CmdPetitionPosixSockets *)inf;
+    if (!petition->mSession)
+    {
+        return false;
+    }
+
+    // Sessions are not interactive (as clients not able to read responses): show the question that is dismissed,
+    // and have the request fail
+    petition->mQuestionDismissed = true;
+    string dismissed = question + "\n(dismissed: non-interactive session)\n";
+    if (!petition->mSession->sendFrame(petition->mRequestId, MCMD_PARTIALERR, dismissed.data(), dismissed.size()))
+    {
+        LOG_err << "ERROR writing to session socket: " << errno;
+    }
+    return true;
+}
+
 int ComunicationsManagerFileSockets::getConfirmation(CmdPetition *inf, string message)
 {
     int connectedsocket = ((CmdPetitionPosixSockets *)inf)->outSocket;
@@ -472,6 +766,13 @@ int ComunicationsManagerFileSockets::getConfirmation(CmdPetition *inf, string me
         return false;
     }
 
+    flushPartialOutputs(inf); // the question must come after whatever was printed before
+
+    if (dismissQuestionInSession(inf, message))
+    {
+        return MCMDCONFIRM_NO;
+    }
+
     int outCode = MCMD_REQCONFIRM;
     auto n = send(connectedsocket, (void*)&outCode, sizeof( outCode ), MSG_NOSIGNAL);
     if (n < 0)
@@ -500,6 +801,13 @@ string ComunicationsManagerFileSockets::getUserResponse(CmdPetition *inf, string
         return "FAILED";
     }
 
+    flushPartialOutputs(inf);
+
+    if (dismissQuestionInSession(inf, message))
+    {
+        return "FAILED";
+    }
+
     int outCode = MCMD_REQSTRING;
     auto n = send(connectedsocket, (void*)&outCode, sizeof( outCode ), MSG_NOSIGNAL);
     if (n < 0)
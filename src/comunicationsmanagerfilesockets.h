@@ -21,25 +21,69 @@
 #ifndef WIN32
 
 #include "comunicationsmanager.h"
+#include "megacmd_petition_frame.h"
+#include "megacmd_state_listener_queue.h"
 
 #include <sys/types.h>
 #include <sys/socket.h>
 
 #include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
 
 namespace megacmd {
+
+// A connection kept open to serve many petitions (see SESSION_PETITION), closed once none of them needs it
+struct PetitionSession
+{
+    const int mSocket;
+    std::mutex mWriteMutex; // frames of concurrent petitions must not interleave
+
+    explicit PetitionSession(int socket) : mSocket(socket) {}
+
+    ~PetitionSession()
+    {
+        shutdown(mSocket, SHUT_RDWR);
+        close(mSocket);
+    }
+
+    // Sends a whole session frame, waiting for the socket to be writable if needed. Note: no logging in here
+    bool sendFrame(uint32_t requestId, int code, const char *payload, size_t size);
+};
+
 struct CmdPetitionPosixSockets: public CmdPetition
 {
     int outSocket = -1;
 
+    // Set for the petitions received within a persistent session, whose socket is shared with other petitions
+    std::shared_ptr<PetitionSession> mSession;
+    uint32_t mRequestId = 0;
+    bool mQuestionDismissed = false; // (the request ends with an error)
+
+    // Partial outputs (of the same kind) not yet sent to the client, coalesced into a single frame
+    std::mutex mPartialOutputMutex;
+    std::string mPartialOutputBuffer;
+    int mPartialOutputCode = MCMD_PARTIALOUT;
+
+    // State messages not yet written (for petitions registered as state listeners)
+    StateListenerQueue mStateQueue;
+
     virtual ~CmdPetitionPosixSockets()
     {
-        shutdown(outSocket, SHUT_RDWR);
-        close(outSocket);
+        if (!mSession)
+        {
+            shutdown(outSocket, SHUT_RDWR);
+            close(outSocket);
+        }
     }
 
     std::string getPetitionDetails() const override
     {
+        if (mSession)
+        {
+            return "socket output: " + std::to_string(outSocket) + " (session request " + std::to_string(mRequestId) + ")";
+        }
         return "socket output: " + std::to_string(outSocket);
     }
 };
@@ -52,7 +96,6 @@ private:
     std::atomic<bool> mHasPetition;
 
     // sockets and asociated variables
-    int sockfd;
     char buffer[1024];
     struct sockaddr_in serv_addr, cli_addr;
 
@@ -62,7 +105,43 @@ private:
     std::mutex informerMutex;
 
     void sendPartialOutputImpl(CmdPetition *inf, char *s, size_t size, bool binaryContents, bool sendAsError);
+
+    // Reads either a framed petition or a raw one (legacy clients: whatever is available, see the .cpp),
+    // failing if it takes longer than mPetitionReadTimeout
+    bool readPetition(int socket, std::string &petition);
+    std::chrono::milliseconds mPetitionReadTimeout = PETITION_READ_TIMEOUT;
+
+    // Requires mPartialOutputMutex of the petition to be locked
+    void flushPartialOutputBuffer(CmdPetitionPosixSockets *inf);
+    void sendPartialOutputFrame(CmdPetitionPosixSockets *inf, int outCode, const char *s, size_t size);
+
+    // Petitions within a session cannot be asked anything: true if so (the client is shown the question)
+    bool dismissQuestionInSession(CmdPetition *inf, const std::string &question);
+
+protected:
+    int sockfd; // listening socket
+
+    // Max state listeners allowed given the process limit of open files, never above fdCeiling
+    int computeMaxStateListeners(int fdCeiling) const;
+
+    /**
+     * @brief Writes the queued state messages of a listener, without blocking
+     * @return -1 if the listener is to be removed: its socket failed, or it has not taken anything for too long
+     */
+    int drainStateListener(CmdPetitionPosixSockets *inf);
+
+    // Called when a listener has messages left that its socket would not take: they are written on the next inform,
+    // unless the implementation drains them when the socket becomes writable
+    virtual void onStateListenerPending(int socket) {}
+
 public:
+    // Buffered partial outputs are sent once they reach this size (besides explicit flushes)
+    static constexpr size_t PARTIAL_OUTPUT_FLUSH_THRESHOLD = 64 * 1024;
+
+    // Time given to a client, once connected, to send its whole petition
+    static constexpr std::chrono::milliseconds PETITION_READ_TIMEOUT = std::chrono::seconds(10);
+    void setPetitionReadTimeout(std::chrono::milliseconds timeout) { mPetitionReadTimeout = timeout; }
+
     ComunicationsManagerFileSockets();
 
     int initialize();
@@ -88,6 +167,10 @@ public:
     void sendPartialError(CmdPetition *inf, OUTSTRING *s) override;
     void sendPartialError(CmdPetition *inf, char *s, size_t size, bool binaryContents = false) override;
 
+    void flushPartialOutputs(CmdPetition *inf) override;
+
+    bool isClientConnected(CmdPetition *inf) override;
+
     int informStateListener(CmdPetition *inf, const std::string &s) override;
 
 
@@ -45,6 +45,12 @@
 #include <sys/file.h> //flock
 #endif
 
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif
+
 #ifdef _WIN32
 #define PATH_MAX_LOCAL_BACKUP MAX_PATH
 #else
@@ -191,61 +197,160 @@ void ConfigurationManager::saveSession(const char*session)
 
 string ConfigurationManager::saveProperty(const char *property, const char *value)
 {
-    std::lock_guard<std::recursive_mutex> g(settingsMutex);
+    return getConfigStore().set(property, value);
+}
 
+ConfigStore &ConfigurationManager::getConfigStore()
+{
+    static ConfigStore configStore;
+    if (configStore.isLoaded())
+    {
+        return configStore;
+    }
+
+    std::lock_guard<std::recursive_mutex> g(settingsMutex);
     if (mConfigFolder.empty())
     {
         loadConfigDir();
     }
-    assert(!mConfigFolder.empty());
+    if (!mConfigFolder.empty() && !configStore.isLoaded())
+    {
+        configStore.setWriteErrorHandler([](const std::string &error) { LOG_err << error; });
+        configStore.load(mConfigFolder / "megacmd.cfg");
+    }
+    return configStore;
+}
 
-    bool found = false;
-    const fs::path configFilePath = mConfigFolder / "megacmd.cfg";
+void ConfigurationManager::flushConfiguration()
+{
+    getConfigStore().flush();
+}
 
-    stringstream formerlines;
+void ConfigurationManager::addConfigurationChangeListener(ConfigStore::ChangeListener listener)
+{
+    getConfigStore().addChangeListener(std::move(listener));
+}
 
-    ifstream infile(configFilePath);
-    string line, prevValue;
-    while (getline(infile, line))
+#ifdef __linux__
+namespace {
+// Calls onChanged whenever a file of a folder is written, replaced (e.g: by a text editor) or removed
+class FileWatcher
+{
+public:
+    FileWatcher(const fs::path &folder, std::string fileName, std::function<void()> onChanged) :
+        mFileName(std::move(fileName)),
+        mOnChanged(std::move(onChanged))
     {
-        if (line.length() > 0 && line[0] != '#')
+        mInotifyFd = inotify_init1(IN_CLOEXEC);
+        mWakeFd = eventfd(0, EFD_CLOEXEC);
+        if (mInotifyFd < 0 || mWakeFd < 0
+            || inotify_add_watch(mInotifyFd, folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE) < 0)
         {
-            string key;
-            size_t pos = line.find("=");
-            if (pos != string::npos)
+            LOG_warn << "Failed to watch " << folder << " for configuration changes: " << errno;
+            return;
+        }
+        mThread = std::thread([this] { loop(); });
+    }
+
+    ~FileWatcher()
+    {
+        if (mThread.joinable())
+        {
+            uint64_t wake = 1;
+            if (write(mWakeFd, &wake, sizeof(wake)) != sizeof(wake))
+            {
+                LOG_err << "Failed to stop watching for configuration changes: " << errno;
+            }
+            mThread.join();
+        }
+        for (int fd : {mInotifyFd, mWakeFd})
+        {
+            if (fd >= 0)
             {
-                key = line.substr(0, pos);
-                rtrimProperty(key, ' ');
+                close(fd);
+            }
+        }
+    }
 
-                if (!strcmp(key.c_str(), property) && !found)
-                {
-                    formerlines << property << "=" << value << endl;
-                    prevValue = line.substr(pos + 1);
-                    found = true;
-                }
-                else
+private:
+    void loop()
+    {
+        alignas(struct inotify_event) char buffer[4096];
+        while (true)
+        {
+            struct pollfd fds[2] = {{mInotifyFd, POLLIN, 0}, {mWakeFd, POLLIN, 0}};
+            if (poll(fds, 2, -1) < 0)
+            {
+                if (errno == EINTR)
                 {
-                    formerlines << line << endl;
+                    continue;
                 }
+                LOG_err << "Stopped watching for configuration changes: " << errno;
+                return;
+            }
+            if (fds[1].revents)
+            {
+                return;
+            }
+
+            auto length = read(mInotifyFd, buffer, sizeof(buffer));
+            bool changed = false;
+            for (char *event = buffer; length > 0 && event < buffer + length; )
+            {
+                auto *inotifyEvent = reinterpret_cast<struct inotify_event *>(event);
+                changed = changed || (inotifyEvent->len && mFileName == inotifyEvent->name);
+                event += sizeof(struct inotify_event) + inotifyEvent->len;
             }
-            else
+            if (changed)
             {
-                formerlines << line << endl;
+                mOnChanged();
             }
         }
     }
 
-    ofstream fo(configFilePath);
-    if (fo.is_open())
+    std::string mFileName;
+    std::function<void()> mOnChanged;
+    int mInotifyFd = -1;
+    int mWakeFd = -1;
+    std::thread mThread;
+};
+
+std::unique_ptr<FileWatcher> configFileWatcher;
+}
+#endif
+
+void ConfigurationManager::startWatchingConfigurationFile()
+{
+#ifdef __linux__
+    std::lock_guard<std::recursive_mutex> g(settingsMutex);
+    ConfigStore &configStore = getConfigStore();
+    if (configFileWatcher || mConfigFolder.empty())
     {
-        fo << formerlines.str();
-        if (!found)
+        return;
+    }
+
+    // (our own writes leave the file as the store knows it, so they are no changes)
+    configFileWatcher = std::make_unique<FileWatcher>(mConfigFolder, "megacmd.cfg", [&configStore]()
+    {
+        auto changedKeys = configStore.reload();
+        if (!changedKeys.empty())
         {
-            fo << property << "=" << value << endl;
+            LOG_debug << "Configuration file edited: " << joinStrings(changedKeys, ", ", false) << " changed";
         }
-        fo.close();
+    });
+#endif
+}
+
+void ConfigurationManager::stopWatchingConfigurationFile()
+{
+#ifdef __linux__
+    std::unique_ptr<FileWatcher> watcher;
+    {
+        std::lock_guard<std::recursive_mutex> g(settingsMutex);
+        watcher = std::move(configFileWatcher);
     }
-    return prevValue;
+    watcher.reset(); // (joins its thread, which might be notifying listeners)
+#endif
 }
 
 void ConfigurationManager::migrateSyncConfig(MegaApi *api)
@@ -856,65 +961,14 @@ bool ConfigurationManager::unlockExecution(const fs::path &lockFileFolder)
 
 string ConfigurationManager::getConfigurationSValue(string propertyName)
 {
-    std::lock_guard<std::recursive_mutex> g(settingsMutex);
-
-    if (mConfigFolder.empty())
-    {
-        loadConfigDir();
-    }
-    if (!mConfigFolder.empty())
-    {
-        const fs::path configFilePath = mConfigFolder / "megacmd.cfg";
-        return getPropertyFromFile(configFilePath, propertyName.c_str());
-    }
-    return "";
+    return getConfigStore().get(propertyName).value_or("");
 }
 
 void ConfigurationManager::clearConfigurationFile()
 {
-    std::lock_guard<std::recursive_mutex> g(settingsMutex);
-
-    if (mConfigFolder.empty())
-    {
-        loadConfigDir();
-    }
-    if (!mConfigFolder.empty())
-    {
-        const fs::path configFilePath = mConfigFolder / "megacmd.cfg";
-        ifstream infile(configFilePath);
-
-        stringstream formerlines;
-        string line;
-        while (getline(infile, line))
-        {
-            size_t pos;
-            if (line.length() > 0 && line[0] != '#' && (pos = line.find("=")) != string::npos)
-            {
-                string key;
-                key = line.substr(0, pos);
-                rtrimProperty(key, ' ');
-
-                for (unsigned int i = 0; i < sizeof(persistentmcmdconfigurationkeys)/sizeof(persistentmcmdconfigurationkeys[0]); i++)
-                {
-                    if (!strcmp(key.c_str(), persistentmcmdconfigurationkeys[i]))
-                    {
-                        formerlines << line << endl;
-                    }
-                }
-            }
-            else
-            {
-                formerlines << line << endl;
-            }
-        }
-
-        ofstream fo(configFilePath);
-        if (fo.is_open())
-        {
-            fo << formerlines.str();
-            fo.close();
-        }
-    }
+    ConfigStore &configStore = getConfigStore();
+    configStore.retainOnly(std::set<std::string>(std::begin(persistentmcmdconfigurationkeys), std::end(persistentmcmdconfigurationkeys)));
+    configStore.flush();
 }
 
 ConfiguratorMegaApiHelper::ConfiguratorMegaApiHelper()
@@ -972,13 +1026,57 @@ ConfiguratorMegaApiHelper::ConfiguratorMegaApiHelper()
                                 std::nullopt/*megaApiGetter*/,
                                 validatorULL());
 
-    mConfigurators.emplace_back("exported_folders_sdks", "Number of additional SDK instances loaded at startup",
-                                "This controls the number of SDK instances that are created at startup in order to download or import contents from exported folder links. "
-                                "Default 5. Min 0. Max 20. If set to 0, you will not be able to download or import from folder links.",
-                                configSetterSyncULLCb([](MegaApi *api, auto value){ return true;/*TODO: implement reactiveness to value changes*/ }),
+    mConfigurators.emplace_back("exported_folders_sdks", "Max number of additional SDK instances for exported folder links",
+                                "This controls the max number of SDK instances used to download or import contents from exported folder links. "
+                                "They are created when needed and destroyed after 5 minutes unused. "
+                                "Default 5. Min 0. Max 20. If set to 0, you will not be able to download or import from folder links. Changes apply immediately.",
+                                configSetterSyncULLCb([](MegaApi *, auto value){ setMaxApiFolders(static_cast<size_t>(value)); return true; }),
                                 confGetter,
                                 std::nullopt/*megaApiGetter*/,
                                 validatorULL(0, 20));
+
+    mConfigurators.emplace_back("petition_workers", "Max number of threads processing commands in parallel",
+                                "This controls the size of the pool of threads that process the commands received by the server. "
+                                "Threads are created on demand and reused afterwards. Commands received while all of them are busy wait in a queue. "
+                                "Default 100. Min 4. Max 1000. Changes will take effect after restarting the server.",
+                                configSetterSyncULLCb([](MegaApi *, auto){ return true; }), // (read once, at startup)
+                                confGetter,
+                                std::nullopt/*megaApiGetter*/,
+                                validatorULL(4, 1000));
+
+    mConfigurators.emplace_back("progress_update_rate", "Max number of progress updates per second of transfer commands",
+                                "This controls how often the progress of commands like get or put is refreshed. "
+                                "Default 10. Min 1. Max 1000. Changes will apply to the commands executed afterwards.",
+                                configSetterSyncULLCb([](MegaApi *, auto){ return true; }), // (read by each command as it starts)
+                                confGetter,
+                                std::nullopt/*megaApiGetter*/,
+                                validatorULL(1, 1000));
+
+    mConfigurators.emplace_back("transfers_history_size", "Max number of completed transfers kept in memory",
+                                "This controls how many of the most recent completed transfers can be listed with \"transfers --show-completed\". "
+                                "Default 10000. Min 0. Max 1000000. Changes apply immediately.",
+                                configSetterSyncULLCb([](MegaApi *, auto value){ setTransfersHistorySize(static_cast<size_t>(value)); return true; }),
+                                confGetter,
+                                std::nullopt/*megaApiGetter*/,
+                                validatorULL(0, 1000000));
+
+    mConfigurators.emplace_back("transfers_history_disk", "Max number of completed transfers kept on disk",
+                                "Completed transfers no longer kept in memory are stored on disk (within the configuration folder) up to this number, "
+                                "so that they can still be listed. "
+                                "Default 0 (disabled). Min 0. Max 100000000. Changes will take effect after restarting the server.",
+                                configSetterSyncULLCb([](MegaApi *, auto){ return true; }), // (read once, at startup)
+                                confGetter,
+                                std::nullopt/*megaApiGetter*/,
+                                validatorULL(0, 100000000));
+
+    mConfigurators.emplace_back("requests_in_flight", "Max number of requests issued at once by a command",
+                                "This controls how many requests commands operating on many nodes (e.g: rm, mv or cp with wildcards) "
+                                "issue without waiting for the previous ones to finish. "
+                                "Default 32. Min 1. Max 1024. Changes will apply to the commands executed afterwards.",
+                                configSetterSyncULLCb([](MegaApi *, auto){ return true; }), // (read by each command as it starts)
+                                confGetter,
+                                std::nullopt/*megaApiGetter*/,
+                                validatorULL(1, 1024));
 }
 
 const std::vector<ConfiguratorMegaApiHelper::ValueConfigurator> & ConfiguratorMegaApiHelper::getConfigurators()
@@ -986,4 +1084,32 @@ const std::vector<ConfiguratorMegaApiHelper::ValueConfigurator> & ConfiguratorMe
     return mConfigurators;
 }
 
+void ConfiguratorMegaApiHelper::onConfigurationChanged(MegaApi *api, const std::string &key, const std::optional<std::string> &value)
+{
+    auto it = std::find_if(mConfigurators.begin(), mConfigurators.end(), [&key](const ValueConfigurator &vc) { return vc.mKey == key; });
+    if (it == mConfigurators.end())
+    {
+        return;
+    }
+
+    if (!value)
+    {
+        LOG_debug << "Configuration value " << key << " unset. Its default will apply after restarting the server";
+        return;
+    }
+
+    if (it->mValidator && !it->mValidator.value()(value->c_str()))
+    {
+        LOG_err << "Failed to change " << it->mKey << " (" << it->mDescription << ") after editing the configuration file. Invalid value: " << *value;
+        return;
+    }
+
+    if (!it->mSetter(api, key, value->c_str()))
+    {
+        LOG_err << "Failed to change " << it->mKey << " (" << it->mDescription << ") after editing the configuration file. Setting failed";
+        return;
+    }
+    LOG_debug << "Configuration value " << key << " changed to " << *value;
+}
+
 }//end namespace
@@ -20,6 +20,7 @@
 #define CONFIGURATIONMANAGER_H
 
 #include "megacmd.h"
+#include "megacmd_config_store.h"
 #include <map>
 #include <set>
 
@@ -44,6 +45,9 @@ private:
 
     static void removeSyncConfig(sync_struct *syncToRemove);
 
+    // The contents of megacmd.cfg (loaded on first use)
+    static ConfigStore &getConfigStore();
+
 #ifdef MEGACMD_TESTING_CODE
 public:
 #endif
@@ -77,6 +81,14 @@ public:
 
     static std::string /* prev value, if any */ saveProperty(const char* property, const char* value);
 
+    // Writes the pending configuration changes to disk now (they are otherwise written shortly after being made)
+    static void flushConfiguration();
+
+    // Listeners are called with the keys changed by editing megacmd.cfg while running (see startWatchingConfigurationFile)
+    static void addConfigurationChangeListener(ConfigStore::ChangeListener listener);
+    static void startWatchingConfigurationFile();
+    static void stopWatchingConfigurationFile();
+
     template<typename T,
              typename Opt_T = std::optional<typename std::conditional_t<std::is_same_v<std::decay_t<T>, const char*>, std::string, T>>>
     static Opt_T savePropertyValue(const char* property, const T& value)
@@ -109,10 +121,7 @@ public:
         }
         else
         {
-            T prevValue;
-            std::istringstream is(prevValueStr);
-            is >> prevValue;
-            return prevValue;
+            return parseConfigValue<T>(trimProperty(prevValueStr));
         }
     }
 
@@ -152,25 +161,13 @@ public:
     template <typename T>
     static T getConfigurationValue(std::string propertyName, T defaultValue)
     {
-        std::string propValue = getConfigurationSValue(propertyName);
-        if (!propValue.size()) return defaultValue;
-
-        T i;
-        std::istringstream is(propValue);
-        is >> i;
-        return i;
+        return getConfigStore().getAs<T>(propertyName).value_or(defaultValue);
     }
 
     template <typename T>
     static std::optional<T> getConfigurationValueOpt(std::string propertyName)
     {
-        std::string propValue = getConfigurationSValue(propertyName);
-        if (!propValue.size()) return {};
-
-        T i;
-        std::istringstream is(propValue);
-        is >> i;
-        return i;
+        return getConfigStore().getAs<T>(propertyName);
     }
 
     template <typename T>
@@ -200,10 +197,10 @@ public:
 
             if (current.size())
             {
-                T i;
-                std::istringstream is(current);
-                is >> i;
-                toret.push_back(i);
+                if (auto i = parseConfigValue<T>(current))
+                {
+                    toret.push_back(std::move(*i));
+                }
             }
         } while (possep != std::string::npos);
 
@@ -270,10 +267,10 @@ public:
 
             if (current.size())
             {
-                T i;
-                std::istringstream is(current);
-                is >> i;
-                toret.insert(i);
+                if (auto i = parseConfigValue<T>(current))
+                {
+                    toret.insert(std::move(*i));
+                }
             }
         } while (possep != std::string::npos);
 
@@ -327,6 +324,10 @@ class ConfiguratorMegaApiHelper
     std::vector<ValueConfigurator> mConfigurators;
 public:
     const std::vector<ValueConfigurator> & getConfigurators();
+
+    // Applies a value changed outside of MEGAcmd (i.e: by editing megacmd.cfg), if it is one of the configurators'
+    void onConfigurationChanged(::mega::MegaApi *api, const std::string &key, const std::optional<std::string> &value);
+
     ConfiguratorMegaApiHelper();
 };
 
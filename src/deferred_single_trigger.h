@@ -15,96 +15,141 @@
 
 #pragma once
 
-#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <cassert>
+#include <optional>
+#include <utility>
 
-#include "megacmdcommonutils.h"
-
-class DeferredSingleTrigger
+/**
+ * @brief Calls a callback once some time passed without it being triggered again: each trigger replaces
+ * the callback and restarts the wait (but for maxDelay, if given, since the first trigger not yet served).
+ *
+ * Its thread sleeps until the deadline, or indefinitely while there is none: there are no periodic wakeups.
+ * Callbacks are called from that thread, without holding any lock.
+ */
+class DeferredTrigger
 {
-    std::unique_ptr<std::thread> mThread;
-    std::condition_variable mConditionVariable;
-    std::mutex mConditionVariableMutex;
-    std::mutex mThreadMutex;
-    bool mDestroyed;
-    size_t mCounter;
-    std::chrono::seconds mSecondsToWait;
+public:
+    using Clock = std::chrono::steady_clock;
 
-    size_t incrementCounter()
+    DeferredTrigger(Clock::duration delay, std::optional<Clock::duration> maxDelay = std::nullopt) :
+        mDelay(delay),
+        mMaxDelay(maxDelay),
+        mThread([this] { loop(); }) {}
+
+    // Cancels the pending callback (waiting for the one running, if any)
+    ~DeferredTrigger()
     {
-        // Since the counter is used in the CV predicate, it must be protected with the CV mutex
-        std::unique_lock<std::mutex> lock(mConditionVariableMutex);
-        return ++mCounter;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            assert(!mDestroyed);
+            mDestroyed = true;
+            mCallback = nullptr;
+        }
+        mConditionVariable.notify_one();
+        mThread.join();
     }
 
-    void destroy()
+    template<typename CB>
+    void trigger(CB&& callback)
     {
-        // Since the destroyed flag is used in the CV predicate, it must be protected with the CV mutex
-        std::unique_lock<std::mutex> lock(mConditionVariableMutex);
-        assert(!mDestroyed);
-        mDestroyed = true;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (mDestroyed)
+            {
+                return;
+            }
+
+            const auto now = Clock::now();
+            if (!mCallback)
+            {
+                mFirstPendingTrigger = now;
+            }
+            mDeadline = now + mDelay;
+            if (mMaxDelay)
+            {
+                mDeadline = std::min(mDeadline, mFirstPendingTrigger + *mMaxDelay);
+            }
+            mCallback = std::forward<CB>(callback);
+            ++mTriggers;
+        }
+        mConditionVariable.notify_one();
+    }
+
+    void cancel()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCallback = nullptr;
     }
 
-    bool isDestroyed()
+    // The number of triggers and callbacks called so far
+    std::pair<uint64_t, uint64_t> getCounts() const
     {
-        // Since the destroyed flag is used in the CV predicate, it must be protected with the CV mutex
-        std::unique_lock<std::mutex> lock(mConditionVariableMutex);
-        return mDestroyed;
+        std::lock_guard<std::mutex> lock(mMutex);
+        return {mTriggers, mCalls};
     }
 
-    std::unique_lock<std::mutex> ensureThreadIsStopped()
+private:
+    void loop()
     {
-        std::unique_lock<std::mutex> lock(mThreadMutex);
-        if (mThread)
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (!mDestroyed)
         {
-            mConditionVariable.notify_one();
-            mThread->join();
-            mThread.reset();
+            if (!mCallback)
+            {
+                mConditionVariable.wait(lock);
+                continue;
+            }
+
+            // (the deadline might have been moved while waiting)
+            if (Clock::now() < mDeadline)
+            {
+                mConditionVariable.wait_until(lock, mDeadline);
+                continue;
+            }
+
+            auto callback = std::move(mCallback);
+            mCallback = nullptr;
+            ++mCalls;
+            lock.unlock();
+            callback();
+            lock.lock();
         }
-        return lock;
     }
 
+    const Clock::duration mDelay;
+    const std::optional<Clock::duration> mMaxDelay;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mConditionVariable;
+    bool mDestroyed = false;
+    std::function<void()> mCallback;
+    Clock::time_point mDeadline;
+    Clock::time_point mFirstPendingTrigger;
+    uint64_t mTriggers = 0;
+    uint64_t mCalls = 0;
+
+    std::thread mThread; // (last, to start once the rest is initialized)
+};
+
+// Calls the last callback triggered once some seconds passed without further triggers
+class DeferredSingleTrigger
+{
+    DeferredTrigger mTrigger;
+
 public:
     DeferredSingleTrigger(std::chrono::seconds secondsToWait) :
-        mDestroyed(false),
-        mCounter(0),
-        mSecondsToWait(secondsToWait) {}
-
-    ~DeferredSingleTrigger()
-    {
-        destroy();
-        ensureThreadIsStopped();
-    }
+        mTrigger(secondsToWait) {}
 
     template<typename CB>
     void triggerDeferredSingleShot(CB&& callback)
     {
-        const size_t id = incrementCounter();
-        std::unique_lock<std::mutex> lock = ensureThreadIsStopped();
-
-        if (isDestroyed())
-        {
-            // Without this check, we might spawn a new thread after the destructor is done
-            // (i.e., if the lock above is waiting on the destructor's lock)
-            return;
-        }
-
-        mThread.reset(new std::thread([this, id, FWD_CAPTURE(callback)] () {
-            std::unique_lock<std::mutex> lock(mConditionVariableMutex);
-
-            bool cancelled = mConditionVariable.wait_for(lock, mSecondsToWait, [this, id]
-            {
-                assert(mCounter >= id);
-                return mDestroyed || id != mCounter;
-            });
-
-            if (!cancelled)
-            {
-                callback();
-            }
-        }));
+        mTrigger.trigger(std::forward<CB>(callback));
     }
 };
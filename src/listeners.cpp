@@ -82,11 +82,18 @@ void MegaCmdGlobalListener::onNodesUpdate(MegaApi *api, MegaNodeList *nodes)
     long long nfiles = 0;
     long long rfolders = 0;
     long long rfiles = 0;
+    bool pathsChanged = !nodes; // (null for the whole tree)
     if (nodes)
     {
         for (int i = 0; i < nodes->size(); i++)
         {
             MegaNode *n = nodes->get(i);
+            if (n->hasChanged(MegaNode::CHANGE_TYPE_REMOVED | MegaNode::CHANGE_TYPE_ATTRIBUTES
+                              | MegaNode::CHANGE_TYPE_PARENT | MegaNode::CHANGE_TYPE_NEW))
+            {
+                pathsChanged = true;
+            }
+
             if (n->getType() == MegaNode::TYPE_FOLDER)
             {
                 if (n->isRemoved())
@@ -189,6 +196,16 @@ void MegaCmdGlobalListener::onNodesUpdate(MegaApi *api, MegaNodeList *nodes)
         LOG_debug << rfiles << " files "
                   << "removed";
     }
+
+    if (pathsChanged && sandboxCMD->cmdexecuter)
+    {
+        sandboxCMD->cmdexecuter->invalidatePathCache();
+    }
+
+    if (sandboxCMD->cmdexecuter)
+    {
+        sandboxCMD->cmdexecuter->invalidateFolderStats(nodes);
+    }
 }
 
 void MegaCmdGlobalListener::onAccountUpdate(MegaApi *api)
@@ -404,6 +421,27 @@ void MegaCmdGlobalListener::onEvent(MegaApi *api, MegaEvent *event)
 
 void MegaCmdMegaListener::onRequestFinish(MegaApi *api, MegaRequest *request, MegaError *e)
 {
+    // Node changes are notified (onNodesUpdate) independently of the requests that made them: paths resolved
+    // before (including those not found) should not be reused by whoever waits for the request to finish
+    switch (request->getType())
+    {
+        case MegaRequest::TYPE_MOVE:
+        case MegaRequest::TYPE_RENAME:
+        case MegaRequest::TYPE_REMOVE:
+        case MegaRequest::TYPE_CLEAN_RUBBISH_BIN:
+        case MegaRequest::TYPE_REMOVE_VERSIONS:
+        case MegaRequest::TYPE_CREATE_FOLDER:
+        case MegaRequest::TYPE_COPY:
+        case MegaRequest::TYPE_IMPORT_LINK:
+            if (sandboxCMD && sandboxCMD->cmdexecuter)
+            {
+                sandboxCMD->cmdexecuter->invalidatePathCache();
+            }
+            break;
+        default:
+            break;
+    }
+
     if (request->getType() == MegaRequest::TYPE_APP_VERSION)
     {
         LOG_verbose << "TYPE_APP_VERSION finished";
@@ -924,13 +962,13 @@ void MegaCmdMultiTransferListener::onTransferStart(MegaApi* api, MegaTransfer *t
         return;
     }
     alreadyFinished = false;
-    if (totalbytes == 0)
+    if (mProgress.finishedTotal() == 0)
     {
         percentDownloaded = 0;
     }
     else
     {
-        percentDownloaded = float((transferredbytes + getOngoingTransferredBytes()) * 1.0 / totalbytes * 1.0);
+        percentDownloaded = float(mProgress.transferred() * 1.0 / mProgress.finishedTotal() * 1.0);
     }
 
     onTransferUpdate(api,transfer);
@@ -981,20 +1019,7 @@ void MegaCmdMultiTransferListener::doOnTransferFinish(MegaApi* api, MegaTransfer
         informStateListenerByClientId(this->clientID, s);
     }
 
-    map<int, long long>::iterator itr = ongoingtransferredbytes.find(transfer->getTag());
-    if ( itr!= ongoingtransferredbytes.end())
-    {
-        ongoingtransferredbytes.erase(itr);
-    }
-
-    itr = ongoingtotalbytes.find(transfer->getTag());
-    if ( itr!= ongoingtotalbytes.end())
-    {
-        ongoingtotalbytes.erase(itr);
-    }
-
-    transferredbytes+=transfer->getTransferredBytes();
-    totalbytes+=transfer->getTotalBytes();
+    mProgress.finish(transfer->getTag(), transfer->getTransferredBytes(), transfer->getTotalBytes());
 }
 
 void MegaCmdMultiTransferListener::waitMultiEnd()
@@ -1021,33 +1046,19 @@ void MegaCmdMultiTransferListener::onTransferUpdate(MegaApi* api, MegaTransfer *
         LOG_err << " onTransferUpdate for undefined Transfer ";
         return;
     }
-    ongoingtransferredbytes[transfer->getTag()] = transfer->getTransferredBytes();
-    ongoingtotalbytes[transfer->getTag()] = transfer->getTotalBytes();
-
-    unsigned int cols = getNumberOfCols(80);
-
-    string outputString;
-    outputString.resize(cols + 1);
-    for (unsigned int i = 0; i < cols; i++)
-    {
-        outputString[i] = '.';
-    }
-
-    outputString[cols] = '\0';
-    char *ptr = (char *)outputString.c_str();
-    sprintf(ptr, "%s", "TRANSFERRING ||");
-    ptr += strlen("TRANSFERRING ||");
-    *ptr = '.'; //replace \0 char
-
+    // SDK callbacks are serialized, so the totals need no further synchronization
+    mProgress.update(transfer->getTag(), transfer->getTransferredBytes(), transfer->getTotalBytes());
+    const long long transferred = mProgress.transferred();
+    const long long total = mProgress.total();
 
     float oldpercent = percentDownloaded;
-    if ((totalbytes + getOngoingTotalBytes() ) == 0)
+    if (total == 0)
     {
         percentDownloaded = 0;
     }
     else
     {
-        percentDownloaded = float((transferredbytes + getOngoingTransferredBytes()) * 1.0 / (totalbytes + getOngoingTotalBytes() ) * 100.0);
+        percentDownloaded = float(transferred * 1.0 / total * 100.0);
     }
     if (alreadyFinished || ( (percentDownloaded == oldpercent ) && ( oldpercent != 0 ) ) )
     {
@@ -1068,13 +1079,35 @@ void MegaCmdMultiTransferListener::onTransferUpdate(MegaApi* api, MegaTransfer *
     {
         return; // after a 100% this happens
     }
-    if (totalbytes + getOngoingTotalBytes() < 1048576)
+
+    // With many transfers (or fast ones) updates come way more often than they can be followed: the completion is always rendered
+    if (!mProgressThrottle.shouldRender(std::chrono::steady_clock::now(), percentDownloaded == 100))
+    {
+        return;
+    }
+
+    unsigned int cols = getNumberOfCols(80);
+
+    string outputString;
+    outputString.resize(cols + 1);
+    for (unsigned int i = 0; i < cols; i++)
+    {
+        outputString[i] = '.';
+    }
+
+    outputString[cols] = '\0';
+    char *ptr = (char *)outputString.c_str();
+    sprintf(ptr, "%s", "TRANSFERRING ||");
+    ptr += strlen("TRANSFERRING ||");
+    *ptr = '.'; //replace \0 char
+
+    if (total < 1048576)
     {
-        sprintf(aux,"||(%lld/%lld KB: %.2f %%) ", (transferredbytes + getOngoingTransferredBytes()) / 1024, (totalbytes + getOngoingTotalBytes() ) / 1024, percentDownloaded);
+        sprintf(aux,"||(%lld/%lld KB: %.2f %%) ", transferred / 1024, total / 1024, percentDownloaded);
     }
     else
     {
-        sprintf(aux,"||(%lld/%lld MB: %.2f %%) ", (transferredbytes + getOngoingTransferredBytes()) / 1024 / 1024, (totalbytes + getOngoingTotalBytes() ) / 1024 / 1024, percentDownloaded);
+        sprintf(aux,"||(%lld/%lld MB: %.2f %%) ", transferred / 1024 / 1024, total / 1024 / 1024, percentDownloaded);
     }
     sprintf((char *)outputString.c_str() + cols - strlen(aux), "%s",                         aux);
     for (int i = 0; i <= ( cols - strlen("TRANSFERRING ||") - strlen(aux)) * 1.0 * min (100.0f, percentDownloaded) / 100.0; i++)
@@ -1096,7 +1129,7 @@ void MegaCmdMultiTransferListener::onTransferUpdate(MegaApi* api, MegaTransfer *
 
     LOG_verbose << "onTransferUpdate transfer->getType(): " << transfer->getType() << " clientID=" << this->clientID;
 
-    informProgressUpdate((transferredbytes + getOngoingTransferredBytes()),(totalbytes + getOngoingTotalBytes() ), clientID);
+    informProgressUpdate(transferred, total, clientID);
     progressinformed = true;
 
 }
@@ -1118,27 +1151,7 @@ int MegaCmdMultiTransferListener::getFinalerror() const
 
 long long MegaCmdMultiTransferListener::getTotalbytes() const
 {
-    return totalbytes;
-}
-
-long long MegaCmdMultiTransferListener::getOngoingTransferredBytes()
-{
-    long long total = 0;
-    for (map<int, long long>::iterator itr = ongoingtransferredbytes.begin(); itr!= ongoingtransferredbytes.end(); itr++)
-    {
-        total += itr->second;
-    }
-    return total;
-}
-
-long long MegaCmdMultiTransferListener::getOngoingTotalBytes()
-{
-    long long total = 0;
-    for (map<int, long long>::iterator itr = ongoingtotalbytes.begin(); itr!= ongoingtotalbytes.end(); itr++)
-    {
-        total += itr->second;
-    }
-    return total;
+    return mProgress.finishedTotal();
 }
 
 bool MegaCmdMultiTransferListener::getProgressinformed() const
@@ -1147,6 +1160,7 @@ bool MegaCmdMultiTransferListener::getProgressinformed() const
 }
 
 MegaCmdMultiTransferListener::MegaCmdMultiTransferListener(MegaApi *megaApi, MegaCmdSandbox *sandboxCMD, MegaTransferListener *listener, int clientID)
+    : mProgressThrottle(static_cast<unsigned>(ConfigurationManager::getConfigurationValue("progress_update_rate", 10)))
 {
     this->megaApi = megaApi;
     this->sandboxCMD = sandboxCMD;
@@ -1157,8 +1171,6 @@ MegaCmdMultiTransferListener::MegaCmdMultiTransferListener(MegaApi *megaApi, Meg
 
     created = 0;
     finished = 0;
-    totalbytes = 0;
-    transferredbytes = 0;
 
     progressinformed = false;
 
@@ -1190,38 +1202,124 @@ void MegaCmdMultiTransferListener::onTransferStarted(const std::string &path, in
 ////////////////////////////////////////
 ///  MegaCmdGlobalTransferListener   ///
 ////////////////////////////////////////
-const int MegaCmdGlobalTransferListener::MAXCOMPLETEDTRANSFERSBUFFER = 10000;
-
 MegaCmdGlobalTransferListener::MegaCmdGlobalTransferListener(MegaApi *megaApi, MegaCmdSandbox *sandboxCMD, MegaTransferListener *parent)
+    : mCompletedTransfers(static_cast<size_t>(std::max(0, ConfigurationManager::getConfigurationValue("transfers_history_size", 10000))))
 {
     this->megaApi = megaApi;
     this->sandboxCMD = sandboxCMD;
     this->listener = parent;
+
+    auto maxOnDisk = ConfigurationManager::getConfigurationValue("transfers_history_disk", 0);
+    if (maxOnDisk > 0)
+    {
+        mCompletedTransfers.enableSpill(ConfigurationManager::getConfigFolder() / "completed_transfers", static_cast<size_t>(maxOnDisk));
+    }
+
+    // (from the history's thread, not the SDK's)
+    mCompletedTransfers.setRemotePathResolver([megaApi](const CompletedTransfer &transfer)
+    {
+        return resolveRemotePath(megaApi, transfer);
+    });
+}
+
+std::string MegaCmdGlobalTransferListener::resolveRemotePath(MegaApi *api, const CompletedTransfer &transfer)
+{
+    std::string remotePath;
+    if (transfer.mType == MegaTransfer::TYPE_DOWNLOAD)
+    {
+        std::unique_ptr<MegaNode> node(api->getNodeByHandle(transfer.mNodeHandle));
+        std::unique_ptr<char []> nodePath(node ? api->getNodePath(node.get()) : nullptr);
+        if (nodePath)
+        {
+            remotePath = nodePath.get();
+        }
+    }
+    else
+    {
+        std::unique_ptr<MegaNode> parentNode(api->getNodeByHandle(transfer.mParentHandle));
+        std::unique_ptr<char []> parentNodePath(parentNode ? api->getNodePath(parentNode.get()) : nullptr);
+        if (parentNodePath)
+        {
+            remotePath = parentNodePath.get();
+            if (!transfer.mFileName.empty())
+            {
+                if (!remotePath.empty() && remotePath.back() != '/')
+                {
+                    remotePath.append("/");
+                }
+                remotePath.append(transfer.mFileName);
+            }
+        }
+    }
+    return remotePath;
+}
+
+void MegaCmdGlobalTransferListener::indexTransfer(MegaTransfer *transfer)
+{
+    // Only those in the transfer queue: folder and streaming transfers are not
+    if (!transfer || transfer->isFolderTransfer() || transfer->isStreamingTransfer()
+            || (transfer->getType() != MegaTransfer::TYPE_DOWNLOAD && transfer->getType() != MegaTransfer::TYPE_UPLOAD))
+    {
+        return;
+    }
+
+    IndexedTransfer indexed;
+    indexed.mTag = transfer->getTag();
+    indexed.mUpload = transfer->getType() == MegaTransfer::TYPE_UPLOAD;
+    indexed.mSync = transfer->isSyncTransfer();
+    indexed.mState = transfer->getState();
+    indexed.mPriority = transfer->getPriority();
+    indexed.mTransferred = transfer->getTransferredBytes();
+    indexed.mTotal = transfer->getTotalBytes();
+    mTransferIndex.upsert(indexed);
+}
+
+void MegaCmdGlobalTransferListener::onTransferStart(MegaApi* api, MegaTransfer *transfer)
+{
+    indexTransfer(transfer);
+}
+
+void MegaCmdGlobalTransferListener::onTransferUpdate(MegaApi* api, MegaTransfer *transfer)
+{
+    indexTransfer(transfer);
 }
 
 void MegaCmdGlobalTransferListener::onTransferFinish(MegaApi* api, MegaTransfer *transfer, MegaError* error)
 {
-    completedTransfersMutex.lock();
-    completedTransfers.push_front(transfer->copy());
+    mTransferIndex.erase(transfer->getTag());
 
-    // source
-    MegaNode * node = api->getNodeByHandle(transfer->getNodeHandle());
-    if (node)
+    // An upload creates a node (see MegaCmdMegaListener::onRequestFinish)
+    if (transfer->getType() == MegaTransfer::TYPE_UPLOAD && sandboxCMD && sandboxCMD->cmdexecuter)
     {
-        char * nodepath = api->getNodePath(node);
-        completedPathsByHandle[transfer->getNodeHandle()]=nodepath;
-        delete []nodepath;
-        delete node;
+        sandboxCMD->cmdexecuter->invalidatePathCache();
     }
 
-    if (completedTransfers.size()>MAXCOMPLETEDTRANSFERSBUFFER)
+    // Only what is needed to show it afterwards: remote paths are resolved when shown
+    CompletedTransfer completed;
+    completed.mTag = transfer->getTag();
+    completed.mType = transfer->getType();
+    completed.mSync = transfer->isSyncTransfer();
+    completed.mBackup = transfer->isBackupTransfer();
+    completed.mState = transfer->getState();
+    completed.mErrorCode = error ? error->getErrorCode() : MegaError::API_OK;
+    completed.mNodeHandle = transfer->getNodeHandle();
+    completed.mParentHandle = transfer->getParentHandle();
+    if (transfer->getPath())
+    {
+        completed.mLocalPath = transfer->getPath();
+    }
+    else
     {
-        MegaTransfer * todelete = completedTransfers.back();
-        completedPathsByHandle.erase(todelete->getNodeHandle()); //TODO: this can be potentially eliminate a handle that has been added twice
-        delete todelete;
-        completedTransfers.pop_back();
+        completed.mLocalPath = transfer->getParentPath() ? transfer->getParentPath() : "";
+        completed.mLocalPath.append(transfer->getFileName() ? transfer->getFileName() : "");
     }
-    completedTransfersMutex.unlock();
+    completed.mFileName = transfer->getFileName() ? transfer->getFileName() : "";
+    completed.mTransferred = transfer->getTransferredBytes();
+    completed.mTotal = transfer->getTotalBytes();
+    completed.mSpeed = transfer->getMeanSpeed();
+    completed.mStartTime = transfer->getStartTime();
+    completed.mFinishTime = transfer->getUpdateTime();
+    mCompletedTransfers.add(std::move(completed));
 }
 
 void MegaCmdGlobalTransferListener::onTransferTemporaryError(MegaApi *api, MegaTransfer *transfer, MegaError* e)
@@ -1246,30 +1344,21 @@ bool MegaCmdGlobalTransferListener::onTransferData(MegaApi *api, MegaTransfer *t
 
 MegaCmdGlobalTransferListener::~MegaCmdGlobalTransferListener()
 {
-    completedTransfersMutex.lock();
-    while (completedTransfers.size())
-    {
-        delete completedTransfers.front();
-        completedTransfers.pop_front();
-    }
-    completedTransfersMutex.unlock();
 }
 
 bool MegaCmdCatTransferListener::onTransferData(MegaApi *api, MegaTransfer *transfer, char *buffer, size_t size)
 {
-    if (!ls->isClientConnected())
-    {
-        LOG_verbose << " CatTransfer listener, cancelled transfer due to client disconnected";
-        api->cancelTransfer(transfer);
-    }
-    else
-    {
+    LOG_verbose << " CatTransfer listener, streaming " << size << " bytes";
 
-        LOG_verbose << " CatTransfer listener, streaming " << size << " bytes";
-        *ls << BinaryStringView(buffer, size);
-    }
+    // Returning false cancels the transfer: the buffer is either full (the stream is restarted once the
+    // client has read it) or aborted (e.g: the client disconnected)
+    return mBuffer->write(buffer, size);
+}
 
-    return true;
+void MegaCmdCatTransferListener::doOnTransferFinish(MegaApi *api, MegaTransfer *transfer, MegaError *e)
+{
+    MegaCmdTransferListener::doOnTransferFinish(api, transfer, e);
+    mBuffer->closeInput();
 }
 
 ATransferListener::ATransferListener(const std::shared_ptr<MegaCmdMultiTransferListener> &mMultiTransferListener, const std::string &path)
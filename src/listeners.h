@@ -21,6 +21,10 @@
 
 #include "megacmdlogger.h"
 #include "megacmdsandbox.h"
+#include "megacmd_stream_buffer.h"
+#include "megacmd_transfer_progress.h"
+#include "megacmd_transfer_index.h"
+#include "megacmd_transfer_history.h"
 
 namespace megacmd {
 class MegaCmdSandbox;
@@ -110,17 +114,17 @@ protected:
     mega::MegaTransferListener *listener;
 };
 
+// Hands the streamed data to a StreamBuffer, so that the SDK thread never waits for the client to read it
 class MegaCmdCatTransferListener : public MegaCmdTransferListener
 {
 private:
-    LoggedStream *ls;
+    StreamBuffer *mBuffer;
 public:
-    std::string contents;
-
-    MegaCmdCatTransferListener(LoggedStream *_ls, mega::MegaApi *megaApi, MegaCmdSandbox * sandboxCMD, mega::MegaTransferListener *listener = NULL, int clientID=-1)
-        :MegaCmdTransferListener(megaApi,sandboxCMD,listener,clientID),ls(_ls){};
+    MegaCmdCatTransferListener(StreamBuffer *buffer, mega::MegaApi *megaApi, MegaCmdSandbox * sandboxCMD, mega::MegaTransferListener *listener = NULL, int clientID=-1)
+        :MegaCmdTransferListener(megaApi,sandboxCMD,listener,clientID),mBuffer(buffer){};
 
     bool onTransferData(mega::MegaApi *api, mega::MegaTransfer *transfer, char *buffer, size_t size);
+    void doOnTransferFinish(mega::MegaApi* api, mega::MegaTransfer *transfer, mega::MegaError* e);
 };
 
 class MegaCmdMultiTransferListener : public mega::SynchronousTransferListener
@@ -133,15 +137,10 @@ private:
     int clientID;
     unsigned created;
     int finished;
-    long long transferredbytes;
-    std::map<int, long long> ongoingtransferredbytes;
-    std::map<int, long long> ongoingtotalbytes;
-    long long totalbytes;
+    TransferProgress mProgress;
+    ProgressThrottle mProgressThrottle;
     int finalerror;
 
-    long long getOngoingTransferredBytes();
-    long long getOngoingTotalBytes();
-
     bool progressinformed;
 
     std::mutex mStartedTransfersMutex; //to protect mStartedTransfers
@@ -279,17 +278,20 @@ class MegaCmdGlobalTransferListener : public mega::MegaTransferListener
 {
 private:
     MegaCmdSandbox *sandboxCMD;
-    static const int MAXCOMPLETEDTRANSFERSBUFFER;
 
 public:
-    std::mutex completedTransfersMutex;
-    std::deque<mega::MegaTransfer *> completedTransfers;
-    std::map<mega::MegaHandle,std::string> completedPathsByHandle;
+    CompletedTransferHistory mCompletedTransfers;
+    TransferIndex mTransferIndex; // ongoing transfers
 public:
     MegaCmdGlobalTransferListener(mega::MegaApi *megaApi, MegaCmdSandbox *sandboxCMD, mega::MegaTransferListener *parent = NULL);
     virtual ~MegaCmdGlobalTransferListener();
 
+    // The source of a download, the destination of an upload (empty if its node is gone)
+    static std::string resolveRemotePath(mega::MegaApi *api, const CompletedTransfer &transfer);
+
     //Transfer callbacks
+    void onTransferStart(mega::MegaApi* api, mega::MegaTransfer *transfer);
+    void onTransferUpdate(mega::MegaApi* api, mega::MegaTransfer *transfer);
     void onTransferFinish(mega::MegaApi* api, mega::MegaTransfer *transfer, mega::MegaError* error);
     void onTransferTemporaryError(mega::MegaApi *api, mega::MegaTransfer *transfer, mega::MegaError* e);
     bool onTransferData(mega::MegaApi *api, mega::MegaTransfer *transfer, char *buffer, size_t size);
@@ -297,6 +299,9 @@ public:
 protected:
     mega::MegaApi *megaApi;
     mega::MegaTransferListener *listener;
+
+private:
+    void indexTransfer(mega::MegaTransfer *transfer);
 };
 
 class MegaCmdFatalErrorListener : public mega::MegaGlobalListener
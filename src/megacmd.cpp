@@ -27,6 +27,7 @@
 #include "configurationmanager.h"
 #include "megacmdlogger.h"
 #include "comunicationsmanager.h"
+#include "megacmd_petition_frame.h"
 #include "listeners.h"
 #include "megacmd_fuse.h"
 #include "sync_command.h"
@@ -98,6 +99,10 @@
 #include <signal.h>
 #endif
 
+#ifdef __linux__
+#include "comunicationsmanagerepoll.h"
+#endif
+
 using namespace mega;
 
 namespace megacmd {
@@ -107,21 +112,16 @@ typedef char *completionfunction_t PARAMS((const char *, int));
 MegaCmdExecuter *cmdexecuter;
 MegaCmdSandbox *sandboxCMD;
 
-MegaSemaphore semaphoreClients; //to limit max parallel petitions
+std::unique_ptr<WorkerPool> petitionsPool; // reusable threads to process petitions (bounds max parallel petitions)
 
 MegaApi *api = nullptr;
 
-//api objects for folderlinks
-std::queue<MegaApi *> apiFolders;
-std::vector<MegaApi *> occupiedapiFolders;
-MegaSemaphore semaphoreapiFolders;
-std::mutex mutexapiFolders;
+//api objects for folderlinks: created when needed, and destroyed after being idle for a while
+std::unique_ptr<ElasticPool<MegaApi>> apiFoldersPool;
+constexpr std::chrono::minutes API_FOLDERS_IDLE_TIMEOUT(5);
 
 MegaCmdLogger *loggerCMD;
 
-std::mutex mutexEndedPetitionThreads;
-std::vector<std::unique_ptr<MegaThread>> petitionThreads;
-std::vector<MegaThread *> endedPetitionThreads;
 MegaThread *threadRetryConnections;
 
 std::mutex greetingsmsgsMutex;
@@ -163,6 +163,11 @@ time_t lastTimeCheckBlockStatus = 0;
 static std::atomic<::mega::m_time_t> timeOfLoginInAtStartup(0);
 ::mega::m_time_t timeLoginStarted();
 
+StartupProfiler startupProfiler; // (since the server process started)
+
+static std::atomic_bool fastStart(false);
+static std::atomic_bool startupReadOnlyMode(false); // fast start: cached nodes loaded while login in at startup
+
 
 // local console
 Console* console;
@@ -176,7 +181,7 @@ int mcmdMainArgc;
 
 void printWelcomeMsg();
 
-void delete_finished_threads();
+size_t getNumberOfPendingPetitions();
 
 void appendGreetingStatusFirstListener(const std::string &msj)
 {
@@ -473,6 +478,7 @@ void insertValidParamsPerCommand(set<string> *validParams, string thecommand, se
         validParams->insert("h");
         validParams->insert("versions");
         validOptValues->insert("path-display-size");
+        validOptValues->insert("threads");
 #ifdef USE_PCRE
         validParams->insert("use-pcre");
 #endif
@@ -501,18 +507,21 @@ void insertValidParamsPerCommand(set<string> *validParams, string thecommand, se
 #ifdef USE_PCRE
         validParams->insert("use-pcre");
 #endif
+        validOptValues->insert("clientID");
     }
     else if ("mv" == thecommand)
     {
 #ifdef USE_PCRE
         validParams->insert("use-pcre");
 #endif
+        validOptValues->insert("clientID");
     }
     else if ("cp" == thecommand)
     {
 #ifdef USE_PCRE
         validParams->insert("use-pcre");
 #endif
+        validOptValues->insert("clientID");
     }
     else if ("speedlimit" == thecommand)
     {
@@ -530,6 +539,12 @@ void insertValidParamsPerCommand(set<string> *validParams, string thecommand, se
     {
         validParams->insert("h");
     }
+    else if ("cat" == thecommand)
+    {
+        validOptValues->insert("offset");
+        validOptValues->insert("length");
+        validOptValues->insert("streams");
+    }
     else if ("mediainfo" == thecommand)
     {
         validOptValues->insert("path-display-size");
@@ -539,6 +554,10 @@ void insertValidParamsPerCommand(set<string> *validParams, string thecommand, se
         validParams->insert("c");
         validParams->insert("s");
     }
+    else if ("debug" == thecommand)
+    {
+        validParams->insert("stats");
+    }
 #ifndef _WIN32
     else if ("permissions" == thecommand)
     {
@@ -634,6 +653,10 @@ void insertValidParamsPerCommand(set<string> *validParams, string thecommand, se
         validParams->insert("detail");
         validParams->insert("all");
         validOptValues->insert("limit");
+        validOptValues->insert("sync");
+        validOptValues->insert("type");
+        validOptValues->insert("path");
+        validOptValues->insert("page");
         validOptValues->insert("col-separator");
         validOptValues->insert("output-cols");
     }
@@ -682,6 +705,8 @@ void insertValidParamsPerCommand(set<string> *validParams, string thecommand, se
     else if ("find" == thecommand)
     {
         validOptValues->insert("pattern");
+        validOptValues->insert("limit");
+        validOptValues->insert("threads");
         validOptValues->insert("l");
         validParams->insert("show-handles");
         validParams->insert("print-only-handles");
@@ -811,6 +836,7 @@ void insertValidParamsPerCommand(set<string> *validParams, string thecommand, se
         validParams->insert("p");
         validParams->insert("r");
         validOptValues->insert("limit");
+        validOptValues->insert("offset");
         validOptValues->insert("path-display-size");
         validOptValues->insert("col-separator");
         validOptValues->insert("output-cols");
@@ -1549,30 +1575,41 @@ string getListOfCompletionValues(vector<string> words, char separator = ' ', con
 
 MegaApi* getFreeApiFolder()
 {
+    return apiFoldersPool ? apiFoldersPool->acquire() : nullptr;
+}
+
+void freeApiFolder(MegaApi *apiFolder)
+{
+    if (apiFoldersPool)
     {
-        std::lock_guard g(mutexapiFolders);
-        if (apiFolders.empty() && occupiedapiFolders.empty())
-        {
-            return nullptr;
-        }
+        apiFoldersPool->release(apiFolder);
     }
+}
 
-    semaphoreapiFolders.wait();
-    mutexapiFolders.lock();
-    MegaApi* toret = apiFolders.front();
-    apiFolders.pop();
-    occupiedapiFolders.push_back(toret);
-    mutexapiFolders.unlock();
-    return toret;
+void setMaxApiFolders(size_t maxApiFolders)
+{
+    if (apiFoldersPool)
+    {
+        LOG_debug << "Max auxiliar MegaApi folders set to " << maxApiFolders;
+        apiFoldersPool->setMaxInstances(maxApiFolders);
+    }
 }
 
-void freeApiFolder(MegaApi *apiFolder)
+void setTransfersHistorySize(size_t size)
+{
+    if (cmdexecuter)
+    {
+        cmdexecuter->setTransfersHistorySize(size);
+    }
+}
+
+std::optional<ElasticPoolStats> getApiFoldersPoolStats()
 {
-    mutexapiFolders.lock();
-    occupiedapiFolders.erase(std::remove(occupiedapiFolders.begin(), occupiedapiFolders.end(), apiFolder), occupiedapiFolders.end());
-    apiFolders.push(apiFolder);
-    semaphoreapiFolders.release();
-    mutexapiFolders.unlock();
+    if (!apiFoldersPool)
+    {
+        return {};
+    }
+    return apiFoldersPool->getStats();
 }
 
 const char * getUsageStr(const char *command, const HelpFlags& flags)
@@ -1684,11 +1721,11 @@ const char * getUsageStr(const char *command, const HelpFlags& flags)
     {
         if (flags.usePcre || flags.showAll)
         {
-            return "du [-h] [--versions] [remotepath remotepath2 remotepath3 ... ] [--use-pcre]";
+            return "du [-h] [--versions] [--threads=N] [remotepath remotepath2 remotepath3 ... ] [--use-pcre]";
         }
         else
         {
-            return "du [-h] [--versions] [remotepath remotepath2 remotepath3 ... ]";
+            return "du [-h] [--versions] [--threads=N] [remotepath remotepath2 remotepath3 ... ]";
         }
     }
     if (!strcmp(command, "pwd"))
@@ -1822,7 +1859,7 @@ const char * getUsageStr(const char *command, const HelpFlags& flags)
     }
     if (!strcmp(command, "sync-issues"))
     {
-        return "sync-issues [[--detail (ID|--all)] [--limit=rowcount] [--disable-path-collapse]] | [--enable-warning|--disable-warning]";
+        return "sync-issues [[--detail (ID|--all)] [--limit=rowcount] [--disable-path-collapse]] | [[--sync=ID|localpath] [--type=TYPE] [--path=PATH] [--page=N] [--limit=rowcount] [--disable-path-collapse]] | [--enable-warning|--disable-warning]";
     }
     if (!strcmp(command, "sync-ignore"))
     {
@@ -1920,7 +1957,7 @@ const char * getUsageStr(const char *command, const HelpFlags& flags)
     }
     if (!strcmp(command, "cat"))
     {
-        return "cat remotepath1 remotepath2 ...";
+        return "cat [--offset=N] [--length=N] [--streams=N] remotepath1 remotepath2 ...";
     }
     if (!strcmp(command, "mediainfo"))
     {
@@ -1963,7 +2000,7 @@ const char * getUsageStr(const char *command, const HelpFlags& flags)
     }
     if (!strcmp(command, "debug"))
     {
-        return "debug";
+        return "debug [--stats]";
     }
     if (!strcmp(command, "chatf"))
     {
@@ -2017,11 +2054,11 @@ const char * getUsageStr(const char *command, const HelpFlags& flags)
     {
         if (flags.usePcre || flags.showAll)
         {
-            return "find [remotepath] [-l] [--pattern=PATTERN] [--type=d|f] [--mtime=TIMECONSTRAIN] [--size=SIZECONSTRAIN] [--use-pcre] [--time-format=FORMAT] [--show-handles|--print-only-handles]";
+            return "find [remotepath] [-l] [--pattern=PATTERN] [--type=d|f] [--mtime=TIMECONSTRAIN] [--size=SIZECONSTRAIN] [--limit=N] [--threads=N] [--use-pcre] [--time-format=FORMAT] [--show-handles|--print-only-handles]";
         }
         else
         {
-            return "find [remotepath] [-l] [--pattern=PATTERN] [--type=d|f] [--mtime=TIMECONSTRAIN] [--size=SIZECONSTRAIN] [--time-format=FORMAT] [--show-handles|--print-only-handles]";
+            return "find [remotepath] [-l] [--pattern=PATTERN] [--type=d|f] [--mtime=TIMECONSTRAIN] [--size=SIZECONSTRAIN] [--limit=N] [--threads=N] [--time-format=FORMAT] [--show-handles|--print-only-handles]";
         }
     }
     if (!strcmp(command, "help"))
@@ -2356,6 +2393,7 @@ string getHelpStr(const char *command, const HelpFlags& flags = {})
         os << " --versions" << "\t" << "Calculate size including all versions." << endl;
         os << "   " << "\t" << "You can remove all versions with \"deleteversions\" and list them with \"ls --versions\"" << endl;
         os << " --path-display-size=N" << "\t" << "Use a fixed size of N characters for paths" << endl;
+        os << " --threads=N" << "\t" << "Use N threads to walk the folders when calculating the size of versions" << endl;
 
         if (flags.usePcre || flags.showAll)
         {
@@ -2696,6 +2734,12 @@ string getHelpStr(const char *command, const HelpFlags& flags = {})
         os << "                       " << "\t" << "\t" << "TYPE: The type of the path (file or directory). This column is hidden if the information is not relevant for the particular sync issue." << endl;
         os << "                       " << "\t" << "The \"--all\" argument can be used to show the details of all issues." << endl;
         os << " --limit=rowcount " << "\t" << "Limits the amount of rows displayed. Set to 0 to display unlimited rows. Default is 10. Can also be combined with \"--detail\"." << endl;
+        os << " --sync=ID|localpath " << "\t" << "Only lists the issues of the sync with that ID or local path." << endl;
+        os << " --type=TYPE " << "\t" << "Only lists the issues of a type: either a reason (e.g: \"FileIssue\", \"NamesWouldClashWhenSynced\") or a path problem (e.g: \"DetectedSymlink\")." << endl;
+        os << "             " << "\t" << "An invalid type shows the list of valid ones." << endl;
+        os << " --path=PATH " << "\t" << "Only lists the issues with a local or cloud path that is PATH or within it." << endl;
+        os << " --page=N " << "\t" << "Lists the N-th page of issues, with as many issues per page as the row count limit. Default is 1." << endl;
+        os << "          " << "\t" << "Note: \"--sync\", \"--type\", \"--path\" and \"--page\" cannot be combined with \"--detail\"." << endl;
         os << " --disable-path-collapse " << "\t" << "Ensures all paths are fully shown. By default long paths are truncated for readability." << endl;
         os << " --enable-warning " << "\t" << "Enables the notification that appears when issues are detected. This setting is saved for the next time you open MEGAcmd, but will be removed if you logout." << endl;
         os << " --disable-warning " << "\t" << "Disables the notification that appears when issues are detected. This setting is saved for the next time you open MEGAcmd, but will be removed if you logout." << endl;
@@ -3081,6 +3125,13 @@ string getHelpStr(const char *command, const HelpFlags& flags = {})
     {
         os << "Prints the contents of remote files" << endl;
         os << endl;
+        os << "Options:" << endl;
+        os << " --offset=N" << "\t" << "Start printing at byte N. Negative values count from the end of the file" << endl;
+        os << "   " << "\t" << "(e.g: --offset=-1024 prints the last 1024 bytes)" << endl;
+        os << " --length=N" << "\t" << "Print at most N bytes" << endl;
+        os << " --streams=N" << "\t" << "Read each file through N concurrent streams (up to 8), printed in order." << endl;
+        os << "   " << "\t" << "It may speed up reading large files" << endl;
+        os << endl;
 
         if (flags.win || flags.showAll)
         {
@@ -3159,6 +3210,8 @@ string getHelpStr(const char *command, const HelpFlags& flags = {})
         os << "                      " << "\t" << "   \"+1m12k3B\" shows files bigger than 1 Mega, 12 Kbytes and 3Bytes" << endl;
         os << "                      " << "\t" << "   \"-3M\" shows files smaller than 3 Megabytes" << endl;
         os << "                      " << "\t" << "   \"-4M+100K\" shows files smaller than 4 Mbytes and bigger than 100 Kbytes" << endl;
+        os << " --limit=N" << "\t" << "Stops after the first N matches" << endl;
+        os << " --threads=N" << "\t" << "Use N threads to walk the folders. Matches are listed in the same order" << endl;
         os << " --show-handles" << "\t" << "Prints files/folders handles (H:XXXXXXXX). You can address a file/folder by its handle" << endl;
         os << " --print-only-handles" << "\t" << "Prints only files/folders handles (H:XXXXXXXX). You can address a file/folder by its handle" << endl;
 
@@ -3175,6 +3228,9 @@ string getHelpStr(const char *command, const HelpFlags& flags = {})
         os << "Enters debugging mode (HIGHLY VERBOSE)" << endl;
         os << endl;
         os << "For a finer control of log level see \"log --help\"" << endl;
+        os << endl;
+        os << "Options:" << endl;
+        os << " --stats" << "\t" << "Prints internal statistics of the server instead (e.g: how long its startup phases took, usage of the threads processing commands or of the cache of resolved paths)" << endl;
     }
     else if (!strcmp(command, "quit") || !strcmp(command, "exit"))
     {
@@ -3207,6 +3263,7 @@ string getHelpStr(const char *command, const HelpFlags& flags = {})
         os << " --show-completed" << "\t" << "Show completed transfers" << endl;
         os << " --only-completed" << "\t" << "Show only completed download" << endl;
         os << " --limit=N" << "\t" << "Show only first N transfers" << endl;
+        os << " --offset=N" << "\t" << "Skip the N most recent completed transfers (to page through them)" << endl;
         os << " --path-display-size=N" << "\t" << "Use at least N characters for displaying paths" << endl;
         printColumnDisplayerHelp(os);
         os << endl;
@@ -3565,7 +3622,11 @@ void executecommand(const char* ptr)
     if (!validCommand(thecommand))   //unknown command
     {
         setCurrentThreadOutCode(MCMD_EARGS);
-        if (loginInAtStartup)
+        if (loginInAtStartup && startupReadOnlyMode)
+        {
+            LOG_err << "Command not valid until the session is fully resumed (only read-only commands are available meanwhile): " << thecommand;
+        }
+        else if (loginInAtStartup)
         {
             LOG_err << "Command not valid while login in: " << thecommand;
         }
@@ -4193,13 +4254,11 @@ static bool process_line(const std::string_view line)
                 if (strstr(l,"--wait-for-ongoing-petitions"))
                 {
                     int attempts=20; //give a while for ongoing petitions to end before killing the server
-                    delete_finished_threads();
 
-                    while(petitionThreads.size() > 1 && attempts--)
+                    while(getNumberOfPendingPetitions() > 1 && attempts--)
                     {
-                        LOG_debug << "giving a little longer for ongoing petitions: " << petitionThreads.size();
+                        LOG_debug << "giving a little longer for ongoing petitions: " << getNumberOfPendingPetitions();
                         sleepSeconds(20-attempts);
-                        delete_finished_threads();
                     }
                 }
 
@@ -4237,7 +4296,7 @@ static bool process_line(const std::string_view line)
                     OUTSTREAM << " " << endl;
 
                     int attempts=20; //give a while for ongoing petitions to end before killing the server
-                    while(petitionThreads.size() > 1 && attempts--)
+                    while(getNumberOfPendingPetitions() > 1 && attempts--)
                     {
                         sleepSeconds(20-attempts);
                     }
@@ -4257,10 +4316,8 @@ static bool process_line(const std::string_view line)
     return false; //Do not exit
 }
 
-void* doProcessLine(void* infRaw)
+void doProcessLine(std::unique_ptr<CmdPetition> inf)
 {
-    auto inf = std::unique_ptr<CmdPetition>((CmdPetition*) infRaw);
-
     OUTSTRINGSTREAM s;
 
     setCurrentThreadLogLevel(MegaApi::LOG_LEVEL_ERROR);
@@ -4286,25 +4343,18 @@ void* doProcessLine(void* infRaw)
 
     LOG_verbose << " Processed " << inf->getRedactedLine() << " in thread: " << MegaThread::currentThreadId() << " " << inf->getPetitionDetails();
 
-    MegaThread * petitionThread = inf->getPetitionThread();
-
     if (inf->clientID != -3) // -3 is self client (no actual client)
     {
         cm->returnAndClosePetition(std::move(inf), &s, getCurrentThreadOutCode());
     }
 
-    semaphoreClients.release();
-
     if (doExit && (!isCurrentThreadInteractive() || isCurrentThreadCmdShell() ))
     {
         cm->stopWaiting();
     }
 
-    mutexEndedPetitionThreads.lock();
-    endedPetitionThreads.push_back(petitionThread);
-    mutexEndedPetitionThreads.unlock();
-
-    return nullptr;
+    // The worker thread will be reused for other petitions: the streams above are about to die
+    resetCurrentThreadData();
 }
 
 int askforConfirmation(string message)
@@ -4346,26 +4396,18 @@ string askforUserResponse(string message)
 
 
 
-void delete_finished_threads()
+size_t getNumberOfPendingPetitions()
 {
-    std::unique_lock<std::mutex> lock(mutexEndedPetitionThreads);
+    return petitionsPool ? petitionsPool->getStats().pending() : 0;
+}
 
-    for (MegaThread *mt : endedPetitionThreads)
+std::optional<WorkerPoolStats> getPetitionsPoolStats()
+{
+    if (!petitionsPool)
     {
-        for (auto it = petitionThreads.begin(); it != petitionThreads.end(); )
-        {
-            if (mt == it->get())
-            {
-                (*it)->join();
-                it = petitionThreads.erase(it);
-            }
-            else
-            {
-                ++it;
-            }
-        }
+        return {};
     }
-    endedPetitionThreads.clear();
+    return petitionsPool->getStats();
 }
 
 void processCommandInPetitionQueues(CmdPetition *inf);
@@ -4407,7 +4449,19 @@ void finalize(bool waitForRestartSignal_param)
     alreadyfinalized = true;
     LOG_info << "closing application ...";
 
-    delete_finished_threads();
+    if (petitionsPool)
+    {
+        if (petitionsPool->waitUntilIdle(std::chrono::seconds(5)) && !petitionsPool->isWorkerThread())
+        {
+            petitionsPool.reset();
+        }
+        else
+        {
+            // Cannot join workers still stuck in a petition: let them be discarded at exit
+            LOG_warn << "Petitions still ongoing at finalization: " << getNumberOfPendingPetitions();
+            (void) petitionsPool.release();
+        }
+    }
     if (!consoleFailed)
     {
         delete console;
@@ -4419,24 +4473,18 @@ void finalize(bool waitForRestartSignal_param)
         threadRetryConnections->join();
     }
     delete threadRetryConnections;
-    delete api;
 
-    while (!apiFolders.empty())
-    {
-        delete apiFolders.front();
-        apiFolders.pop();
-    }
-
-    for (std::vector< MegaApi * >::iterator it = occupiedapiFolders.begin(); it != occupiedapiFolders.end(); ++it)
-    {
-        delete ( *it );
-    }
+    ConfigurationManager::stopWatchingConfigurationFile();
+    delete api;
 
-    occupiedapiFolders.clear();
+    apiFoldersPool.reset();
 
     delete megaCmdGlobalListener;
     delete cmdexecuter;
 
+    // (after everything that might still change it is gone)
+    ConfigurationManager::flushConfiguration();
+
 #ifdef __linux__
     if (waitForRestartSignal_param)
     {
@@ -4549,11 +4597,10 @@ void* checkForUpdates(void *param)
             sleepSeconds(1);
             if (stopCheckingforUpdaters) break;
 
-            while(petitionThreads.size() && !stopCheckingforUpdaters)
+            while(getNumberOfPendingPetitions() && !stopCheckingforUpdaters)
             {
-                LOG_fatal << " waiting for petitions to end to initiate upload " << petitionThreads.size() << petitionThreads.at(0).get();
+                LOG_fatal << " waiting for petitions to end to initiate upload " << getNumberOfPendingPetitions();
                 sleepSeconds(2);
-                delete_finished_threads();
             }
 
             if (stopCheckingforUpdaters) break;
@@ -4573,10 +4620,9 @@ void* checkForUpdates(void *param)
         if (restartRequired && restartServer())
         {
             int attempts = 20; //give a while for ingoin petitions to end before killing the server
-            while(petitionThreads.size() && --attempts)
+            while(getNumberOfPendingPetitions() && --attempts)
             {
                 sleepSeconds(20 - attempts);
-                delete_finished_threads();
             }
 
             doExit = true;
@@ -4600,16 +4646,17 @@ void* checkForUpdates(void *param)
 
 void processCommandInPetitionQueues(std::unique_ptr<CmdPetition> inf)
 {
-    semaphoreClients.wait();
-
-    //append new one
-    auto petitionThread = new MegaThread();
+    assert(petitionsPool);
+    LOG_verbose << "starting processing: <" << inf->getRedactedLine() << ">";
 
-    petitionThreads.emplace_back(petitionThread);
-    inf->setPetitionThread(petitionThread);
+    // std::function requires copyable callables
+    auto sharedInf = std::make_shared<std::unique_ptr<CmdPetition>>(std::move(inf));
 
-    LOG_verbose << "starting processing: <" << inf->getRedactedLine() << ">";
-    petitionThread->start(doProcessLine, (void*) inf.release());
+    // Blocks if all workers are busy and the queue is full
+    if (!petitionsPool->push([sharedInf]() { doProcessLine(std::move(*sharedInf)); }))
+    {
+        LOG_err << "Petition discarded: no longer processing petitions";
+    }
 }
 
 void processCommandLinePetitionQueues(std::string what)
@@ -4659,7 +4706,6 @@ void megacmd()
             CmdPetition* inf = infOwned.get();
 
             LOG_verbose << "petition registered: " << inf->getRedactedLine();
-            delete_finished_threads();
 
             if (inf->getUniformLine() == "ERROR")
             {
@@ -4808,7 +4854,7 @@ void megacmd()
 
                 // if server resuming session, lets give him a very litle while before sending greeting message to the early clients
                 // (to aovid "Resuming session..." being printed fast resumed session)
-                while (getloginInAtStartup() && ((m_time(nullptr) - timeLoginStarted() < RESUME_SESSION_TIMEOUT * 0.3)))
+                while (getloginInAtStartup() && !startupReadOnlyMode && ((m_time(nullptr) - timeLoginStarted() < RESUME_SESSION_TIMEOUT * 0.3)))
                 {
                     sleepMilliSeconds(300);
                 }
@@ -4831,7 +4877,8 @@ void megacmd()
                 // if server resuming session, lets give him a litle while before returning a prompt to the early clients
                 // This will block the server from responging any commands in the meantime, but that assumable, it will only happen
                 // the first time the server is initiated.
-                while (getloginInAtStartup() && ((m_time(nullptr) - timeLoginStarted() < RESUME_SESSION_TIMEOUT * 0.7)))
+                // In fast start mode, only until the cached nodes are loaded: read-only commands can be served from then on
+                while (getloginInAtStartup() && !startupReadOnlyMode && ((m_time(nullptr) - timeLoginStarted() < RESUME_SESSION_TIMEOUT * 0.7)))
                 {
                     sleepMilliSeconds(300);
                 }
@@ -5264,9 +5311,68 @@ void setloginInAtStartup(bool value)
     {
         timeOfLoginInAtStartup = m_time(NULL);
     }
+    else
+    {
+        startupReadOnlyMode = false;
+        endStartupPhase("session resume"); // (if the login failed before the nodes were loaded)
+        endStartupPhase("nodes current");
+    }
+    updatevalidCommands();
+}
+
+bool isFastStartEnabled()
+{
+    return fastStart;
+}
+
+void setStartupReadOnlyMode(bool value)
+{
+    startupReadOnlyMode = value;
     updatevalidCommands();
 }
 
+void markStartupPhase(const std::string &name)
+{
+    startupProfiler.endSequentialPhase(name);
+}
+
+void startStartupPhase(const std::string &name)
+{
+    startupProfiler.startPhase(name);
+}
+
+bool endStartupPhase(const std::string &name)
+{
+    auto duration = startupProfiler.endPhase(name);
+    if (!duration)
+    {
+        return false;
+    }
+    LOG_info << "Startup phase \"" << name << "\" took " << std::chrono::duration_cast<std::chrono::milliseconds>(*duration).count() << " ms";
+    return true;
+}
+
+std::vector<StartupProfiler::Phase> getStartupPhases()
+{
+    return startupProfiler.getPhases();
+}
+
+// The sequential ones are logged all together: most of them end before the logger is established
+static void logStartupPhases()
+{
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+    for (const auto &phase : startupProfiler.getPhases())
+    {
+        if (!phase.mOngoing)
+        {
+            LOG_debug << "Startup phase \"" << phase.mName << "\" took " << duration_cast<milliseconds>(phase.mDuration).count() << " ms";
+        }
+    }
+    LOG_info << "Server accepting commands " << duration_cast<milliseconds>(startupProfiler.getElapsed()).count() << " ms after startup"
+             << (fastStart ? " (fast start)" : "");
+}
+
 void unblock()
 {
     setBlocked(0);
@@ -5298,7 +5404,17 @@ int getBlocked()
 
 void updatevalidCommands()
 {
-    if (loginInAtStartup || blocked)
+    if (loginInAtStartup && startupReadOnlyMode && !blocked)
+    {
+        static const std::vector<std::string> fastStartLoginInValidCommands = []
+        {
+            auto commands = loginInValidCommands;
+            commands.insert(commands.end(), fastStartValidCommands.begin(), fastStartValidCommands.end());
+            return commands;
+        }();
+        validCommands = fastStartLoginInValidCommands;
+    }
+    else if (loginInAtStartup || blocked)
     {
         validCommands = loginInValidCommands;
     }
@@ -5416,6 +5532,21 @@ void disableFuseExplorerListView(MegaApi& api)
     LOG_debug << "FUSE FileExplorer view set to NONE (disabled list view)";
 }
 
+// On Linux, the epoll based one is used unless MEGACMD_COMMS_EVENT_LOOP=select
+ComunicationsManager* createComunicationsManager()
+{
+#ifdef __linux__
+    const char *eventLoop = getenv("MEGACMD_COMMS_EVENT_LOOP");
+    if (!eventLoop || strcmp(eventLoop, "select"))
+    {
+        LOG_debug << "Using epoll communications manager";
+        return new ComunicationsManagerEpoll();
+    }
+    LOG_debug << "Using select communications manager";
+#endif
+    return new COMUNICATIONMANAGER();
+}
+
 int executeServer(int argc, char* argv[],
                   const std::function<LoggedStream*()>& createLoggedStream,
                   const LogConfig& logConfig,
@@ -5461,6 +5592,7 @@ int executeServer(int argc, char* argv[],
         sleepSeconds(5);
         return -2;
     }
+    markStartupPhase("configuration");
 
     // The logger stream must be created after the configuration is loaded (so the .megaCmd directory is created if necessary)
     if (createLoggedStream)
@@ -5481,6 +5613,7 @@ int executeServer(int argc, char* argv[],
     LOG_info << "----------------------- program start -----------------------";
     LOG_debug << "MEGAcmd version: " << MEGACMD_MAJOR_VERSION << "." << MEGACMD_MINOR_VERSION << "." << MEGACMD_MICRO_VERSION << "." << MEGACMD_BUILD_ID << ": code " << MEGACMD_CODE_VERSION;
     LOG_debug << "MEGA SDK version: " << SDK_COMMIT_HASH;
+    markStartupPhase("logger");
 
     const fs::path configDirPath = ConfigurationManager::getAndCreateConfigDir();
     const std::string configDirStrUtf8 = pathAsUtf8(configDirPath);
@@ -5499,6 +5632,7 @@ int executeServer(int argc, char* argv[],
         MegaApi::setMaxPayloadLogSize(0); // Max size
     }
     LOG_debug << "Language set to: " << localecode;
+    markStartupPhase("main MegaApi");
 
     sandboxCMD = new MegaCmdSandbox();
     cmdexecuter = new MegaCmdExecuter(api, loggerCMD, sandboxCMD);
@@ -5507,25 +5641,25 @@ int executeServer(int argc, char* argv[],
     auto cmdFatalErrorListener = std::make_unique<MegaCmdFatalErrorListener>(*sandboxCMD);
 
     auto numberOfApiFolders = ConfigurationManager::getConfigurationValue("exported_folders_sdks", 5);
-    LOG_debug << "Loading " << numberOfApiFolders << " auxiliar MegaApi folders";
-
-    for (int i = 0; i < numberOfApiFolders; i++)
-    {
-        const fs::path apiFolderPath = ConfigurationManager::getConfigFolderSubdir("apiFolder_" + std::to_string(i));
-        const std::string apiFolderStrUtf8 = pathAsUtf8(apiFolderPath);
+    LOG_debug << "Using up to " << numberOfApiFolders << " auxiliar MegaApi folders (created when needed)";
 
-        MegaApi *apiFolder = new MegaApi("BdARkQSQ", apiFolderStrUtf8.c_str(), userAgent);
-        apiFolder->setLanguage(localecode.c_str());
-        apiFolder->addGlobalListener(cmdFatalErrorListener.get());
+    apiFoldersPool = std::make_unique<ElasticPool<MegaApi>>(numberOfApiFolders, API_FOLDERS_IDLE_TIMEOUT,
+        [localecode, userAgent = std::string(userAgent), fatalErrorListener = cmdFatalErrorListener.get()](size_t slot)
+        {
+            // each slot keeps its cache folder, for the instances to come
+            const fs::path apiFolderPath = ConfigurationManager::getConfigFolderSubdir("apiFolder_" + std::to_string(slot));
+            const std::string apiFolderStrUtf8 = pathAsUtf8(apiFolderPath);
+            LOG_debug << "Creating auxiliar MegaApi folder at " << apiFolderStrUtf8;
 
-        apiFolders.push(apiFolder);
-        semaphoreapiFolders.release();
-    }
+            auto apiFolder = std::make_unique<MegaApi>("BdARkQSQ", apiFolderStrUtf8.c_str(), userAgent.c_str());
+            apiFolder->setLanguage(localecode.c_str());
+            apiFolder->addGlobalListener(fatalErrorListener);
+            return apiFolder;
+        });
 
-    for (int i = 0; i < 100; i++)
-    {
-        semaphoreClients.release();
-    }
+    auto numberOfPetitionWorkers = ConfigurationManager::getConfigurationValue("petition_workers", 100);
+    LOG_debug << "Using up to " << numberOfPetitionWorkers << " threads to process petitions";
+    petitionsPool = std::make_unique<WorkerPool>(numberOfPetitionWorkers, numberOfPetitionWorkers);
 
     if (const char* fuseLogLevelStr = getenv("MEGACMD_FUSE_LOG_LEVEL"); fuseLogLevelStr)
     {
@@ -5539,6 +5673,13 @@ int executeServer(int argc, char* argv[],
 
     GlobalSyncConfig::loadFromConfigurationManager(*api);
 
+    ConfigurationManager::addConfigurationChangeListener([](const std::string &key, const std::optional<std::string> &value)
+    {
+        Instance<ConfiguratorMegaApiHelper>::Get().onConfigurationChanged(api, key, value);
+    });
+    ConfigurationManager::startWatchingConfigurationFile();
+    markStartupPhase("executer and pools");
+
     megaCmdGlobalListener = new MegaCmdGlobalListener(loggerCMD, sandboxCMD);
     megaCmdMegaListener = new MegaCmdMegaListener(api, NULL, sandboxCMD);
     api->addGlobalListener(megaCmdGlobalListener);
@@ -5560,7 +5701,9 @@ int executeServer(int argc, char* argv[],
         console = new CONSOLE_CLASS;
     }
 #endif
-    cm = new COMUNICATIONMANAGER();
+    markStartupPhase("listeners and console");
+    cm = createComunicationsManager();
+    markStartupPhase("communications");
 
 #if _WIN32
     if( SetConsoleCtrlHandler( (PHANDLER_ROUTINE) CtrlHandler, TRUE ) )
@@ -5616,6 +5759,7 @@ int executeServer(int argc, char* argv[],
         }
         processCommandLinePetitionQueues(command);
     }
+    markStartupPhase("updater and proxy");
 
     if (ConfigurationManager::getHasBeenUpdated())
     {
@@ -5625,17 +5769,24 @@ int executeServer(int argc, char* argv[],
         stringstream ss;
         ss << "MEGAcmd has been updated to version " << MEGACMD_MAJOR_VERSION << "." << MEGACMD_MINOR_VERSION << "." << MEGACMD_MICRO_VERSION << "." << MEGACMD_BUILD_ID << " - code " << MEGACMD_CODE_VERSION << endl;
         broadcastMessage(ss.str(), true);
+        markStartupPhase("update notification");
     }
 
+    fastStart = getenv("MEGACMD_FAST_START") != nullptr;
     if (!ConfigurationManager::session.empty())
     {
+        LOG_debug << "Resuming session" << (fastStart ? " (fast start: read-only commands allowed once the cached nodes are loaded)" : "");
+        startStartupPhase("session resume");
         loginInAtStartup = true;
         stringstream logLine;
         logLine << "login " << ConfigurationManager::session;
         LOG_debug << "Executing ... " << logLine.str().substr(0,9) << "...";
         processCommandLinePetitionQueues(logLine.str());
+        markStartupPhase("login queued");
     }
 
+    logStartupPhases();
+
     megacmd::megacmd();
     finalize(waitForRestartSignal);
 
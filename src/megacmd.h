@@ -40,6 +40,9 @@ using std::exception;
 
 #include "megaapi_impl.h"
 #include "megacmd_events.h"
+#include "megacmd_worker_pool.h"
+#include "megacmd_elastic_pool.h"
+#include "megacmd_startup_profiler.h"
 
 #define PROGRESS_COMPLETE -2
 namespace megacmd {
@@ -128,6 +131,27 @@ public:
 mega::MegaApi* getFreeApiFolder();
 void freeApiFolder(mega::MegaApi *apiFolder);
 
+// Max auxiliary MegaApi folders (exported_folders_sdks): applies right away
+void setMaxApiFolders(size_t maxApiFolders);
+
+// Max completed transfers kept in memory (transfers_history_size): applies right away
+void setTransfersHistorySize(size_t size);
+
+// Empty if the server has not created the pool of auxiliary MegaApi folders yet
+std::optional<ElasticPoolStats> getApiFoldersPoolStats();
+
+// Startup profiling: the phases of executeServer, one after another, and those going on in the background
+// once the server accepts commands (e.g. the session resumption)
+void markStartupPhase(const std::string &name);
+void startStartupPhase(const std::string &name);
+bool endStartupPhase(const std::string &name); // false if it was not ongoing
+std::vector<StartupProfiler::Phase> getStartupPhases();
+
+// Fast start (MEGACMD_FAST_START): while the session is resumed at startup, read-only commands are served against
+// the cached nodes as soon as they are loaded, instead of waiting for the account to be up to date
+bool isFastStartEnabled();
+void setStartupReadOnlyMode(bool value);
+
 struct HelpFlags
 {
     bool win = false;
@@ -190,6 +214,9 @@ void startcheckingForUpdates();
  */
 std::optional<std::string> lookForAvailableNewerVersions(::mega::MegaApi *api);
 
+// Empty if the server is not yet processing petitions
+std::optional<WorkerPoolStats> getPetitionsPoolStats();
+
 void informTransferUpdate(mega::MegaTransfer *transfer, int clientID);
 void informStateListenerByClientId(int clientID, std::string s);
 void informProgressUpdate(long long transferred, long long total, int clientID, std::string title = "");
@@ -0,0 +1,85 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+namespace megacmd {
+
+constexpr size_t CAT_BUFFER_CAPACITY = 16 * 1024 * 1024;   // of the single stream
+constexpr size_t CAT_SEGMENT_SIZE = 8 * 1024 * 1024;       // with several streams
+constexpr size_t MAX_CAT_STREAMS = 8;
+
+/**
+ * @brief How cat streams a range of a file: with a single stream, the whole range goes through one buffer.
+ * With several, the range is split in segments of CAT_SEGMENT_SIZE (the last one may be shorter) streamed
+ * concurrently, up to mStreams at a time, and sent in order: each one is kept in a buffer of its own until
+ * the previous ones are sent.
+ */
+struct CatPlan
+{
+    long long mStart = 0;
+    long long mEnd = 0;             // exclusive (nothing to stream if it is not past mStart)
+    long long mSegmentSize = 0;
+    size_t mStreams = 1;            // never more than the segments
+    size_t mBufferCapacity = 0;     // of each segment
+
+    bool empty() const { return mStart >= mEnd; }
+
+    size_t segmentCount() const
+    {
+        return empty() ? 0 : static_cast<size_t>((mEnd - mStart + mSegmentSize - 1) / mSegmentSize);
+    }
+
+    // [start, end) of the i-th segment (in the order they are sent)
+    std::pair<long long, long long> segment(size_t i) const
+    {
+        const long long start = mStart + static_cast<long long>(i) * mSegmentSize;
+        return {start, std::min(mEnd, start + mSegmentSize)};
+    }
+};
+
+// A negative offset counts from the end of the file, and a negative length means up to the end of it
+inline CatPlan planCat(long long fileSize, long long offset, long long length, size_t streams)
+{
+    CatPlan plan;
+    plan.mStart = offset < 0 ? std::max(0LL, fileSize + offset) : std::min(offset, fileSize);
+    plan.mEnd = (length < 0 || length >= fileSize - plan.mStart) ? fileSize : plan.mStart + length; // (no overflow)
+    if (plan.empty())
+    {
+        plan.mEnd = plan.mStart;
+        return plan;
+    }
+
+    const long long size = plan.mEnd - plan.mStart;
+    const auto segments = static_cast<size_t>((size + static_cast<long long>(CAT_SEGMENT_SIZE) - 1) / static_cast<long long>(CAT_SEGMENT_SIZE));
+    plan.mStreams = std::min(std::clamp<size_t>(streams, 1, MAX_CAT_STREAMS), segments);
+    if (plan.mStreams > 1)
+    {
+        plan.mSegmentSize = static_cast<long long>(CAT_SEGMENT_SIZE);
+        plan.mBufferCapacity = CAT_SEGMENT_SIZE;
+    }
+    else // (a single segment)
+    {
+        plan.mSegmentSize = size;
+        plan.mBufferCapacity = CAT_BUFFER_CAPACITY;
+    }
+    return plan;
+}
+
+}//end namespace
@@ -0,0 +1,601 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <cstdio>
+#include <io.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "deferred_single_trigger.h"
+#include "megacmdcommonutils.h"
+
+namespace megacmd {
+
+// Converts a configuration value to T (nullopt if it is not one): the whole value for strings,
+// 1/0 (or any other number) and true/false for booleans; trailing characters after a number are ignored
+template <typename T>
+std::optional<T> parseConfigValue(std::string_view value)
+{
+    if constexpr (std::is_same_v<T, std::string>)
+    {
+        return std::string(value);
+    }
+    else if constexpr (std::is_same_v<T, bool>)
+    {
+        if (value == "true")
+        {
+            return true;
+        }
+        if (value == "false")
+        {
+            return false;
+        }
+        auto number = parseConfigValue<long long>(value);
+        if (!number)
+        {
+            return std::nullopt;
+        }
+        return *number != 0;
+    }
+    else if constexpr (std::is_integral_v<T>)
+    {
+        if (!value.empty() && value[0] == '+')
+        {
+            value.remove_prefix(1);
+        }
+        T number{};
+        auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), number);
+        if (ec != std::errc())
+        {
+            return std::nullopt;
+        }
+        return number;
+    }
+    else if constexpr (std::is_floating_point_v<T>)
+    {
+        // (std::from_chars for floating point is not available in every supported compiler)
+        std::string str(value);
+        char *end = nullptr;
+        auto number = std::strtod(str.c_str(), &end);
+        if (end == str.c_str())
+        {
+            return std::nullopt;
+        }
+        return static_cast<T>(number);
+    }
+    else
+    {
+        T converted;
+        std::istringstream is{std::string(value)};
+        if (!(is >> converted))
+        {
+            return std::nullopt;
+        }
+        return converted;
+    }
+}
+
+/**
+ * @brief The "key=value" lines of a configuration file, parsed once and kept in memory.
+ *
+ * Changes are written back (the whole file at once, replaced atomically through a temporary one, synced to disk
+ * before it takes the place of the file) once some time passed without further changes, or on flush(). Edits made to the file by others are brought in by reload(),
+ * which notifies the listeners of the keys changed that way. Lines other than "key=value" ones (e.g: comments)
+ * are kept as they are.
+ *
+ * Thread safe. Listeners and the write error handler are called without holding any lock.
+ */
+class ConfigStore
+{
+public:
+    using Clock = DeferredTrigger::Clock;
+    using ChangeListener = std::function<void(const std::string &key, const std::optional<std::string> &value)>;
+    using ErrorHandler = std::function<void(const std::string &error)>;
+
+    explicit ConfigStore(Clock::duration writeBackDelay = std::chrono::milliseconds(100),
+                         Clock::duration maxWriteBackDelay = std::chrono::seconds(1)) :
+        mWriteBack(writeBackDelay, maxWriteBackDelay) {}
+
+    ~ConfigStore()
+    {
+        flush();
+    }
+
+    // Reads the file (a missing one is an empty one), discarding what was loaded before
+    void load(const fs::path &file)
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        if (mLoaded && mFile != file)
+        {
+            writeBack();
+        }
+
+        mFile = file;
+        mOnDiskContent = readFile(file);
+        mLines = splitLines(mOnDiskContent);
+        reindex();
+        mOnDisk = getValues();
+        mPendingKeys.clear();
+        mLoaded = true;
+    }
+
+    bool isLoaded() const
+    {
+        return mLoaded;
+    }
+
+    // The value of the key (trimmed, and without quotes), if set and not empty
+    std::optional<std::string> get(std::string_view key) const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return getValue(key);
+    }
+
+    template <typename T>
+    std::optional<T> getAs(std::string_view key) const
+    {
+        auto value = get(key);
+        if (!value)
+        {
+            return std::nullopt;
+        }
+        return parseConfigValue<T>(*value);
+    }
+
+    // Sets the value of the key, to be written back later. Returns the former one (as it was in the file), if any
+    std::string set(const std::string &key, std::string_view value)
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        std::string line = key + "=" + std::string(value);
+
+        std::string previousValue;
+        auto it = mKeyLines.find(key);
+        if (it != mKeyLines.end())
+        {
+            std::string &current = mLines[it->second];
+            previousValue = std::string(parseLine(current)->second);
+            if (current == line)
+            {
+                return previousValue;
+            }
+            current = std::move(line);
+        }
+        else
+        {
+            mKeyLines.emplace(key, mLines.size());
+            mLines.push_back(std::move(line));
+        }
+
+        mPendingKeys.insert(key);
+        scheduleWriteBack();
+        return previousValue;
+    }
+
+    // Removes every key but the given ones (other lines are kept)
+    void retainOnly(const std::set<std::string> &keys)
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        bool removed = false;
+        for (const auto &[key, line] : mKeyLines)
+        {
+            if (!keys.count(key))
+            {
+                mPendingKeys.insert(key);
+                removed = true;
+            }
+        }
+        if (!removed)
+        {
+            return;
+        }
+
+        eraseLines([&keys](const std::string &key) { return !keys.count(key); });
+        scheduleWriteBack();
+    }
+
+    // Writes the pending changes now. Returns false if they could not be written (they are kept pending)
+    bool flush()
+    {
+        std::optional<std::string> error;
+        ErrorHandler errorHandler;
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            error = writeBack();
+            if (error)
+            {
+                errorHandler = mErrorHandler;
+            }
+        }
+        if (error && errorHandler)
+        {
+            errorHandler(*error);
+        }
+        return !error;
+    }
+
+    bool hasPendingChanges() const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return !mPendingKeys.empty();
+    }
+
+    // The number of times the file was written so far
+    uint64_t getWriteCount() const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return mWrites;
+    }
+
+    /**
+     * @brief Brings in the changes made to the file since it was last read or written.
+     *
+     * Those win over the pending changes to the same keys; pending changes to other keys are kept.
+     * @returns the keys whose value changed (listeners are notified of each of them)
+     */
+    std::vector<std::string> reload()
+    {
+        std::vector<std::pair<std::string, std::optional<std::string>>> changes;
+        std::vector<ChangeListener> listeners;
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            if (!mLoaded)
+            {
+                return {};
+            }
+
+            std::string content = readFile(mFile);
+            if (content == mOnDiskContent) // (e.g: the file we wrote ourselves)
+            {
+                return {};
+            }
+
+            // (pending changes are kept as lines, to be put back on top of the new ones)
+            auto before = getValues();
+            std::map<std::string, std::optional<std::string>> pendingLines;
+            for (const std::string &key : mPendingKeys)
+            {
+                auto it = mKeyLines.find(key);
+                pendingLines[key] = it == mKeyLines.end() ? std::nullopt : std::optional<std::string>(mLines[it->second]);
+            }
+
+            mLines = splitLines(content);
+            reindex();
+            auto onDisk = getValues();
+            mPendingKeys.clear();
+            for (auto &[key, line] : pendingLines)
+            {
+                if (getOptional(onDisk, key) == getOptional(mOnDisk, key))
+                {
+                    restoreLine(key, std::move(line));
+                    mPendingKeys.insert(key);
+                }
+            }
+            mOnDisk = std::move(onDisk);
+            mOnDiskContent = std::move(content);
+
+            auto after = getValues();
+            std::set<std::string> keys;
+            for (const auto &values : {&before, &after})
+            {
+                for (const auto &[key, value] : *values)
+                {
+                    keys.insert(key);
+                }
+            }
+            for (const std::string &key : keys)
+            {
+                if (auto value = getOptional(after, key); value != getOptional(before, key))
+                {
+                    changes.emplace_back(key, std::move(value));
+                }
+            }
+            listeners = mListeners;
+        }
+
+        std::vector<std::string> changedKeys;
+        for (const auto &[key, value] : changes)
+        {
+            for (const ChangeListener &listener : listeners)
+            {
+                listener(key, value);
+            }
+            changedKeys.push_back(key);
+        }
+        return changedKeys;
+    }
+
+    // Called by reload() with each key changed in the file, and its new value (nullopt if removed)
+    void addChangeListener(ChangeListener listener)
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        mListeners.push_back(std::move(listener));
+    }
+
+    void setWriteErrorHandler(ErrorHandler handler)
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        mErrorHandler = std::move(handler);
+    }
+
+private:
+    // The key (right trimmed) and the value (as is) of a "key=value" line
+    static std::optional<std::pair<std::string, std::string_view>> parseLine(std::string_view line)
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            return std::nullopt;
+        }
+        auto pos = line.find('=');
+        if (pos == std::string_view::npos)
+        {
+            return std::nullopt;
+        }
+        std::string key(line.substr(0, pos));
+        rtrimProperty(key, ' ');
+        return std::make_pair(std::move(key), line.substr(pos + 1));
+    }
+
+    static std::vector<std::string> splitLines(std::string_view content)
+    {
+        std::vector<std::string> lines;
+        while (!content.empty())
+        {
+            auto pos = content.find('\n');
+            lines.emplace_back(content.substr(0, pos));
+            content.remove_prefix(pos == std::string_view::npos ? content.size() : pos + 1);
+        }
+        return lines;
+    }
+
+    static std::string readFile(const fs::path &file)
+    {
+        std::ifstream infile(file);
+        std::ostringstream content;
+        content << infile.rdbuf();
+        return content.str();
+    }
+
+    // Writes the file and waits for it to reach the disk, so that a crash right after replacing the former one with it
+    // cannot leave an empty or partial file instead
+    static std::error_code writeFileSynced(const fs::path &file, const std::string &content)
+    {
+#ifdef _WIN32
+        FILE *fo = _wfopen(file.c_str(), L"wb");
+        if (!fo)
+        {
+            return std::make_error_code(std::errc::io_error);
+        }
+        bool ok = fwrite(content.data(), 1, content.size(), fo) == content.size();
+        ok = !fflush(fo) && ok;
+        ok = !_commit(_fileno(fo)) && ok;
+        ok = !fclose(fo) && ok;
+        return ok ? std::error_code() : std::make_error_code(std::errc::io_error);
+#else
+        int fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (fd < 0)
+        {
+            return std::error_code(errno, std::generic_category());
+        }
+
+        std::error_code ec;
+        for (size_t written = 0; written < content.size();)
+        {
+            ssize_t n = ::write(fd, content.data() + written, content.size() - written);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n < 0)
+            {
+                ec = std::error_code(errno, std::generic_category());
+                break;
+            }
+            written += static_cast<size_t>(n);
+        }
+        if (!ec && ::fsync(fd))
+        {
+            ec = std::error_code(errno, std::generic_category());
+        }
+        if (::close(fd) && !ec)
+        {
+            ec = std::error_code(errno, std::generic_category());
+        }
+        return ec;
+#endif
+    }
+
+    // Syncs the entries of a folder (not needed on Windows, nor possible through a handle to it)
+    static void syncFolder(const fs::path &folder)
+    {
+#ifndef _WIN32
+        int fd = ::open(folder.empty() ? "." : folder.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd >= 0)
+        {
+            ::fsync(fd);
+            ::close(fd);
+        }
+#else
+        (void) folder;
+#endif
+    }
+
+    // (the first line of a key is the one that counts)
+    void reindex()
+    {
+        mKeyLines.clear();
+        for (size_t i = 0; i < mLines.size(); ++i)
+        {
+            if (auto keyValue = parseLine(mLines[i]))
+            {
+                mKeyLines.emplace(std::move(keyValue->first), i);
+            }
+        }
+    }
+
+    std::optional<std::string> getValue(std::string_view key) const
+    {
+        auto it = mKeyLines.find(key);
+        if (it == mKeyLines.end())
+        {
+            return std::nullopt;
+        }
+        std::string value(parseLine(mLines[it->second])->second);
+        if (trimProperty(value).empty())
+        {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    std::map<std::string, std::string, std::less<>> getValues() const
+    {
+        std::map<std::string, std::string, std::less<>> values;
+        for (const auto &[key, line] : mKeyLines)
+        {
+            if (auto value = getValue(key))
+            {
+                values.emplace(key, std::move(*value));
+            }
+        }
+        return values;
+    }
+
+    static std::optional<std::string> getOptional(const std::map<std::string, std::string, std::less<>> &values, const std::string &key)
+    {
+        auto it = values.find(key);
+        if (it == values.end())
+        {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    template <typename Predicate>
+    void eraseLines(Predicate &&shouldErase)
+    {
+        mLines.erase(std::remove_if(mLines.begin(), mLines.end(), [&shouldErase](const std::string &line)
+        {
+            auto keyValue = parseLine(line);
+            return keyValue && shouldErase(keyValue->first);
+        }), mLines.end());
+        reindex();
+    }
+
+    // Puts back the line of a key (or removes it, if none)
+    void restoreLine(const std::string &key, std::optional<std::string> line)
+    {
+        if (!line)
+        {
+            eraseLines([&key](const std::string &lineKey) { return lineKey == key; });
+            return;
+        }
+
+        auto it = mKeyLines.find(key);
+        if (it != mKeyLines.end())
+        {
+            mLines[it->second] = std::move(*line);
+            return;
+        }
+        mKeyLines.emplace(key, mLines.size());
+        mLines.push_back(std::move(*line));
+    }
+
+    void scheduleWriteBack()
+    {
+        mWriteBack.trigger([this] { flush(); });
+    }
+
+    // Returns the error, if any
+    std::optional<std::string> writeBack()
+    {
+        if (!mLoaded || mPendingKeys.empty())
+        {
+            return std::nullopt;
+        }
+
+        std::string content;
+        for (const std::string &line : mLines)
+        {
+            content.append(line).append("\n");
+        }
+
+        fs::path tmpFile = mFile;
+        tmpFile += ".tmp";
+        std::error_code ec = writeFileSynced(tmpFile, content);
+        if (!ec)
+        {
+            fs::rename(tmpFile, mFile, ec);
+        }
+        if (!ec)
+        {
+            syncFolder(mFile.parent_path()); // (so that the rename itself survives a crash)
+        }
+        if (ec)
+        {
+            std::error_code ignored;
+            fs::remove(tmpFile, ignored);
+            return "Failed to write " + pathAsUtf8(mFile) + ": " + ec.message();
+        }
+
+        mOnDiskContent = std::move(content);
+        mOnDisk = getValues();
+        mPendingKeys.clear();
+        ++mWrites;
+        return std::nullopt;
+    }
+
+    mutable std::mutex mMutex;
+    fs::path mFile;
+    std::atomic<bool> mLoaded{false};
+    std::vector<std::string> mLines;
+    std::map<std::string, size_t, std::less<>> mKeyLines;           // line of each key
+
+    std::string mOnDiskContent;                                     // of the file, as last read or written
+    std::map<std::string, std::string, std::less<>> mOnDisk;        // values in it
+    std::set<std::string> mPendingKeys;                             // changed since then
+
+    std::vector<ChangeListener> mListeners;
+    ErrorHandler mErrorHandler;
+    uint64_t mWrites = 0;
+
+    DeferredTrigger mWriteBack; // (last, to be destroyed first)
+};
+
+}//end namespace
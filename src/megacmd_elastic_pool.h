@@ -0,0 +1,323 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "deferred_single_trigger.h"
+
+namespace megacmd {
+
+struct ElasticPoolStats
+{
+    size_t mMaxInstances = 0;
+    size_t mInstances = 0;    // created and not destroyed yet (including the ones being created or destroyed)
+    size_t mBusyInstances = 0;
+    size_t mMaxBusyInstances = 0; // high watermark
+    uint64_t mCreated = 0;
+    uint64_t mDestroyed = 0;
+    uint64_t mAcquisitions = 0;
+    uint64_t mWaits = 0;      // acquisitions that had to wait for an instance to be released
+    std::chrono::microseconds mMaxWait{0};
+};
+
+/**
+ * @brief A pool of expensive instances (e.g. MegaApi folders) created on demand and destroyed once idle for a while
+ *
+ *  - acquire() takes an idle instance, or creates one if there are less than maxInstances. Otherwise it waits
+ *    for one to be released. Instances are created (and destroyed) without holding the lock.
+ *  - Each instance is created for a slot (the lowest not in use, below maxInstances), so that whatever the factory
+ *    keeps per slot (e.g. a cache folder) is reused by the instances that come later. A slot is not in use
+ *    anymore once its instance is destroyed (not when it starts being destroyed), and instances being destroyed
+ *    count towards maxInstances: two instances never share a slot.
+ *  - Instances idle for idleTimeout are destroyed (the most recently released ones are handed out first, so that
+ *    the rest get to expire).
+ *  - maxInstances can be changed at any time: extra idle instances are destroyed right away, and busy ones
+ *    when released.
+ */
+template <typename T>
+class ElasticPool
+{
+public:
+    using Factory = std::function<std::unique_ptr<T>(size_t slot)>;
+
+    ElasticPool(size_t maxInstances, std::chrono::milliseconds idleTimeout, Factory factory) :
+        mFactory(std::move(factory)),
+        mIdleTimeout(idleTimeout),
+        mMaxInstances(maxInstances),
+        mReaper(idleTimeout, idleTimeout) // (releases keep on coming while others are idle: do not postpone it further)
+    {
+    }
+
+    ElasticPool(const ElasticPool&) = delete;
+    ElasticPool& operator=(const ElasticPool&) = delete;
+
+    // Returns nullptr if the pool does not allow any instance (or the factory failed)
+    T* acquire()
+    {
+        const auto start = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(mMutex);
+        bool waited = false;
+        for (;;)
+        {
+            if (!mMaxInstances)
+            {
+                return nullptr;
+            }
+
+            // (the idle ones are at the end of mEntries, the most recently released last)
+            if (!mEntries.empty() && !mEntries.back().mBusy)
+            {
+                Entry &entry = mEntries.back();
+                entry.mBusy = true;
+                std::rotate(mEntries.begin(), mEntries.end() - 1, mEntries.end());
+                onAcquired(start, waited);
+                return mEntries.front().mInstance.get();
+            }
+
+            if (mEntries.size() + mCreating + mDestroying < mMaxInstances)
+            {
+                break;
+            }
+
+            waited = true;
+            mReleasedCV.wait(lock);
+        }
+
+        const size_t slot = takeFreeSlot();
+        ++mCreating;
+        onAcquired(start, waited);
+        lock.unlock();
+
+        std::unique_ptr<T> instance = mFactory(slot);
+
+        lock.lock();
+        --mCreating;
+        if (!instance)
+        {
+            mSlots[slot] = false;
+            --mBusy;
+            lock.unlock();
+            mReleasedCV.notify_one();
+            return nullptr;
+        }
+        ++mCreated;
+        T *created = instance.get();
+        mEntries.insert(mEntries.begin(), Entry{std::move(instance), slot, true, {}});
+        return created;
+    }
+
+    void release(T *instance)
+    {
+        std::vector<TakenEntry> toDestroy;
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            auto it = std::find_if(mEntries.begin(), mEntries.end(), [instance](const Entry &e) { return e.mInstance.get() == instance; });
+            if (it == mEntries.end() || !it->mBusy)
+            {
+                return;
+            }
+            --mBusy;
+
+            if (mEntries.size() + mCreating > mMaxInstances) // the pool shrank meanwhile
+            {
+                toDestroy.push_back(takeEntry(it));
+            }
+            else
+            {
+                it->mBusy = false;
+                it->mIdleSince = std::chrono::steady_clock::now();
+                std::rotate(it, it + 1, mEntries.end()); // to the end: the most recently released
+            }
+        }
+        mReleasedCV.notify_one();
+
+        if (toDestroy.empty())
+        {
+            mReaper.trigger([this] { reapIdle(); });
+        }
+        destroy(std::move(toDestroy));
+    }
+
+    void setMaxInstances(size_t maxInstances)
+    {
+        std::vector<TakenEntry> toDestroy;
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            mMaxInstances = maxInstances;
+            while (mEntries.size() + mCreating > mMaxInstances && !mEntries.empty() && !mEntries.back().mBusy)
+            {
+                toDestroy.push_back(takeEntry(mEntries.end() - 1));
+            }
+        }
+        mReleasedCV.notify_all(); // to create more, or to give up if none are allowed anymore
+        destroy(std::move(toDestroy));
+    }
+
+    // Destroys the instances idle for longer than the idle timeout. Returns how many
+    size_t reapIdle(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now())
+    {
+        std::vector<TakenEntry> toDestroy;
+        bool idleLeft = false;
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            for (auto it = mEntries.begin(); it != mEntries.end();)
+            {
+                if (it->mBusy)
+                {
+                    ++it;
+                }
+                else if (now - it->mIdleSince >= mIdleTimeout)
+                {
+                    toDestroy.push_back(takeEntry(it));
+                    it = mEntries.begin(); // (takeEntry invalidates it: cheap, there are few of them)
+                }
+                else
+                {
+                    idleLeft = true;
+                    ++it;
+                }
+            }
+        }
+
+        if (idleLeft)
+        {
+            mReaper.trigger([this] { reapIdle(); });
+        }
+        const size_t reaped = toDestroy.size();
+        destroy(std::move(toDestroy));
+        return reaped;
+    }
+
+    ElasticPoolStats getStats() const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        ElasticPoolStats stats;
+        stats.mMaxInstances = mMaxInstances;
+        stats.mInstances = mEntries.size() + mCreating + mDestroying;
+        stats.mBusyInstances = mBusy;
+        stats.mMaxBusyInstances = mMaxBusy;
+        stats.mCreated = mCreated;
+        stats.mDestroyed = mDestroyed;
+        stats.mAcquisitions = mAcquisitions;
+        stats.mWaits = mWaits;
+        stats.mMaxWait = mMaxWait;
+        return stats;
+    }
+
+private:
+    struct Entry
+    {
+        std::unique_ptr<T> mInstance;
+        size_t mSlot;
+        bool mBusy;
+        std::chrono::steady_clock::time_point mIdleSince;
+    };
+
+    // Requires mMutex locked
+    size_t takeFreeSlot()
+    {
+        auto it = std::find(mSlots.begin(), mSlots.end(), false);
+        if (it == mSlots.end())
+        {
+            mSlots.push_back(true);
+            return mSlots.size() - 1;
+        }
+        *it = true;
+        return static_cast<size_t>(it - mSlots.begin());
+    }
+
+    struct TakenEntry
+    {
+        std::unique_ptr<T> mInstance;
+        size_t mSlot;
+    };
+
+    // Requires mMutex locked. The instance is to be destroyed without it (see destroy)
+    TakenEntry takeEntry(typename std::vector<Entry>::iterator it)
+    {
+        TakenEntry taken{std::move(it->mInstance), it->mSlot};
+        mEntries.erase(it);
+        ++mDestroying;
+        return taken;
+    }
+
+    // Requires mMutex unlocked. Their slots are freed once they are destroyed
+    void destroy(std::vector<TakenEntry> &&taken)
+    {
+        if (taken.empty())
+        {
+            return;
+        }
+
+        for (auto &entry : taken)
+        {
+            entry.mInstance.reset();
+        }
+
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            for (auto &entry : taken)
+            {
+                mSlots[entry.mSlot] = false;
+            }
+            mDestroying -= taken.size();
+            mDestroyed += taken.size();
+        }
+        mReleasedCV.notify_all();
+    }
+
+    // Requires mMutex locked
+    void onAcquired(std::chrono::steady_clock::time_point start, bool waited)
+    {
+        ++mAcquisitions;
+        ++mBusy;
+        mMaxBusy = std::max(mMaxBusy, mBusy);
+        if (waited)
+        {
+            ++mWaits;
+            mMaxWait = std::max(mMaxWait, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start));
+        }
+    }
+
+    const Factory mFactory;
+    const std::chrono::milliseconds mIdleTimeout;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mReleasedCV;
+    size_t mMaxInstances;
+    std::vector<Entry> mEntries; // busy ones first, then the idle ones from the least to the most recently released
+    std::vector<bool> mSlots;    // in use
+    size_t mCreating = 0;
+    size_t mDestroying = 0;
+    size_t mBusy = 0;            // (including the ones being created)
+    size_t mMaxBusy = 0;
+    uint64_t mCreated = 0;
+    uint64_t mDestroyed = 0;
+    uint64_t mAcquisitions = 0;
+    uint64_t mWaits = 0;
+    std::chrono::microseconds mMaxWait{0};
+
+    DeferredTrigger mReaper; // (last: its callbacks use the rest)
+};
+
+}//end namespace
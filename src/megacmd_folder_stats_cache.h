@@ -0,0 +1,239 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace megacmd {
+
+// What getFolderInfo tells about a folder
+struct FolderStats
+{
+    long long mFiles = 0;
+    long long mFolders = 0;
+    long long mVersions = 0;
+};
+
+struct FolderStatsCacheStats
+{
+    size_t mEntries = 0;
+    uint64_t mHits = 0;
+    uint64_t mMisses = 0;
+    uint64_t mInvalidations = 0;
+};
+
+/**
+ * @brief A cache of the statistics of (a few) folders, as sync roots, to not request them every time they are shown.
+ *
+ * An entry is dropped when a node in the folder (or the folder itself) changes. Statistics being fetched when
+ * that happens are not stored: fetches are bracketed by fetchStarted / fetchFinished.
+ *
+ * Changes reported by nodesChanged (from the SDK thread) are only recorded: the folders containing them are
+ * looked up (with getParent) by the next get.
+ */
+class FolderStatsCache
+{
+public:
+    using Handle = uint64_t; // mega::MegaHandle
+    static constexpr Handle UNDEF = UINT64_MAX;
+
+    // Beyond that many changed nodes pending, everything is dropped instead of looking up their folders
+    static constexpr size_t MAX_PENDING_CHANGES = 100000;
+
+    // getParent returns the handle of the parent of a node (UNDEF for the roots). Without it, any change drops everything
+    explicit FolderStatsCache(std::function<Handle(Handle)> getParent = nullptr) :
+        mGetParent(std::move(getParent))
+    {
+    }
+
+    std::optional<FolderStats> get(Handle folder)
+    {
+        resolvePendingChanges();
+
+        std::lock_guard<std::mutex> g(mMutex);
+        auto it = mEntries.find(folder);
+        if (it == mEntries.end())
+        {
+            ++mMisses;
+            return std::nullopt;
+        }
+        ++mHits;
+        return it->second;
+    }
+
+    void fetchStarted(Handle folder)
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        ++mFetches[folder].mCount;
+    }
+
+    // stats is empty if the fetch failed
+    void fetchFinished(Handle folder, const std::optional<FolderStats> &stats)
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        auto it = mFetches.find(folder);
+        if (it == mFetches.end())
+        {
+            return;
+        }
+        if (stats && !it->second.mStale)
+        {
+            mEntries[folder] = *stats;
+        }
+        if (!--it->second.mCount)
+        {
+            mFetches.erase(it);
+        }
+    }
+
+    bool empty() const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return mEntries.empty() && mFetches.empty();
+    }
+
+    /**
+     * @brief Drops the entries of the folders containing any of the changed nodes
+     * @param getParent returns the handle of the parent of a node (UNDEF for the roots)
+     */
+    template <typename GetParent>
+    void invalidateAncestors(const std::vector<Handle> &changed, GetParent &&getParent)
+    {
+        // (the parents are looked up without holding the lock, each one once)
+        std::unordered_set<Handle> ancestors;
+        for (Handle handle : changed)
+        {
+            while (handle != UNDEF && ancestors.insert(handle).second)
+            {
+                handle = getParent(handle);
+            }
+        }
+
+        std::lock_guard<std::mutex> g(mMutex);
+        for (Handle handle : ancestors)
+        {
+            mInvalidations += mEntries.erase(handle);
+            auto it = mFetches.find(handle);
+            if (it != mFetches.end())
+            {
+                it->second.mStale = true;
+            }
+        }
+    }
+
+    // Records nodes that changed (and their parents), to drop the entries of the folders containing them later on
+    void nodesChanged(const std::vector<Handle> &changed)
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        if (mEntries.empty() && mFetches.empty())
+        {
+            return;
+        }
+
+        // (whether the folders being fetched contain the changes is not known yet)
+        for (auto &fetch : mFetches)
+        {
+            fetch.second.mStale = true;
+        }
+
+        if (mPendingChanges.size() + changed.size() > MAX_PENDING_CHANGES)
+        {
+            mPendingChanges.clear();
+            clearLocked();
+            return;
+        }
+        mPendingChanges.insert(mPendingChanges.end(), changed.begin(), changed.end());
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        mPendingChanges.clear();
+        clearLocked();
+    }
+
+    FolderStatsCacheStats getStats() const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        FolderStatsCacheStats stats;
+        stats.mEntries = mEntries.size();
+        stats.mHits = mHits;
+        stats.mMisses = mMisses;
+        stats.mInvalidations = mInvalidations;
+        return stats;
+    }
+
+private:
+    void resolvePendingChanges()
+    {
+        std::lock_guard<std::mutex> resolving(mResolveMutex);
+
+        std::vector<Handle> changed;
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            changed.swap(mPendingChanges);
+        }
+        if (changed.empty())
+        {
+            return;
+        }
+
+        if (!mGetParent)
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            clearLocked();
+            return;
+        }
+        invalidateAncestors(changed, mGetParent);
+    }
+
+    void clearLocked()
+    {
+        mInvalidations += mEntries.size();
+        mEntries.clear();
+        for (auto &fetch : mFetches)
+        {
+            fetch.second.mStale = true;
+        }
+    }
+
+    struct Fetch
+    {
+        unsigned mCount = 0;
+        bool mStale = false; // invalidated while fetching
+    };
+
+    std::function<Handle(Handle)> mGetParent;
+
+    mutable std::mutex mMutex;
+    std::unordered_map<Handle, FolderStats> mEntries;
+    std::unordered_map<Handle, Fetch> mFetches;
+    std::vector<Handle> mPendingChanges;
+
+    // held while looking up the folders of pending changes, so that gets meanwhile wait for them
+    std::mutex mResolveMutex;
+    uint64_t mHits = 0;
+    uint64_t mMisses = 0;
+    uint64_t mInvalidations = 0;
+};
+
+}//end namespace
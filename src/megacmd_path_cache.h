@@ -0,0 +1,173 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace megacmd {
+
+struct PathCacheStats
+{
+    size_t mEntries = 0;
+    size_t mCapacity = 0;
+    uint64_t mHits = 0;
+    uint64_t mMisses = 0;
+    uint64_t mInvalidations = 0;
+};
+
+/**
+ * @brief A bounded LRU cache of resolved paths: for a base node (the root, the cwd, an inshare...) and
+ * a path relative to it, as typed (i.e: escaped), the handle of the node it resolved to.
+ *
+ * Being resolved from the same base, a path always resolves to the same node as long as the tree doesn't
+ * change, so the cache is simply cleared whenever it might have. To avoid caching resolutions that started
+ * before that, they are only stored if no clear() happened since the generation() they started at.
+ */
+class PathResolutionCache
+{
+public:
+    using Handle = uint64_t; // mega::MegaHandle
+
+    explicit PathResolutionCache(size_t capacity = 4096) :
+        mCapacity(capacity)
+    {
+    }
+
+    uint64_t generation() const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return mGeneration;
+    }
+
+    /**
+     * @brief Looks for the longest prefix of path, ending either at a '/' or at its very end, that has been cached
+     * @returns the length of that prefix and the handle it resolved to, or nothing (a miss) if none was cached
+     */
+    std::optional<std::pair<size_t, Handle>> findLongestPrefix(Handle base, std::string_view path)
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        for (size_t length = path.size(); length != std::string_view::npos && length > 0; length = path.rfind('/', length - 1))
+        {
+            auto it = mEntries.find(makeKey(base, path.substr(0, length)));
+            if (it != mEntries.end())
+            {
+                mLru.splice(mLru.begin(), mLru, it->second.mLruPosition);
+                ++mHits;
+                return std::make_pair(length, it->second.mHandle);
+            }
+        }
+        ++mMisses;
+        return std::nullopt;
+    }
+
+    void put(Handle base, std::string_view path, Handle resolved, uint64_t generation)
+    {
+        if (!mCapacity || path.empty())
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> g(mMutex);
+        if (generation != mGeneration)
+        {
+            return; // the tree might have changed while resolving
+        }
+
+        auto key = makeKey(base, path);
+        auto it = mEntries.find(key);
+        if (it != mEntries.end())
+        {
+            it->second.mHandle = resolved;
+            mLru.splice(mLru.begin(), mLru, it->second.mLruPosition);
+            return;
+        }
+
+        if (mEntries.size() >= mCapacity)
+        {
+            mEntries.erase(mLru.back());
+            mLru.pop_back();
+        }
+
+        mLru.push_front(key);
+        mEntries.emplace(std::move(key), Entry{resolved, mLru.begin()});
+    }
+
+    // For entries found to be no longer valid
+    void erase(Handle base, std::string_view path)
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        auto it = mEntries.find(makeKey(base, path));
+        if (it != mEntries.end())
+        {
+            mLru.erase(it->second.mLruPosition);
+            mEntries.erase(it);
+        }
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        ++mGeneration;
+        ++mInvalidations;
+        mEntries.clear();
+        mLru.clear();
+    }
+
+    PathCacheStats getStats() const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        PathCacheStats stats;
+        stats.mEntries = mEntries.size();
+        stats.mCapacity = mCapacity;
+        stats.mHits = mHits;
+        stats.mMisses = mMisses;
+        stats.mInvalidations = mInvalidations;
+        return stats;
+    }
+
+private:
+    struct Entry
+    {
+        Handle mHandle;
+        std::list<std::string>::iterator mLruPosition;
+    };
+
+    static std::string makeKey(Handle base, std::string_view path)
+    {
+        std::string key(reinterpret_cast<const char*>(&base), sizeof(base));
+        key.append(path);
+        return key;
+    }
+
+    const size_t mCapacity;
+
+    mutable std::mutex mMutex;
+    std::unordered_map<std::string, Entry> mEntries;
+    std::list<std::string> mLru; // most recently used first
+    uint64_t mGeneration = 0;
+    uint64_t mHits = 0;
+    uint64_t mMisses = 0;
+    uint64_t mInvalidations = 0;
+};
+
+}//end namespace
@@ -0,0 +1,93 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace megacmd {
+
+/**
+ * @brief Finds which of a set of root folders (e.g: sync roots) contains a path, looking up the
+ * path and each of its ancestors: O(depth) regardless of the number of roots.
+ *
+ * Both '/' and '\\' are taken as separators. Unlike a plain string prefix check, "/a/foobar" is not within "/a/foo".
+ */
+template <typename Id>
+class PathPrefixIndex
+{
+public:
+    void add(std::string_view root, Id id)
+    {
+        mRoots.emplace(std::string(trimTrailingSeparators(root)), id);
+    }
+
+    bool empty() const
+    {
+        return mRoots.empty();
+    }
+
+    // The root that is path, or its closest ancestor
+    std::optional<Id> findContaining(std::string_view path) const
+    {
+        if (mRoots.empty())
+        {
+            return std::nullopt;
+        }
+
+        path = trimTrailingSeparators(path);
+        for (size_t length = path.size(); ; )
+        {
+            auto it = mRoots.find(std::string(path.substr(0, length)));
+            if (it != mRoots.end())
+            {
+                return it->second;
+            }
+            if (!length)
+            {
+                return std::nullopt;
+            }
+            const size_t separator = path.find_last_of("/\\", length - 1);
+            if (separator == std::string_view::npos)
+            {
+                return std::nullopt;
+            }
+            length = separator;
+        }
+    }
+
+private:
+    static bool isSeparator(char c)
+    {
+        return c == '/' || c == '\\';
+    }
+
+    // (the root "/" becomes "", found for any absolute path)
+    static std::string_view trimTrailingSeparators(std::string_view path)
+    {
+        while (!path.empty() && isSeparator(path.back()))
+        {
+            path.remove_suffix(1);
+        }
+        return path;
+    }
+
+    std::unordered_map<std::string, Id> mRoots;
+};
+
+}//end namespace
@@ -0,0 +1,157 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace megacmd {
+
+/*
+ * Petitions can be sent to the server in two ways:
+ *  - raw (legacy clients): the petition is whatever the client writes before waiting for the response.
+ *  - framed: a header (magic, version & payload size) followed by the petition itself.
+ *    The header starts with a null character, which a raw petition (a command line) never starts with,
+ *    so that the server can tell one from the other in every petition.
+ */
+constexpr char PETITION_FRAME_MAGIC[4] = {'\0', 'M', 'C', 'F'};
+constexpr uint32_t PETITION_FRAME_VERSION = 1;
+constexpr size_t PETITION_FRAME_HEADER_SIZE = sizeof(PETITION_FRAME_MAGIC) + sizeof(uint32_t) + sizeof(uint64_t);
+constexpr uint64_t PETITION_FRAME_MAX_PAYLOAD_SIZE = 256ull * 1024 * 1024;
+
+/*
+ * Servers acknowledge every framed petition with PETITION_FRAME_ACK, before anything else they write back (but
+ * SESSION_PETITION, acknowledged as a session). That is how clients find out whether the server takes framed petitions,
+ * without asking beforehand: servers older than frames take a frame as an empty petition (its first character is
+ * null), which does nothing, and respond to it with an out code instead. Clients then send the petition again, raw.
+ * (No out code is the acknowledgement, read as an int)
+ */
+constexpr char PETITION_FRAME_ACK[4] = {'\0', 'M', 'C', 'A'};
+
+enum class PetitionFrameStatus
+{
+    INCOMPLETE, // not enough data to tell (or the header is not complete yet)
+    RAW,        // a legacy petition
+    FRAMED,     // a valid header: payload size available
+    INVALID,    // a header from an unsupported version or with an excessive size
+};
+
+inline std::string framePetition(std::string_view petition)
+{
+    const uint32_t version = PETITION_FRAME_VERSION;
+    const uint64_t payloadSize = petition.size();
+
+    std::string frame;
+    frame.reserve(PETITION_FRAME_HEADER_SIZE + petition.size());
+    frame.append(PETITION_FRAME_MAGIC, sizeof(PETITION_FRAME_MAGIC));
+    frame.append(reinterpret_cast<const char*>(&version), sizeof(version));
+    frame.append(reinterpret_cast<const char*>(&payloadSize), sizeof(payloadSize));
+    frame.append(petition);
+    return frame;
+}
+
+// Inspects the first bytes received from a client
+inline PetitionFrameStatus parsePetitionFrameHeader(std::string_view received, uint64_t &payloadSize)
+{
+    const size_t magicBytes = std::min(received.size(), sizeof(PETITION_FRAME_MAGIC));
+    if (memcmp(received.data(), PETITION_FRAME_MAGIC, magicBytes))
+    {
+        return PetitionFrameStatus::RAW;
+    }
+
+    if (received.size() < PETITION_FRAME_HEADER_SIZE)
+    {
+        return PetitionFrameStatus::INCOMPLETE;
+    }
+
+    uint32_t version;
+    memcpy(&version, received.data() + sizeof(PETITION_FRAME_MAGIC), sizeof(version));
+    memcpy(&payloadSize, received.data() + sizeof(PETITION_FRAME_MAGIC) + sizeof(version), sizeof(payloadSize));
+
+    if (version != PETITION_FRAME_VERSION || payloadSize > PETITION_FRAME_MAX_PAYLOAD_SIZE)
+    {
+        return PetitionFrameStatus::INVALID;
+    }
+    return PetitionFrameStatus::FRAMED;
+}
+
+/*
+ * Persistent sessions: a client sends the (framed) petition SESSION_PETITION and, once acknowledged, keeps
+ * the connection open to send many requests through it, without connecting again for each of them.
+ * Every message that follows, in both directions, is a session frame: a header (magic, request id, code
+ * & payload size) followed by the payload:
+ *  - client to server: a petition, tagged with an id chosen by the client (the code is not used).
+ *  - server to client: partial outputs/errors (MCMD_PARTIALOUT/MCMD_PARTIALERR) of a request, and its
+ *    out code together with the rest of the output, which ends that request.
+ * The server acknowledges the session with a frame for request 0. Requests are served concurrently, so
+ * the frames of different requests may interleave: clients demultiplex them by request id.
+ * Sessions are not interactive: a request asking the user (for a confirmation or a string) gets the question
+ * as a partial error and ends with MCMD_NOTPERMITTED.
+ */
+constexpr std::string_view SESSION_PETITION = "startsession";
+constexpr char SESSION_FRAME_MAGIC[4] = {'\0', 'M', 'C', 'S'};
+constexpr size_t SESSION_FRAME_HEADER_SIZE = sizeof(SESSION_FRAME_MAGIC) + sizeof(uint32_t) + sizeof(int32_t) + sizeof(uint64_t);
+
+struct SessionFrameHeader
+{
+    uint32_t mRequestId = 0;
+    int32_t mCode = 0;
+    uint64_t mPayloadSize = 0;
+};
+
+inline std::string sessionFrameHeader(uint32_t requestId, int32_t code, uint64_t payloadSize)
+{
+    std::string header;
+    header.reserve(SESSION_FRAME_HEADER_SIZE);
+    header.append(SESSION_FRAME_MAGIC, sizeof(SESSION_FRAME_MAGIC));
+    header.append(reinterpret_cast<const char*>(&requestId), sizeof(requestId));
+    header.append(reinterpret_cast<const char*>(&code), sizeof(code));
+    header.append(reinterpret_cast<const char*>(&payloadSize), sizeof(payloadSize));
+    return header;
+}
+
+inline std::string frameSessionMessage(uint32_t requestId, int32_t code, std::string_view payload)
+{
+    return sessionFrameHeader(requestId, code, payload.size()).append(payload);
+}
+
+// Petitions that take over their connection (state listeners, which keep on receiving unframed messages through it),
+// and thus cannot be served within a session: they are rejected with an error frame
+inline bool takesOverConnection(std::string_view uniformLine)
+{
+    constexpr std::string_view stateListenerPetition = "registerstatelistener";
+    return uniformLine.substr(0, stateListenerPetition.size()) == stateListenerPetition || uniformLine == SESSION_PETITION;
+}
+
+// Requires at least SESSION_FRAME_HEADER_SIZE bytes. Returns false if they are not a valid header
+inline bool parseSessionFrameHeader(std::string_view received, SessionFrameHeader &header)
+{
+    if (received.size() < SESSION_FRAME_HEADER_SIZE || memcmp(received.data(), SESSION_FRAME_MAGIC, sizeof(SESSION_FRAME_MAGIC)))
+    {
+        return false;
+    }
+
+    const char *fields = received.data() + sizeof(SESSION_FRAME_MAGIC);
+    memcpy(&header.mRequestId, fields, sizeof(header.mRequestId));
+    memcpy(&header.mCode, fields + sizeof(header.mRequestId), sizeof(header.mCode));
+    memcpy(&header.mPayloadSize, fields + sizeof(header.mRequestId) + sizeof(header.mCode), sizeof(header.mPayloadSize));
+    return header.mPayloadSize <= PETITION_FRAME_MAX_PAYLOAD_SIZE;
+}
+
+}//end namespace
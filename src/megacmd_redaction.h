@@ -0,0 +1,216 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace megacmd {
+
+/**
+ * @brief Removes confidential info from a command line, to be logged:
+ *  - everything after the command, for passwd, login, confirm and confirmcancel (e.g: "login <REDACTED>")
+ *  - the values of --password (quoted or not), --auth-code and --auth-key (e.g: "--password=********")
+ *  - the keys of links (e.g: "https://mega.nz/file/handle#********"), including old and password protected ones
+ *
+ * Each kind of secret is looked for in a hand-written scan of the line, in the same order and with the same matching
+ * rules the std::regex chain that this replaced used (so that a secret within another, e.g. a password within a link,
+ * is redacted the same). Most lines do not even have the prefixes the scans look for.
+ */
+class LineRedactor
+{
+public:
+    static std::string redact(std::string_view line)
+    {
+        if (auto commandEnd = getConfidentialCommandEnd(line))
+        {
+            return std::string(line.substr(0, commandEnd)).append("<REDACTED>");
+        }
+
+        std::string output(line);
+        if (output.find("--") != std::string::npos)
+        {
+            output = replaceAll(output, "--password=", matchPassword);
+            output = replaceAll(output, "--auth-", matchAuth);
+        }
+        if (output.find(sMegaUrl) != std::string::npos)
+        {
+            output = replaceAll(output, sMegaUrl, matchLink);
+            output = replaceAll(output, sMegaUrl, matchOldLink);
+            output = replaceAll(output, sMegaUrl, matchEncryptedLink);
+        }
+        return output;
+    }
+
+private:
+    static constexpr std::string_view sMegaUrl = "https://mega.nz/";
+    static constexpr size_t npos = std::string_view::npos;
+
+    // (those of \s in the classic locale)
+    static bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+    }
+
+    static bool startsWith(std::string_view s, size_t pos, std::string_view prefix)
+    {
+        return s.substr(pos, prefix.size()) == prefix;
+    }
+
+    // The end of \S+ from pos (npos if there is no such char there)
+    static size_t matchNonSpaces(std::string_view s, size_t pos)
+    {
+        size_t end = pos;
+        while (end < s.size() && !isSpace(s[end]))
+        {
+            ++end;
+        }
+        return end == pos ? npos : end;
+    }
+
+    /**
+     * @returns the length of "[X](passwd|login|confirm|confirmcancel)\s+" at the beginning of the line (0 if it is not one)
+     * Unlike the former "^...\s+.*$" regex, lines with more than one line are redacted too.
+     */
+    static size_t getConfidentialCommandEnd(std::string_view line)
+    {
+        size_t pos = !line.empty() && line[0] == 'X' ? 1 : 0;
+        static constexpr std::array<std::string_view, 4> commands{"passwd", "login", "confirmcancel", "confirm"};
+        for (std::string_view command : commands)
+        {
+            if (startsWith(line, pos, command) && pos + command.size() < line.size() && isSpace(line[pos + command.size()]))
+            {
+                size_t end = pos + command.size();
+                while (end < line.size() && isSpace(line[end]))
+                {
+                    ++end;
+                }
+                return end;
+            }
+        }
+        return 0;
+    }
+
+    // Each matcher is given the position after the prefix looked for. It returns the end of the match (npos if none),
+    // and the end of the text that is kept (the rest of the match is replaced by asterisks)
+
+    // (--password=)("[^"]+"|'[^']+'|\S+)
+    static std::pair<size_t, size_t> matchPassword(std::string_view s, size_t pos)
+    {
+        if (pos < s.size() && (s[pos] == '"' || s[pos] == '\''))
+        {
+            size_t closing = s.find(s[pos], pos + 1);
+            if (closing != npos && closing > pos + 1)
+            {
+                return {closing + 1, pos};
+            }
+        }
+        return {matchNonSpaces(s, pos), pos};
+    }
+
+    // (--auth-(code|key)=)\S+
+    static std::pair<size_t, size_t> matchAuth(std::string_view s, size_t pos)
+    {
+        for (std::string_view kind : {std::string_view("code="), std::string_view("key=")})
+        {
+            if (startsWith(s, pos, kind))
+            {
+                return {matchNonSpaces(s, pos + kind.size()), pos + kind.size()};
+            }
+        }
+        return {npos, npos};
+    }
+
+    // (https://mega\.nz/(file|folder)/[^#]+#)\S+
+    static std::pair<size_t, size_t> matchLink(std::string_view s, size_t pos)
+    {
+        for (std::string_view kind : {std::string_view("file/"), std::string_view("folder/")})
+        {
+            if (startsWith(s, pos, kind))
+            {
+                size_t hash = s.find('#', pos + kind.size());
+                if (hash == npos || hash == pos + kind.size())
+                {
+                    return {npos, npos};
+                }
+                return {matchNonSpaces(s, hash + 1), hash + 1};
+            }
+        }
+        return {npos, npos};
+    }
+
+    // (https://mega\.nz/#F?![^!]+#)\S+
+    static std::pair<size_t, size_t> matchOldLink(std::string_view s, size_t pos)
+    {
+        if (!startsWith(s, pos, "#!") && !startsWith(s, pos, "#F!"))
+        {
+            return {npos, npos};
+        }
+        size_t handle = pos + (s[pos + 1] == 'F' ? 3 : 2);
+
+        // ([^!]+ goes as far as it can, and then back to the last '#' followed by \S)
+        size_t handleEnd = std::min(s.find('!', handle), s.size());
+        for (size_t hash = handleEnd; hash-- > handle + 1; )
+        {
+            if (s[hash] == '#' && hash + 1 < s.size() && !isSpace(s[hash + 1]))
+            {
+                return {matchNonSpaces(s, hash + 1), hash + 1};
+            }
+        }
+        return {npos, npos};
+    }
+
+    // (https://mega\.nz/#P!)\S+
+    static std::pair<size_t, size_t> matchEncryptedLink(std::string_view s, size_t pos)
+    {
+        if (!startsWith(s, pos, "#P!"))
+        {
+            return {npos, npos};
+        }
+        return {matchNonSpaces(s, pos + 3), pos + 3};
+    }
+
+    // Like std::regex_replace with "$1********": replaces every match (not overlapping the former one) found from the left
+    template <typename Matcher>
+    static std::string replaceAll(const std::string &s, std::string_view prefix, Matcher &&match)
+    {
+        std::string output;
+        size_t copied = 0;
+        size_t pos = s.find(prefix);
+        while (pos != npos)
+        {
+            auto [end, kept] = match(s, pos + prefix.size());
+            if (end == npos)
+            {
+                pos = s.find(prefix, pos + 1);
+                continue;
+            }
+            output.append(s, copied, kept - copied).append("********");
+            copied = end;
+            pos = s.find(prefix, end);
+        }
+        if (!copied)
+        {
+            return s;
+        }
+        return output.append(s, copied, npos);
+    }
+};
+
+}//end namespace
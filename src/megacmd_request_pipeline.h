@@ -0,0 +1,130 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace megacmd {
+
+/**
+ * @brief Keeps up to a window of asynchronous requests in flight, instead of waiting for each one before issuing the next.
+ *
+ * An operation may consist of several dependent requests: each one is issued from the callback of the previous one,
+ * and the operation finishes (freeing its room in the window) when the last one does.
+ *
+ * Failures are collected (rather than reported from whichever thread finished them) for the submitter to report them,
+ * in the order the operations were submitted.
+ */
+class RequestPipeline
+{
+public:
+    // To be called once an operation finished, with its error code (0 for success)
+    using Done = std::function<void(int errorCode)>;
+
+    // Called with (finished, submitted) each time a request finishes. It is called holding the pipeline lock: keep it short
+    using ProgressCallback = std::function<void(size_t finished, size_t submitted)>;
+
+    struct Failure
+    {
+        size_t mIndex;  // order of submission
+        std::string mDescription;
+        int mErrorCode;
+    };
+
+    explicit RequestPipeline(size_t window, ProgressCallback onProgress = nullptr) :
+        mWindow(std::max<size_t>(1, window)),
+        mOnProgress(std::move(onProgress))
+    {
+    }
+
+    ~RequestPipeline()
+    {
+        waitAll();
+    }
+
+    /**
+     * @brief Waits for room in the window and issues an operation: start must issue its first request (without waiting
+     * for it) and have done called once the operation finishes, from any thread.
+     * @returns the index of the operation (its order of submission)
+     */
+    size_t submit(std::string description, const std::function<void(Done)> &start)
+    {
+        size_t index;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCv.wait(lock, [this]() { return mSubmitted - mFinished < mWindow; });
+            index = mSubmitted++;
+        }
+
+        start([this, index, description = std::move(description)](int errorCode) {
+            std::lock_guard<std::mutex> g(mMutex);
+            ++mFinished;
+            if (errorCode)
+            {
+                mFailures.push_back({index, description, errorCode});
+            }
+            if (mOnProgress)
+            {
+                mOnProgress(mFinished, mSubmitted);
+            }
+            mCv.notify_all();
+        });
+        return index;
+    }
+
+    // Waits for all the requests submitted to finish
+    void waitAll()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCv.wait(lock, [this]() { return mFinished == mSubmitted; });
+    }
+
+    // The failures so far, in order of submission
+    std::vector<Failure> takeFailures()
+    {
+        std::vector<Failure> failures;
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            failures.swap(mFailures);
+        }
+        std::sort(failures.begin(), failures.end(), [](const Failure &a, const Failure &b) { return a.mIndex < b.mIndex; });
+        return failures;
+    }
+
+    size_t submitted() const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return mSubmitted;
+    }
+
+private:
+    const size_t mWindow;
+    const ProgressCallback mOnProgress;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCv;
+    size_t mSubmitted = 0;
+    size_t mFinished = 0;
+    std::vector<Failure> mFailures;
+};
+
+}//end namespace
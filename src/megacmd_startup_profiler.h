@@ -0,0 +1,136 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace megacmd {
+
+/**
+ * @brief Times the phases of the server startup
+ *
+ *  - The startup sequence: each phase ends with endSequentialPhase, and begins when the former one ended.
+ *  - Phases apart from the sequence (e.g. those going on in the background once the server is serving commands),
+ *    with startPhase and endPhase. Each of them is timed only once: the first time it is started.
+ *
+ * It is thread safe.
+ */
+class StartupProfiler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Phase
+    {
+        std::string mName;
+        Clock::duration mStart{};    // since the startup began
+        Clock::duration mDuration{}; // so far, if ongoing
+        bool mOngoing = false;
+    };
+
+    explicit StartupProfiler(Clock::time_point start = Clock::now()) : mStart(start), mSequenceEnd(start) {}
+
+    // Returns how long it took
+    Clock::duration endSequentialPhase(std::string name, Clock::time_point now = Clock::now())
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        const auto duration = now - mSequenceEnd;
+        mPhases.push_back({std::move(name), mSequenceEnd - mStart, duration, false});
+        mSequenceEnd = now;
+        return duration;
+    }
+
+    // false if it had been started already
+    bool startPhase(std::string name, Clock::time_point now = Clock::now())
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        if (findPhase(name) != mPhases.end())
+        {
+            return false;
+        }
+        mPhases.push_back({std::move(name), now - mStart, {}, true});
+        return true;
+    }
+
+    // Returns how long it took (nullopt if it was not ongoing)
+    std::optional<Clock::duration> endPhase(const std::string &name, Clock::time_point now = Clock::now())
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        auto it = findPhase(name);
+        if (it == mPhases.end() || !it->mOngoing)
+        {
+            return std::nullopt;
+        }
+        it->mOngoing = false;
+        it->mDuration = now - mStart - it->mStart;
+        return it->mDuration;
+    }
+
+    bool isOngoing(const std::string &name) const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        auto it = findPhase(name);
+        return it != mPhases.end() && it->mOngoing;
+    }
+
+    Clock::duration getElapsed(Clock::time_point now = Clock::now()) const
+    {
+        return now - mStart;
+    }
+
+    // By start
+    std::vector<Phase> getPhases(Clock::time_point now = Clock::now()) const
+    {
+        std::vector<Phase> phases;
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            phases = mPhases;
+        }
+        for (auto &phase : phases)
+        {
+            if (phase.mOngoing)
+            {
+                phase.mDuration = now - mStart - phase.mStart;
+            }
+        }
+        std::stable_sort(phases.begin(), phases.end(), [](const Phase &a, const Phase &b) { return a.mStart < b.mStart; });
+        return phases;
+    }
+
+private:
+    const Clock::time_point mStart;
+
+    mutable std::mutex mMutex;
+    Clock::time_point mSequenceEnd;
+    std::vector<Phase> mPhases;
+
+    std::vector<Phase>::iterator findPhase(const std::string &name)
+    {
+        return std::find_if(mPhases.begin(), mPhases.end(), [&name](const Phase &p) { return p.mName == name; });
+    }
+
+    std::vector<Phase>::const_iterator findPhase(const std::string &name) const
+    {
+        return std::find_if(mPhases.begin(), mPhases.end(), [&name](const Phase &p) { return p.mName == name; });
+    }
+};
+
+}//end namespace
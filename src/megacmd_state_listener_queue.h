@@ -0,0 +1,206 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <cerrno>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace megacmd {
+
+/**
+ * @brief Outbound messages of a state listener not yet written to its (non-blocking) socket
+ *
+ * Informing a listener only queues the message and writes whatever the socket takes, so that a client
+ * not reading its state messages (e.g. a frozen shell) does not hold back the others nor whoever informed them.
+ *
+ *  - A message superseding the last queued one (not yet started to be written) replaces it: a newer progress
+ *    of the same transfer, or a newer prompt.
+ *  - The queue is bounded: a push that goes beyond maxQueuedBytes is refused (the listener is to be evicted).
+ *  - A listener is stalled when messages have been queued for longer than maxStall without anything written.
+ *
+ * It is thread safe: messages are pushed by whoever informs, and drained by the communications event loop.
+ */
+class StateListenerQueue
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class DrainResult
+    {
+        DRAINED, // nothing left to write
+        PENDING, // the socket would block: to be drained again once writable
+        FAILED,  // the socket cannot be written anymore
+    };
+
+    static constexpr size_t DEFAULT_MAX_QUEUED_BYTES = 256 * 1024;
+    static constexpr std::chrono::milliseconds DEFAULT_MAX_STALL = std::chrono::seconds(10);
+
+    explicit StateListenerQueue(size_t maxQueuedBytes = DEFAULT_MAX_QUEUED_BYTES,
+                                std::chrono::milliseconds maxStall = DEFAULT_MAX_STALL)
+        : mMaxQueuedBytes(maxQueuedBytes), mMaxStall(maxStall)
+    {
+    }
+
+    // false if the message would not fit (it is not queued)
+    bool push(std::string message, Clock::time_point now = Clock::now())
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+
+        const bool canReplaceLast = !mMessages.empty() && (mMessages.size() > 1 || !mFrontWritten);
+        if (canReplaceLast && supersedes(message, mMessages.back()))
+        {
+            mQueuedBytes -= mMessages.back().size();
+            if (mQueuedBytes + message.size() > mMaxQueuedBytes)
+            {
+                mQueuedBytes += mMessages.back().size();
+                return false;
+            }
+            mQueuedBytes += message.size();
+            mMessages.back() = std::move(message);
+            ++mCoalesced;
+            return true;
+        }
+
+        if (mQueuedBytes + message.size() > mMaxQueuedBytes)
+        {
+            return false;
+        }
+
+        if (mMessages.empty())
+        {
+            mLastProgress = now;
+        }
+        mQueuedBytes += message.size();
+        mMessages.push_back(std::move(message));
+        return true;
+    }
+
+    /**
+     * @brief Writes as much as possible
+     * @param write as send on a non-blocking socket: returns the bytes written, or < 0 with errno set
+     */
+    template <typename Writer>
+    DrainResult drain(Writer &&write, Clock::time_point now = Clock::now())
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        while (!mMessages.empty())
+        {
+            const std::string &front = mMessages.front();
+            auto n = write(front.data() + mFrontWritten, front.size() - mFrontWritten);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return errno == EAGAIN || errno == EWOULDBLOCK ? DrainResult::PENDING : DrainResult::FAILED;
+            }
+
+            mLastProgress = now;
+            mFrontWritten += static_cast<size_t>(n);
+            if (mFrontWritten < front.size())
+            {
+                continue; // short write: the next one will tell if it would block
+            }
+            mQueuedBytes -= front.size();
+            mFrontWritten = 0;
+            mMessages.pop_front();
+        }
+        return DrainResult::DRAINED;
+    }
+
+    bool isStalled(Clock::time_point now = Clock::now()) const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return !mMessages.empty() && now - mLastProgress > mMaxStall;
+    }
+
+    bool empty() const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return mMessages.empty();
+    }
+
+    size_t getQueuedBytes() const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return mQueuedBytes;
+    }
+
+    size_t getQueuedMessages() const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return mMessages.size();
+    }
+
+    size_t getCoalescedCount() const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return mCoalesced;
+    }
+
+    /**
+     * @returns what identifies the messages superseded by newer ones of the same kind (nullopt for other messages):
+     *  - "progress:<transferred>:<total>[:<title>]" by the title: the progress of the same transfer
+     *  - "prompt:<prompt>": any prompt
+     */
+    static std::optional<std::string_view> getSupersedingKey(std::string_view message)
+    {
+        if (message.substr(0, sPrompt.size()) == sPrompt)
+        {
+            return sPrompt;
+        }
+        if (message.substr(0, sProgress.size()) != sProgress)
+        {
+            return std::nullopt;
+        }
+
+        size_t totalEnd = message.find(':', message.find(':', sProgress.size()) + 1);
+        return totalEnd == std::string_view::npos ? sProgress : message.substr(totalEnd); // (untitled ones share the key)
+    }
+
+private:
+    mutable std::mutex mMutex;
+    std::deque<std::string> mMessages;
+    size_t mFrontWritten = 0; // bytes of the first message already written
+    size_t mQueuedBytes = 0;
+    size_t mCoalesced = 0;
+    Clock::time_point mLastProgress;
+
+    const size_t mMaxQueuedBytes;
+    const std::chrono::milliseconds mMaxStall;
+
+    static constexpr std::string_view sProgress = "progress:";
+    static constexpr std::string_view sPrompt = "prompt:";
+
+    // A completed progress is never superseded, so that clients get to know it completed
+    static bool supersedes(std::string_view newer, std::string_view older)
+    {
+        auto olderKey = getSupersedingKey(older);
+        if (!olderKey || older.substr(0, sProgress.size() + 3) == "progress:-2:" /*PROGRESS_COMPLETE*/)
+        {
+            return false;
+        }
+        return getSupersedingKey(newer) == olderKey;
+    }
+};
+
+}//end namespace
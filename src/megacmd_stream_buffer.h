@@ -0,0 +1,206 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace megacmd {
+
+struct StreamBufferStats
+{
+    uint64_t mWritten = 0;      // bytes taken from the producer
+    size_t mMaxInFlight = 0;    // high watermark of the bytes in memory (see inFlight())
+    unsigned mPauses = 0;       // times the producer was told to stop because the buffer was full
+};
+
+/**
+ * @brief A bounded buffer of byte chunks between a producer that must not block (e.g: the SDK thread delivering
+ * a streaming transfer) and a consumer that may (e.g: a petition thread writing to a slow client).
+ *
+ * write() never blocks: it takes the chunk and tells the producer to stop once the bytes in flight (buffered, or
+ * taken by the consumer and not recycled yet) reach the capacity (i.e: the stream is paused, writes are discarded
+ * from then on). The consumer takes all buffered chunks at once. The producer is paused only while the consumer
+ * is behind: once it has stopped and the consumer has caught up (see canResume), it can be restarted (reopenInput)
+ * from totalWritten(), while the consumer still sends what is left. The memory of the chunks is reused.
+ */
+class StreamBuffer
+{
+public:
+    explicit StreamBuffer(size_t capacity) :
+        mCapacity(capacity)
+    {
+    }
+
+    // Producer side: returns false if the producer is to stop (the buffer is full, paused or aborted)
+    bool write(const char *data, size_t size)
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        if (mAborted || mPaused || mInputClosed)
+        {
+            return false;
+        }
+
+        std::string chunk;
+        if (!mSpare.empty())
+        {
+            chunk = std::move(mSpare.back());
+            mSpare.pop_back();
+        }
+        chunk.assign(data, size);
+        mChunks.push_back(std::move(chunk));
+
+        mInFlight += size;
+        mStats.mWritten += size;
+        mStats.mMaxInFlight = std::max(mStats.mMaxInFlight, mInFlight);
+        mCv.notify_all();
+
+        if (mInFlight >= mCapacity)
+        {
+            mPaused = true;
+            ++mStats.mPauses;
+            return false;
+        }
+        return true;
+    }
+
+    // Producer side: no more writes are coming (till reopenInput)
+    void closeInput()
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        mInputClosed = true;
+        mCv.notify_all();
+    }
+
+    // To restart the producer (from totalWritten()), once the input was closed
+    void reopenInput()
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        mInputClosed = false;
+        mPaused = false;
+    }
+
+    /**
+     * @brief Consumer side: waits for chunks to be written and takes all of them
+     * @returns false when there are no chunks left and the input was closed (or the buffer aborted)
+     */
+    bool read(std::vector<std::string> &chunks)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCv.wait(lock, [this]() { return !mChunks.empty() || mInputClosed || mAborted; });
+        if (mAborted)
+        {
+            return false;
+        }
+
+        for (auto &chunk : mChunks)
+        {
+            chunks.push_back(std::move(chunk));
+        }
+        mChunks.clear();
+        return !chunks.empty() || !mInputClosed;
+    }
+
+    // Consumer side: returns the chunks read (once sent, or given up) so that their memory is reused
+    void recycle(std::vector<std::string> &chunks)
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        for (auto &chunk : chunks)
+        {
+            mInFlight -= std::min(mInFlight, chunk.size());
+            if (mSpare.size() < MAX_SPARE_CHUNKS)
+            {
+                mSpare.push_back(std::move(chunk));
+            }
+        }
+        chunks.clear();
+    }
+
+    // Consumer side: gives up (e.g: the client disconnected). The producer is told to stop
+    void abort()
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        mAborted = true;
+        for (auto &chunk : mChunks)
+        {
+            mInFlight -= std::min(mInFlight, chunk.size());
+        }
+        mChunks.clear();
+        mCv.notify_all();
+    }
+
+    bool isAborted() const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return mAborted;
+    }
+
+    // Whether the producer was told to stop because the buffer got full (till reopenInput)
+    bool isPaused() const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return mPaused;
+    }
+
+    // Whether the paused producer has stopped and the consumer has caught up (half the capacity in flight at most),
+    // so that it can be restarted without waiting for the buffer to be drained
+    bool canResume() const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return mPaused && mInputClosed && !mAborted && mInFlight <= mCapacity / 2;
+    }
+
+    // Bytes in memory: buffered, or taken by the consumer and not recycled yet
+    size_t inFlight() const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return mInFlight;
+    }
+
+    uint64_t totalWritten() const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return mStats.mWritten;
+    }
+
+    StreamBufferStats getStats() const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return mStats;
+    }
+
+private:
+    static constexpr size_t MAX_SPARE_CHUNKS = 64;
+
+    const size_t mCapacity;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCv;
+    std::deque<std::string> mChunks;
+    std::vector<std::string> mSpare;
+    size_t mInFlight = 0;
+    bool mPaused = false;
+    bool mInputClosed = false;
+    bool mAborted = false;
+    StreamBufferStats mStats;
+};
+
+}//end namespace
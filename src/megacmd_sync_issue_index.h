@@ -0,0 +1,391 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace megacmd {
+
+// What the index keeps of a sync issue
+struct IndexedSyncIssue
+{
+    static constexpr uint64_t UNDEF = UINT64_MAX;
+
+    uint64_t mSyncId = UNDEF;           // backup id of the sync the issue belongs to (UNDEF if none)
+    int mReason = 0;                    // mega::SyncWaitReason
+    std::vector<int> mPathProblems;     // mega::PathProblem of each of its paths
+    std::vector<std::string> mPaths;    // its local and cloud paths (kept sorted and distinct)
+};
+
+// Unset filters match every issue
+struct SyncIssueQuery
+{
+    std::optional<uint64_t> mSyncId;
+    std::optional<int> mReason;
+    std::optional<int> mPathProblem;
+    std::optional<std::string> mPathPrefix; // any of the paths of the issue is (or is within) this one
+
+    size_t mOffset = 0;
+    size_t mLimit = std::numeric_limits<size_t>::max();
+};
+
+struct SyncIssueQueryResult
+{
+    std::vector<std::string> mIds;  // the ones in [mOffset, mOffset + mLimit) of the matching issues, sorted
+    size_t mTotal = 0;              // of matching issues
+};
+
+/**
+ * @brief An in-memory index of sync issues (by id), to filter and page through them without going through
+ * the whole list: there are secondary indexes by sync, by reason, by path problem and by path.
+ *
+ * It is kept up to date with each new list of issues by update(), which only indexes the issues not seen before.
+ * Not thread safe.
+ */
+class SyncIssueIndex
+{
+public:
+    /**
+     * @brief Brings the index up to date with the current list of issues
+     * @param ids the ids of all the current issues, sorted
+     * @param makeIssue returns the IndexedSyncIssue of an id, only called for the ids not yet indexed
+     * @returns the number of issues newly indexed
+     */
+    template <typename MakeIssue>
+    size_t update(const std::vector<std::string> &ids, MakeIssue &&makeIssue)
+    {
+        // (both sorted: a single merge pass)
+        size_t added = 0;
+        auto current = mIssues.begin();
+        for (const std::string &id : ids)
+        {
+            while (current != mIssues.end() && current->first < id)
+            {
+                current = erase(current);
+            }
+            if (current != mIssues.end() && current->first == id)
+            {
+                ++current;
+                continue;
+            }
+            current = std::next(insert(current, id, makeIssue(id)));
+            ++added;
+        }
+        while (current != mIssues.end())
+        {
+            current = erase(current);
+        }
+        return added;
+    }
+
+    void clear()
+    {
+        mIssues.clear();
+        mBySync.clear();
+        mByReason.clear();
+        mByPathProblem.clear();
+        mByPath.clear();
+    }
+
+    size_t size() const
+    {
+        return mIssues.size();
+    }
+
+    bool empty() const
+    {
+        return mIssues.empty();
+    }
+
+    SyncIssueQueryResult query(const SyncIssueQuery &query) const
+    {
+        // Go through the smallest of the candidate sets given by the filters, checking the rest of them on each issue
+        const IssueSet *candidates = nullptr;
+        size_t filterCount = 0;
+        auto narrow = [&candidates, &filterCount](const IssueSet *issues)
+        {
+            ++filterCount;
+            if (!candidates || issues->size() < candidates->size())
+            {
+                candidates = issues;
+            }
+        };
+        if (query.mSyncId)
+        {
+            narrow(find(mBySync, *query.mSyncId));
+        }
+        if (query.mReason)
+        {
+            narrow(find(mByReason, *query.mReason));
+        }
+        if (query.mPathProblem)
+        {
+            narrow(find(mByPathProblem, *query.mPathProblem));
+        }
+
+        if (query.mPathPrefix)
+        {
+            // (only gone through if fewer than the other candidates)
+            auto [first, last] = getPathRange(trimTrailingSeparators(*query.mPathPrefix));
+            if (!candidates || static_cast<size_t>(std::distance(first, last)) < candidates->size())
+            {
+                std::vector<Issue> underPrefix;
+                for (auto it = first; it != last; ++it)
+                {
+                    if (isWithin(it->first, *query.mPathPrefix))
+                    {
+                        underPrefix.push_back(it->second);
+                    }
+                }
+
+                // (an issue with several paths within the prefix is there more than once: cheaper to compare the iterators than the ids)
+                auto byAddress = [](const Issue &a, const Issue &b) { return std::less<const void*>()(&*a, &*b); };
+                std::sort(underPrefix.begin(), underPrefix.end(), byAddress);
+                underPrefix.erase(std::unique(underPrefix.begin(), underPrefix.end()), underPrefix.end());
+
+                SyncIssueQuery otherFilters = query;
+                otherFilters.mPathPrefix.reset();
+                std::vector<Issue> matching;
+                for (const Issue &issue : underPrefix)
+                {
+                    if (matches(issue->second, otherFilters))
+                    {
+                        matching.push_back(issue);
+                    }
+                }
+                return page(std::move(matching), query);
+            }
+            ++filterCount;
+        }
+
+        if (!candidates)
+        {
+            return page(mIssues, query, true);
+        }
+        return page(*candidates, query, filterCount == 1);
+    }
+
+    // Whether path is prefix, or within it
+    static bool isWithin(std::string_view path, std::string_view prefix)
+    {
+        prefix = trimTrailingSeparators(prefix);
+        return path.substr(0, prefix.size()) == prefix
+               && (path.size() == prefix.size() || isSeparator(path[prefix.size()]));
+    }
+
+private:
+    using IssuesMap = std::map<std::string, IndexedSyncIssue>;
+    using Issue = IssuesMap::const_iterator; // (stable until erased)
+
+    struct ById
+    {
+        bool operator()(const Issue &a, const Issue &b) const
+        {
+            return a->first < b->first;
+        }
+    };
+    using IssueSet = std::set<Issue, ById>;
+
+    static const std::string &getId(const IssuesMap::value_type &issue) { return issue.first; }
+    static const std::string &getId(const Issue &issue) { return issue->first; }
+    static const IndexedSyncIssue &getIssue(const IssuesMap::value_type &issue) { return issue.second; }
+    static const IndexedSyncIssue &getIssue(const Issue &issue) { return issue->second; }
+
+    // The page of the matching issues among the candidates (sorted by id)
+    template <typename Candidates>
+    SyncIssueQueryResult page(const Candidates &candidates, const SyncIssueQuery &query, bool allMatching) const
+    {
+        SyncIssueQueryResult result;
+        if (allMatching) // (no need to check them: straight to the page)
+        {
+            result.mTotal = candidates.size();
+            if (query.mOffset < candidates.size())
+            {
+                auto it = std::next(candidates.begin(), static_cast<std::ptrdiff_t>(query.mOffset));
+                for (; it != candidates.end() && result.mIds.size() < query.mLimit; ++it)
+                {
+                    result.mIds.push_back(getId(*it));
+                }
+            }
+            return result;
+        }
+
+        for (const auto &candidate : candidates)
+        {
+            if (!matches(getIssue(candidate), query))
+            {
+                continue;
+            }
+            if (result.mTotal >= query.mOffset && result.mIds.size() < query.mLimit)
+            {
+                result.mIds.push_back(getId(candidate));
+            }
+            ++result.mTotal;
+        }
+        return result;
+    }
+
+    // The page of the (unsorted) matching issues: only the page gets sorted
+    static SyncIssueQueryResult page(std::vector<Issue> matching, const SyncIssueQuery &query)
+    {
+        SyncIssueQueryResult result;
+        result.mTotal = matching.size();
+        if (query.mOffset >= matching.size())
+        {
+            return result;
+        }
+
+        auto pageBegin = matching.begin() + static_cast<std::ptrdiff_t>(query.mOffset);
+        auto pageEnd = matching.begin() + static_cast<std::ptrdiff_t>(std::min(matching.size() - query.mOffset, query.mLimit) + query.mOffset);
+        std::nth_element(matching.begin(), pageBegin, matching.end(), ById());
+        std::partial_sort(pageBegin, pageEnd, matching.end(), ById());
+        for (auto it = pageBegin; it != pageEnd; ++it)
+        {
+            result.mIds.push_back((*it)->first);
+        }
+        return result;
+    }
+
+    IssuesMap::iterator insert(IssuesMap::iterator hint, const std::string &id, IndexedSyncIssue issue)
+    {
+        std::sort(issue.mPaths.begin(), issue.mPaths.end());
+        issue.mPaths.erase(std::unique(issue.mPaths.begin(), issue.mPaths.end()), issue.mPaths.end());
+
+        auto it = mIssues.emplace_hint(hint, id, std::move(issue));
+        mBySync[it->second.mSyncId].insert(it);
+        mByReason[it->second.mReason].insert(it);
+        for (int pathProblem : it->second.mPathProblems)
+        {
+            mByPathProblem[pathProblem].insert(it);
+        }
+        for (const std::string &path : it->second.mPaths)
+        {
+            mByPath.emplace(path, it);
+        }
+        return it;
+    }
+
+    IssuesMap::iterator erase(IssuesMap::iterator it)
+    {
+        const IndexedSyncIssue &issue = it->second;
+        eraseFrom(mBySync, issue.mSyncId, it);
+        eraseFrom(mByReason, issue.mReason, it);
+        for (int pathProblem : issue.mPathProblems)
+        {
+            eraseFrom(mByPathProblem, pathProblem, it);
+        }
+        for (const std::string &path : issue.mPaths)
+        {
+            auto [first, last] = mByPath.equal_range(path);
+            auto pathIt = std::find_if(first, last, [it](const auto &entry) { return entry.second == Issue(it); });
+            if (pathIt != last)
+            {
+                mByPath.erase(pathIt);
+            }
+        }
+        return mIssues.erase(it);
+    }
+
+    template <typename Key>
+    static void eraseFrom(std::unordered_map<Key, IssueSet> &index, const Key &key, Issue issue)
+    {
+        auto it = index.find(key);
+        if (it != index.end() && it->second.erase(issue) && it->second.empty())
+        {
+            index.erase(it);
+        }
+    }
+
+    template <typename Key>
+    static const IssueSet *find(const std::unordered_map<Key, IssueSet> &index, const Key &key)
+    {
+        static const IssueSet none;
+        auto it = index.find(key);
+        return it == index.end() ? &none : &it->second;
+    }
+
+    // The paths starting with a prefix are all together in the sorted paths, right after it
+    // (not only those within it: e.g "/a/foo bar" goes between "/a/foo" and "/a/foo/b")
+    std::pair<std::multimap<std::string, Issue>::const_iterator, std::multimap<std::string, Issue>::const_iterator>
+        getPathRange(std::string_view prefix) const
+    {
+        auto first = mByPath.lower_bound(std::string(prefix));
+        auto last = first;
+        while (last != mByPath.end() && std::string_view(last->first).substr(0, prefix.size()) == prefix)
+        {
+            ++last;
+        }
+        return {first, last};
+    }
+
+    static bool matches(const IndexedSyncIssue &issue, const SyncIssueQuery &query)
+    {
+        if (query.mSyncId && issue.mSyncId != *query.mSyncId)
+        {
+            return false;
+        }
+        if (query.mReason && issue.mReason != *query.mReason)
+        {
+            return false;
+        }
+        if (query.mPathProblem
+            && std::find(issue.mPathProblems.begin(), issue.mPathProblems.end(), *query.mPathProblem) == issue.mPathProblems.end())
+        {
+            return false;
+        }
+        if (query.mPathPrefix)
+        {
+            return std::any_of(issue.mPaths.begin(), issue.mPaths.end(),
+                               [&query](const std::string &path) { return isWithin(path, *query.mPathPrefix); });
+        }
+        return true;
+    }
+
+    static bool isSeparator(char c)
+    {
+        return c == '/' || c == '\\';
+    }
+
+    // (the root "/" becomes "", containing any absolute path)
+    static std::string_view trimTrailingSeparators(std::string_view path)
+    {
+        while (!path.empty() && isSeparator(path.back()))
+        {
+            path.remove_suffix(1);
+        }
+        return path;
+    }
+
+    IssuesMap mIssues;
+    std::unordered_map<uint64_t, IssueSet> mBySync;
+    std::unordered_map<int, IssueSet> mByReason;
+    std::unordered_map<int, IssueSet> mByPathProblem;
+    std::multimap<std::string, Issue> mByPath;
+};
+
+}//end namespace
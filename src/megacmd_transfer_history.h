@@ -0,0 +1,491 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "deferred_single_trigger.h"
+
+namespace megacmd {
+
+// What is kept of a finished transfer
+struct CompletedTransfer
+{
+    uint64_t mId = 0;           // order of completion (set by the history)
+    int mTag = 0;
+    int mType = 0;              // mega::MegaTransfer::TYPE_*
+    bool mSync = false;
+    bool mBackup = false;
+    int mState = 0;             // mega::MegaTransfer::STATE_*
+    int mErrorCode = 0;
+    uint64_t mNodeHandle = UINT64_MAX;
+    uint64_t mParentHandle = UINT64_MAX;
+    std::string mLocalPath;     // the destination of a download, the source of an upload
+    std::string mFileName;
+    std::string mRemotePath;    // the source of a download, the destination of an upload: resolved when first shown
+    long long mTransferred = 0;
+    long long mTotal = 0;
+    long long mSpeed = 0;
+    int64_t mStartTime = 0;
+    int64_t mFinishTime = 0;
+};
+
+/**
+ * @brief The history of completed transfers: the most recent ones in a fixed-capacity ring, with optionally
+ * the ones evicted from it written to disk (up to a maximum), so that it can be paged through beyond memory.
+ *
+ * Adding is O(1) and does no I/O: evicted records are written in batches from a background thread, which also
+ * resolves the remote paths of the records added (if a resolver is set). Spill files are indexed in blocks of
+ * records, so that the memory used does not grow with the number of records on disk.
+ * Records are returned newest first.
+ */
+class CompletedTransferHistory
+{
+public:
+    using RemotePathResolver = std::function<std::string(const CompletedTransfer &)>;
+
+    explicit CompletedTransferHistory(size_t capacity) :
+        mRing(capacity)
+    {
+    }
+
+    // Evicted records are written to spillFile (and a previous one, once full) instead of dropped, up to maxSpilled
+    void enableSpill(const std::filesystem::path &spillFile, size_t maxSpilled)
+    {
+        std::lock_guard<std::mutex> gs(mSpillMutex);
+        mSpillFiles[0] = {spillFile, {}, 0};
+        mSpillFiles[1] = {std::filesystem::path(spillFile).concat(".1"), {}, 0};
+        mMaxPerSpillFile = std::max<size_t>(1, maxSpilled / 2);
+        std::error_code ec;
+        std::filesystem::remove(mSpillFiles[1].mPath, ec);
+        mSpillOut.open(mSpillFiles[0].mPath, std::ios::binary | std::ios::trunc);
+        std::lock_guard<std::mutex> g(mMutex);
+        mSpilling = maxSpilled && mSpillOut.is_open();
+        startBackgroundWork();
+    }
+
+    // Remote paths are resolved shortly after the records are added (while their nodes are most likely still there)
+    void setRemotePathResolver(RemotePathResolver resolver)
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        mResolver = std::move(resolver);
+        mResolvedUpTo = mNextId;
+        startBackgroundWork();
+    }
+
+    void add(CompletedTransfer transfer)
+    {
+        DeferredTrigger *background = nullptr;
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            transfer.mId = mNextId++;
+            if (mRing.empty())
+            {
+                spillOrDrop(std::move(transfer));
+            }
+            else
+            {
+                if (mCount == mRing.size())
+                {
+                    spillOrDrop(std::move(mRing[mNext]));
+                }
+                else
+                {
+                    ++mCount;
+                }
+                mRing[mNext] = std::move(transfer);
+                mNext = (mNext + 1) % mRing.size();
+            }
+
+            if (mResolver || mPendingSpill.size() >= SPILL_BATCH)
+            {
+                background = mBackground.get();
+            }
+        }
+
+        if (background)
+        {
+            background->trigger([this] { doBackgroundWork(); });
+        }
+    }
+
+    // Records in memory beyond the new capacity are evicted (as when adding), oldest first
+    void setCapacity(size_t capacity)
+    {
+        DeferredTrigger *background = nullptr;
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            std::vector<CompletedTransfer> ring(capacity);
+            const size_t evicted = mCount - std::min(mCount, capacity);
+            for (size_t i = 0; i < mCount; ++i) // (oldest first)
+            {
+                CompletedTransfer &record = mRing[(mNext + mRing.size() - mCount + i) % mRing.size()];
+                if (i < evicted)
+                {
+                    spillOrDrop(std::move(record));
+                }
+                else
+                {
+                    ring[i - evicted] = std::move(record);
+                }
+            }
+            mCount -= evicted;
+            mNext = capacity ? mCount % capacity : 0;
+            mRing = std::move(ring);
+
+            if (mPendingSpill.size() >= SPILL_BATCH)
+            {
+                background = mBackground.get();
+            }
+        }
+
+        if (background)
+        {
+            background->trigger([this] { doBackgroundWork(); });
+        }
+    }
+
+    // The number of records (in memory or on disk)
+    size_t size()
+    {
+        std::lock_guard<std::mutex> gs(mSpillMutex);
+        flushPendingSpill();
+        std::lock_guard<std::mutex> g(mMutex);
+        return mCount + mPendingSpill.size() + mSpillFiles[0].mRecords + mSpillFiles[1].mRecords;
+    }
+
+    /**
+     * @brief Gets (copies of) up to count records for which matches returns true, newest first,
+     * skipping the first skip of them.
+     */
+    template <typename Filter>
+    std::vector<CompletedTransfer> get(size_t skip, size_t count, Filter &&matches)
+    {
+        std::vector<CompletedTransfer> records;
+        auto consider = [&](const CompletedTransfer &record) {
+            if (!matches(record))
+            {
+                return;
+            }
+            if (skip)
+            {
+                --skip;
+                return;
+            }
+            records.push_back(record);
+        };
+
+        std::lock_guard<std::mutex> gs(mSpillMutex);
+        uint64_t oldestInMemory;
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            for (size_t i = 0; i < mCount && records.size() < count; ++i)
+            {
+                consider(mRing[(mNext + mRing.size() - 1 - i) % mRing.size()]);
+            }
+            oldestInMemory = mNextId - mCount;
+        }
+        flushPendingSpill(); // (those evicted since then are left out: they were in memory)
+
+        std::vector<CompletedTransfer> block;
+        for (int file = 0; file < 2 && records.size() < count; ++file)
+        {
+            const SpillFile &spill = mSpillFiles[file];
+            if (!spill.mRecords)
+            {
+                continue;
+            }
+            std::ifstream in(spill.mPath, std::ios::binary);
+            for (size_t b = spill.mBlockOffsets.size(); in && b-- > 0 && records.size() < count;)
+            {
+                block.clear();
+                in.seekg(static_cast<std::streamoff>(spill.mBlockOffsets[b]));
+                const size_t inBlock = std::min(SPILL_BLOCK, spill.mRecords - b * SPILL_BLOCK);
+                for (size_t i = 0; i < inBlock; ++i)
+                {
+                    CompletedTransfer record;
+                    if (!read(in, record))
+                    {
+                        break;
+                    }
+                    block.push_back(std::move(record));
+                }
+
+                for (auto it = block.rbegin(); it != block.rend() && records.size() < count; ++it)
+                {
+                    if (it->mId < oldestInMemory)
+                    {
+                        consider(*it);
+                    }
+                }
+            }
+        }
+        return records;
+    }
+
+    // Keeps a remote path resolved when showing a record (if it is still in memory)
+    void setRemotePath(uint64_t id, const std::string &remotePath)
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        if (auto record = findInMemory(id))
+        {
+            record->mRemotePath = remotePath;
+        }
+    }
+
+    // The remote path of the most recent download of a node still in memory (if resolved)
+    std::optional<std::string> findDownloadRemotePath(uint64_t nodeHandle, int downloadType)
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        for (size_t i = 0; i < mCount; ++i)
+        {
+            const CompletedTransfer &record = mRing[(mNext + mRing.size() - 1 - i) % mRing.size()];
+            if (record.mNodeHandle == nodeHandle && record.mType == downloadType && !record.mRemotePath.empty())
+            {
+                return record.mRemotePath;
+            }
+        }
+        return std::nullopt;
+    }
+
+private:
+    static constexpr size_t SPILL_BATCH = 256;
+    static constexpr size_t SPILL_BLOCK = 64; // records per index entry of the spill files
+
+    struct SpillFile
+    {
+        std::filesystem::path mPath;
+        std::vector<uint64_t> mBlockOffsets; // where every SPILL_BLOCK records start, oldest first
+        size_t mRecords = 0;
+    };
+
+    // requires mMutex
+    void startBackgroundWork()
+    {
+        if (!mBackground)
+        {
+            // short, to resolve paths while nodes are still there, but batching the adds in between
+            mBackground = std::make_unique<DeferredTrigger>(std::chrono::milliseconds(100), std::chrono::seconds(1));
+        }
+    }
+
+    void doBackgroundWork()
+    {
+        resolveRemotePaths();
+        std::lock_guard<std::mutex> gs(mSpillMutex);
+        flushPendingSpill();
+    }
+
+    // Of the records added since last time (without holding the lock while resolving)
+    void resolveRemotePaths()
+    {
+        RemotePathResolver resolver;
+        std::vector<CompletedTransfer> toResolve;
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            if (!mResolver)
+            {
+                return;
+            }
+            resolver = mResolver;
+            const uint64_t oldestInMemory = mNextId - mCount - mPendingSpill.size(); // (the evicted ones come right before)
+            for (uint64_t id = std::max(mResolvedUpTo, oldestInMemory); id < mNextId; ++id)
+            {
+                auto record = findInMemory(id);
+                if (record && record->mRemotePath.empty())
+                {
+                    toResolve.push_back(*record);
+                }
+            }
+            mResolvedUpTo = mNextId;
+        }
+
+        for (auto &record : toResolve)
+        {
+            record.mRemotePath = resolver(record);
+        }
+
+        std::lock_guard<std::mutex> g(mMutex);
+        for (auto &record : toResolve)
+        {
+            auto stored = findInMemory(record.mId);
+            if (stored && stored->mRemotePath.empty())
+            {
+                stored->mRemotePath = std::move(record.mRemotePath);
+            }
+        }
+    }
+
+    // requires mMutex: the record in the ring or waiting to be written to disk
+    CompletedTransfer *findInMemory(uint64_t id)
+    {
+        if (id >= mNextId)
+        {
+            return nullptr;
+        }
+        const uint64_t newer = mNextId - 1 - id;
+        if (newer < mCount)
+        {
+            return &mRing[(mNext + mRing.size() - 1 - newer) % mRing.size()];
+        }
+        auto it = std::find_if(mPendingSpill.begin(), mPendingSpill.end(), [id](const CompletedTransfer &r) { return r.mId == id; });
+        return it == mPendingSpill.end() ? nullptr : &*it;
+    }
+
+    // requires mMutex
+    void spillOrDrop(CompletedTransfer &&transfer)
+    {
+        if (mSpilling)
+        {
+            mPendingSpill.push_back(std::move(transfer));
+        }
+    }
+
+    // requires mSpillMutex
+    void flushPendingSpill()
+    {
+        std::vector<CompletedTransfer> pending;
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            pending.swap(mPendingSpill);
+        }
+        if (pending.empty())
+        {
+            return;
+        }
+
+        for (auto &record : pending)
+        {
+            if (mSpillFiles[0].mRecords >= mMaxPerSpillFile)
+            {
+                rotateSpillFiles();
+            }
+            SpillFile &spill = mSpillFiles[0];
+            if (spill.mRecords % SPILL_BLOCK == 0)
+            {
+                spill.mBlockOffsets.push_back(static_cast<uint64_t>(mSpillOut.tellp()));
+            }
+            write(mSpillOut, record);
+            ++spill.mRecords;
+        }
+        mSpillOut.flush();
+    }
+
+    // requires mSpillMutex: the current file becomes the previous one (dropping the records in the latter)
+    void rotateSpillFiles()
+    {
+        mSpillOut.close();
+        std::error_code ec;
+        std::filesystem::rename(mSpillFiles[0].mPath, mSpillFiles[1].mPath, ec);
+        mSpillFiles[1].mBlockOffsets = std::move(mSpillFiles[0].mBlockOffsets);
+        mSpillFiles[1].mRecords = mSpillFiles[0].mRecords;
+        mSpillFiles[0].mBlockOffsets.clear();
+        mSpillFiles[0].mRecords = 0;
+        mSpillOut.open(mSpillFiles[0].mPath, std::ios::binary | std::ios::trunc);
+    }
+
+    template <typename T>
+    static void writePod(std::ostream &out, const T &value)
+    {
+        out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    static void writeString(std::ostream &out, const std::string &value)
+    {
+        writePod(out, static_cast<uint32_t>(value.size()));
+        out.write(value.data(), static_cast<std::streamsize>(value.size()));
+    }
+
+    template <typename T>
+    static bool readPod(std::istream &in, T &value)
+    {
+        return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(value)));
+    }
+
+    static bool readString(std::istream &in, std::string &value)
+    {
+        uint32_t size = 0;
+        if (!readPod(in, size))
+        {
+            return false;
+        }
+        value.resize(size);
+        return static_cast<bool>(in.read(value.data(), size));
+    }
+
+    static void write(std::ostream &out, const CompletedTransfer &r)
+    {
+        writePod(out, r.mId);
+        writePod(out, r.mTag);
+        writePod(out, r.mType);
+        writePod(out, r.mSync);
+        writePod(out, r.mBackup);
+        writePod(out, r.mState);
+        writePod(out, r.mErrorCode);
+        writePod(out, r.mNodeHandle);
+        writePod(out, r.mParentHandle);
+        writeString(out, r.mLocalPath);
+        writeString(out, r.mFileName);
+        writeString(out, r.mRemotePath);
+        writePod(out, r.mTransferred);
+        writePod(out, r.mTotal);
+        writePod(out, r.mSpeed);
+        writePod(out, r.mStartTime);
+        writePod(out, r.mFinishTime);
+    }
+
+    static bool read(std::istream &in, CompletedTransfer &r)
+    {
+        return readPod(in, r.mId) && readPod(in, r.mTag) && readPod(in, r.mType) && readPod(in, r.mSync)
+                && readPod(in, r.mBackup) && readPod(in, r.mState) && readPod(in, r.mErrorCode)
+                && readPod(in, r.mNodeHandle) && readPod(in, r.mParentHandle)
+                && readString(in, r.mLocalPath) && readString(in, r.mFileName) && readString(in, r.mRemotePath)
+                && readPod(in, r.mTransferred) && readPod(in, r.mTotal) && readPod(in, r.mSpeed)
+                && readPod(in, r.mStartTime) && readPod(in, r.mFinishTime);
+    }
+
+    // Lock order: mSpillMutex before mMutex
+    mutable std::mutex mMutex;
+    std::vector<CompletedTransfer> mRing;
+    size_t mNext = 0;   // where the next one goes (i.e: the oldest one once full)
+    size_t mCount = 0;
+    uint64_t mNextId = 0;
+    bool mSpilling = false;
+    std::vector<CompletedTransfer> mPendingSpill;
+    RemotePathResolver mResolver;
+    uint64_t mResolvedUpTo = 0;  // ids below it were already given to the resolver
+
+    mutable std::mutex mSpillMutex;
+    SpillFile mSpillFiles[2];    // current, previous
+    size_t mMaxPerSpillFile = 0;
+    std::ofstream mSpillOut;
+
+    std::unique_ptr<DeferredTrigger> mBackground; // (last: its callbacks use the rest)
+};
+
+}//end namespace
@@ -0,0 +1,178 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace megacmd {
+
+// What the index keeps of a transfer
+struct IndexedTransfer
+{
+    int mTag = 0;
+    bool mUpload = false;
+    bool mSync = false;
+    int mState = 0;          // mega::MegaTransfer::STATE_*
+    uint64_t mPriority = 0;  // the lower, the sooner in the queue
+    long long mTransferred = 0;
+    long long mTotal = 0;
+};
+
+struct TransferDirectionStats
+{
+    size_t mCount = 0;
+    long long mTransferred = 0;
+    long long mTotal = 0;
+    std::map<int, size_t> mCountByState;
+};
+
+/**
+ * @brief An index of the ongoing transfers, kept up to date from the transfer callbacks.
+ *
+ * It keeps the totals of each direction and the transfers sorted as in the queue, so that listing
+ * transfers does not require going through (and copying from the SDK) all of them.
+ */
+class TransferIndex
+{
+public:
+    // Adds or updates a transfer
+    void upsert(const IndexedTransfer &transfer)
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        auto it = mTransfers.find(transfer.mTag);
+        if (it == mTransfers.end())
+        {
+            mTransfers.emplace(transfer.mTag, transfer);
+            account(transfer, +1);
+            order(transfer).emplace(transfer.mPriority, transfer.mTag);
+            return;
+        }
+
+        auto &indexed = it->second;
+        account(indexed, -1);
+        if (indexed.mPriority != transfer.mPriority || indexed.mUpload != transfer.mUpload || indexed.mSync != transfer.mSync)
+        {
+            order(indexed).erase({indexed.mPriority, indexed.mTag});
+            order(transfer).emplace(transfer.mPriority, transfer.mTag);
+        }
+        indexed = transfer;
+        account(indexed, +1);
+    }
+
+    void erase(int tag)
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        auto it = mTransfers.find(tag);
+        if (it != mTransfers.end())
+        {
+            account(it->second, -1);
+            order(it->second).erase({it->second.mPriority, tag});
+            mTransfers.erase(it);
+        }
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        mTransfers.clear();
+        for (auto &stats : mStats)
+        {
+            stats = TransferDirectionStats();
+        }
+        for (auto &byDirection : mOrder)
+        {
+            for (auto &order : byDirection)
+            {
+                order.clear();
+            }
+        }
+    }
+
+    TransferDirectionStats getStats(bool uploads) const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return mStats[uploads];
+    }
+
+    /**
+     * @brief The first transfers of a direction in queue order (at most maxCount), leaving out
+     * sync transfers unless includeSyncs, and those for which skip returns true
+     */
+    template <typename Skip>
+    std::vector<IndexedTransfer> first(bool uploads, size_t maxCount, bool includeSyncs, Skip &&skip) const
+    {
+        std::vector<IndexedTransfer> transfers;
+        std::lock_guard<std::mutex> g(mMutex);
+        const auto &regular = mOrder[uploads][false];
+        const auto &syncs = mOrder[uploads][true];
+        auto itRegular = regular.begin();
+        auto itSync = includeSyncs ? syncs.begin() : syncs.end();
+
+        // merging both sorted sets
+        while (transfers.size() < maxCount && (itRegular != regular.end() || itSync != syncs.end()))
+        {
+            auto &next = (itSync == syncs.end() || (itRegular != regular.end() && *itRegular < *itSync)) ? itRegular : itSync;
+            const auto &transfer = mTransfers.at(next->second);
+            ++next;
+            if (!skip(transfer))
+            {
+                transfers.push_back(transfer);
+            }
+        }
+        return transfers;
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return mTransfers.size();
+    }
+
+private:
+    using Order = std::set<std::pair<uint64_t, int>>; // (priority, tag)
+
+    void account(const IndexedTransfer &transfer, int sign)
+    {
+        auto &stats = mStats[transfer.mUpload];
+        stats.mCount += sign;
+        stats.mTransferred += sign * transfer.mTransferred;
+        stats.mTotal += sign * transfer.mTotal;
+        auto &countInState = stats.mCountByState[transfer.mState];
+        countInState += sign;
+        if (!countInState)
+        {
+            stats.mCountByState.erase(transfer.mState);
+        }
+    }
+
+    Order &order(const IndexedTransfer &transfer)
+    {
+        return mOrder[transfer.mUpload][transfer.mSync];
+    }
+
+    mutable std::mutex mMutex;
+    std::unordered_map<int, IndexedTransfer> mTransfers;
+    TransferDirectionStats mStats[2];   // [upload]
+    Order mOrder[2][2];                 // [upload][sync]
+};
+
+}//end namespace
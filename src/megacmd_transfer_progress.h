@@ -0,0 +1,103 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+
+namespace megacmd {
+
+/**
+ * @brief Aggregated progress of a group of transfers (e.g: all the ones started by a get or a put).
+ *
+ * Totals are kept up to date with the difference from the previous values of each transfer,
+ * so that updates cost O(1) regardless of the number of transfers ongoing.
+ */
+class TransferProgress
+{
+public:
+    void update(int tag, long long transferred, long long total)
+    {
+        auto &ongoing = mOngoing[tag];
+        mOngoingTransferred += transferred - ongoing.mTransferred;
+        mOngoingTotal += total - ongoing.mTotal;
+        ongoing.mTransferred = transferred;
+        ongoing.mTotal = total;
+    }
+
+    // The bytes of a finished transfer are no longer accounted as ongoing, but as finished
+    void finish(int tag, long long transferred, long long total)
+    {
+        auto it = mOngoing.find(tag);
+        if (it != mOngoing.end())
+        {
+            mOngoingTransferred -= it->second.mTransferred;
+            mOngoingTotal -= it->second.mTotal;
+            mOngoing.erase(it);
+        }
+        mFinishedTransferred += transferred;
+        mFinishedTotal += total;
+    }
+
+    long long transferred() const { return mFinishedTransferred + mOngoingTransferred; }
+    long long total() const { return mFinishedTotal + mOngoingTotal; }
+
+    long long finishedTransferred() const { return mFinishedTransferred; }
+    long long finishedTotal() const { return mFinishedTotal; }
+
+private:
+    struct OngoingBytes
+    {
+        long long mTransferred = 0;
+        long long mTotal = 0;
+    };
+
+    std::unordered_map<int, OngoingBytes> mOngoing;
+    long long mOngoingTransferred = 0;
+    long long mOngoingTotal = 0;
+    long long mFinishedTransferred = 0;
+    long long mFinishedTotal = 0;
+};
+
+// Limits how often the progress is rendered
+class ProgressThrottle
+{
+public:
+    explicit ProgressThrottle(unsigned updatesPerSecond) :
+        mPeriod(std::chrono::microseconds(1000000 / std::max(1u, updatesPerSecond)))
+    {
+    }
+
+    // Returns true (and restarts the period) if the progress is to be rendered: unless forced, once per period
+    bool shouldRender(std::chrono::steady_clock::time_point now, bool force = false)
+    {
+        if (!force && mRendered && now < mNextRender)
+        {
+            return false;
+        }
+        mRendered = true;
+        mNextRender = now + mPeriod;
+        return true;
+    }
+
+private:
+    const std::chrono::steady_clock::duration mPeriod;
+    std::chrono::steady_clock::time_point mNextRender;
+    bool mRendered = false;
+};
+
+}//end namespace
@@ -0,0 +1,680 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <variant>
+#include <vector>
+
+namespace megacmd {
+
+struct TreeWalkOptions
+{
+    size_t mThreads = 1;
+
+    // Folders waiting to be listed (i.e. node copies kept around). Once reached, workers walk subfolders themselves
+    size_t mMaxQueuedFolders = 4096;
+
+    // Results (and, in ordered walks, subfolder chunks) waiting to be consumed. Once reached, workers wait for
+    // the consumer. In ordered walks, the results the consumer is waiting for are let through: at most the
+    // children of the folders in the path being consumed go beyond it
+    size_t mMaxQueuedResults = 16384;
+
+    // Results are consumed in the order of a sequential walk (the children of a folder, each one after its
+    // own subtree, and then the folder), instead of as soon as they are available
+    bool mOrdered = false;
+
+    // Polled from the walking thread (at most once every mPollPeriod): returns true to stop the walk
+    std::function<bool()> mShouldStop;
+    std::chrono::milliseconds mPollPeriod{100};
+};
+
+struct TreeWalkStats
+{
+    uint64_t mNodes = 0;
+    uint64_t mFolders = 0;       // folders listed
+    uint64_t mStolenFolders = 0; // folders listed by a worker other than the one that found them
+    uint64_t mInlineFolders = 0; // folders walked right away, because too many were queued
+    size_t mMaxQueuedFolders = 0;
+    size_t mMaxQueuedResults = 0;
+    uint64_t mResultWaits = 0;   // times a worker waited for the consumer to catch up
+    uint64_t mHelpedFolders = 0; // folders listed by a waiting worker, because the consumer was waiting for them
+};
+
+/**
+ * @brief Walks a tree with several threads, so that visiting the nodes is not bound to a single core.
+ *
+ * Every folder is a task: a worker lists its children, visits them and queues the subfolders into its own
+ * queue. Workers take the last folder they queued (depth first) and, once theirs is empty, steal the oldest
+ * folder from the others (the biggest subtrees, usually).
+ *
+ * getChildren, isFolder & visit are called from the workers (concurrently). The results of visit are
+ * consumed from the thread calling walk, so it is safe to write the output from consume.
+ */
+template <typename Node, typename Result>
+class ParallelTreeWalker
+{
+public:
+    using NodePtr = std::shared_ptr<Node>;
+    using GetChildren = std::function<std::vector<NodePtr>(Node &)>;
+    using IsFolder = std::function<bool(Node &)>;
+    using Visit = std::function<std::optional<Result>(const NodePtr &)>;
+    using Consume = std::function<bool(Result &&)>; // returns false to stop the walk
+
+    ParallelTreeWalker(TreeWalkOptions options, GetChildren getChildren, IsFolder isFolder, Visit visit) :
+        mOptions(std::move(options)),
+        mGetChildren(std::move(getChildren)),
+        mIsFolder(std::move(isFolder)),
+        mVisit(std::move(visit))
+    {
+        mOptions.mThreads = std::max<size_t>(1, mOptions.mThreads);
+        mOptions.mMaxQueuedFolders = std::max<size_t>(1, mOptions.mMaxQueuedFolders);
+        mOptions.mMaxQueuedResults = std::max<size_t>(1, mOptions.mMaxQueuedResults);
+    }
+
+    ParallelTreeWalker(const ParallelTreeWalker&) = delete;
+    ParallelTreeWalker& operator=(const ParallelTreeWalker&) = delete;
+
+    // Visits root and all its descendants. Returns false if the walk was stopped before the end
+    bool walk(NodePtr root, const Consume &consume)
+    {
+        if (!root)
+        {
+            return false;
+        }
+
+        mStopped = false;
+        mStats = {};
+        mPendingTasks = 1;
+        mQueuedFolders = 0;
+        mQueuedResults = 0;
+        mWaitedChunk.reset();
+        mQueues.clear();
+        for (size_t i = 0; i < mOptions.mThreads; ++i)
+        {
+            mQueues.push_back(std::make_unique<WorkerQueue>());
+        }
+
+        auto rootChunk = std::make_shared<Chunk>();
+        if (mIsFolder(*root))
+        {
+            pushFolder(0, {std::move(root), rootChunk});
+        }
+        else
+        {
+            ++mStats.mNodes;
+            if (auto result = mVisit(root))
+            {
+                rootChunk->mEntries.emplace_back(std::move(*result));
+                ++mQueuedResults;
+            }
+            rootChunk->mComplete = true;
+            mPendingTasks = 0;
+        }
+
+        std::vector<std::thread> workers;
+        if (mPendingTasks)
+        {
+            for (size_t i = 0; i < mOptions.mThreads; ++i)
+            {
+                workers.emplace_back([this, i] { workerLoop(i); });
+            }
+        }
+
+        const bool completed = consumeResults(rootChunk, consume);
+        if (!completed)
+        {
+            mStopped = true;
+            wakeUpWorkers();
+            std::lock_guard<std::mutex> g(mResultsMutex); // (for the ones waiting for the consumer)
+            mResultsCV.notify_all();
+        }
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        mWaitedChunk.reset();
+        return completed;
+    }
+
+    TreeWalkStats getStats() const
+    {
+        std::lock_guard<std::mutex> g(mResultsMutex);
+        return mStats;
+    }
+
+private:
+    // The results of a folder: in ordered walks, subfolders have their own chunk, placed among the results
+    // in the position of the subfolder. Otherwise, all the results go to the root chunk.
+    struct Chunk;
+    using Entry = std::variant<Result, std::shared_ptr<Chunk>>;
+
+    struct Chunk
+    {
+        std::deque<Entry> mEntries;
+        bool mComplete = false;
+    };
+
+    struct Task
+    {
+        NodePtr mFolder;
+        std::shared_ptr<Chunk> mChunk;
+    };
+
+    struct WorkerQueue
+    {
+        std::mutex mMutex;
+        std::deque<Task> mTasks;
+    };
+
+    TreeWalkOptions mOptions;
+    GetChildren mGetChildren;
+    IsFolder mIsFolder;
+    Visit mVisit;
+
+    std::vector<std::unique_ptr<WorkerQueue>> mQueues;
+    std::atomic<size_t> mQueuedFolders{0};
+    std::atomic<size_t> mPendingTasks{0}; // queued or being processed
+    std::atomic<bool> mStopped{false};
+
+    std::mutex mIdleMutex;
+    std::condition_variable mIdleCV;
+
+    mutable std::mutex mResultsMutex;
+    std::condition_variable mResultsCV;
+    TreeWalkStats mStats;
+    size_t mQueuedResults = 0;           // entries in the chunks, not consumed yet
+    std::shared_ptr<Chunk> mWaitedChunk; // the one the consumer waits for (ordered walks)
+
+    void pushFolder(size_t worker, Task &&task)
+    {
+        {
+            std::lock_guard<std::mutex> g(mQueues[worker]->mMutex);
+            mQueues[worker]->mTasks.push_back(std::move(task));
+        }
+        const size_t queued = ++mQueuedFolders;
+        {
+            std::lock_guard<std::mutex> g(mResultsMutex);
+            mStats.mMaxQueuedFolders = std::max(mStats.mMaxQueuedFolders, queued);
+            mResultsCV.notify_all(); // (it may be the one the consumer waits for)
+        }
+        wakeUpWorkers(false);
+    }
+
+    void wakeUpWorkers(bool all = true)
+    {
+        {
+            std::lock_guard<std::mutex> g(mIdleMutex); // so that no worker misses it in between checking and waiting
+        }
+        if (all)
+        {
+            mIdleCV.notify_all();
+        }
+        else
+        {
+            mIdleCV.notify_one();
+        }
+    }
+
+    std::optional<Task> takeFolder(size_t worker)
+    {
+        {
+            auto& own = *mQueues[worker];
+            std::lock_guard<std::mutex> g(own.mMutex);
+            if (!own.mTasks.empty())
+            {
+                Task task = std::move(own.mTasks.back());
+                own.mTasks.pop_back();
+                --mQueuedFolders;
+                return task;
+            }
+        }
+
+        for (size_t i = 1; i < mQueues.size(); ++i)
+        {
+            auto& victim = *mQueues[(worker + i) % mQueues.size()];
+            std::lock_guard<std::mutex> g(victim.mMutex);
+            if (!victim.mTasks.empty())
+            {
+                Task task = std::move(victim.mTasks.front());
+                victim.mTasks.pop_front();
+                --mQueuedFolders;
+
+                std::lock_guard<std::mutex> statsGuard(mResultsMutex);
+                ++mStats.mStolenFolders;
+                return task;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // The queued folder whose results go to chunk, if any
+    std::optional<Task> takeFolderFor(const std::shared_ptr<Chunk> &chunk)
+    {
+        for (auto& queue : mQueues)
+        {
+            std::lock_guard<std::mutex> g(queue->mMutex);
+            auto it = std::find_if(queue->mTasks.begin(), queue->mTasks.end(), [&chunk](const Task &t) { return t.mChunk == chunk; });
+            if (it != queue->mTasks.end())
+            {
+                Task task = std::move(*it);
+                queue->mTasks.erase(it);
+                --mQueuedFolders;
+                return task;
+            }
+        }
+        return std::nullopt;
+    }
+
+    void runTask(size_t worker, std::optional<Task> &&task)
+    {
+        if (!mStopped)
+        {
+            processFolder(worker, std::move(*task));
+        }
+        task.reset(); // release the node copies before telling that the task is done
+
+        if (!--mPendingTasks)
+        {
+            wakeUpWorkers();
+            std::lock_guard<std::mutex> g(mResultsMutex);
+            mResultsCV.notify_all();
+        }
+    }
+
+    void workerLoop(size_t worker)
+    {
+        for (;;)
+        {
+            if (auto task = takeFolder(worker))
+            {
+                runTask(worker, std::move(task));
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mIdleMutex);
+            mIdleCV.wait(lock, [this] { return !mPendingTasks || mQueuedFolders; });
+            if (!mPendingTasks)
+            {
+                return;
+            }
+        }
+    }
+
+    // Waits while too many results are queued, unless the consumer is waiting for these ones
+    void addResult(size_t worker, const std::shared_ptr<Chunk> &chunk, Entry &&entry)
+    {
+        std::unique_lock<std::mutex> lock(mResultsMutex);
+        while (mQueuedResults >= mOptions.mMaxQueuedResults && !mStopped
+               && !(mOptions.mOrdered && chunk == mWaitedChunk))
+        {
+            if (mOptions.mOrdered && mWaitedChunk)
+            {
+                // The consumer may be waiting for a folder that every worker is too busy (waiting) to list
+                auto waited = mWaitedChunk;
+                lock.unlock();
+                auto task = takeFolderFor(waited);
+                if (task)
+                {
+                    runTask(worker, std::move(task));
+                }
+                lock.lock();
+                if (task)
+                {
+                    ++mStats.mHelpedFolders;
+                    continue;
+                }
+            }
+
+            ++mStats.mResultWaits;
+            mResultsCV.wait_for(lock, mOptions.mPollPeriod);
+        }
+
+        chunk->mEntries.push_back(std::move(entry));
+        mStats.mMaxQueuedResults = std::max(mStats.mMaxQueuedResults, ++mQueuedResults);
+        mResultsCV.notify_all();
+    }
+
+    void processFolder(size_t worker, Task &&task)
+    {
+        std::vector<NodePtr> children = mGetChildren(*task.mFolder);
+        uint64_t visited = 0;
+        uint64_t inlineFolders = 0;
+
+        for (auto& child : children)
+        {
+            if (mStopped)
+            {
+                break;
+            }
+
+            if (mIsFolder(*child))
+            {
+                auto childChunk = task.mChunk;
+                if (mOptions.mOrdered)
+                {
+                    childChunk = std::make_shared<Chunk>();
+                    addResult(worker, task.mChunk, childChunk);
+                }
+
+                if (mQueuedFolders < mOptions.mMaxQueuedFolders)
+                {
+                    ++mPendingTasks;
+                    pushFolder(worker, {std::move(child), std::move(childChunk)});
+                }
+                else
+                {
+                    ++inlineFolders;
+                    processFolder(worker, {std::move(child), std::move(childChunk)});
+                }
+            }
+            else
+            {
+                auto result = mVisit(child);
+                ++visited;
+                child.reset(); // no need to wait for its siblings
+                if (result)
+                {
+                    addResult(worker, task.mChunk, std::move(*result));
+                }
+            }
+        }
+        children.clear();
+
+        if (!mStopped)
+        {
+            ++visited;
+            if (auto ownResult = mVisit(task.mFolder))
+            {
+                addResult(worker, task.mChunk, std::move(*ownResult));
+            }
+        }
+
+        std::lock_guard<std::mutex> g(mResultsMutex);
+        mStats.mNodes += visited;
+        if (mOptions.mOrdered)
+        {
+            task.mChunk->mComplete = true;
+        }
+        ++mStats.mFolders;
+        mStats.mInlineFolders += inlineFolders;
+        mResultsCV.notify_all();
+    }
+
+    // Consumes the results as they come (in order, if required), until the whole tree has been walked
+    bool consumeResults(const std::shared_ptr<Chunk> &rootChunk, const Consume &consume)
+    {
+        auto lastPoll = std::chrono::steady_clock::now();
+        auto shouldStop = [this, &lastPoll]()
+        {
+            if (!mOptions.mShouldStop)
+            {
+                return false;
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (now - lastPoll < mOptions.mPollPeriod)
+            {
+                return false;
+            }
+            lastPoll = now;
+            return mOptions.mShouldStop();
+        };
+
+        std::vector<std::shared_ptr<Chunk>> chunks{rootChunk};
+        std::unique_lock<std::mutex> lock(mResultsMutex);
+        while (!chunks.empty())
+        {
+            auto& chunk = *chunks.back();
+            if (!chunk.mEntries.empty())
+            {
+                auto entry = std::move(chunk.mEntries.front());
+                chunk.mEntries.pop_front();
+                if (mQueuedResults-- == mOptions.mMaxQueuedResults)
+                {
+                    mResultsCV.notify_all(); // room for the waiting workers
+                }
+
+                if (auto subChunk = std::get_if<std::shared_ptr<Chunk>>(&entry))
+                {
+                    chunks.push_back(std::move(*subChunk));
+                    continue;
+                }
+
+                lock.unlock();
+                if (!consume(std::move(std::get<Result>(entry))) || shouldStop())
+                {
+                    return false;
+                }
+                lock.lock();
+            }
+            else if (chunk.mComplete || (!mOptions.mOrdered && !mPendingTasks))
+            {
+                chunks.pop_back();
+            }
+            else
+            {
+                if (mOptions.mOrdered && mWaitedChunk != chunks.back())
+                {
+                    mWaitedChunk = chunks.back(); // its results are let through, even if too many are queued
+                    mResultsCV.notify_all();
+                }
+                mResultsCV.wait_for(lock, mOptions.mPollPeriod);
+                if (chunk.mEntries.empty())
+                {
+                    lock.unlock();
+                    if (shouldStop())
+                    {
+                        return false;
+                    }
+                    lock.lock();
+                }
+            }
+        }
+        return true;
+    }
+};
+
+struct NodeVisitContext
+{
+    size_t mDepth = 0;   // 0 for the node the walk starts from
+    bool mIsLast = true; // whether it is the last one among its siblings
+};
+
+/**
+ * @brief Walks a tree depth first, with an explicit stack instead of recursion (so that deep trees can't
+ * exhaust the stack), keeping as few node copies as possible.
+ *
+ * The children of a folder are fetched in batches of up to batchSize, and visited straight from them. Only the
+ * batch of the folder being walked is kept: when a subfolder is entered, the batch it came from is released
+ * (its folder keeps just the position of the next child), and the following batch is fetched from that position
+ * once the subfolder is done. This way, memory is bound by the depth of the tree plus a batch, instead of by
+ * the depth times the number of children of each folder.
+ * Children added or removed while their folder is being walked may shift the positions: some might be skipped.
+ *
+ * Source is expected to provide:
+ *  - the types Node and NodeList.
+ *  - size_t countChildren(Node &)
+ *  - std::unique_ptr<NodeList> getChildren(Node &, size_t offset, size_t count): the children in positions
+ *    [offset, offset + count), fewer at the end
+ *  - size_t size(const NodeList &) and Node *get(const NodeList &, size_t)
+ *  - bool isFolder(Node &)
+ *  - std::unique_ptr<Node> copy(Node &)
+ */
+template <typename Source>
+class DepthFirstTreeVisitor
+{
+public:
+    using Node = typename Source::Node;
+    using NodeList = typename Source::NodeList;
+
+    struct Callbacks
+    {
+        // Called for every node, before its children. Returns true to visit the children (of a folder)
+        std::function<bool(Node &, const NodeVisitContext &)> mOnEnter;
+
+        // (Optional) called with every batch of the children of a folder (from position offset, last tells whether
+        // there are more), before visiting any of them. They are fetched again to be visited
+        std::function<void(Node &, const NodeList &, size_t offset, bool last, const NodeVisitContext &)> mOnChildrenListed;
+
+        // (Optional) called for every node, after its children
+        std::function<void(Node &, const NodeVisitContext &)> mOnLeave;
+
+        // (Optional) polled before every node: returns true to abandon the walk
+        std::function<bool()> mShouldStop;
+    };
+
+    explicit DepthFirstTreeVisitor(Source &source, size_t batchSize = 256) :
+        mSource(source),
+        mBatchSize(std::max<size_t>(1, batchSize))
+    {
+    }
+
+    // Returns false if the walk was abandoned
+    bool walk(Node &root, const Callbacks &callbacks)
+    {
+        auto shouldStop = [&callbacks]() { return callbacks.mShouldStop && callbacks.mShouldStop(); };
+
+        if (shouldStop())
+        {
+            return false;
+        }
+
+        std::vector<Frame> stack;
+        if (callbacks.mOnEnter(root, NodeVisitContext()) && mSource.isFolder(root))
+        {
+            pushFolder(stack, root, nullptr, NodeVisitContext(), callbacks);
+        }
+        else if (callbacks.mOnLeave)
+        {
+            callbacks.mOnLeave(root, NodeVisitContext());
+        }
+
+        while (!stack.empty())
+        {
+            if (shouldStop())
+            {
+                return false;
+            }
+
+            Frame &frame = stack.back();
+            if (frame.mNext < frame.mTotal && !(frame.mBatch && frame.mNext < frame.mBatchOffset + mSource.size(*frame.mBatch)))
+            {
+                frame.mBatch.reset(); // (before fetching the next one)
+                frame.mBatch = mSource.getChildren(*frame.mFolder, frame.mNext, mBatchSize);
+                frame.mBatchOffset = frame.mNext;
+                if (!frame.mBatch || !mSource.size(*frame.mBatch)) // fewer children than counted (e.g. removed meanwhile)
+                {
+                    frame.mTotal = frame.mNext;
+                }
+            }
+
+            if (frame.mNext >= frame.mTotal) // no children left
+            {
+                if (callbacks.mOnLeave)
+                {
+                    callbacks.mOnLeave(*frame.mFolder, frame.mContext);
+                }
+                stack.pop_back();
+                continue;
+            }
+
+            const size_t position = frame.mNext++;
+            Node *child = mSource.get(*frame.mBatch, position - frame.mBatchOffset);
+
+            NodeVisitContext context;
+            context.mDepth = frame.mContext.mDepth + 1;
+            context.mIsLast = position + 1 == frame.mTotal;
+
+            if (callbacks.mOnEnter(*child, context) && mSource.isFolder(*child))
+            {
+                std::unique_ptr<Node> folder = mSource.copy(*child);
+                frame.mBatch.reset(); // (child is no longer valid)
+
+                Node &folderRef = *folder;
+                pushFolder(stack, folderRef, std::move(folder), context, callbacks); // (frame is no longer valid)
+            }
+            else if (callbacks.mOnLeave)
+            {
+                callbacks.mOnLeave(*child, context);
+            }
+        }
+        return true;
+    }
+
+private:
+    struct Frame
+    {
+        Node *mFolder = nullptr;
+        std::unique_ptr<Node> mOwnedFolder; // null for the root (owned by the caller)
+        NodeVisitContext mContext;
+        size_t mTotal = 0;                  // number of children
+        size_t mNext = 0;                   // position of the next one to visit
+
+        std::unique_ptr<NodeList> mBatch;   // only kept while walking this folder (null once released)
+        size_t mBatchOffset = 0;            // position of its first child
+    };
+
+    Source &mSource;
+    const size_t mBatchSize;
+
+    void pushFolder(std::vector<Frame> &stack, Node &folder, std::unique_ptr<Node> &&ownedFolder,
+                    const NodeVisitContext &context, const Callbacks &callbacks)
+    {
+        Frame frame;
+        frame.mFolder = &folder;
+        frame.mOwnedFolder = std::move(ownedFolder);
+        frame.mContext = context;
+        frame.mTotal = mSource.countChildren(folder);
+
+        if (callbacks.mOnChildrenListed)
+        {
+            for (size_t offset = 0;;)
+            {
+                auto batch = mSource.getChildren(folder, offset, mBatchSize);
+                if (!batch)
+                {
+                    break;
+                }
+
+                const size_t listed = mSource.size(*batch);
+                const bool last = listed < mBatchSize || offset + listed >= frame.mTotal;
+                callbacks.mOnChildrenListed(folder, *batch, offset, last, context);
+                if (last)
+                {
+                    if (!offset) // all of them: no need to fetch them again
+                    {
+                        frame.mBatch = std::move(batch);
+                    }
+                    break;
+                }
+                offset += listed;
+            }
+        }
+        stack.push_back(std::move(frame));
+    }
+};
+
+}//end namespace
@@ -0,0 +1,211 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "megacmdcommonutils.h"
+
+namespace megacmd {
+
+struct WorkerPoolStats
+{
+    size_t mMaxWorkers = 0;
+    size_t mWorkers = 0;       // threads spawned so far (they are kept for reuse)
+    size_t mBusyWorkers = 0;
+    size_t mQueueDepth = 0;
+    size_t mMaxQueueDepth = 0; // high watermark
+    uint64_t mProcessed = 0;
+    std::chrono::microseconds mAvgQueueWait{0};
+    std::chrono::microseconds mMaxQueueWait{0};
+
+    // Tasks either queued or being executed
+    size_t pending() const { return mQueueDepth + mBusyWorkers; }
+};
+
+/**
+ * @brief A pool of reusable worker threads fed by a bounded multi-producer/multi-consumer queue.
+ *
+ * Threads are spawned lazily, only when a task is queued and there is no idle worker to take it,
+ * up to maxWorkers. Once spawned they are kept alive until the pool is destroyed.
+ * push() blocks while the queue is full, so that producers get backpressure instead of an
+ * unbounded backlog.
+ */
+class WorkerPool
+{
+public:
+    using Task = std::function<void()>;
+
+    WorkerPool(size_t maxWorkers, size_t queueCapacity) :
+        mMaxWorkers(std::max<size_t>(1, maxWorkers)),
+        mQueueCapacity(std::max<size_t>(1, queueCapacity))
+    {
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            mStopped = true;
+        }
+        mQueueNotEmptyCV.notify_all();
+        mQueueNotFullCV.notify_all();
+
+        for (auto& thread : mThreads)
+        {
+            thread.join();
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Returns false if the pool is being destroyed (the task is discarded)
+    bool push(Task&& task)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mQueueNotFullCV.wait(lock, [this] { return mStopped || mQueue.size() < mQueueCapacity; });
+        if (mStopped)
+        {
+            return false;
+        }
+
+        mQueue.push_back({std::move(task), std::chrono::steady_clock::now()});
+        mMaxQueueDepth = std::max(mMaxQueueDepth, mQueue.size());
+
+        if (mIdleWorkers < mQueue.size() && mThreads.size() < mMaxWorkers)
+        {
+            ++mIdleWorkers; // accounted as idle from the start, so that bursts don't overspawn
+            mThreads.emplace_back([this] { workerLoop(); });
+        }
+        lock.unlock();
+
+        mQueueNotEmptyCV.notify_one();
+        return true;
+    }
+
+    // Waits until there are no queued nor running tasks (other than the ones running in the calling thread)
+    template <typename Rep, typename Period>
+    bool waitUntilIdle(const std::chrono::duration<Rep, Period>& timeout)
+    {
+        const size_t ownTasks = isWorkerThread() ? 1 : 0;
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        return mIdleCV.wait_for(lock, timeout, [this, ownTasks] { return mQueue.size() + mBusyWorkers <= ownTasks; });
+    }
+
+    bool isWorkerThread() const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return std::any_of(mThreads.begin(), mThreads.end(), [](const std::thread& t) { return t.get_id() == std::this_thread::get_id(); });
+    }
+
+    WorkerPoolStats getStats() const
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+
+        WorkerPoolStats stats;
+        stats.mMaxWorkers = mMaxWorkers;
+        stats.mWorkers = mThreads.size();
+        stats.mBusyWorkers = mBusyWorkers;
+        stats.mQueueDepth = mQueue.size();
+        stats.mMaxQueueDepth = mMaxQueueDepth;
+        stats.mProcessed = mProcessed;
+        stats.mMaxQueueWait = mMaxQueueWait;
+        if (mDequeued)
+        {
+            stats.mAvgQueueWait = mTotalQueueWait / mDequeued;
+        }
+        return stats;
+    }
+
+private:
+    struct QueuedTask
+    {
+        Task mTask;
+        std::chrono::steady_clock::time_point mEnqueuedAt;
+    };
+
+    const size_t mMaxWorkers;
+    const size_t mQueueCapacity;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mQueueNotEmptyCV;
+    std::condition_variable mQueueNotFullCV;
+    std::condition_variable mIdleCV;
+
+    std::deque<QueuedTask> mQueue;
+    std::vector<std::thread> mThreads;
+    bool mStopped = false;
+
+    size_t mIdleWorkers = 0;
+    size_t mBusyWorkers = 0;
+
+    // metrics
+    size_t mMaxQueueDepth = 0;
+    uint64_t mProcessed = 0;
+    uint64_t mDequeued = 0;
+    std::chrono::microseconds mTotalQueueWait{0};
+    std::chrono::microseconds mMaxQueueWait{0};
+
+    void workerLoop()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        for (;;)
+        {
+            mQueueNotEmptyCV.wait(lock, [this] { return mStopped || !mQueue.empty(); });
+            --mIdleWorkers;
+
+            if (mQueue.empty()) // stopped
+            {
+                return;
+            }
+
+            QueuedTask queued = std::move(mQueue.front());
+            mQueue.pop_front();
+
+            auto waited = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - queued.mEnqueuedAt);
+            mTotalQueueWait += waited;
+            mMaxQueueWait = std::max(mMaxQueueWait, waited);
+            ++mDequeued;
+            ++mBusyWorkers;
+
+            lock.unlock();
+            mQueueNotFullCV.notify_one();
+
+            queued.mTask();
+            queued.mTask = nullptr; // release captures before going idle
+
+            lock.lock();
+            --mBusyWorkers;
+            ++mIdleWorkers;
+            ++mProcessed;
+            if (mQueue.size() + mBusyWorkers <= 1) // waitUntilIdle may be waiting from within a worker
+            {
+                mIdleCV.notify_all();
+            }
+        }
+    }
+};
+
+}//end namespace
@@ -551,6 +551,18 @@ bool startsWith(const std::string_view str, const std::string_view prefix)
     return str.rfind(prefix, 0) == 0;
 }
 
+bool isSideEffectFreeCommand(std::string_view commandLine)
+{
+    const auto start = commandLine.find_first_not_of(" \t");
+    if (start == std::string_view::npos)
+    {
+        return false;
+    }
+    commandLine.remove_prefix(start);
+    const auto command = commandLine.substr(0, commandLine.find_first_of(" \t"));
+    return std::find(sideEffectFreeCommands.begin(), sideEffectFreeCommands.end(), command) != sideEffectFreeCommands.end();
+}
+
 string toLower(const std::string& str)
 {
     std::string lower = str;
@@ -844,6 +856,24 @@ std::optional<int> getIntOptional(const std::map<std::string, std::string>& clop
     }
 }
 
+std::optional<long long> getLongLongOptional(const std::map<std::string, std::string>& cloptions, const char* optName)
+{
+    auto it = cloptions.find(optName);
+    if (it == cloptions.end())
+    {
+        return std::nullopt;
+    }
+
+    try
+    {
+        return std::stoll(it->second);
+    }
+    catch (...)
+    {
+        return std::nullopt;
+    }
+}
+
 void discardOptionsAndFlags(vector<string> *ws)
 {
     for (std::vector<string>::iterator it = ws->begin(); it != ws->end(); )
@@ -125,6 +125,13 @@ static std::vector<std::string> loginInValidCommands { "log", "debug", "speedlim
 #endif
                            };
 
+// Also valid while resuming the session at startup in fast start mode (MEGACMD_FAST_START), once the cached nodes are loaded
+static std::vector<std::string> fastStartValidCommands { "ls", "tree", "cd", "pwd", "find", "du", "whoami", "lcd", "lpwd" };
+
+// Without side effects (on the account, on local files or on the state of the server, e.g. its working directory):
+// other commands get the same outcome whether they run before or after them
+static std::vector<std::string> sideEffectFreeCommands { "ls", "tree", "pwd", "find", "du", "whoami", "lpwd", "version", "df", "cat", "mediainfo", "help" };
+
 static std::vector<std::string> allValidCommands { "login", "signup", "confirm", "session", "mount", "ls", "cd", "log", "debug", "pwd", "lcd", "lpwd", "import", "masterkey",
                              "put", "get", "attr", "userattr", "mkdir", "rm", "du", "mv", "cp", "sync", "sync-ignore", "export", "share", "invite", "ipc", "df",
                              "showpcr", "users", "speedlimit", "killsession", "whoami", "help", "passwd", "reload", "logout", "version", "quit",
@@ -239,6 +246,9 @@ std::string getRightAlignedString(const std::string origin, unsigned int minsize
 
 bool startsWith(const std::string_view str, const std::string_view prefix);
 
+// Whether the command of a command line is one of sideEffectFreeCommands
+bool isSideEffectFreeCommand(std::string_view commandLine);
+
 /* Vector related */
 template <typename T>
 std::vector<T> operator+(const std::vector<T>& a, const std::vector<T>& b)
@@ -318,6 +328,7 @@ std::optional<std::string> getOptionAsOptional(const std::map<std::string, std::
 
 int getintOption(const std::map<std::string, std::string> *cloptions, const char * optname, int defaultValue = 0);
 std::optional<int> getIntOptional(const std::map<std::string, std::string>& cloptions, const char* optName);
+std::optional<long long> getLongLongOptional(const std::map<std::string, std::string>& cloptions, const char* optName);
 
 void discardOptionsAndFlags(std::vector<std::string> *ws);
 
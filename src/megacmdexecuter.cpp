@@ -30,6 +30,7 @@
 #include "sync_command.h"
 #include "sync_ignore.h"
 #include "megacmd_fuse.h"
+#include "megacmd_cat_plan.h"
 
 #include <iomanip>
 #include <limits>
@@ -37,6 +38,7 @@
 #include <ctime>
 #include <functional>
 #include <set>
+#include <deque>
 
 #include <signal.h>
 
@@ -192,7 +194,12 @@ MegaCmdExecuter::MegaCmdExecuter(MegaApi *api, MegaCmdLogger *loggerCMD, MegaCmd
     // Give a few seconds in order for key sharing to happen
     mFsAccessCMD(::mega::createFSA()),
     mDeferredSharedFoldersVerifier(std::chrono::seconds(5)),
-    mSyncIssuesManager(api)
+    mSyncIssuesManager(api),
+    mFolderStatsCache([api](FolderStatsCache::Handle handle)
+    {
+        std::unique_ptr<MegaNode> node(api->getNodeByHandle(handle));
+        return node ? node->getParentHandle() : FolderStatsCache::UNDEF;
+    })
 {
     signingup = false;
     confirming = false;
@@ -297,15 +304,13 @@ bool MegaCmdExecuter::includeIfIsSharedOrPendingOutShare(MegaApi *api, MegaNode
 
 struct patternNodeVector
 {
-    string pattern;
-    bool usepcre;
+    const PatternMatcher *matcher;
     vector<MegaNode*> *nodesMatching;
 };
 
 struct criteriaNodeVector
 {
-    string pattern;
-    bool usepcre;
+    const PatternMatcher *matcher; // compiled once for the whole tree
     m_time_t minTime;
     m_time_t maxTime;
 
@@ -314,13 +319,15 @@ struct criteriaNodeVector
 
     int mType = MegaNode::TYPE_UNKNOWN;
 
-    vector<MegaNode*> *nodesMatching;
+    // Called with every node matching as soon as it is found (no copies are kept). Returns false to stop looking for more
+    std::function<bool(MegaNode *)> onMatch;
+    bool stop = false;
 };
 
 bool MegaCmdExecuter::includeIfMatchesPattern(MegaApi *api, MegaNode * n, void *arg)
 {
     struct patternNodeVector *pnv = (struct patternNodeVector*)arg;
-    if (patternMatches(n->getName(), pnv->pattern.c_str(), pnv->usepcre))
+    if (pnv->matcher->matches(n->getName()))
     {
         pnv->nodesMatching->push_back(n->copy());
         return true;
@@ -329,10 +336,9 @@ bool MegaCmdExecuter::includeIfMatchesPattern(MegaApi *api, MegaNode * n, void *
 }
 
 
-bool MegaCmdExecuter::includeIfMatchesCriteria(MegaApi *api, MegaNode * n, void *arg)
+// Safe to be called from several threads at the same time
+static bool nodeMatchesCriteria(MegaNode *n, const criteriaNodeVector *pnv)
 {
-    struct criteriaNodeVector *pnv = (struct criteriaNodeVector*)arg;
-
     if (pnv->mType != MegaNode::TYPE_UNKNOWN && n->getType() != pnv->mType )
     {
         return false;
@@ -357,36 +363,107 @@ bool MegaCmdExecuter::includeIfMatchesCriteria(MegaApi *api, MegaNode * n, void
         return false;
     }
 
-    if (!patternMatches(n->getName(), pnv->pattern.c_str(), pnv->usepcre))
+    return pnv->matcher->matches(n->getName());
+}
+
+bool MegaCmdExecuter::includeIfMatchesCriteria(MegaApi *api, MegaNode * n, void *arg)
+{
+    struct criteriaNodeVector *pnv = (struct criteriaNodeVector*)arg;
+
+    if (!nodeMatchesCriteria(n, pnv))
     {
         return false;
     }
 
-    pnv->nodesMatching->push_back(n->copy());
+    if (!pnv->onMatch(n))
+    {
+        pnv->stop = true;
+    }
     return true;
 }
 
-bool MegaCmdExecuter::processTree(MegaNode *n, bool processor(MegaApi *, MegaNode *, void *), void *( arg ))
+bool MegaCmdExecuter::processTree(MegaNode *n, bool processor(MegaApi *, MegaNode *, void *), void *( arg ), const std::function<bool()> &shouldStop)
 {
     if (!n)
     {
         return false;
     }
+
+    // Every node is processed after its children
     bool toret = true;
-    MegaNodeList *children = api->getChildren(n);
-    if (children)
+    MegaApiNodeSource source{api};
+    DepthFirstTreeVisitor<MegaApiNodeSource>::Callbacks callbacks;
+    callbacks.mOnEnter = [](MegaNode &, const NodeVisitContext &) { return true; };
+    callbacks.mOnLeave = [this, processor, arg, &toret](MegaNode &node, const NodeVisitContext &)
     {
-        for (int i = 0; i < children->size(); i++)
+        bool currentret = processor(api, &node, arg);
+        toret = toret && currentret;
+    };
+    callbacks.mShouldStop = shouldStop;
+
+    return DepthFirstTreeVisitor<MegaApiNodeSource>(source).walk(*n, callbacks) && toret;
+}
+
+template <typename Result>
+bool MegaCmdExecuter::walkTreeInParallel(MegaNode *n, TreeWalkOptions options,
+                                         const std::function<std::optional<Result>(const std::shared_ptr<MegaNode> &)> &visit,
+                                         const std::function<bool(Result &&)> &consume)
+{
+    auto getChildren = [this](MegaNode &folder)
+    {
+        // Children share the ownership of their list: no further copies are made
+        std::shared_ptr<MegaNodeList> list(api->getChildren(&folder));
+        std::vector<std::shared_ptr<MegaNode>> children;
+        if (list)
         {
-            bool childret = processTree(children->get(i), processor, arg);
-            toret = toret && childret;
+            children.reserve(static_cast<size_t>(list->size()));
+            for (int i = 0; i < list->size(); i++)
+            {
+                children.emplace_back(list, list->get(i));
+            }
         }
+        return children;
+    };
 
-        delete children;
+    auto isFolder = [](MegaNode &node)
+    {
+        return node.getType() != MegaNode::TYPE_FILE;
+    };
+
+    const size_t threads = options.mThreads;
+    ParallelTreeWalker<MegaNode, Result> walker(std::move(options), getChildren, isFolder, visit);
+
+    // n is owned by the caller
+    const bool completed = walker.walk(std::shared_ptr<MegaNode>(n, [](MegaNode *) {}), consume);
+
+    const auto stats = walker.getStats();
+    LOG_debug << "Walked " << stats.mNodes << " nodes (" << stats.mFolders << " folders) with " << threads << " threads"
+              << ". Stolen folders: " << stats.mStolenFolders << ". Max queued folders: " << stats.mMaxQueuedFolders
+              << ". Max queued results: " << stats.mMaxQueuedResults << " (waited for the output " << stats.mResultWaits << " times)"
+              << (completed ? "" : ". Stopped before the end");
+    return completed;
+}
+
+// Parses --threads, for commands walking trees. Returns false (reporting the error) if invalid
+static bool getTreeWalkThreads(std::map<std::string, std::string> *cloptions, size_t &threads)
+{
+    constexpr int MAX_TREE_WALK_THREADS = 64;
+
+    threads = 1;
+    if (!cloptions->count("threads"))
+    {
+        return true;
     }
 
-    bool currentret = processor(api, n, arg);
-    return toret && currentret;
+    auto requested = getIntOptional(*cloptions, "threads");
+    if (!requested || *requested <= 0 || *requested > MAX_TREE_WALK_THREADS)
+    {
+        setCurrentThreadOutCode(MCMD_EARGS);
+        LOG_err << "Invalid number of threads " << getOption(cloptions, "threads", "") << " (1 to " << MAX_TREE_WALK_THREADS << ")";
+        return false;
+    }
+    threads = static_cast<size_t>(*requested);
+    return true;
 }
 
 
@@ -433,10 +510,37 @@ std::unique_ptr<MegaNode> MegaCmdExecuter::nodebypath(const char* ptr, string* u
         }
     }
 
+    if (!baseNode)
+    {
+        return nullptr;
+    }
+
+    // Resolve from the longest part of the path already resolved (if any)
+    const MegaHandle baseHandle = baseNode->getHandle();
+    const uint64_t cacheGeneration = mPathCache.generation();
+    size_t pos = 0; // where the part left to resolve starts
+    if (auto cached = mPathCache.findLongestPrefix(baseHandle, rest))
+    {
+        std::unique_ptr<MegaNode> cachedNode(api->getNodeByHandle(cached->second));
+        if (cachedNode)
+        {
+            baseNode = std::move(cachedNode);
+            pos = cached->first + 1;
+            if (pos >= rest.size())
+            {
+                return baseNode;
+            }
+        }
+        else
+        {
+            mPathCache.erase(baseHandle, string_view(rest).substr(0, cached->first));
+        }
+    }
+
     while (baseNode)
     {
-        size_t possep = rest.find('/');
-        string curName = rest.substr(0,possep);
+        size_t possep = rest.find('/', pos);
+        string curName = rest.substr(pos, possep == string::npos ? possep : possep - pos);
 
         if (curName != ".")
         {
@@ -479,16 +583,20 @@ std::unique_ptr<MegaNode> MegaCmdExecuter::nodebypath(const char* ptr, string* u
             // mv command target? return name part of not found
             if (namepart && !nextNode && (possep == string::npos)) //if this is the last part, we will pass that one, so that a mv command know the name to give the new node
             {
-                *namepart = rest;
+                *namepart = rest.substr(pos);
                 return baseNode;
             }
 
             baseNode = std::move(nextNode);
+            if (baseNode)
+            {
+                mPathCache.put(baseHandle, string_view(rest).substr(0, possep), baseNode->getHandle(), cacheGeneration);
+            }
         }
 
         if (possep != string::npos && possep != (rest.size() - 1))
         {
-            rest = rest.substr(possep+1);
+            pos = possep + 1;
         }
         else
         {
@@ -550,6 +658,7 @@ void MegaCmdExecuter::getPathsMatching(MegaNode *parentNode, deque<string> pathP
     if (children)
     {
         bool isversion = nodeNameIsVersion(currentPart);
+        PatternMatcher matcher(isversion ? currentPart.substr(0,currentPart.size()-11) : currentPart, usepcre);
 
         for (int i = 0; i < children->size(); i++)
         {
@@ -569,7 +678,7 @@ void MegaCmdExecuter::getPathsMatching(MegaNode *parentNode, deque<string> pathP
             if (isversion)
             {
 
-                if (childNode && patternMatches(childname.c_str(), currentPart.substr(0,currentPart.size()-11).c_str(), usepcre))
+                if (childNode && matcher.matches(childname.c_str()))
                 {
                     MegaNodeList *versionNodes = api->getVersions(childNode);
                     if (versionNodes)
@@ -597,7 +706,7 @@ void MegaCmdExecuter::getPathsMatching(MegaNode *parentNode, deque<string> pathP
             }
             else
             {
-                if (patternMatches(childname.c_str(), currentPart.c_str(), usepcre))
+                if (matcher.matches(childname.c_str()))
                 {
                     if (pathParts.size() == 0) //last leave
                     {
@@ -698,12 +807,13 @@ vector <string> * MegaCmdExecuter::nodesPathsbypath(const char* ptr, bool usepcr
         unique_ptr<MegaShareList> inShares(api->getInSharesList());
         if (inShares)
         {
+            PatternMatcher matcher(matching, false);
             for (int i = 0; i < inShares->size(); i++)
             {
                 unique_ptr<MegaNode> n(api->getNodeByHandle(inShares->get(i)->getNodeHandle()));
                 string tomatch = string("//from/")+inShares->get(i)->getUser() + ":"+n->getName();
 
-                if (patternMatches(tomatch.c_str(), matching.c_str(), false))
+                if (matcher.matches(tomatch.c_str()))
                 {
                     pathsMatching->push_back(tomatch);
                 }
@@ -779,6 +889,7 @@ void MegaCmdExecuter::getNodesMatching(MegaNode *parentNode, deque<string> pathP
     if (children)
     {
         bool isversion = nodeNameIsVersion(currentPart);
+        PatternMatcher matcher(isversion ? currentPart.substr(0,currentPart.size()-11) : currentPart, usepcre);
 
         for (int i = 0; i < children->size(); i++)
         {
@@ -786,7 +897,7 @@ void MegaCmdExecuter::getNodesMatching(MegaNode *parentNode, deque<string> pathP
             if (isversion)
             {
 
-                if (childNode && patternMatches(childNode->getName(), currentPart.substr(0,currentPart.size()-11).c_str(), usepcre))
+                if (childNode && matcher.matches(childNode->getName()))
                 {
                     MegaNodeList *versionNodes = api->getVersions(childNode);
                     if (versionNodes)
@@ -815,7 +926,7 @@ void MegaCmdExecuter::getNodesMatching(MegaNode *parentNode, deque<string> pathP
             else
             {
 
-                if (patternMatches(childNode->getName(), currentPart.c_str(), usepcre))
+                if (matcher.matches(childNode->getName()))
                 {
                     if (pathParts.size() == 0) //last leave
                     {
@@ -1212,6 +1323,7 @@ vector<std::unique_ptr<MegaNode>> MegaCmdExecuter::nodesbypath(const char* ptr,
         {
             string matching = ptr;
             unescapeifRequired(matching);
+            PatternMatcher matcher(matching, false);
 
             for (int i = 0; i < inShares->size(); i++)
             {
@@ -1219,7 +1331,7 @@ vector<std::unique_ptr<MegaNode>> MegaCmdExecuter::nodesbypath(const char* ptr,
                 if (!n) continue;
 
                 string tomatch = string("//from/") + inShares->get(i)->getUser() + ":" + n->getName();
-                if (patternMatches(tomatch.c_str(), matching.c_str(), false))
+                if (matcher.matches(tomatch.c_str()))
                 {
                     nodesMatching.emplace_back(std::move(n));
                 }
@@ -1724,108 +1836,145 @@ void MegaCmdExecuter::printTreeSuffix(int depth, vector<bool> &lastleaf)
 
 void MegaCmdExecuter::dumptree(MegaNode* n, bool treelike, vector<bool> &lastleaf, const char *timeFormat, std::map<std::string, int> *clflags, std::map<std::string, std::string> *cloptions, int recurse, int extended_info, bool showversions, int depth, string pathRelativeTo)
 {
-    if (depth || ( n->getType() == MegaNode::TYPE_FILE ))
+    // whether each of the nodes in the path being printed is the last one among its siblings
+    vector<bool> leaves = lastleaf;
+
+    MegaApiNodeSource source{api};
+    DepthFirstTreeVisitor<MegaApiNodeSource>::Callbacks callbacks;
+    callbacks.mOnEnter = [&](MegaNode &node, const NodeVisitContext &context)
     {
-        if (treelike) printTreeSuffix(depth, lastleaf);
+        MegaNode *n = &node;
+        const int nodeDepth = depth + static_cast<int>(context.mDepth);
+        if (context.mDepth)
+        {
+            leaves.resize(lastleaf.size() + context.mDepth - 1);
+            leaves.push_back(context.mIsLast);
+        }
 
-        if (pathRelativeTo != "NULL")
+        if (nodeDepth || ( n->getType() == MegaNode::TYPE_FILE ))
         {
-            if (!n->getName())
-            {
-                dumpNode(n, timeFormat, clflags, cloptions, extended_info, showversions, treelike?0:depth, "CRYPTO_ERROR");
-            }
-            else
-            {
-                char * nodepath = api->getNodePath(n);
+            if (treelike) printTreeSuffix(nodeDepth, leaves);
 
-                char *pathToShow = NULL;
-                if (pathRelativeTo != "")
+            // only the paths of the top node are shown relative
+            if (!context.mDepth && pathRelativeTo != "NULL")
+            {
+                if (!n->getName())
                 {
-                    pathToShow = strstr(nodepath, pathRelativeTo.c_str());
+                    dumpNode(n, timeFormat, clflags, cloptions, extended_info, showversions, treelike?0:nodeDepth, "CRYPTO_ERROR");
                 }
-
-                if (pathToShow == nodepath)     //found at beginning
+                else
                 {
-                    pathToShow += pathRelativeTo.size();
-                    if (( *pathToShow == '/' ) && ( pathRelativeTo != "/" ))
+                    char * nodepath = api->getNodePath(n);
+
+                    char *pathToShow = NULL;
+                    if (pathRelativeTo != "")
                     {
-                        pathToShow++;
+                        pathToShow = strstr(nodepath, pathRelativeTo.c_str());
+                    }
+
+                    if (pathToShow == nodepath)     //found at beginning
+                    {
+                        pathToShow += pathRelativeTo.size();
+                        if (( *pathToShow == '/' ) && ( pathRelativeTo != "/" ))
+                        {
+                            pathToShow++;
+                        }
+                    }
+                    else
+                    {
+                        pathToShow = nodepath;
                     }
-                }
-                else
-                {
-                    pathToShow = nodepath;
-                }
 
-                dumpNode(n, timeFormat, clflags, cloptions, extended_info, showversions, treelike?0:depth, pathToShow);
+                    dumpNode(n, timeFormat, clflags, cloptions, extended_info, showversions, treelike?0:nodeDepth, pathToShow);
 
-                delete []nodepath;
+                    delete []nodepath;
+                }
+            }
+            else
+            {
+                    dumpNode(n, timeFormat, clflags, cloptions, extended_info, showversions, treelike?0:nodeDepth);
             }
-        }
-        else
-        {
-                dumpNode(n, timeFormat, clflags, cloptions, extended_info, showversions, treelike?0:depth);
-        }
 
-        if (!recurse && depth)
-        {
-            return;
+            if (!recurse && nodeDepth)
+            {
+                return false;
+            }
         }
-    }
+        return true;
+    };
 
-    if (n->getType() != MegaNode::TYPE_FILE)
+    DepthFirstTreeVisitor<MegaApiNodeSource>(source).walk(*n, callbacks);
+}
+
+void MegaCmdExecuter::dumpTreeSummary(MegaNode *n, const char *timeFormat, std::map<std::string, int> *clflags, std::map<std::string, std::string> *cloptions, int recurse, bool show_versions, int depth, bool humanreadable, string pathRelativeTo)
+{
+    // only the paths of the top node are shown relative
+    auto getPathToShow = [this, &pathRelativeTo](MegaNode *n, const NodeVisitContext &context)
     {
-        MegaNodeList* children = api->getChildren(n);
-        if (children)
+        const string relativeTo = context.mDepth ? "NULL" : pathRelativeTo;
+        std::unique_ptr<char[]> nodepath(api->getNodePath(n));
+
+        const char *pathToShow = nodepath.get();
+        if (nodepath && relativeTo != "" && strstr(nodepath.get(), relativeTo.c_str()) == nodepath.get()) //found at beginning
         {
-            for (int i = 0; i < children->size(); i++)
+            pathToShow += relativeTo.size();
+            if (( *pathToShow == '/' ) && ( relativeTo != "/" ))
             {
-                vector<bool> lfs = lastleaf;
-                lfs.push_back(i==(children->size()-1));
-                dumptree(children->get(i), treelike, lfs, timeFormat, clflags, cloptions, recurse, extended_info, showversions, depth + 1);
+                pathToShow++;
             }
-
-            delete children;
         }
-    }
-}
 
-void MegaCmdExecuter::dumpTreeSummary(MegaNode *n, const char *timeFormat, std::map<std::string, int> *clflags, std::map<std::string, std::string> *cloptions, int recurse, bool show_versions, int depth, bool humanreadable, string pathRelativeTo)
-{
-    char * nodepath = api->getNodePath(n);
+        if (!pathToShow && !( pathToShow = n->getName()))
+        {
+            pathToShow = "CRYPTO_ERROR";
+        }
+        return string(pathToShow);
+    };
 
-    string scryptoerror = "CRYPTO_ERROR";
+    MegaApiNodeSource source{api};
+    DepthFirstTreeVisitor<MegaApiNodeSource>::Callbacks callbacks;
 
-    char *pathToShow = NULL;
-    if (pathRelativeTo != "")
+    // Folders are listed as soon as they are entered (their subfolders are entered only when recursing)
+    callbacks.mOnEnter = [&](MegaNode &node, const NodeVisitContext &context)
     {
-        pathToShow = strstr(nodepath, pathRelativeTo.c_str());
-    }
+        MegaNode *n = &node;
+        if (n->getType() != MegaNode::TYPE_FILE)
+        {
+            return !context.mDepth || recurse;
+        }
 
-    if (pathToShow == nodepath) //found at beginning
-    {
-        pathToShow += pathRelativeTo.size();
-        if (( *pathToShow == '/' ) && ( pathRelativeTo != "/" ))
+        if (!(depth + context.mDepth))
         {
-            pathToShow++;
+            dumpNodeSummary(n, timeFormat, clflags, cloptions, humanreadable);
+
+            if (show_versions)
+            {
+                MegaNodeList *vers = api->getVersions(n);
+                if (vers &&  vers->size() > 1)
+                {
+                    OUTSTREAM << endl << "Versions of " << getPathToShow(n, context) << ":" << endl;
+
+                    for (int i = 0; i < vers->size(); i++)
+                    {
+                        string nametoshow = n->getName()+string("#")+SSTR(vers->get(i)->getModificationTime());
+                        dumpNodeSummary(vers->get(i), timeFormat, clflags, cloptions, humanreadable, nametoshow.c_str());
+                    }
+                }
+                delete vers;
+            }
         }
-    }
-    else
-    {
-        pathToShow = nodepath;
-    }
+        return false;
+    };
 
-    if (!pathToShow && !( pathToShow = (char *)n->getName()))
+    // Children with versions, shown once the whole folder is listed (batches are released as they are listed)
+    std::vector<MegaHandle> versionedChildren;
+    callbacks.mOnChildrenListed = [&](MegaNode &node, const MegaNodeList &children, size_t offset, bool last, const NodeVisitContext &context)
     {
-        pathToShow = (char *)scryptoerror.c_str();
-    }
+        const string pathToShow = getPathToShow(&node, context);
 
-    if (n->getType() != MegaNode::TYPE_FILE)
-    {
-        MegaNodeList* children = api->getChildren(n);
-        if (children)
+        if (!offset)
         {
-            if (depth)
+            if (depth + context.mDepth)
             {
                 OUTSTREAM << endl;
             }
@@ -1834,69 +1983,47 @@ void MegaCmdExecuter::dumpTreeSummary(MegaNode *n, const char *timeFormat, std::
             {
                 OUTSTREAM << pathToShow << ":" << endl;
             }
+        }
 
-            for (int i = 0; i < children->size(); i++)
-            {
-                dumpNodeSummary(children->get(i), timeFormat, clflags, cloptions, humanreadable);
-            }
-
-            if (show_versions)
-            {
-                for (int i = 0; i < children->size(); i++)
-                {
-                    MegaNode *c = children->get(i);
-
-                    MegaNodeList *vers = api->getVersions(c);
-                    if (vers &&  vers->size() > 1)
-                    {
-                        OUTSTREAM << endl << "Versions of " << pathToShow << "/" << c->getName() << ":" << endl;
-
-                        for (int i = 0; i < vers->size(); i++)
-                        {
-                            dumpNodeSummary(vers->get(i), timeFormat, clflags, cloptions, humanreadable);
-                        }
-                    }
-                    delete vers;
-                }
-            }
+        for (int i = 0; i < children.size(); i++)
+        {
+            dumpNodeSummary(children.get(i), timeFormat, clflags, cloptions, humanreadable);
 
-            if (recurse)
+            if (show_versions && api->getNumVersions(children.get(i)) > 1)
             {
-                for (int i = 0; i < children->size(); i++)
-                {
-                    MegaNode *c = children->get(i);
-                    dumpTreeSummary(c, timeFormat, clflags, cloptions, recurse, show_versions, depth + 1, humanreadable);
-                }
+                versionedChildren.push_back(children.get(i)->getHandle());
             }
-            delete children;
         }
-    }
-    else // file
-    {
-        if (!depth)
+
+        if (!last)
         {
+            return;
+        }
 
-            dumpNodeSummary(n, timeFormat, clflags, cloptions, humanreadable);
+        for (MegaHandle h : versionedChildren)
+        {
+            std::unique_ptr<MegaNode> c(api->getNodeByHandle(h));
+            if (!c)
+            {
+                continue;
+            }
 
-            if (show_versions)
+            MegaNodeList *vers = api->getVersions(c.get());
+            if (vers &&  vers->size() > 1)
             {
-                MegaNodeList *vers = api->getVersions(n);
-                if (vers &&  vers->size() > 1)
-                {
-                    OUTSTREAM << endl << "Versions of " << pathToShow << ":" << endl;
+                OUTSTREAM << endl << "Versions of " << pathToShow << "/" << c->getName() << ":" << endl;
 
-                    for (int i = 0; i < vers->size(); i++)
-                    {
-                        string nametoshow = n->getName()+string("#")+SSTR(vers->get(i)->getModificationTime());
-                        dumpNodeSummary(vers->get(i), timeFormat, clflags, cloptions, humanreadable, nametoshow.c_str());
-                    }
+                for (int i = 0; i < vers->size(); i++)
+                {
+                    dumpNodeSummary(vers->get(i), timeFormat, clflags, cloptions, humanreadable);
                 }
-                delete vers;
             }
+            delete vers;
         }
+        versionedChildren.clear();
+    };
 
-    }
-    delete []nodepath;
+    DepthFirstTreeVisitor<MegaApiNodeSource>(source).walk(*n, callbacks);
 }
 
 
@@ -2510,6 +2637,19 @@ bool MegaCmdExecuter::actUponFetchNodes(MegaApi *api, SynchronousRequestListener
 
         LOG_verbose << "ActUponFetchNodes ok. Let's wait for nodes current:";
 
+        if (endStartupPhase("session resume")) // i.e. resuming the session at startup
+        {
+            startStartupPhase("nodes current");
+            if (isFastStartEnabled())
+            {
+                // Let read-only commands be served against the cached nodes meanwhile
+                setCwdToRootIfUnset(api);
+                setStartupReadOnlyMode(true);
+                updateprompt(api);
+                LOG_info << "Cached nodes loaded: read-only commands available while getting up to date with the last changes in your account";
+            }
+        }
+
         auto futureNodesCurrent = sandboxCMD->mNodesCurrentPromise.getFuture();
         bool discardGet = false;
 
@@ -2747,6 +2887,24 @@ int MegaCmdExecuter::actUponLogin(SynchronousRequestListener *srl, int timeout)
     return srl->getError()->getErrorCode();
 }
 
+void MegaCmdExecuter::setCwdToRootIfUnset(MegaApi *api)
+{
+    auto cwdNode = (cwd == UNDEF) ? nullptr : std::unique_ptr<MegaNode>(api->getNodeByHandle(cwd));
+    if (cwd == UNDEF || !cwdNode)
+    {
+        auto rootNode = std::unique_ptr<MegaNode>(api->getRootNode());
+        if (rootNode)
+        {
+            cwd = rootNode->getHandle();
+        }
+        else
+        {
+            LOG_err << "Root node was not found after fetching nodes";
+            sendEvent(StatsManager::MegacmdEvent::ROOT_NODE_NOT_FOUND_AFTER_FETCHING, api);
+        }
+    }
+}
+
 void MegaCmdExecuter::fetchNodes(MegaApi *api, int clientID)
 {
     if (!api) api = this->api;
@@ -2767,20 +2925,7 @@ void MegaCmdExecuter::fetchNodes(MegaApi *api, int clientID)
     //automatic now:
     //api->enableTransferResumption();
 
-    auto cwdNode = (cwd == UNDEF) ? nullptr : std::unique_ptr<MegaNode>(api->getNodeByHandle(cwd));
-    if (cwd == UNDEF || !cwdNode)
-    {
-        auto rootNode = std::unique_ptr<MegaNode>(api->getRootNode());
-        if (rootNode)
-        {
-            cwd = rootNode->getHandle();
-        }
-        else
-        {
-            LOG_err << "Root node was not found after fetching nodes";
-            sendEvent(StatsManager::MegacmdEvent::ROOT_NODE_NOT_FOUND_AFTER_FETCHING, api);
-        }
-    }
+    setCwdToRootIfUnset(api);
 
     setloginInAtStartup(false); //to enable all commands before giving clients the green light!
     informStateListeners("loged:"); // tell the clients login ended, before providing them the first prompt
@@ -2964,6 +3109,9 @@ void MegaCmdExecuter::actUponLogout(MegaApi& api, MegaError* e, bool keptSession
     {
         LOG_verbose << "actUponLogout logout ok";
         cwd = UNDEF;
+        mPathCache.clear();
+        mFolderStatsCache.clear();
+        globalTransferListener->mTransferIndex.clear();
         session.reset();
         mtxSyncMap.lock();
         ConfigurationManager::unloadConfiguration();
@@ -3072,12 +3220,14 @@ void MegaCmdExecuter::discardDelete()
 
 void MegaCmdExecuter::confirmDeleteAll()
 {
+    auto pipeline = makeRequestPipeline(-1, "DELETING");
     while (mNodesToConfirmDelete.size())
     {
         std::unique_ptr<MegaNode> nodeToConfirmDelete = std::move(mNodesToConfirmDelete.front());
         mNodesToConfirmDelete.erase(mNodesToConfirmDelete.begin());
-        doDeleteNode(nodeToConfirmDelete, api);
+        doDeleteNode(nodeToConfirmDelete, api, pipeline.get());
     }
+    waitForRequests(*pipeline, -1, "DELETING");
 
     setprompt(COMMAND);
 }
@@ -3089,7 +3239,7 @@ void MegaCmdExecuter::discardDeleteAll()
 }
 
 
-void MegaCmdExecuter::doDeleteNode(const std::unique_ptr<MegaNode>& nodeToDelete, MegaApi* api)
+void MegaCmdExecuter::doDeleteNode(const std::unique_ptr<MegaNode>& nodeToDelete, MegaApi* api, RequestPipeline *pipeline)
 {
     char* nodePath = api->getNodePath(nodeToDelete.get());
     if (nodePath)
@@ -3101,9 +3251,43 @@ void MegaCmdExecuter::doDeleteNode(const std::unique_ptr<MegaNode>& nodeToDelete
         LOG_warn << "Deleting node whose path could not be found " << nodeToDelete->getName();
     }
 
-    MegaCmdListener* megaCmdListener = new MegaCmdListener(api, nullptr);
+    string msj = "delete node ";
+    if (nodePath)
+    {
+        msj += nodePath;
+    }
+    else
+    {
+        msj += nodeToDelete->getName();
+    }
+    delete []nodePath;
+
     std::unique_ptr<MegaNode> parent(api->getParentNode(nodeToDelete.get()));
-    if (parent && parent->getType() == MegaNode::TYPE_FILE)
+    const bool isVersion = parent && parent->getType() == MegaNode::TYPE_FILE;
+
+    if (pipeline)
+    {
+        pipeline->submit(std::move(msj), [api, &nodeToDelete, isVersion](RequestPipeline::Done done)
+        {
+            auto listener = new MegaCmdListenerFuncExecuter([done](MegaApi*, MegaRequest*, MegaError *e)
+            {
+                done(e ? e->getErrorCode() : MegaError::API_EINTERNAL);
+            }, true);
+
+            if (isVersion)
+            {
+                api->removeVersion(nodeToDelete.get(), listener);
+            }
+            else
+            {
+                api->remove(nodeToDelete.get(), listener);
+            }
+        });
+        return;
+    }
+
+    MegaCmdListener* megaCmdListener = new MegaCmdListener(api, nullptr);
+    if (isVersion)
     {
         api->removeVersion(nodeToDelete.get(), megaCmdListener);
     }
@@ -3113,18 +3297,49 @@ void MegaCmdExecuter::doDeleteNode(const std::unique_ptr<MegaNode>& nodeToDelete
     }
     megaCmdListener->wait();
 
-    string msj = "delete node ";
-    if (nodePath)
+    checkNoErrors(megaCmdListener->getError(), msj);
+    delete megaCmdListener;
+}
+
+void MegaCmdExecuter::setTransfersHistorySize(size_t size)
+{
+    LOG_debug << "Max completed transfers kept in memory set to " << size;
+    globalTransferListener->mCompletedTransfers.setCapacity(size);
+}
+
+std::unique_ptr<RequestPipeline> MegaCmdExecuter::makeRequestPipeline(int clientID, const string &progressTitle, bool sequential)
+{
+    const auto window = sequential ? size_t(1) : static_cast<size_t>(std::max(1, ConfigurationManager::getConfigurationValue("requests_in_flight", 32)));
+
+    // progress is only informed when issuing more than one operation, and not too often
+    auto throttle = std::make_shared<ProgressThrottle>(static_cast<unsigned>(ConfigurationManager::getConfigurationValue("progress_update_rate", 10)));
+    return std::make_unique<RequestPipeline>(window, [clientID, throttle, progressTitle](size_t finished, size_t submitted)
     {
-        msj += nodePath;
+        if (submitted > 1 && throttle->shouldRender(std::chrono::steady_clock::now()))
+        {
+            informProgressUpdate(static_cast<long long>(finished), static_cast<long long>(submitted), clientID, progressTitle);
+        }
+    });
+}
+
+void MegaCmdExecuter::reportRequestFailures(RequestPipeline &pipeline)
+{
+    pipeline.waitAll();
+
+    for (auto &failure : pipeline.takeFailures())
+    {
+        checkNoErrors(failure.mErrorCode, failure.mDescription);
     }
-    else
+}
+
+void MegaCmdExecuter::waitForRequests(RequestPipeline &pipeline, int clientID, const string &progressTitle)
+{
+    reportRequestFailures(pipeline);
+
+    if (pipeline.submitted() > 1)
     {
-        msj += nodeToDelete->getName();
+        informProgressUpdate(PROGRESS_COMPLETE, static_cast<long long>(pipeline.submitted()), clientID, progressTitle);
     }
-    checkNoErrors(megaCmdListener->getError(), msj);
-    delete megaCmdListener;
-    delete []nodePath;
 }
 
 int MegaCmdExecuter::deleteNodeVersions(const std::unique_ptr<MegaNode>& nodeToDelete, MegaApi* api, int force)
@@ -3210,7 +3425,7 @@ int MegaCmdExecuter::deleteNodeVersions(const std::unique_ptr<MegaNode>& nodeToD
  * @param force
  * @return confirmation code
  */
-int MegaCmdExecuter::deleteNode(const std::unique_ptr<MegaNode>& nodeToDelete, MegaApi* api, int recursive, int force)
+int MegaCmdExecuter::deleteNode(const std::unique_ptr<MegaNode>& nodeToDelete, MegaApi* api, int recursive, int force, RequestPipeline *pipeline)
 {
     if (nodeToDelete->getType() != MegaNode::TYPE_FILE && !recursive)
     {
@@ -3256,7 +3471,7 @@ int MegaCmdExecuter::deleteNode(const std::unique_ptr<MegaNode>& nodeToDelete, M
             if (confirmationResponse == MCMDCONFIRM_YES || confirmationResponse == MCMDCONFIRM_ALL)
             {
                 LOG_debug << "confirmation received";
-                doDeleteNode(nodeToDelete, api);
+                doDeleteNode(nodeToDelete, api, pipeline);
             }
             else
             {
@@ -3266,7 +3481,7 @@ int MegaCmdExecuter::deleteNode(const std::unique_ptr<MegaNode>& nodeToDelete, M
         }
         else //force
         {
-            doDeleteNode(nodeToDelete, api);
+            doDeleteNode(nodeToDelete, api, pipeline);
             return MCMDCONFIRM_ALL;
         }
     }
@@ -3882,31 +4097,45 @@ string MegaCmdExecuter::getCurrentPath()
     return toret;
 }
 
-long long MegaCmdExecuter::getVersionsSize(MegaNode *n)
+long long MegaCmdExecuter::getVersionsSize(MegaNode *n, size_t threads)
 {
     long long toret = 0;
 
-    MegaNodeList *versionNodes = api->getVersions(n);
-    if (versionNodes)
+    if (threads > 1)
     {
-        for (int i = 0; i < versionNodes->size(); i++)
-        {
-            MegaNode *versionNode = versionNodes->get(i);
-            toret += api->getSize(versionNode);
-        }
-        delete versionNodes;
+        TreeWalkOptions options;
+        options.mThreads = threads;
+        walkTreeInParallel<long long>(n, std::move(options),
+            [this](const std::shared_ptr<MegaNode> &node)
+            {
+                long long size = 0;
+                std::unique_ptr<MegaNodeList> versionNodes(api->getVersions(node.get()));
+                for (int i = 0; versionNodes && i < versionNodes->size(); i++)
+                {
+                    size += api->getSize(versionNodes->get(i));
+                }
+                return std::make_optional(size);
+            },
+            [&toret](long long &&size)
+            {
+                toret += size;
+                return true;
+            });
+        return toret;
     }
 
-    MegaNodeList *children = api->getChildren(n);
-    if (children)
+    MegaApiNodeSource source{api};
+    DepthFirstTreeVisitor<MegaApiNodeSource>::Callbacks callbacks;
+    callbacks.mOnEnter = [this, &toret](MegaNode &node, const NodeVisitContext &)
     {
-        for (int i = 0; i < children->size(); i++)
+        std::unique_ptr<MegaNodeList> versionNodes(api->getVersions(&node));
+        for (int i = 0; versionNodes && i < versionNodes->size(); i++)
         {
-            MegaNode *child = children->get(i);
-            toret += getVersionsSize(child);
+            toret += api->getSize(versionNodes->get(i));
         }
-        delete children;
-    }
+        return true;
+    };
+    DepthFirstTreeVisitor<MegaApiNodeSource>(source).walk(*n, callbacks);
     return toret;
 }
 
@@ -4323,11 +4552,13 @@ void MegaCmdExecuter::printTransfer(MegaTransfer *transfer, const unsigned int P
 
             delete node;
         }
+        else if (auto completedPath = globalTransferListener->mCompletedTransfers.findDownloadRemotePath(transfer->getNodeHandle(), MegaTransfer::TYPE_DOWNLOAD))
+        {
+            OUTSTREAM << getFixLengthString(*completedPath,PATHSIZE);
+        }
         else
         {
-            globalTransferListener->completedTransfersMutex.lock();
-            OUTSTREAM << getFixLengthString(globalTransferListener->completedPathsByHandle[transfer->getNodeHandle()],PATHSIZE);
-            globalTransferListener->completedTransfersMutex.unlock();
+            OUTSTREAM << getFixLengthString("",PATHSIZE,'-');
         }
 
         OUTSTREAM << " ";
@@ -4431,11 +4662,13 @@ void MegaCmdExecuter::printTransferColumnDisplayer(ColumnDisplayer *cd, MegaTran
 
             delete node;
         }
+        else if (auto completedPath = globalTransferListener->mCompletedTransfers.findDownloadRemotePath(transfer->getNodeHandle(), MegaTransfer::TYPE_DOWNLOAD))
+        {
+            cd->addValue("SOURCEPATH",*completedPath);
+        }
         else
         {
-            globalTransferListener->completedTransfersMutex.lock();
-            cd->addValue("SOURCEPATH",globalTransferListener->completedPathsByHandle[transfer->getNodeHandle()]);
-            globalTransferListener->completedTransfersMutex.unlock();
+            cd->addValue("SOURCEPATH","---------");
         }
 
         //destination
@@ -4507,6 +4740,66 @@ void MegaCmdExecuter::printTransferColumnDisplayer(ColumnDisplayer *cd, MegaTran
     }
 }
 
+void MegaCmdExecuter::printCompletedTransferColumnDisplayer(ColumnDisplayer *cd, CompletedTransfer &transfer, bool printstate)
+{
+    //Direction
+    string type;
+#ifdef _WIN32
+    type += utf16ToUtf8((transfer.mType == MegaTransfer::TYPE_DOWNLOAD)?L"\u25bc":L"\u25b2");
+#else
+    type += (transfer.mType == MegaTransfer::TYPE_DOWNLOAD)?"\u21d3":"\u21d1";
+#endif
+
+    //type (transfer/normal)
+    if (transfer.mSync)
+    {
+#ifdef _WIN32
+        type += utf16ToUtf8(L"\u21a8");
+#else
+        type += "\u21f5";
+#endif
+    }
+    else if (transfer.mBackup)
+    {
+#ifdef _WIN32
+        type += utf16ToUtf8(L"\u2191");
+#else
+        type += "\u23eb";
+#endif
+    }
+
+    cd->addValue("TYPE",type);
+    cd->addValue("TAG", SSTR(transfer.mTag));
+
+    // the remote path is resolved the first time it is shown (and kept, in case the node is gone afterwards)
+    if (transfer.mRemotePath.empty())
+    {
+        transfer.mRemotePath = MegaCmdGlobalTransferListener::resolveRemotePath(api, transfer);
+        if (!transfer.mRemotePath.empty())
+        {
+            globalTransferListener->mCompletedTransfers.setRemotePath(transfer.mId, transfer.mRemotePath);
+        }
+    }
+
+    const string remotePath = transfer.mRemotePath.empty() ? "---------" : transfer.mRemotePath;
+    bool isDownload = transfer.mType == MegaTransfer::TYPE_DOWNLOAD;
+    cd->addValue("SOURCEPATH", isDownload ? remotePath : transfer.mLocalPath);
+    cd->addValue("DESTINYPATH", isDownload ? transfer.mLocalPath : remotePath);
+
+    //progress
+    float percent = !transfer.mTotal ? 0 : float(transfer.mTransferred * 1.0 / transfer.mTotal);
+
+    stringstream osspercent;
+    osspercent << percentageToText(percent) << " of " << getFixLengthString(sizeToText(transfer.mTotal),10,' ',true);
+    cd->addValue("PROGRESS",osspercent.str());
+
+    //state
+    if (printstate)
+    {
+        cd->addValue("STATE",getTransferStateStr(transfer.mState));
+    }
+}
+
 void MegaCmdExecuter::printBackupHeader(const unsigned int PATHSIZE)
 {
     OUTSTREAM << "TAG  " << " ";
@@ -4718,14 +5011,15 @@ void MegaCmdExecuter::printBackup(backup_struct *backupstruct, const char *timeF
     }
 }
 
-void MegaCmdExecuter::doFind(MegaNode* nodeBase, const char *timeFormat, std::map<std::string, int> *clflags, std::map<std::string, std::string> *cloptions, string word, int printfileinfo, string pattern, bool usepcre, m_time_t minTime, m_time_t maxTime, int64_t minSize, int64_t maxSize)
+bool MegaCmdExecuter::doFind(MegaNode* nodeBase, const char *timeFormat, std::map<std::string, int> *clflags, std::map<std::string, std::string> *cloptions, string word, int printfileinfo, const PatternMatcher &matcher, m_time_t minTime, m_time_t maxTime, int64_t minSize, int64_t maxSize, std::optional<size_t> &pendingMatches, size_t threads)
 {
-    struct criteriaNodeVector pnv;
-    pnv.pattern = pattern;
+    if (pendingMatches && !*pendingMatches)
+    {
+        return false;
+    }
 
-    vector<MegaNode *> listOfMatches;
-    pnv.nodesMatching = &listOfMatches;
-    pnv.usepcre = usepcre;
+    struct criteriaNodeVector pnv;
+    pnv.matcher = &matcher;
 
     pnv.minTime = minTime;
     pnv.maxTime = maxTime;
@@ -4734,53 +5028,91 @@ void MegaCmdExecuter::doFind(MegaNode* nodeBase, const char *timeFormat, std::ma
     auto opt = getOption(cloptions, "type", "");
     pnv.mType = opt == "f" ? MegaNode::TYPE_FILE : (opt == "d" ? MegaNode::TYPE_FOLDER : MegaNode::TYPE_UNKNOWN);
 
+    // Matches are printed right away (in the order they are found), instead of after walking the whole tree
+    pnv.onMatch = [&](MegaNode *n)
+    {
+        string pathToShow;
+
+        if ( word.size() > 0 && ( (word.find("/") == 0) || (word.find("..") != string::npos)) )
+        {
+            char * nodepath = api->getNodePath(n);
+            pathToShow = string(nodepath);
+            delete [] nodepath;
+        }
+        else
+        {
+            pathToShow = getDisplayPath("", n);
+        }
+        if (getFlag(clflags, "print-only-handles"))
+        {
+            OUTSTREAM << "H:" << handleToBase64(n->getHandle()) << "" << endl;
+        }
+        else if (printfileinfo)
+        {
+            dumpNode(n, timeFormat, clflags, cloptions, 3, false, 1, pathToShow.c_str());
+        }
+        else
+        {
+            OUTSTREAM << pathToShow;
+
+            if (getFlag(clflags, "show-handles"))
+            {
+                OUTSTREAM << " <H:" << handleToBase64(n->getHandle()) << ">";
+            }
 
-    processTree(nodeBase, includeIfMatchesCriteria, (void*)&pnv);
+            OUTSTREAM << endl;
+        }
+        //notice: some nodes may be dumped twice
 
+        return !pendingMatches || --*pendingMatches;
+    };
 
-    for (std::vector< MegaNode * >::iterator it = listOfMatches.begin(); it != listOfMatches.end(); ++it)
+    // Clients going away (e.g. interrupted) are only noticed from time to time: no need to check on every node
+    constexpr unsigned CLIENT_CHECK_PERIOD = 1024;
+    unsigned checks = 0;
+    bool clientGone = false;
+    auto shouldStop = [&pnv, &checks, &clientGone]()
     {
-        MegaNode * n = *it;
-        if (n)
+        if (!pnv.stop && !(++checks % CLIENT_CHECK_PERIOD) && !OUTSTREAM.isClientConnected())
         {
-            string pathToShow;
+            LOG_verbose << "Client disconnected: stop finding nodes";
+            pnv.stop = clientGone = true;
+        }
+        return pnv.stop;
+    };
 
-            if ( word.size() > 0 && ( (word.find("/") == 0) || (word.find("..") != string::npos)) )
-            {
-                char * nodepath = api->getNodePath(n);
-                pathToShow = string(nodepath);
-                delete [] nodepath;
-            }
-            else
-            {
-                pathToShow = getDisplayPath("", n);
-            }
-            if (getFlag(clflags, "print-only-handles"))
+    if (threads > 1)
+    {
+        // Nodes are checked by the walking threads, while matches are printed from this one (in the same order)
+        TreeWalkOptions options;
+        options.mThreads = threads;
+        options.mOrdered = true;
+        options.mShouldStop = [&clientGone]()
+        {
+            if (!OUTSTREAM.isClientConnected())
             {
-                OUTSTREAM << "H:" << handleToBase64(n->getHandle()) << "" << endl;
+                LOG_verbose << "Client disconnected: stop finding nodes";
+                clientGone = true;
             }
-            else if (printfileinfo)
+            return clientGone;
+        };
+
+        walkTreeInParallel<std::shared_ptr<MegaNode>>(nodeBase, std::move(options),
+            [&pnv](const std::shared_ptr<MegaNode> &n)
             {
-                dumpNode(n, timeFormat, clflags, cloptions, 3, false, 1, pathToShow.c_str());
-            }
-            else
+                return nodeMatchesCriteria(n.get(), &pnv) ? std::make_optional(n) : std::nullopt;
+            },
+            [&pnv](std::shared_ptr<MegaNode> &&n)
             {
-                OUTSTREAM << pathToShow;
-
-                if (getFlag(clflags, "show-handles"))
-                {
-                    OUTSTREAM << " <H:" << handleToBase64(n->getHandle()) << ">";
-                }
-
-                OUTSTREAM << endl;
-            }
-            //notice: some nodes may be dumped twice
-
-            delete n;
-        }
+                return pnv.onMatch(n.get());
+            });
+    }
+    else
+    {
+        processTree(nodeBase, includeIfMatchesCriteria, (void*)&pnv, shouldStop);
     }
 
-    listOfMatches.clear();
+    return !clientGone && (!pendingMatches || *pendingMatches);
 }
 
 string MegaCmdExecuter::getLPWD()
@@ -4798,12 +5130,22 @@ string MegaCmdExecuter::getLPWD()
 }
 
 
-void MegaCmdExecuter::moveToDestination(const std::unique_ptr<MegaNode>& n, string destiny)
+// A listener calling next with the request and its error code once it finishes (deleting itself afterwards)
+static MegaCmdListenerFuncExecuter *continueWith(std::function<void(MegaRequest *request, int errorCode)> next)
+{
+    return new MegaCmdListenerFuncExecuter([next = std::move(next)](MegaApi*, MegaRequest *request, MegaError *e)
+    {
+        next(request, e ? e->getErrorCode() : MegaError::API_EINTERNAL);
+    }, true);
+}
+
+void MegaCmdExecuter::moveToDestination(const std::unique_ptr<MegaNode>& n, string destiny, RequestPipeline &pipeline)
 {
     assert(n);
 
     char* nodepath = api->getNodePath(n.get());
     LOG_debug << "Moving : " << nodepath << " to " << destiny;
+    string description = string("move ") + (nodepath ? nodepath : n->getName()) + " to " + destiny;
     delete []nodepath;
 
     string newname;
@@ -4814,6 +5156,8 @@ void MegaCmdExecuter::moveToDestination(const std::unique_ptr<MegaNode>& n, stri
     // 2. target node exists and is folder - move
     // 3. target node exists and is file - delete and rename (unless same)
     // 4. target path exists, but filename does not - rename
+    // Dependent requests are issued from the callback of the previous one, so as not to block the pipeline
+    MegaApi *api = this->api;
     if (tn)
     {
         if (tn->getHandle() == n->getHandle())
@@ -4832,24 +5176,29 @@ void MegaCmdExecuter::moveToDestination(const std::unique_ptr<MegaNode>& n, stri
                 }
                 else //move and rename!
                 {
-                    MegaCmdListener *megaCmdListener = new MegaCmdListener(nullptr);
-                    api->moveNode(n.get(), tn.get(), megaCmdListener);
-                    megaCmdListener->wait();
-
-                    if (checkNoErrors(megaCmdListener->getError(), "move"))
+                    pipeline.submit(std::move(description), [api, &n, &tn, &newname](RequestPipeline::Done done)
                     {
-                        MegaCmdListener *megaCmdListener = new MegaCmdListener(nullptr);
-                        api->renameNode(n.get(), newname.c_str(), megaCmdListener);
-                        megaCmdListener->wait();
+                        api->moveNode(n.get(), tn.get(), continueWith([api, handle = n->getHandle(), newname, done](MegaRequest*, int errorCode)
+                        {
+                            if (errorCode != MegaError::API_OK)
+                            {
+                                LOG_debug << "Won't rename, since move failed: " << errorCode;
+                                done(errorCode);
+                                return;
+                            }
 
-                        checkNoErrors(megaCmdListener->getError(), "rename");
-                        delete megaCmdListener;
-                    }
-                    else
-                    {
-                        LOG_debug << "Won't rename, since move failed " << n->getName() << " to " << tn->getName() << " : " << megaCmdListener->getError()->getErrorCode();
-                    }
-                    delete megaCmdListener;
+                            std::unique_ptr<MegaNode> moved(api->getNodeByHandle(handle));
+                            if (!moved)
+                            {
+                                done(MegaError::API_ENOENT);
+                                return;
+                            }
+                            api->renameNode(moved.get(), newname.c_str(), continueWith([done](MegaRequest*, int errorCode)
+                            {
+                                done(errorCode);
+                            }));
+                        }));
+                    });
                 }
             }
             else //target found
@@ -4860,45 +5209,45 @@ void MegaCmdExecuter::moveToDestination(const std::unique_ptr<MegaNode>& n, stri
                     std::unique_ptr<MegaNode> tnParentNode(api->getNodeByHandle(tn->getParentHandle()));
                     if (tnParentNode)
                     {
-                        //move into the parent of target node
-                        MegaCmdListener *megaCmdListener = new MegaCmdListener(nullptr);
-                        std::unique_ptr<MegaNode> parentNode(api->getNodeByHandle(tn->getParentHandle()));
-                        api->moveNode(n.get(), parentNode.get(), megaCmdListener);
-                        megaCmdListener->wait();
-
-                        if (checkNoErrors(megaCmdListener->getError(), "move node"))
+                        // move into the parent of target node, then remove (replaced) target node and rename moved node with the new name.
+                        // A failure removing or renaming does not stop the rest, but is the one reported
+                        const bool rename = strcmp(tn->getName(), n->getName()) != 0;
+                        pipeline.submit(std::move(description), [api, &n, &tn, &tnParentNode, rename](RequestPipeline::Done done)
                         {
-                            const char* name_to_replace = tn->getName();
-
-                            //remove (replaced) target node
-                            if (n.get() != tn.get()) //just in case moving to same location
+                            auto renameMoved = [api, handle = n->getHandle(), nameToReplace = string(tn->getName()), rename, done](int previousError)
                             {
-                                MegaCmdListener *megaCmdListener = new MegaCmdListener(NULL);
-                                api->remove(tn.get(), megaCmdListener); //remove target node
-                                megaCmdListener->wait();
-
-                                if (!checkNoErrors(megaCmdListener->getError(), "remove target node"))
+                                std::unique_ptr<MegaNode> moved(rename ? api->getNodeByHandle(handle) : nullptr);
+                                if (!moved)
                                 {
-                                    LOG_err << "Couldnt move " << n->getName() << " to " << tn->getName() << " : " << megaCmdListener->getError()->getErrorCode();
+                                    done(previousError ? previousError : (rename ? MegaError::API_ENOENT : MegaError::API_OK));
+                                    return;
                                 }
-                                delete megaCmdListener;
-                            }
+                                api->renameNode(moved.get(), nameToReplace.c_str(), continueWith([done, previousError](MegaRequest*, int errorCode)
+                                {
+                                    done(previousError ? previousError : errorCode);
+                                }));
+                            };
 
-                            // rename moved node with the new name
-                            if (strcmp(name_to_replace, n->getName()))
+                            api->moveNode(n.get(), tnParentNode.get(), continueWith([api, targetHandle = tn->getHandle(), renameMoved, done](MegaRequest*, int errorCode)
                             {
-                                MegaCmdListener *megaCmdListener = new MegaCmdListener(NULL);
-                                api->renameNode(n.get(), name_to_replace, megaCmdListener);
-                                megaCmdListener->wait();
+                                if (errorCode != MegaError::API_OK)
+                                {
+                                    done(errorCode);
+                                    return;
+                                }
 
-                                if (!checkNoErrors(megaCmdListener->getError(), "rename moved node"))
+                                std::unique_ptr<MegaNode> replaced(api->getNodeByHandle(targetHandle));
+                                if (!replaced)
                                 {
-                                    LOG_err << "Failed to rename moved node: " << megaCmdListener->getError()->getErrorString();
+                                    renameMoved(MegaError::API_OK);
+                                    return;
                                 }
-                                delete megaCmdListener;
-                            }
-                        }
-                        delete megaCmdListener;
+                                api->remove(replaced.get(), continueWith([renameMoved](MegaRequest*, int errorCode)
+                                {
+                                    renameMoved(errorCode);
+                                }));
+                            }));
+                        });
                     }
                     else
                     {
@@ -4908,12 +5257,13 @@ void MegaCmdExecuter::moveToDestination(const std::unique_ptr<MegaNode>& n, stri
                 }
                 else // target is a folder
                 {
-                    MegaCmdListener *megaCmdListener = new MegaCmdListener(nullptr);
-                    api->moveNode(n.get(), tn.get(), megaCmdListener);
-                    megaCmdListener->wait();
-
-                    checkNoErrors(megaCmdListener->getError(), "move node");
-                    delete megaCmdListener;
+                    pipeline.submit(std::move(description), [api, &n, &tn](RequestPipeline::Done done)
+                    {
+                        api->moveNode(n.get(), tn.get(), continueWith([done](MegaRequest*, int errorCode)
+                        {
+                            done(errorCode);
+                        }));
+                    });
                 }
             }
         }
@@ -4952,8 +5302,18 @@ std::string MegaCmdExecuter::getNodePathString(MegaNode *n)
     return toret;
 }
 
-void MegaCmdExecuter::copyNode(MegaNode *n, string destiny, MegaNode * tn, string &targetuser, string &newname)
+void MegaCmdExecuter::copyNode(MegaNode *n, string destiny, MegaNode * tn, string &targetuser, string &newname, RequestPipeline &pipeline)
 {
+    // Dependent requests are issued from the callback of the previous one, so as not to block the pipeline
+    MegaApi *api = this->api;
+    auto finish = [](RequestPipeline::Done done)
+    {
+        return continueWith([done = std::move(done)](MegaRequest*, int errorCode)
+        {
+            done(errorCode);
+        });
+    };
+
     if (tn)
     {
         if (tn->getHandle() == n->getHandle())
@@ -4968,37 +5328,34 @@ void MegaCmdExecuter::copyNode(MegaNode *n, string destiny, MegaNode * tn, strin
                 {
                     LOG_debug << "copy with new name: \"" << getNodePathString(n) << "\" to \"" << destiny << "\" newname=" << newname;
                     //copy with new name
-                    MegaCmdListener *megaCmdListener = new MegaCmdListener(NULL);
-                    api->copyNode(n, tn, newname.c_str(), megaCmdListener); //only works for files
-                    megaCmdListener->wait();
-                    checkNoErrors(megaCmdListener->getError(), "copy node");
-                    delete megaCmdListener;
+                    pipeline.submit("copy " + getNodePathString(n) + " to " + destiny, [api, n, tn, &newname, &finish](RequestPipeline::Done done)
+                    {
+                        api->copyNode(n, tn, newname.c_str(), finish(std::move(done))); //only works for files
+                    });
                 }
                 else //copy & rename
                 {
                     LOG_debug << "copy & rename: \"" << getNodePathString(n) << "\" to \"" << destiny << "\"";
-                    //copy with new name
-                    MegaCmdListener *megaCmdListener = new MegaCmdListener(NULL);
-                    api->copyNode(n, tn, megaCmdListener);
-                    megaCmdListener->wait();
-                    if (checkNoErrors(megaCmdListener->getError(), "copy node"))
+                    pipeline.submit("copy " + getNodePathString(n) + " to " + destiny, [api, n, tn, &newname, &finish](RequestPipeline::Done done)
                     {
-                        MegaNode * newNode = api->getNodeByHandle(megaCmdListener->getRequest()->getNodeHandle());
-                        if (newNode)
+                        api->copyNode(n, tn, continueWith([api, newname, done, finish](MegaRequest *request, int errorCode)
                         {
-                            MegaCmdListener *megaCmdListener = new MegaCmdListener(NULL);
-                            api->renameNode(newNode, newname.c_str(), megaCmdListener);
-                            megaCmdListener->wait();
-                            checkNoErrors(megaCmdListener->getError(), "rename new node");
-                            delete megaCmdListener;
-                            delete newNode;
-                        }
-                        else
-                        {
-                            LOG_err << " Couldn't find new node created upon cp";
-                        }
-                    }
-                    delete megaCmdListener;
+                            if (errorCode != MegaError::API_OK)
+                            {
+                                done(errorCode);
+                                return;
+                            }
+
+                            std::unique_ptr<MegaNode> newNode(api->getNodeByHandle(request->getNodeHandle()));
+                            if (!newNode)
+                            {
+                                LOG_debug << "Couldn't find new node created upon cp";
+                                done(MegaError::API_ENOENT);
+                                return;
+                            }
+                            api->renameNode(newNode.get(), newname.c_str(), finish(done));
+                        }));
+                    });
                 }
             }
             else
@@ -5010,30 +5367,24 @@ void MegaCmdExecuter::copyNode(MegaNode *n, string destiny, MegaNode * tn, strin
                         LOG_debug << "overwriding target: \"" << getNodePathString(n) << "\" to \"" << destiny << "\"";
 
                         // overwrite target if source and target are files
-                        MegaNode *tnParentNode = api->getNodeByHandle(tn->getParentHandle());
+                        std::unique_ptr<MegaNode> tnParentNode(api->getNodeByHandle(tn->getParentHandle()));
                         if (tnParentNode) // (there should never be any orphaned filenodes)
                         {
-                            const char* name_to_replace = tn->getName();
-                            //copy with new name
-                            MegaCmdListener *megaCmdListener = new MegaCmdListener(NULL);
-                            api->copyNode(n, tnParentNode, name_to_replace, megaCmdListener);
-                            megaCmdListener->wait();
-                            if (checkNoErrors(megaCmdListener->getError(), "copy with new name") )
+                            //copy with new name, then remove target node
+                            pipeline.submit("copy " + getNodePathString(n) + " to " + destiny, [api, n, tn, &tnParentNode, &finish](RequestPipeline::Done done)
                             {
-                                MegaHandle newNodeHandle = megaCmdListener->getRequest()->getNodeHandle();
-                                delete megaCmdListener;
-                                delete tnParentNode;
-
-                                //remove target node
-                                if (tn->getHandle() != newNodeHandle )//&& newNodeHandle != n->getHandle())
+                                api->copyNode(n, tnParentNode.get(), tn->getName(), continueWith([api, targetHandle = tn->getHandle(), done, finish](MegaRequest *request, int errorCode)
                                 {
-                                    megaCmdListener = new MegaCmdListener(NULL);
-                                    api->remove(tn, megaCmdListener);
-                                    megaCmdListener->wait();
-                                    checkNoErrors(megaCmdListener->getError(), "delete target node");
-                                    delete megaCmdListener;
-                                }
-                            }
+                                    std::unique_ptr<MegaNode> replaced(errorCode == MegaError::API_OK && request->getNodeHandle() != targetHandle
+                                                                       ? api->getNodeByHandle(targetHandle) : nullptr);
+                                    if (!replaced)
+                                    {
+                                        done(errorCode);
+                                        return;
+                                    }
+                                    api->remove(replaced.get(), finish(done));
+                                }));
+                            });
                         }
                         else
                         {
@@ -5052,11 +5403,10 @@ void MegaCmdExecuter::copyNode(MegaNode *n, string destiny, MegaNode * tn, strin
                 {
                     LOG_debug << "Copying into folder: \"" << getNodePathString(n) << "\" to \"" << destiny << "\"";
 
-                    MegaCmdListener *megaCmdListener = new MegaCmdListener(NULL);
-                    api->copyNode(n, tn, megaCmdListener);
-                    megaCmdListener->wait();
-                    checkNoErrors(megaCmdListener->getError(), "copy node");
-                    delete megaCmdListener;
+                    pipeline.submit("copy " + getNodePathString(n) + " to " + destiny, [api, n, tn, &finish](RequestPipeline::Done done)
+                    {
+                        api->copyNode(n, tn, finish(std::move(done)));
+                    });
                 }
             }
         }
@@ -5065,11 +5415,10 @@ void MegaCmdExecuter::copyNode(MegaNode *n, string destiny, MegaNode * tn, strin
     {
         LOG_debug << "Sending to user: \"" << getNodePathString(n) << "\" to \"" << targetuser << "\"";
 
-        MegaCmdListener *megaCmdListener = new MegaCmdListener(NULL);
-        api->sendFileToUser(n,targetuser.c_str(),megaCmdListener);
-        megaCmdListener->wait();
-        checkNoErrors(megaCmdListener->getError(), "send file to user");
-        delete megaCmdListener;
+        pipeline.submit("send file to user " + targetuser, [api, n, &targetuser, &finish](RequestPipeline::Done done)
+        {
+            api->sendFileToUser(n, targetuser.c_str(), finish(std::move(done)));
+        });
     }
     else
     {
@@ -5378,7 +5727,28 @@ void MegaCmdExecuter::addFtpLocation(MegaNode *n, bool firstone, string name)
 #endif
 
 
-void MegaCmdExecuter::catFile(MegaNode *n)
+namespace {
+// A range of a file being streamed by cat
+struct CatSegment
+{
+    long long mStart;
+    long long mEnd;
+    StreamBuffer mBuffer;
+    std::unique_ptr<MegaCmdCatTransferListener> mListener;
+
+    CatSegment(long long start, long long end, size_t capacity) :
+        mStart(start),
+        mEnd(end),
+        mBuffer(capacity)
+    {
+    }
+
+    // where the streaming is (to be) at
+    long long next() const { return mStart + static_cast<long long>(mBuffer.totalWritten()); }
+};
+}
+
+void MegaCmdExecuter::catFile(MegaNode *n, long long offset, long long length, size_t streams)
 {
     if (n->getType() != MegaNode::TYPE_FILE)
     {
@@ -5387,25 +5757,116 @@ void MegaCmdExecuter::catFile(MegaNode *n)
         return;
     }
 
-    long long nsize = api->getSize(n);
-    if (!nsize)
+    const CatPlan plan = planCat(api->getSize(n), offset, length, streams);
+    if (plan.empty())
     {
         return;
     }
-    long long end = nsize;
-    long long start = 0;
 
-    MegaCmdCatTransferListener *mcctl = new MegaCmdCatTransferListener(&OUTSTREAM, api, sandboxCMD);
-    api->startStreaming(n, start, end-start, mcctl);
-    mcctl->wait();
-    if (checkNoErrors(mcctl->getError(), "cat streaming from " +SSTR(start) + " to " + SSTR(end) ))
+    // The SDK thread hands the data to a buffer, and this thread sends it to the client. When the client
+    // is slower than the transfer, the buffer fills up and the streaming is stopped, to be restarted from
+    // where it was as soon as the client has caught up (with half of the buffer still to be sent).
+    // With several streams, memory is bound by streams * segment size (see CatPlan)
+    std::deque<std::unique_ptr<CatSegment>> segments;
+    size_t nextSegment = 0;
+
+    auto startStreaming = [this, n](CatSegment &segment)
+    {
+        segment.mListener.reset(new MegaCmdCatTransferListener(&segment.mBuffer, api, sandboxCMD));
+        segment.mBuffer.reopenInput();
+        api->startStreaming(n, segment.next(), segment.mEnd - segment.next(), segment.mListener.get());
+    };
+
+    auto startSegments = [&]()
+    {
+        while (segments.size() < plan.mStreams && nextSegment < plan.segmentCount())
+        {
+            const auto [segmentStart, segmentEnd] = plan.segment(nextSegment++);
+            segments.push_back(std::make_unique<CatSegment>(segmentStart, segmentEnd, plan.mBufferCapacity));
+            startStreaming(*segments.back());
+        }
+    };
+
+    // Gives up on the segments left (the first one has finished already)
+    auto abandonSegments = [&segments]()
+    {
+        segments.pop_front();
+        for (auto &segment : segments)
+        {
+            segment->mBuffer.abort();
+        }
+        for (auto &segment : segments)
+        {
+            segment->mListener->wait();
+        }
+        segments.clear();
+    };
+
+    startSegments();
+
+    bool completed = true;
+    unsigned pauses = 0;
+    size_t maxInFlight = 0;
+    std::vector<std::string> chunks;
+    while (!segments.empty())
+    {
+        CatSegment &segment = *segments.front();
+        if (segment.mBuffer.read(chunks))
+        {
+            for (auto &chunk : chunks)
+            {
+                if (!OUTSTREAM.isClientConnected())
+                {
+                    LOG_verbose << " CatTransfer listener, cancelled transfer due to client disconnected";
+                    segment.mBuffer.abort();
+                    break;
+                }
+                OUTSTREAM << BinaryStringView(chunk.data(), chunk.size());
+            }
+            segment.mBuffer.recycle(chunks);
+
+            if (segment.mBuffer.canResume() && segment.next() < segment.mEnd)
+            {
+                segment.mListener->wait(); // (its input is closed already: it is finishing)
+                LOG_verbose << "Resuming cat streaming from " << segment.next();
+                startStreaming(segment);
+            }
+            continue;
+        }
+
+        segment.mListener->wait(); // the input is closed once the transfer finishes
+        const bool aborted = segment.mBuffer.isAborted();
+        if (!aborted && segment.mBuffer.isPaused() && segment.next() < segment.mEnd)
+        {
+            LOG_verbose << "Resuming cat streaming from " << segment.next();
+            startStreaming(segment);
+            continue;
+        }
+
+        if (aborted || segment.next() < segment.mEnd)
+        {
+            if (!aborted)
+            {
+                checkNoErrors(segment.mListener->getError(), "cat streaming from " + SSTR(segment.next()) + " to " + SSTR(segment.mEnd));
+            }
+            abandonSegments();
+            completed = false;
+            break;
+        }
+
+        const auto stats = segment.mBuffer.getStats();
+        pauses += stats.mPauses;
+        maxInFlight = std::max(maxInFlight, stats.mMaxInFlight);
+        segments.pop_front();
+        startSegments();
+    }
+
+    if (completed)
     {
         char * npath = api->getNodePath(n);
-        LOG_verbose << "Streamed: " << npath << " from " << start << " to " << end;
+        LOG_verbose << "Streamed: " << npath << " from " << plan.mStart << " to " << plan.mEnd << " (" << plan.mStreams << " streams, paused " << pauses << " times, up to " << maxInFlight << " bytes in memory per stream)";
         delete []npath;
     }
-
-    delete mcctl;
 }
 
 void MegaCmdExecuter::printInfoFile(MegaNode *n, bool &firstone, int PATHSIZE)
@@ -5601,6 +6062,80 @@ bool checkExactlyNArgs(const vector<string> &words, size_t n)
     return true;
 }
 
+void MegaCmdExecuter::printServerStats()
+{
+    if (auto poolStats = getPetitionsPoolStats())
+    {
+        OUTSTREAM << "Command processing threads:" << endl;
+        OUTSTREAM << "  threads (busy/created/max): " << poolStats->mBusyWorkers << "/" << poolStats->mWorkers << "/" << poolStats->mMaxWorkers << endl;
+        OUTSTREAM << "  queued commands (current/max): " << poolStats->mQueueDepth << "/" << poolStats->mMaxQueueDepth << endl;
+        OUTSTREAM << "  processed commands: " << poolStats->mProcessed << endl;
+        OUTSTREAM << "  queue wait (avg/max): " << static_cast<long long>(poolStats->mAvgQueueWait.count()) << "/" << static_cast<long long>(poolStats->mMaxQueueWait.count()) << " microseconds" << endl;
+    }
+
+    OUTSTREAM << "Startup phases" << (isFastStartEnabled() ? " (fast start)" : "") << ":" << endl;
+    for (const auto &phase : getStartupPhases())
+    {
+        using std::chrono::duration_cast;
+        using std::chrono::milliseconds;
+        OUTSTREAM << "  " << phase.mName << ": " << duration_cast<milliseconds>(phase.mDuration).count() << " ms"
+                  << (phase.mOngoing ? " so far" : "") << " (from " << duration_cast<milliseconds>(phase.mStart).count() << " ms)" << endl;
+    }
+
+    if (auto apiFoldersStats = getApiFoldersPoolStats())
+    {
+        OUTSTREAM << "Auxiliary SDK instances for folder links:" << endl;
+        OUTSTREAM << "  instances (busy/created/max): " << apiFoldersStats->mBusyInstances << "/" << apiFoldersStats->mInstances << "/" << apiFoldersStats->mMaxInstances << endl;
+        OUTSTREAM << "  max busy instances: " << apiFoldersStats->mMaxBusyInstances << endl;
+        OUTSTREAM << "  instances created/destroyed so far: " << apiFoldersStats->mCreated << "/" << apiFoldersStats->mDestroyed << endl;
+        OUTSTREAM << "  uses (total/waited): " << apiFoldersStats->mAcquisitions << "/" << apiFoldersStats->mWaits << endl;
+        OUTSTREAM << "  max wait: " << static_cast<long long>(apiFoldersStats->mMaxWait.count()) << " microseconds" << endl;
+    }
+
+    const PathCacheStats pathCacheStats = mPathCache.getStats();
+    OUTSTREAM << "Path resolution cache:" << endl;
+    OUTSTREAM << "  entries (current/max): " << pathCacheStats.mEntries << "/" << pathCacheStats.mCapacity << endl;
+    OUTSTREAM << "  lookups (hits/misses): " << pathCacheStats.mHits << "/" << pathCacheStats.mMisses << endl;
+    OUTSTREAM << "  invalidations: " << pathCacheStats.mInvalidations << endl;
+
+    const FolderStatsCacheStats folderStatsCacheStats = mFolderStatsCache.getStats();
+    OUTSTREAM << "Sync folder statistics cache:" << endl;
+    OUTSTREAM << "  entries: " << folderStatsCacheStats.mEntries << endl;
+    OUTSTREAM << "  lookups (hits/misses): " << folderStatsCacheStats.mHits << "/" << folderStatsCacheStats.mMisses << endl;
+    OUTSTREAM << "  invalidations: " << folderStatsCacheStats.mInvalidations << endl;
+}
+
+void MegaCmdExecuter::invalidateFolderStats(MegaNodeList* nodes)
+{
+    if (mFolderStatsCache.empty())
+    {
+        return;
+    }
+
+    if (!nodes)
+    {
+        mFolderStatsCache.clear();
+        return;
+    }
+
+    // (the folders containing them are looked up when the cache is next read, not on the SDK thread)
+    std::vector<FolderStatsCache::Handle> changed;
+    changed.reserve(2 * static_cast<size_t>(nodes->size()));
+    for (int i = 0; i < nodes->size(); i++)
+    {
+        MegaNode *n = nodes->get(i);
+        if (n->hasChanged(MegaNode::CHANGE_TYPE_PARENT))
+        {
+            mFolderStatsCache.clear(); // the folders it was in are unknown
+            return;
+        }
+        changed.push_back(n->getHandle());
+        changed.push_back(n->getParentHandle()); // (removed nodes are no longer found)
+    }
+
+    mFolderStatsCache.nodesChanged(changed);
+}
+
 void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clflags, map<string, string> *cloptions)
 {
     if (words[0] == "ls")
@@ -5790,12 +6325,34 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
         }
 
 
+        PatternMatcher matcher(pattern, getFlag(clflags,"use-pcre"));
+
+        size_t threads = 1;
+        if (!getTreeWalkThreads(cloptions, threads))
+        {
+            return;
+        }
+
+        std::optional<size_t> pendingMatches;
+        if (cloptions->count("limit"))
+        {
+            auto limit = getIntOptional(*cloptions, "limit");
+            if (!limit || *limit <= 0)
+            {
+                setCurrentThreadOutCode(MCMD_EARGS);
+                LOG_err << "Invalid limit " << getOption(cloptions, "limit", "");
+                return;
+            }
+            pendingMatches = static_cast<size_t>(*limit);
+        }
+
         if (words.size() <= 1)
         {
             std::unique_ptr<MegaNode> n(api->getNodeByHandle(cwd));
-            doFind(n.get(), getTimeFormatFromSTR(getOption(cloptions, "time-format","RFC2822")), clflags, cloptions, "", printfileinfo, pattern, getFlag(clflags,"use-pcre"), minTime, maxTime, minSize, maxSize);
+            doFind(n.get(), getTimeFormatFromSTR(getOption(cloptions, "time-format","RFC2822")), clflags, cloptions, "", printfileinfo, matcher, minTime, maxTime, minSize, maxSize, pendingMatches, threads);
         }
-        for (int i = 1; i < (int)words.size(); i++)
+        bool keepFinding = true;
+        for (int i = 1; i < (int)words.size() && keepFinding; i++)
         {
             if (isRegExp(words[i]))
             {
@@ -5805,7 +6362,11 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                     for (const auto& node : nodesToFind)
                     {
                         assert(node);
-                        doFind(node.get(), getTimeFormatFromSTR(getOption(cloptions, "time-format","RFC2822")), clflags, cloptions, words[i], printfileinfo, pattern, getFlag(clflags,"use-pcre"), minTime, maxTime, minSize, maxSize);
+                        keepFinding = doFind(node.get(), getTimeFormatFromSTR(getOption(cloptions, "time-format","RFC2822")), clflags, cloptions, words[i], printfileinfo, matcher, minTime, maxTime, minSize, maxSize, pendingMatches, threads);
+                        if (!keepFinding)
+                        {
+                            break;
+                        }
                     }
                 }
                 else
@@ -5824,7 +6385,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                 }
                 else
                 {
-                    doFind(n.get(), getTimeFormatFromSTR(getOption(cloptions, "time-format","RFC2822")), clflags, cloptions, words[i], printfileinfo, pattern, getFlag(clflags,"use-pcre"), minTime, maxTime, minSize, maxSize);
+                    keepFinding = doFind(n.get(), getTimeFormatFromSTR(getOption(cloptions, "time-format","RFC2822")), clflags, cloptions, words[i], printfileinfo, matcher, minTime, maxTime, minSize, maxSize, pendingMatches, threads);
                 }
             }
         }
@@ -5925,6 +6486,10 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
             bool force = getFlag(clflags, "f");
             bool none = false;
 
+            // deletions are issued without waiting for the previous ones to finish (up to a window)
+            int clientID = getintOption(cloptions, "clientID", -1);
+            auto pipeline = makeRequestPipeline(clientID, "DELETING");
+
             for (unsigned int i = 1; i < words.size(); i++)
             {
                 unescapeifRequired(words[i]);
@@ -5941,7 +6506,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                     {
                         assert(node);
 
-                        int confirmationCode = deleteNode(node, api, getFlag(clflags, "r"), force);
+                        int confirmationCode = deleteNode(node, api, getFlag(clflags, "r"), force, pipeline.get());
                         if (confirmationCode == MCMDCONFIRM_ALL)
                         {
                             force = true;
@@ -5962,7 +6527,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                     }
                     else
                     {
-                        int confirmationCode = deleteNode(nodeToDelete, api, getFlag(clflags, "r"), force);
+                        int confirmationCode = deleteNode(nodeToDelete, api, getFlag(clflags, "r"), force, pipeline.get());
                         if (confirmationCode == MCMDCONFIRM_ALL)
                         {
                             force = true;
@@ -5974,6 +6539,8 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                     }
                 }
             }
+
+            waitForRequests(*pipeline, clientID, "DELETING");
         }
         else
         {
@@ -6003,8 +6570,14 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                 return;
             }
 
+            // sources are resolved one argument at a time, once the previous ones were moved.
+            // Unless moving into an existing folder, each move may change what the destination is (e.g. renaming
+            // onto it): then they go one at a time, each resolving the destination once the previous one finished
+            const bool sequential = !isValidFolder(destiny);
+            auto pipeline = makeRequestPipeline(getintOption(cloptions, "clientID", -1), "MOVING", sequential);
             for (unsigned int i=1;i<(words.size()-1);i++)
             {
+                reportRequestFailures(*pipeline);
                 string source = words[i];
                 unescapeifRequired(source);
 
@@ -6030,7 +6603,11 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                         for (const auto& node : nodesToList)
                         {
                             assert(node);
-                            moveToDestination(node, destiny);
+                            if (sequential)
+                            {
+                                reportRequestFailures(*pipeline);
+                            }
+                            moveToDestination(node, destiny, *pipeline);
                         }
                     }
                 }
@@ -6039,7 +6616,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                     std::unique_ptr<MegaNode> n = nodebypath(source.c_str());
                     if (n)
                     {
-                        moveToDestination(n, destiny);
+                        moveToDestination(n, destiny, *pipeline);
                     }
                     else
                     {
@@ -6048,6 +6625,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                     }
                 }
             }
+            waitForRequests(*pipeline, getintOption(cloptions, "clientID", -1), "MOVING");
 
         }
         else
@@ -6080,8 +6658,11 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                 return;
             }
 
+            // sources are resolved one argument at a time, once the previous ones were copied
+            auto pipeline = makeRequestPipeline(getintOption(cloptions, "clientID", -1), "COPYING");
             for (unsigned int i=1;i<(words.size()-1);i++)
             {
+                reportRequestFailures(*pipeline);
                 string source = words[i];
 
                 if (isRegExp(source))
@@ -6106,7 +6687,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                         for (const auto& n : nodesToCopy)
                         {
                             assert(n);
-                            copyNode(n.get(), destiny, tn.get(), targetuser, newname);
+                            copyNode(n.get(), destiny, tn.get(), targetuser, newname, *pipeline);
                         }
                     }
                 }
@@ -6115,7 +6696,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                     std::unique_ptr<MegaNode> n = nodebypath(source.c_str());
                     if (n)
                     {
-                        copyNode(n.get(), destiny, tn.get(), targetuser, newname);
+                        copyNode(n.get(), destiny, tn.get(), targetuser, newname, *pipeline);
                     }
                     else
                     {
@@ -6124,6 +6705,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                     }
                 }
             }
+            waitForRequests(*pipeline, getintOption(cloptions, "clientID", -1), "COPYING");
         }
         else
         {
@@ -6164,6 +6746,12 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
         bool show_versions_size = getFlag(clflags, "versions");
         bool firstone = true;
 
+        size_t threads = 1;
+        if (!getTreeWalkThreads(cloptions, threads))
+        {
+            return;
+        }
+
         for (unsigned int i = 1; i < words.size(); i++)
         {
             unescapeifRequired(words[i]);
@@ -6191,7 +6779,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                     OUTSTREAM << getFixLengthString(dpath+":",PATHSIZE) << getFixLengthString(sizeToText(currentSize, true, humanreadable), 12, ' ', true);
                     if (show_versions_size)
                     {
-                        long long sizeWithVersions = getVersionsSize(n.get());
+                        long long sizeWithVersions = getVersionsSize(n.get(), threads);
                         OUTSTREAM << getFixLengthString(sizeToText(sizeWithVersions, true, humanreadable), 12, ' ', true);
                         totalVersionsSize += sizeWithVersions;
                     }
@@ -6228,7 +6816,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                     OUTSTREAM << getFixLengthString(dpath+":",PATHSIZE) << getFixLengthString(sizeToText(currentSize, true, humanreadable), 12, ' ', true);
                     if (show_versions_size)
                     {
-                        long long sizeWithVersions = getVersionsSize(n.get());
+                        long long sizeWithVersions = getVersionsSize(n.get(), threads);
                         OUTSTREAM << getFixLengthString(sizeToText(sizeWithVersions, true, humanreadable), 12, ' ', true);
                         totalVersionsSize += sizeWithVersions;
                     }
@@ -6258,13 +6846,24 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
     }
     else if (words[0] == "cat")
     {
-        if (words.size() < 2)
+        auto offset = getLongLongOptional(*cloptions, "offset");
+        auto length = getLongLongOptional(*cloptions, "length");
+        auto streams = getIntOptional(*cloptions, "streams");
+        if (words.size() < 2
+                || (cloptions->count("offset") && !offset)
+                || (cloptions->count("length") && (!length || *length < 0))
+                || (cloptions->count("streams") && (!streams || *streams < 1 || *streams > static_cast<int>(MAX_CAT_STREAMS))))
         {
             setCurrentThreadOutCode(MCMD_EARGS);
             LOG_err << "      " << getUsageStr("cat");
             return;
         }
 
+        auto catNode = [&](MegaNode *n)
+        {
+            catFile(n, offset.value_or(0), length.value_or(-1), static_cast<size_t>(streams.value_or(1)));
+        };
+
         for (int i = 1; i < (int)words.size(); i++)
         {
             if (isPublicLink(words[i]))
@@ -6304,7 +6903,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                             MegaNode *n = megaCmdListener->getRequest()->getPublicMegaNode();
                             if (n)
                             {
-                                catFile(n);
+                                catNode(n);
                                 delete n;
                             }
                         }
@@ -6338,7 +6937,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                     for (const auto& n : nodes)
                     {
                         assert(n);
-                        catFile(n.get());
+                        catNode(n.get());
                     }
                 }
                 else
@@ -6346,7 +6945,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                     std::unique_ptr<MegaNode> n = nodebypath(words[i].c_str());
                     if (n)
                     {
-                        catFile(n.get());
+                        catNode(n.get());
                     }
                     else
                     {
@@ -7866,7 +8465,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                 auto syncIssues = mSyncIssuesManager.getSyncIssues();
 
                 ColumnDisplayer cd(clflags, cloptions);
-                SyncCommand::printSync(*api, cd, showHandles, *sync, syncIssues);
+                SyncCommand::printSync(*api, cd, showHandles, *sync, syncIssues, mFolderStatsCache);
 
                 OUTSTREAM << cd.str();
             }
@@ -7878,7 +8477,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
             assert(syncList);
 
             ColumnDisplayer cd(clflags, cloptions);
-            SyncCommand::printSyncList(*api, cd, showHandles, *syncList, syncIssues);
+            SyncCommand::printSyncList(*api, cd, showHandles, *syncList, syncIssues, mFolderStatsCache);
 
             OUTSTREAM << cd.str();
 
@@ -9268,6 +9867,12 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
     }
     else if (words[0] == "debug")
     {
+        if (getFlag(clflags, "stats"))
+        {
+            printServerStats();
+            return;
+        }
+
         vector<string> newcom;
         newcom.push_back("log");
         newcom.push_back("5");
@@ -10593,39 +11198,18 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
             return;
         }
 
-        //show transfers
-        std::unique_ptr<MegaTransferData> transferdata(api->getTransferData());
+        //show transfers: they are taken from the index of ongoing transfers, not to go through all of them
+        const TransferIndex &transferIndex = globalTransferListener->mTransferIndex;
+        const TransferDirectionStats downloadStats = transferIndex.getStats(false);
+        const TransferDirectionStats uploadStats = transferIndex.getStats(true);
 
-        int ndownloads = transferdata->getNumDownloads();
-        int nuploads = transferdata->getNumUploads();
+        int ndownloads = static_cast<int>(downloadStats.mCount);
+        int nuploads = static_cast<int>(uploadStats.mCount);
 
         if (printsummary)
         {
-            long long transferredDownload = 0, transferredUpload = 0, totalDownload = 0, totalUpload = 0;
-            for (int i = 0; i< ndownloads; i++)
-            {
-                MegaTransfer *t = api->getTransferByTag(transferdata->getDownloadTag(i));
-                {
-                    if (t)
-                    {
-                        transferredDownload += t->getTransferredBytes();
-                        totalDownload += t->getTotalBytes();
-                        delete t;
-                    }
-                }
-            }
-            for (int i = 0; i< nuploads; i++)
-            {
-                MegaTransfer *t = api->getTransferByTag(transferdata->getUploadTag(i));
-                {
-                    if (t)
-                    {
-                        transferredUpload += t->getTransferredBytes();
-                        totalUpload += t->getTotalBytes();
-                        delete t;
-                    }
-                }
-            }
+            long long transferredDownload = downloadStats.mTransferred, totalDownload = downloadStats.mTotal;
+            long long transferredUpload = uploadStats.mTransferred, totalUpload = uploadStats.mTotal;
 
             float percentDownload = !totalDownload?0:float(transferredDownload*1.0/totalDownload);
             float percentUpload = !totalUpload?0:float(transferredUpload*1.0/totalUpload);
@@ -10657,14 +11241,8 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
 
 
 
-        int limit = getintOption(cloptions, "limit", min(10,ndownloads+nuploads+(int)globalTransferListener->completedTransfers.size()));
-
-        if (!transferdata)
-        {
-            setCurrentThreadOutCode(MCMD_EUNEXPECTED);
-            LOG_err << "No transferdata.";
-            return;
-        }
+        CompletedTransferHistory &completedTransfers = globalTransferListener->mCompletedTransfers;
+        int limit = getintOption(cloptions, "limit", min(10,ndownloads+nuploads+(int)completedTransfers.size()));
 
         bool downloadpaused = api->areTransfersPaused(MegaTransfer::TYPE_DOWNLOAD);
         bool uploadpaused = api->areTransfersPaused(MegaTransfer::TYPE_UPLOAD);
@@ -10679,95 +11257,79 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
 
         vector<MegaTransfer *> transfersDLToShow;
         vector<MegaTransfer *> transfersUPToShow;
-        vector<MegaTransfer *> transfersCompletedToShow;
+        vector<CompletedTransfer> transfersCompletedToShow;
 
         if (showcompleted)
         {
-            globalTransferListener->completedTransfersMutex.lock();
-            size_t totalcompleted = globalTransferListener->completedTransfers.size();
-            for (size_t i = 0;(i < totalcompleted)
-                 && (shownCompleted < totalcompleted)
-                 && (shownCompleted < (size_t)(limit+1)); //Note limit+1 to seek for one more to show if there are more to show!
-                 i++)
+            // Note limit+1 to seek for one more to show if there are more to show!
+            const size_t skipCompleted = static_cast<size_t>(max(0, getintOption(cloptions, "offset", 0)));
+            transfersCompletedToShow = completedTransfers.get(skipCompleted, static_cast<size_t>(limit + 1), [&](const CompletedTransfer &transfer)
             {
-                MegaTransfer *transfer = globalTransferListener->completedTransfers.at(i);
-                if (
-                    (
-                            (transfer->getType() == MegaTransfer::TYPE_UPLOAD && (onlyuploads || (!onlyuploads && !onlydownloads) ))
-                        ||  (transfer->getType() == MegaTransfer::TYPE_DOWNLOAD && (onlydownloads || (!onlyuploads && !onlydownloads) ) )
-                    )
-                    &&  !(!showsyncs && transfer->isSyncTransfer())
-                    )
-                {
-
-                    transfersCompletedToShow.push_back(transfer);
-                    shownCompleted++;
-                }
-            }
-            globalTransferListener->completedTransfersMutex.unlock();
+                return (
+                            (transfer.mType == MegaTransfer::TYPE_UPLOAD && (onlyuploads || (!onlyuploads && !onlydownloads) ))
+                        ||  (transfer.mType == MegaTransfer::TYPE_DOWNLOAD && (onlydownloads || (!onlyuploads && !onlydownloads) ) )
+                       )
+                       &&  !(!showsyncs && transfer.mSync);
+            });
+            shownCompleted = static_cast<unsigned int>(transfersCompletedToShow.size());
         }
 
         shown += shownCompleted;
 
-        while (!onlycompleted)
+        // Candidates: at most as many as could be shown (Note limit+1 to seek for one more to show if there are more to show!)
+        vector<IndexedTransfer> downloadCandidates, uploadCandidates;
+        if (!onlycompleted)
         {
-            //MegaTransfer *transfer = transferdata->get(i);
-            MegaTransfer *transfer = NULL;
-            //Next transfer to show
-            if (onlyuploads && !onlydownloads && indexUpload < transferdata->getNumUploads()) //Only uploads
+            const size_t maxCandidates = static_cast<size_t>(max(0, limit + 1 - shown));
+            auto skipCompleted = [showcompleted](const IndexedTransfer &t) { return !showcompleted && t.mState == MegaTransfer::STATE_COMPLETED; };
+            if (onlydownloads || !onlyuploads)
             {
-                transfer = api->getTransferByTag(transferdata->getUploadTag(indexUpload++));
+                downloadCandidates = transferIndex.first(false, maxCandidates, showsyncs, skipCompleted);
             }
-            else
+            if (onlyuploads || !onlydownloads)
             {
-                if ( (!onlydownloads || (onlydownloads && onlyuploads)) //both
-                     && ( (shown >= (limit/2) ) || indexDownload == ndownloads ) // /already chosen half slots for dls or no more dls
-                     && indexUpload < transferdata->getNumUploads()
-                     )
-                    //This is not 100 % perfect, it could show with a limit of 10 5 downloads and 3 uploads with more downloads on the queue.
-                {
-                    transfer = api->getTransferByTag(transferdata->getUploadTag(indexUpload++));
+                uploadCandidates = transferIndex.first(true, maxCandidates, showsyncs, skipCompleted);
+            }
+        }
 
-                }
-                else if(indexDownload < ndownloads)
-                {
-                    transfer =  api->getTransferByTag(transferdata->getDownloadTag(indexDownload++));
-                }
+        while (!onlycompleted && shown < (limit+1))
+        {
+            const IndexedTransfer *candidate = nullptr;
+            //Next transfer to show
+            if ( ( (shown >= (limit/2) ) || indexDownload == (int)downloadCandidates.size() ) // /already chosen half slots for dls or no more dls
+                 && indexUpload < (int)uploadCandidates.size()
+                 )
+                //This is not 100 % perfect, it could show with a limit of 10 5 downloads and 3 uploads with more downloads on the queue.
+            {
+                candidate = &uploadCandidates[indexUpload++];
+            }
+            else if (indexDownload < (int)downloadCandidates.size())
+            {
+                candidate = &downloadCandidates[indexDownload++];
             }
 
-            if (!transfer) break; //finish
+            if (!candidate) break; //finish
 
-            if (
-                    (showcompleted || transfer->getState() != MegaTransfer::STATE_COMPLETED)
-                    &&  !(onlyuploads && transfer->getType() != MegaTransfer::TYPE_UPLOAD && !onlydownloads )
-                    &&  !(onlydownloads && transfer->getType() != MegaTransfer::TYPE_DOWNLOAD && !onlyuploads )
-                    &&  !(!showsyncs && transfer->isSyncTransfer())
-                    &&  (shown < (limit+1)) //Note limit+1 to seek for one more to show if there are more to show!
-                    )
+            MegaTransfer *transfer = api->getTransferByTag(candidate->mTag);
+            if (!transfer)
             {
-                shown++;
-                if (transfer->getType() == MegaTransfer::TYPE_DOWNLOAD)
-                {
-                    transfersDLToShow.push_back(transfer);
-                    showndl++;
-                }
-                else
-                {
-                    transfersUPToShow.push_back(transfer);
-                    shownup++;
-                }
+                continue; // finished in the meantime
             }
-            else
+
+            shown++;
+            if (transfer->getType() == MegaTransfer::TYPE_DOWNLOAD)
             {
-                delete transfer;
+                transfersDLToShow.push_back(transfer);
+                showndl++;
             }
-            if (shown>limit || transfer == NULL) //we-re done
+            else
             {
-                break;
+                transfersUPToShow.push_back(transfer);
+                shownup++;
             }
         }
 
-        vector<MegaTransfer *>::iterator itCompleted = transfersCompletedToShow.begin();
+        vector<CompletedTransfer>::iterator itCompleted = transfersCompletedToShow.begin();
         vector<MegaTransfer *>::iterator itDLs = transfersDLToShow.begin();
         vector<MegaTransfer *>::iterator itUPs = transfersUPToShow.begin();
 
@@ -10778,7 +11340,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
         for (unsigned int i=0;i<showndl+shownup+shownCompleted; i++)
         {
             MegaTransfer *transfer = NULL;
-            bool deleteTransfer = true;
+            CompletedTransfer *completedTransfer = NULL;
             if (itDLs == transfersDLToShow.end() && itCompleted == transfersCompletedToShow.end())
             {
                 transfer = (MegaTransfer *) *itUPs;
@@ -10791,9 +11353,8 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
             }
             else
             {
-                transfer = (MegaTransfer *) *itCompleted;
+                completedTransfer = &*itCompleted;
                 itCompleted++;
-                deleteTransfer=false;
             }
             if (i == 0) //first
             {
@@ -10806,17 +11367,17 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
             if (i==(unsigned int)limit) //we are in the extra one (not to be shown)
             {
                 OUTSTREAM << " ...  Showing first " << limit << " transfers ..." << endl;
-                if (deleteTransfer)
-                {
-                    delete transfer;
-                }
+                delete transfer;
                 break;
             }
 
-            printTransferColumnDisplayer(&cd, transfer);
-
-            if (deleteTransfer)
+            if (completedTransfer)
+            {
+                printCompletedTransferColumnDisplayer(&cd, *completedTransfer);
+            }
+            else
             {
+                printTransferColumnDisplayer(&cd, transfer);
                 delete transfer;
             }
         }
@@ -11172,6 +11733,50 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
             rowCountLimit = std::numeric_limits<int>::max();
         }
 
+        int page = getintOption(cloptions, "page", 1);
+        if (page < 1)
+        {
+            setCurrentThreadOutCode(MCMD_EARGS);
+            LOG_err << "Page number must be 1 or greater";
+            return;
+        }
+        if (page > 1 && rowCountLimit == std::numeric_limits<int>::max())
+        {
+            setCurrentThreadOutCode(MCMD_EARGS);
+            LOG_err << "A page other than the first one requires a row count limit";
+            return;
+        }
+
+        SyncIssueQuery query;
+        query.mOffset = static_cast<size_t>(page - 1) * static_cast<size_t>(rowCountLimit);
+        query.mLimit = static_cast<size_t>(rowCountLimit);
+
+        if (auto syncIdOrPath = getOption(cloptions, "sync", ""); !syncIdOrPath.empty())
+        {
+            auto sync = SyncCommand::getSync(*api, syncIdOrPath);
+            if (!sync)
+            {
+                setCurrentThreadOutCode(MCMD_NOTFOUND);
+                LOG_err << "Sync " << syncIdOrPath << " does not exist";
+                return;
+            }
+            query.mSyncId = sync->getBackupId();
+        }
+
+        if (auto type = getOption(cloptions, "type", ""); !type.empty() && !SyncIssuesCommand::parseIssueType(type, query))
+        {
+            setCurrentThreadOutCode(MCMD_EARGS);
+            LOG_err << "Unknown sync issue type \"" << type << "\". Valid types are: " << joinStrings(SyncIssuesCommand::getIssueTypeNames(), ", ", false);
+            return;
+        }
+
+        if (auto pathPrefix = getOption(cloptions, "path", ""); !pathPrefix.empty())
+        {
+            query.mPathPrefix = pathPrefix;
+        }
+
+        const bool filtered = query.mSyncId || query.mReason || query.mPathProblem || query.mPathPrefix;
+
         bool disablePathCollapse = getFlag(clflags, "disable-path-collapse");
 
         if (disableWarning)
@@ -11185,28 +11790,36 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
             return;
         }
 
-        auto syncIssues = mSyncIssuesManager.getSyncIssues();
-#ifdef MEGACMD_TESTING_CODE
-        // Do not trust empty results (SDK may send them after spurious scans delayed 20ds. SDK-4813)
-        timelyRetry(std::chrono::milliseconds(2300), std::chrono::milliseconds(200),
-                    [&syncIssues]() { return !syncIssues.empty(); },
-                    [this, &syncIssues, firstTime{true}]() mutable
-        {
-            if (firstTime)
-            {
-                LOG_warn << "sync-issues first retrieval returned empty";
-                firstTime = false;
-            }
-            syncIssues = mSyncIssuesManager.getSyncIssues();
-            LOG_warn << "sync-issues retrieval returned empty. Retried returned = " << syncIssues.size();
-        });
-#endif
-
         ColumnDisplayer cd(clflags, cloptions);
 
         bool detailSyncIssue = getFlag(clflags, "detail");
         if (detailSyncIssue) // get the details of one or more issues
         {
+            if (filtered || page > 1)
+            {
+                setCurrentThreadOutCode(MCMD_EARGS);
+                LOG_err << "--sync, --type, --path and --page cannot be combined with --detail";
+                LOG_err << "      " << getUsageStr("sync-issues");
+                return;
+            }
+
+            auto syncIssues = mSyncIssuesManager.getSyncIssues();
+#ifdef MEGACMD_TESTING_CODE
+            // Do not trust empty results (SDK may send them after spurious scans delayed 20ds. SDK-4813)
+            timelyRetry(std::chrono::milliseconds(2300), std::chrono::milliseconds(200),
+                        [&syncIssues]() { return !syncIssues.empty(); },
+                        [this, &syncIssues, firstTime{true}]() mutable
+            {
+                if (firstTime)
+                {
+                    LOG_warn << "sync-issues first retrieval returned empty";
+                    firstTime = false;
+                }
+                syncIssues = mSyncIssuesManager.getSyncIssues();
+                LOG_warn << "sync-issues retrieval returned empty. Retried returned = " << syncIssues.size();
+            });
+#endif
+
             bool showAll = getFlag(clflags, "all");
             if (showAll)
             {
@@ -11238,15 +11851,45 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                 SyncIssuesCommand::printSingleIssueDetail(*api, cd, *syncIssuePtr, disablePathCollapse, rowCountLimit);
             }
         }
-        else // show all sync issues
+        else // show all sync issues (from the index, without fetching them again)
         {
+            auto issuesPage = mSyncIssuesManager.querySyncIssues(query);
+#ifdef MEGACMD_TESTING_CODE
+            // Do not trust empty results (SDK may send them after spurious scans delayed 20ds. SDK-4813)
+            timelyRetry(std::chrono::milliseconds(2300), std::chrono::milliseconds(200),
+                        [&issuesPage]() { return !issuesPage.mSyncIssues->empty(); },
+                        [this, &issuesPage, &query, firstTime{true}]() mutable
+            {
+                if (firstTime)
+                {
+                    LOG_warn << "sync-issues first retrieval returned empty";
+                    firstTime = false;
+                }
+                issuesPage = mSyncIssuesManager.querySyncIssues(query, true);
+                LOG_warn << "sync-issues retrieval returned empty. Retried returned = " << issuesPage.mSyncIssues->size();
+            });
+#endif
+            const SyncIssueList& syncIssues = *issuesPage.mSyncIssues;
+            const SyncIssueQueryResult& result = issuesPage.mResult;
             if (syncIssues.empty())
             {
                 OUTSTREAM << "There are no sync issues" << endl;
                 return;
             }
 
-            SyncIssuesCommand::printAllIssues(*api, cd, syncIssues, disablePathCollapse, rowCountLimit);
+            if (!result.mTotal)
+            {
+                OUTSTREAM << "There are no sync issues matching the given filters" << endl;
+                return;
+            }
+            if (result.mIds.empty())
+            {
+                setCurrentThreadOutCode(MCMD_EARGS);
+                LOG_err << "Page " << page << " is out of range: there are " << result.mTotal << " matching issues";
+                return;
+            }
+
+            SyncIssuesCommand::printIssuesPage(*api, cd, syncIssues, result, disablePathCollapse, static_cast<size_t>(page), static_cast<size_t>(rowCountLimit));
         }
     }
 #if defined(DEBUG) || defined(MEGACMD_TESTING_CODE)
@@ -24,6 +24,14 @@
 #include "listeners.h"
 #include "deferred_single_trigger.h"
 #include "sync_issues.h"
+#include "megacmd_tree_walker.h"
+#include "megacmd_path_cache.h"
+#include "megacmd_folder_stats_cache.h"
+#include "megacmd_request_pipeline.h"
+#include "megacmdutils.h"
+
+#include <functional>
+#include <optional>
 
 namespace megacmd {
 class MegaCmdGlobalTransferListener;
@@ -47,6 +55,12 @@ private:
     DeferredSingleTrigger mDeferredSharedFoldersVerifier;
     SyncIssuesManager mSyncIssuesManager;
 
+    // paths resolved by nodebypath
+    PathResolutionCache mPathCache;
+
+    // statistics of the sync roots
+    FolderStatsCache mFolderStatsCache;
+
     std::recursive_mutex mtxBackupsMap;
 
     // login/signup e-mail address
@@ -73,22 +87,21 @@ private:
     template <typename Cb>
     void forEachFileInNode(mega::MegaNode &n, bool recurse, Cb &&callback)
     {
-        auto children = std::unique_ptr<mega::MegaNodeList>(api->getChildren(&n));
-        if (children != nullptr)
+        MegaApiNodeSource source{api};
+        DepthFirstTreeVisitor<MegaApiNodeSource>::Callbacks callbacks;
+        callbacks.mOnEnter = [recurse, &callback](mega::MegaNode &node, const NodeVisitContext &context)
         {
-            for (int i = 0; i < children->size(); i++)
+            if (node.getType() == mega::MegaNode::TYPE_FILE)
             {
-                auto child = children->get(i);
-                if (child->getType() == mega::MegaNode::TYPE_FILE)
+                if (context.mDepth)
                 {
-                    callback(children->get(i));
-                }
-                else if (recurse)
-                {
-                    forEachFileInNode(*child, true, std::forward<Cb>(callback));
+                    callback(&node);
                 }
+                return false;
             }
-        }
+            return !context.mDepth || recurse;
+        };
+        DepthFirstTreeVisitor<MegaApiNodeSource>(source).walk(n, callbacks);
     }
 
 public:
@@ -103,6 +116,9 @@ public:
 
     void updateprompt(mega::MegaApi *api = nullptr);
 
+    // Max completed transfers kept in memory (transfers_history_size)
+    void setTransfersHistorySize(size_t size);
+
     // nodes browsing
     void listtrees();
     static bool includeIfIsExported(mega::MegaApi* api, mega::MegaNode * n, void *arg);
@@ -112,9 +128,21 @@ public:
     static bool includeIfMatchesPattern(mega::MegaApi* api, mega::MegaNode * n, void *arg);
     static bool includeIfMatchesCriteria(mega::MegaApi* api, mega::MegaNode * n, void *arg);
 
-    bool processTree(mega::MegaNode * n, bool(mega::MegaApi *, mega::MegaNode *, void *), void *( arg ));
+    // The walk is abandoned (returning false) as soon as shouldStop (if any) returns true
+    bool processTree(mega::MegaNode * n, bool(mega::MegaApi *, mega::MegaNode *, void *), void *( arg ), const std::function<bool()> &shouldStop = nullptr);
+
+    // Walks n and its descendants with several threads (see ParallelTreeWalker): visit is called from the walking
+    // threads, consume from the calling one. Returns false if the walk was stopped
+    template <typename Result>
+    bool walkTreeInParallel(mega::MegaNode *n, TreeWalkOptions options,
+                            const std::function<std::optional<Result>(const std::shared_ptr<mega::MegaNode> &)> &visit,
+                            const std::function<bool(Result &&)> &consume);
 
     std::unique_ptr<mega::MegaNode> nodebypath(const char* ptr, std::string* user = nullptr, std::string* namepart = nullptr);
+    // To be called whenever the node tree might have changed, so that paths are resolved again
+    void invalidatePathCache() { mPathCache.clear(); }
+    // To be called with the nodes that changed (null for the whole tree), so that the statistics of the folders containing them are requested again
+    void invalidateFolderStats(mega::MegaNodeList* nodes);
     std::vector<std::unique_ptr<mega::MegaNode>> nodesbypath(const char* ptr, bool usepcre, std::string* user = nullptr);
     void getNodesMatching(mega::MegaNode* parentNode, std::deque<std::string> pathParts, std::vector<std::unique_ptr<mega::MegaNode>>& nodesMatching, bool usepcre);
 
@@ -136,7 +164,7 @@ public:
     void dumpListOfAllShared(mega::MegaNode* n, std::string givenPath);
     void dumpListOfPendingShares(mega::MegaNode* n, std::string givenPath);
     std::string getCurrentPath();
-    long long getVersionsSize(mega::MegaNode* n);
+    long long getVersionsSize(mega::MegaNode* n, size_t threads = 1);
 
     //acting
     void verifySharedFolders(mega::MegaApi * api); //verifies unverified shares and broadcasts warning accordingly
@@ -148,7 +176,7 @@ public:
     void actUponLogout(mega::MegaApi& api, mega::MegaError* e, bool keptSession);
     void actUponLogout(mega::SynchronousRequestListener *srl, bool keptSession, int timeout = 0);
     int actUponCreateFolder(mega::SynchronousRequestListener *srl, int timeout = 0);
-    int deleteNode(const std::unique_ptr<mega::MegaNode>& nodeToDelete, mega::MegaApi* api, int recursive, int force = 0);
+    int deleteNode(const std::unique_ptr<mega::MegaNode>& nodeToDelete, mega::MegaApi* api, int recursive, int force = 0, RequestPipeline *pipeline = nullptr);
     int deleteNodeVersions(const std::unique_ptr<mega::MegaNode>& nodeToDelete, mega::MegaApi* api, int force = 0);
     void downloadNode(std::string source, std::string localPath, mega::MegaApi* api, mega::MegaNode *node, bool background, bool ignorequotawar, int clientID, std::shared_ptr<MegaCmdMultiTransferListener> listener);
     void uploadNode(const std::map<std::string, int> &clflags, const std::map<std::string, std::string> &cloptions, const std::string &receivedPath, mega::MegaApi* api, mega::MegaNode *node, const std::string &newname, MegaCmdMultiTransferListener *multiTransferListener = NULL);
@@ -182,7 +210,14 @@ public:
     int makedir(std::string remotepath, bool recursive, mega::MegaNode *parentnode = NULL);
     bool IsFolder(std::string path);
     bool pathExists(const std::string &path);
-    void doDeleteNode(const std::unique_ptr<mega::MegaNode>& nodeToDelete, mega::MegaApi* api);
+    // With a pipeline, the node is deleted asynchronously (see waitForRequests)
+    void doDeleteNode(const std::unique_ptr<mega::MegaNode>& nodeToDelete, mega::MegaApi* api, RequestPipeline *pipeline = nullptr);
+    // Pipelines informing progress with the given title (when issuing more than one operation)
+    // sequential: a window of a single request, regardless of requests_in_flight
+    std::unique_ptr<RequestPipeline> makeRequestPipeline(int clientID, const std::string &progressTitle, bool sequential = false);
+    void waitForRequests(RequestPipeline &pipeline, int clientID, const std::string &progressTitle);
+    // Waits for the operations submitted so far and reports their failures
+    void reportRequestFailures(RequestPipeline &pipeline);
 
     void confirmDelete();
     void discardDelete();
@@ -192,6 +227,7 @@ public:
     void printTransfersHeader(const unsigned int PATHSIZE, bool printstate=true);
     void printTransfer(mega::MegaTransfer *transfer, const unsigned int PATHSIZE, bool printstate=true);
     void printTransferColumnDisplayer(ColumnDisplayer *cd, mega::MegaTransfer *transfer, bool printstate=true);
+    void printCompletedTransferColumnDisplayer(ColumnDisplayer *cd, CompletedTransfer &transfer, bool printstate=true);
 
     void printBackupHeader(const unsigned int PATHSIZE);
     void printBackupSummary(int tag, const char *localfolder, const char *remoteparentfolder, std::string status, const unsigned int PATHSIZE);
@@ -200,10 +236,12 @@ public:
     void printBackup(int tag, mega::MegaScheduledCopy *backup, const char *timeFormat, const unsigned int PATHSIZE, bool extendedinfo = false, bool showhistory = false, mega::MegaNode *parentnode = NULL);
     void printBackup(backup_struct *backupstruct, const char *timeFormat, const unsigned int PATHSIZE, bool extendedinfo = false, bool showhistory = false);
 
-    void doFind(mega::MegaNode* nodeBase, const char *timeFormat, std::map<std::string, int> *clflags, std::map<std::string, std::string> *cloptions, std::string word, int printfileinfo, std::string pattern, bool usepcre, mega::m_time_t minTime, mega::m_time_t maxTime, int64_t minSize, int64_t maxSize);
+    // Prints the matches as they are found, up to pendingMatches (if any). Returns false once there is no point in finding more
+    bool doFind(mega::MegaNode* nodeBase, const char *timeFormat, std::map<std::string, int> *clflags, std::map<std::string, std::string> *cloptions, std::string word, int printfileinfo, const PatternMatcher &matcher, mega::m_time_t minTime, mega::m_time_t maxTime, int64_t minSize, int64_t maxSize, std::optional<size_t> &pendingMatches, size_t threads = 1);
 
-    void moveToDestination(const std::unique_ptr<mega::MegaNode>& n, std::string destiny);
-    void copyNode(mega::MegaNode *n, std::string destiny, mega::MegaNode *tn, std::string &targetuser, std::string &newname);
+    // These issue the requests asynchronously through the pipeline (see waitForRequests)
+    void moveToDestination(const std::unique_ptr<mega::MegaNode>& n, std::string destiny, RequestPipeline &pipeline);
+    void copyNode(mega::MegaNode *n, std::string destiny, mega::MegaNode *tn, std::string &targetuser, std::string &newname, RequestPipeline &pipeline);
     std::string getLPWD();
     bool isValidFolder(std::string destiny);
     bool establishBackup(std::string local, mega::MegaNode *n, int64_t period, std::string periodstring, int numBackups);
@@ -225,8 +263,10 @@ public:
     bool amIPro();
 
     void processPath(std::string path, bool usepcre, bool& firstone, void (*nodeprocessor)(MegaCmdExecuter *, mega::MegaNode *, bool), MegaCmdExecuter *context = NULL);
-    void catFile(mega::MegaNode *n);
+    // Prints length bytes (all if negative) from offset (counting from the end if negative), through several concurrent streams
+    void catFile(mega::MegaNode *n, long long offset = 0, long long length = -1, size_t streams = 1);
     void printInfoFile(mega::MegaNode *n, bool &firstone, int PATHSIZE);
+    void printServerStats();
 
 
 #ifdef HAVE_LIBUV
@@ -238,6 +278,7 @@ public:
     bool printUserAttribute(int a, std::string user, bool onlylist = false);
     bool setProxy(const std::string &url, const std::string &username, const std::string &password, int proxyType);
     void fetchNodes(mega::MegaApi *api = nullptr, int clientID = -27);
+    void setCwdToRootIfUnset(mega::MegaApi *api);
 
     void mayExecutePendingStuffInWorkerThread();
 };
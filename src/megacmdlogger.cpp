@@ -90,6 +90,12 @@ void setCurrentThreadIsCmdShell(bool isCmdShell)
     getCurrentThreadData().mIsCmdShell = isCmdShell;
 }
 
+void resetCurrentThreadData()
+{
+    isThreadDataSet = false;
+    getCurrentThreadData() = ThreadData();
+}
+
 std::string formatErrorAndMaySetErrorCode(const MegaError &error)
 {
     auto code = error.getErrorCode();
@@ -194,11 +194,18 @@ public:
     virtual ~LoggedStreamDefaultFile() = default;
 };
 
+// Whether the manipulator is std::endl or std::flush
+inline bool isFlushingManipulator(OUTSTREAMTYPE& (*F)(OUTSTREAMTYPE&))
+{
+    using Manipulator = OUTSTREAMTYPE& (*)(OUTSTREAMTYPE&);
+    return F == static_cast<Manipulator>(std::endl) || F == static_cast<Manipulator>(std::flush);
+}
+
 class LoggedStreamPartialOutputs : public LoggedStream
 {
 public:
     LoggedStreamPartialOutputs(ComunicationsManager *_cm, CmdPetition *_inf) : cm(_cm), inf(_inf) {}
-    virtual bool isClientConnected() override { return inf && !inf->clientDisconnected; }
+    virtual bool isClientConnected() override { return inf && cm->isClientConnected(inf); }
 
     virtual const LoggedStream& operator<<(const char& v) const override { OUTSTRINGSTREAM os; os << v; OUTSTRING s = os.str(); cm->sendPartialOutput(inf, &s); return *this; }
     virtual const LoggedStream& operator<<(const char* v) const override { OUTSTRINGSTREAM os; os << v; OUTSTRING s = os.str(); cm->sendPartialOutput(inf, &s); return *this; }
@@ -223,9 +230,15 @@ public:
     LoggedStream const& operator<<(OUTSTREAMTYPE& (*F)(OUTSTREAMTYPE&)) const override
     {
         OUTSTRINGSTREAM os; os << F; OUTSTRING s = os.str(); cm->sendPartialOutput(inf, &s);
+        if (isFlushingManipulator(F))
+        {
+            cm->flushPartialOutputs(inf);
+        }
         return *this;
     }
 
+    void flush() override { cm->flushPartialOutputs(inf); }
+
     virtual ~LoggedStreamPartialOutputs() = default;
 
 protected:
@@ -238,7 +251,7 @@ class LoggedStreamPartialErrors : public LoggedStream
 {
 public:
     LoggedStreamPartialErrors(ComunicationsManager *_cm, CmdPetition *_inf) : cm(_cm), inf(_inf) {}
-    virtual bool isClientConnected() override { return inf && !inf->clientDisconnected; }
+    virtual bool isClientConnected() override { return inf && cm->isClientConnected(inf); }
 
     virtual const LoggedStream& operator<<(const char& v) const override { OUTSTRINGSTREAM os; os << v; OUTSTRING s = os.str(); cm->sendPartialError(inf, &s); return *this; }
     virtual const LoggedStream& operator<<(const char* v) const override { OUTSTRINGSTREAM os; os << v; OUTSTRING s = os.str(); cm->sendPartialError(inf, &s); return *this; }
@@ -263,9 +276,15 @@ public:
     LoggedStream const& operator<<(OUTSTREAMTYPE& (*F)(OUTSTREAMTYPE&)) const override
     {
         OUTSTRINGSTREAM os; os << F; OUTSTRING s = os.str(); cm->sendPartialError(inf, &s);
+        if (isFlushingManipulator(F))
+        {
+            cm->flushPartialOutputs(inf);
+        }
         return *this;
     }
 
+    void flush() override { cm->flushPartialOutputs(inf); }
+
     virtual ~LoggedStreamPartialErrors() = default;
 
 protected:
@@ -300,6 +319,9 @@ void setCurrentThreadLogLevel(int logLevel);
 void setCurrentThreadCmdPetition(CmdPetition *cmdPetition);
 void setCurrentThreadIsCmdShell(bool isCmdShell);
 
+// Leaves the thread data as in a newly created thread (for threads reused across petitions)
+void resetCurrentThreadData();
+
 constexpr size_t LogTimestampSize = std::char_traits<char>::length("2024-12-27_16-33-12.654787");
 std::optional<std::chrono::time_point<std::chrono::system_clock>> stringToTimestamp(std::string_view str);
 std::string timestampToString(std::chrono::time_point<std::chrono::system_clock> timestamp);
@@ -1593,7 +1593,7 @@ void process_line(const char * line)
                 }
                 else
                 {
-                    if ( words[0] == "get" || words[0] == "put" || words[0] == "reload")
+                    if ( words[0] == "get" || words[0] == "put" || words[0] == "rm" || words[0] == "mv" || words[0] == "cp" || words[0] == "reload")
                     {
                         string s = commandtoexec;
                         if (clientID.size())
@@ -23,6 +23,8 @@
 #include "../megacmdcommonutils.h"
 
 #include <iostream>
+#include <deque>
+#include <map>
 #include <sstream>
 #include <string.h>
 
@@ -371,41 +373,301 @@ int MegaCmdShellCommunications::executeCommandW(wstring wcommand, std::string (*
 }
 
 #ifndef _WIN32
+namespace {
+
+bool recvAll(SOCKET thesock, char *data, size_t size)
+{
+    while (size)
+    {
+        auto n = recv(thesock, data, size, MSG_WAITALL);
+        if (n <= 0)
+        {
+            if (n < 0 && ERRNO == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+}
+
+SOCKET MegaCmdShellCommunicationsPosix::connectAndSendPetition(const string &petition, bool initializeserver, bool awaitFrameAck)
+{
+    for (;;)
+    {
+        SOCKET thesock = createSocket(0, initializeserver);
+        if (!isSocketValid(thesock))
+        {
+            return INVALID_SOCKET;
+        }
+
+        // Framed: the server knows where the petition ends without waiting for anything else
+        const bool framed = mFramedPetitions.load() != FramedPetitions::NO;
+        const string data = framed ? framePetition(petition) : petition;
+        auto n = send(thesock, data.data(), data.size(), MSG_NOSIGNAL);
+        if (n == SOCKET_ERROR)
+        {
+            if ( (!petition.compare(0,5,"Xexit") || !petition.compare(0,5,"Xquit") ) && (ERRNO == ENOTCONN) )
+            {
+                 cerr << "Could not send exit command to MEGAcmd server (probably already down)" << endl;
+            }
+            else
+            {
+                cerr << "ERROR writing command to socket: " << ERRNO << endl;
+            }
+            close(thesock);
+            return INVALID_SOCKET;
+        }
+
+        if (!framed || !awaitFrameAck)
+        {
+            return thesock;
+        }
+
+        char ack[sizeof(PETITION_FRAME_ACK)];
+        if (!recvAll(thesock, ack, sizeof(ack)))
+        {
+            cerr << "ERROR reading response from socket: " << ERRNO << endl;
+            close(thesock);
+            return INVALID_SOCKET;
+        }
+
+        if (!memcmp(ack, PETITION_FRAME_ACK, sizeof(ack)))
+        {
+            mFramedPetitions = FramedPetitions::YES;
+            return thesock;
+        }
+
+        // An older server, which took the frame as an empty petition (doing nothing) and responded to it
+        close(thesock);
+        mFramedPetitions = FramedPetitions::NO;
+    }
+}
+
+SOCKET MegaCmdShellCommunicationsPosix::sendPetition(string command, bool interactiveshell)
+{
+    const bool initializeserver = command.compare(0,4,"exit") && command.compare(0,4,"quit") && command.compare(0,10,"completion");
+
+    if (interactiveshell)
+    {
+        command="X"+command;
+    }
+
+    return connectAndSendPetition(command, initializeserver);
+}
+
 int MegaCmdShellCommunicationsPosix::executeCommand(string command, std::string (*readresponse)(const char *), OUTSTREAMTYPE &output, OUTSTREAMTYPE &errorOutput, bool interactiveshell, wstring /*wcommand*/)
 {
-    SOCKET thesock = createSocket(0, command.compare(0,4,"exit") && command.compare(0,4,"quit") && command.compare(0,10,"completion"));
+    SOCKET thesock = sendPetition(command, interactiveshell);
     if (!isSocketValid(thesock))
     {
         return -1;
     }
 
-    ScopeGuard g([this, &thesock]()
+    return receiveResponse(thesock, readresponse, output, errorOutput);
+}
+
+std::vector<int> MegaCmdShellCommunicationsPosix::executeCommands(const std::vector<string> &commands, std::string (*readresponse)(const char *), OUTSTREAMTYPE &output, OUTSTREAMTYPE &errorOutput, bool interactiveshell, size_t maxInFlight)
+{
+    std::vector<int> outcodes;
+    outcodes.reserve(commands.size());
+
+    // Petitions are sent ahead of reading the responses (which are consumed in order), up to maxInFlight at once.
+    // Each one has a connection of its own, so the server may run them in any order: only side effect free ones
+    // go together
+    std::deque<SOCKET> inFlight;
+    bool inFlightHaveSideEffects = false;
+    size_t nextToSend = 0;
+    while (outcodes.size() < commands.size())
     {
-        close(thesock);
+        while (nextToSend < commands.size() && inFlight.size() < std::max<size_t>(1, maxInFlight))
+        {
+            const bool hasSideEffects = !isSideEffectFreeCommand(commands[nextToSend]);
+            if (!inFlight.empty() && (hasSideEffects || inFlightHaveSideEffects))
+            {
+                break;
+            }
+            inFlightHaveSideEffects = hasSideEffects;
+            inFlight.push_back(sendPetition(commands[nextToSend++], interactiveshell));
+        }
+
+        SOCKET thesock = inFlight.front();
+        inFlight.pop_front();
+        outcodes.push_back(isSocketValid(thesock) ? receiveResponse(thesock, readresponse, output, errorOutput) : -1);
+    }
+    return outcodes;
+}
+
+namespace {
+
+// Skips empty lines and comments
+bool readBatchCommand(std::istream &input, string &command)
+{
+    while (getline(input, command))
+    {
+        auto firstNonBlank = command.find_first_not_of(" \t\r");
+        if (firstNonBlank != string::npos && command[firstNonBlank] != '#')
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+int MegaCmdShellCommunicationsPosix::executeBatch(std::istream &input, OUTSTREAMTYPE &output, OUTSTREAMTYPE &errorOutput, size_t maxInFlight)
+{
+    // (servers not taking framed petitions predate sessions. Those taking them acknowledge sessions as such)
+    SOCKET thesock = mFramedPetitions.load() != FramedPetitions::NO ? connectAndSendPetition(string(SESSION_PETITION), true, false) : INVALID_SOCKET;
+    ScopeGuard g([this, thesock]()
+    {
+        if (isSocketValid(thesock))
+        {
+            close(thesock);
+        }
     });
 
-    if (interactiveshell)
+    char headerBuffer[SESSION_FRAME_HEADER_SIZE];
+    SessionFrameHeader header;
+    if (!isSocketValid(thesock)
+            || !recvAll(thesock, headerBuffer, sizeof(headerBuffer))
+            || !parseSessionFrameHeader(string_view(headerBuffer, sizeof(headerBuffer)), header)
+            || header.mRequestId != 0 || header.mCode != MCMD_OK)
     {
-        command="X"+command;
+        // Not acknowledged as a session (i.e: an older server): resort to a connection per command
+        std::vector<string> commands;
+        string command;
+        while (readBatchCommand(input, command))
+        {
+            commands.push_back(command);
+        }
+
+        for (int outcode : executeCommands(commands, NULL, output, errorOutput, false, maxInFlight))
+        {
+            if (outcode != MCMD_OK)
+            {
+                return outcode;
+            }
+        }
+        return MCMD_OK;
     }
 
-    auto n = send(thesock,command.data(),command.size(), MSG_NOSIGNAL);
-    if (n == SOCKET_ERROR)
+    struct PendingRequest
+    {
+        bool mDone = false;
+        int mOutCode = MCMD_OK;
+        std::vector<std::pair<bool /*error*/, string>> mOutputs; // not yet written: previous commands are not done
+    };
+    std::map<uint32_t, PendingRequest> inFlight; // by request id, in the order of the commands
+
+    uint32_t nextRequestId = 1;
+    bool inputEnded = false;
+    int firstFailure = MCMD_OK;
+    for (;;)
     {
-        if ( (!command.compare(0,5,"Xexit") || !command.compare(0,5,"Xquit") ) && (ERRNO == ENOTCONN) )
+        string requests;
+        string command;
+        while (!inputEnded && inFlight.size() < std::max<size_t>(1, maxInFlight))
+        {
+            if (!readBatchCommand(input, command))
+            {
+                inputEnded = true;
+                break;
+            }
+            requests.append(frameSessionMessage(nextRequestId, 0, command));
+            inFlight.emplace(nextRequestId++, PendingRequest());
+        }
+
+        if (!requests.empty() && send(thesock, requests.data(), requests.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(requests.size()))
         {
-             cerr << "Could not send exit command to MEGAcmd server (probably already down)" << endl;
+            cerr << "ERROR writing commands to socket: " << ERRNO << endl;
+            return -1;
+        }
+
+        if (inFlight.empty())
+        {
+            return firstFailure;
+        }
+
+        string payload;
+        if (!recvAll(thesock, headerBuffer, sizeof(headerBuffer))
+                || !parseSessionFrameHeader(string_view(headerBuffer, sizeof(headerBuffer)), header))
+        {
+            cerr << "ERROR reading response from socket: " << ERRNO << endl;
+            return -1;
+        }
+        payload.resize(header.mPayloadSize);
+        if (!recvAll(thesock, payload.data(), payload.size()))
+        {
+            cerr << "ERROR reading output: " << ERRNO << endl;
+            return -1;
+        }
+
+        auto it = inFlight.find(header.mRequestId);
+        if (it == inFlight.end())
+        {
+            continue;
+        }
+
+        auto &request = it->second;
+        if (header.mCode == MCMD_PARTIALOUT || header.mCode == MCMD_PARTIALERR)
+        {
+            request.mOutputs.emplace_back(header.mCode == MCMD_PARTIALERR, std::move(payload));
         }
         else
         {
-            cerr << "ERROR writing command to socket: " << ERRNO << endl;
+            if (payload.size() != 1 || payload[0] != 0) //To avoid outputing 0 char in binary outputs
+            {
+                request.mOutputs.emplace_back(false, std::move(payload));
+            }
+            request.mDone = true;
+            request.mOutCode = header.mCode;
+        }
+
+        // Write what the first commands have output so far, and forget those that are done
+        while (!inFlight.empty())
+        {
+            auto &first = inFlight.begin()->second;
+            if (!first.mOutputs.empty())
+            {
+                StdoutMutexGuard stdOutLockGuard;
+                for (auto &[isError, contents] : first.mOutputs)
+                {
+                    (isError ? errorOutput : output) << contents << flush;
+                }
+                first.mOutputs.clear();
+            }
+
+            if (!first.mDone)
+            {
+                break;
+            }
+
+            if (first.mOutCode != MCMD_OK && firstFailure == MCMD_OK)
+            {
+                firstFailure = first.mOutCode;
+            }
+            inFlight.erase(inFlight.begin());
         }
-        return -1;
     }
+}
+
+int MegaCmdShellCommunicationsPosix::receiveResponse(SOCKET thesock, std::string (*readresponse)(const char *), OUTSTREAMTYPE &output, OUTSTREAMTYPE &errorOutput)
+{
+    ScopeGuard g([this, &thesock]()
+    {
+        close(thesock);
+    });
 
     int outcode = -1;
 
-    n = recv(thesock, (char *)&outcode, sizeof(outcode), MSG_NOSIGNAL);
+    auto n = recv(thesock, (char *)&outcode, sizeof(outcode), MSG_NOSIGNAL);
     if (n == SOCKET_ERROR)
     {
         cerr << "ERROR reading output code: " << ERRNO << endl;
@@ -429,9 +691,9 @@ int MegaCmdShellCommunicationsPosix::executeCommand(string command, std::string
                     char *buffer = new char[partialoutsize+1];
                     n = recv(thesock, (char *)buffer, partialoutsize, MSG_NOSIGNAL);
 
-                    if (n)
+                    if (n > 0)
                     {
-                        partialOutputStream << string(buffer,partialoutsize) << flush;
+                        partialOutputStream << string(buffer,n) << flush; // frames may arrive in pieces
                         partialoutsize-=n;
                     }
                     delete[] buffer;
@@ -697,7 +959,8 @@ bool MegaCmdShellCommunications::registerForStateChanges(bool interactive, State
 #ifndef _WIN32
 std::optional<int> MegaCmdShellCommunicationsPosix::registerForStateChangesImpl(bool interactive, bool initiateServer)
 {
-    SOCKET thesock = createSocket(0, initiateServer);
+    const string petition = interactive?"Xregisterstatelistener":"registerstatelistener";
+    SOCKET thesock = connectAndSendPetition(petition, initiateServer);
 
     if (thesock == INVALID_SOCKET)
     {
@@ -705,27 +968,6 @@ std::optional<int> MegaCmdShellCommunicationsPosix::registerForStateChangesImpl(
         return {};
     }
 
-    bool ok = false;
-    ScopeGuard g([this, &thesock, &ok]()
-    {
-        if (!ok) //something failed
-        {
-            close(thesock);
-        }
-    });
-
-    string command=interactive?"Xregisterstatelistener":"registerstatelistener";
-
-    auto n = send(thesock,command.data(),command.size(), MSG_NOSIGNAL);
-
-    if (n == SOCKET_ERROR)
-    {
-        cerr << "ERROR writing output Code to socket: " << ERRNO << endl;
-        return {};
-    }
-
-    ok = true;
-
     mStateListenerSocket = thesock; // to be able to trigger shutdown
     return thesock;
 }
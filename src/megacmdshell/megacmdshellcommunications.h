@@ -23,6 +23,7 @@
 #define MEGACMDSHELLCOMMUNICATIONS_H
 
 #include "../megacmdcommonutils.h"
+#include "../megacmd_petition_frame.h"
 
 // In the server, OUTSTREAM is defined in megacmdlogger.h: #define OUTSTREAM getCurrentOut()
 // However in the exec and cmd apps:
@@ -32,6 +33,7 @@
 #include <iostream>
 #include <mutex>
 #include <future>
+#include <vector>
 
 #ifdef _WIN32
 #include <WinSock2.h>
@@ -144,8 +146,28 @@ class MegaCmdShellCommunicationsPosix : public MegaCmdShellCommunications
 {
 public:
     int executeCommand(std::string command, std::string (*readresponse)(const char *) = NULL, OUTSTREAMTYPE &output = COUT, OUTSTREAMTYPE &errorOutput = CERR, bool interactiveshell = true, std::wstring = L"") override;
+
+    // Pipelined: petitions are sent before the responses of the previous ones are read, up to maxInFlight at once, as
+    // long as they are side effect free (see isSideEffectFreeCommand). Any other command is sent once the previous
+    // ones are done, and the following ones once it is done, so that they run in order. Returns their out codes
+    std::vector<int> executeCommands(const std::vector<std::string> &commands, std::string (*readresponse)(const char *) = NULL, OUTSTREAMTYPE &output = COUT, OUTSTREAMTYPE &errorOutput = CERR, bool interactiveshell = false, size_t maxInFlight = 16);
+
+    // Executes the commands read from input (one per line) through a single persistent session, up to maxInFlight at once
+    // (with a connection per command, if the server does not support sessions). Their outputs are written in order.
+    // Returns 0 if all of them succeeded, or the out code of the first one that failed
+    int executeBatch(std::istream &input, OUTSTREAMTYPE &output = COUT, OUTSTREAMTYPE &errorOutput = CERR, size_t maxInFlight = 1);
 private:
 
+    SOCKET sendPetition(std::string command, bool interactiveshell);
+
+    // Connects and sends the petition: framed, unless the server is known not to take frames. Then, unless
+    // awaitFrameAck is false (for petitions acknowledged otherwise), reads PETITION_FRAME_ACK: servers not
+    // sending it (older than frames) are sent the petition again, raw, and every one after it
+    SOCKET connectAndSendPetition(const std::string &petition, bool initializeserver, bool awaitFrameAck = true);
+    enum class FramedPetitions { UNKNOWN, YES, NO };
+    std::atomic<FramedPetitions> mFramedPetitions = FramedPetitions::UNKNOWN;
+    int receiveResponse(SOCKET thesock, std::string (*readresponse)(const char *), OUTSTREAMTYPE &output, OUTSTREAMTYPE &errorOutput);
+
     bool isSocketValid(SOCKET socket);
     SOCKET createSocket(int number = 0, bool initializeserver = true);
 
@@ -20,6 +20,7 @@
 #include "mega/types.h"
 
 #ifdef USE_PCRE
+#include <pcre.h>
 #include <pcrecpp.h>
 #elif __cplusplus >= 201103L && !defined(__MINGW32__)
 #include <regex>
@@ -1117,6 +1118,191 @@ bool patternMatches(const char *what, const char *pattern, bool usepcre)
     return megacmdWildcardMatch(what,pattern);
 }
 
+#ifdef USE_PCRE
+struct PatternMatcher::CompiledRegex
+{
+    pcre *mCode = nullptr;
+    pcre_extra *mExtra = nullptr;
+
+    ~CompiledRegex()
+    {
+        if (mExtra)
+        {
+#ifdef PCRE_STUDY_JIT_COMPILE
+            pcre_free_study(mExtra);
+#else
+            pcre_free(mExtra);
+#endif
+        }
+        if (mCode)
+        {
+            pcre_free(mCode);
+        }
+    }
+
+    // Anchored at both ends, as pcrecpp::RE::FullMatch does
+    bool compile(const string &pattern, string &error)
+    {
+        const char *compileError = nullptr;
+        int errorOffset = 0;
+        mCode = pcre_compile(("(?:" + pattern + ")\\z").c_str(), PCRE_ANCHORED, &compileError, &errorOffset, nullptr);
+        if (!mCode)
+        {
+            error = compileError ? compileError : "unknown error";
+            return false;
+        }
+
+        const char *studyError = nullptr;
+#ifdef PCRE_STUDY_JIT_COMPILE
+        mExtra = pcre_study(mCode, PCRE_STUDY_JIT_COMPILE, &studyError);
+#else
+        mExtra = pcre_study(mCode, 0, &studyError);
+#endif
+        if (studyError)
+        {
+            LOG_verbose << "Could not study PCRE regex " << pattern << ": " << studyError;
+        }
+        return true;
+    }
+
+    bool matches(const char *what) const
+    {
+        return pcre_exec(mCode, mExtra, what, static_cast<int>(strlen(what)), 0, 0, nullptr, 0) >= 0;
+    }
+};
+#elif __cplusplus >= 201103L && !defined(__MINGW32__)
+struct PatternMatcher::CompiledRegex
+{
+    std::regex mRegex;
+
+    bool matches(const char *what) const
+    {
+        return std::regex_match(what, mRegex);
+    }
+};
+#else
+struct PatternMatcher::CompiledRegex
+{
+    bool matches(const char *) const
+    {
+        return false;
+    }
+};
+#endif
+
+PatternMatcher::PatternMatcher(string pattern, bool usepcre)
+    : mPattern(std::move(pattern))
+{
+    if (usepcre)
+    {
+        compileRegex();
+    }
+    else
+    {
+        compileWildcards();
+    }
+}
+
+PatternMatcher::~PatternMatcher() = default;
+PatternMatcher::PatternMatcher(PatternMatcher &&) noexcept = default;
+PatternMatcher &PatternMatcher::operator=(PatternMatcher &&) noexcept = default;
+
+void PatternMatcher::compileWildcards()
+{
+    const size_t firstStar = mPattern.find('*');
+    if (mPattern.find('?') != string::npos)
+    {
+        mKind = Kind::WILDCARDS;
+    }
+    else if (firstStar == string::npos)
+    {
+        mKind = Kind::LITERAL;
+    }
+    else
+    {
+        const size_t lastStar = mPattern.rfind('*');
+        const size_t afterFirstStars = mPattern.find_first_not_of('*', firstStar);
+        if (afterFirstStars == string::npos || afterFirstStars > lastStar)
+        {
+            // a single run of '*'
+            mKind = Kind::PREFIX_AND_SUFFIX;
+            mPrefix = mPattern.substr(0, firstStar);
+            mSuffix = mPattern.substr(lastStar + 1);
+        }
+        else if (firstStar == 0 && lastStar == mPattern.size() - 1
+                 && mPattern.find('*', afterFirstStars) == mPattern.find_last_not_of('*') + 1)
+        {
+            // '*' at both ends only
+            mKind = Kind::CONTAINS;
+            mInfix = mPattern.substr(afterFirstStars, mPattern.find_last_not_of('*') + 1 - afterFirstStars);
+        }
+        else
+        {
+            mKind = Kind::WILDCARDS;
+        }
+    }
+}
+
+void PatternMatcher::compileRegex()
+{
+    mKind = Kind::REGEX;
+#ifdef USE_PCRE
+    mRegex = std::make_unique<CompiledRegex>();
+    string error;
+    if (!mRegex->compile(mPattern, error))
+    {
+        //In case the user supplied non-pcre regexp with * or ? in it.
+        string newpattern(mPattern);
+        replaceAll(newpattern,"*",".*");
+        replaceAll(newpattern,"?",".");
+        mRegex = std::make_unique<CompiledRegex>();
+        if (!mRegex->compile(newpattern, error))
+        {
+            LOG_warn << "Invalid PCRE regex: " << error;
+            mKind = Kind::INVALID;
+        }
+    }
+#elif __cplusplus >= 201103L && !defined(__MINGW32__)
+    try
+    {
+        mRegex.reset(new CompiledRegex{std::regex(mPattern)});
+    }
+    catch (const std::regex_error &)
+    {
+        LOG_warn << "Couldn't compile regex: " << mPattern;
+        mKind = Kind::INVALID;
+    }
+#else
+    LOG_warn << " PCRE not supported";
+    mKind = Kind::INVALID;
+#endif
+}
+
+bool PatternMatcher::matches(const char *what) const
+{
+    switch (mKind)
+    {
+        case Kind::LITERAL:
+            return mPattern == what;
+        case Kind::PREFIX_AND_SUFFIX:
+        {
+            const size_t length = strlen(what);
+            return length >= mPrefix.size() + mSuffix.size()
+                    && !mPrefix.compare(0, mPrefix.size(), what, mPrefix.size())
+                    && !mSuffix.compare(0, mSuffix.size(), what + length - mSuffix.size(), mSuffix.size());
+        }
+        case Kind::CONTAINS:
+            return strstr(what, mInfix.c_str()) != nullptr;
+        case Kind::WILDCARDS:
+            return megacmdWildcardMatch(what, mPattern.c_str());
+        case Kind::REGEX:
+            return mRegex->matches(what);
+        case Kind::INVALID:
+            break;
+    }
+    return false;
+}
+
 bool nodeNameIsVersion(string &nodeName)
 {
     bool isversion = false;
@@ -22,6 +22,8 @@
 #include "megacmdcommonutils.h"
 #include "megacmd.h"
 
+#include <algorithm>
+#include <memory>
 #include <string>
 
 namespace megacmd {
@@ -136,6 +138,73 @@ bool megacmdWildcardMatch(const char *pszString, const char *pszMatch);
 
 bool patternMatches(const char *what, const char *pattern, bool usepcre);
 
+/**
+ * @brief Same matching as patternMatches, but compiling the pattern only once:
+ * to be used when matching many names (e.g: all the nodes of a tree) against the same pattern.
+ *
+ * Regular expressions are compiled with PCRE (JIT compiled, if supported) or std::regex.
+ * Wildcard patterns that are a literal, or a prefix and/or a suffix around a single '*' (e.g: "*.jpg"),
+ * or a literal within two '*' are resolved without backtracking.
+ *
+ * Once built, it can be used from several threads at the same time.
+ */
+class PatternMatcher
+{
+public:
+    PatternMatcher(std::string pattern, bool usepcre);
+    ~PatternMatcher();
+
+    PatternMatcher(PatternMatcher &&) noexcept;
+    PatternMatcher &operator=(PatternMatcher &&) noexcept;
+
+    bool matches(const char *what) const;
+
+private:
+    enum class Kind
+    {
+        LITERAL,           // no wildcards at all
+        PREFIX_AND_SUFFIX, // mPrefix*mSuffix (either may be empty)
+        CONTAINS,          // *mInfix*
+        WILDCARDS,         // any other wildcard pattern
+        REGEX,
+        INVALID,           // a regular expression that could not be compiled: nothing matches
+    };
+
+    struct CompiledRegex;
+
+    void compileWildcards();
+    void compileRegex();
+
+    std::string mPattern;
+    Kind mKind = Kind::WILDCARDS;
+    std::string mPrefix;
+    std::string mSuffix;
+    std::string mInfix;
+    std::unique_ptr<CompiledRegex> mRegex;
+};
+
+// Nodes of a MegaApi, for DepthFirstTreeVisitor
+struct MegaApiNodeSource
+{
+    using Node = mega::MegaNode;
+    using NodeList = mega::MegaNodeList;
+
+    mega::MegaApi *mApi;
+
+    size_t countChildren(Node &n) { return static_cast<size_t>(std::max(0, mApi->getNumChildren(&n))); }
+    std::unique_ptr<NodeList> getChildren(Node &n, size_t offset, size_t count)
+    {
+        std::unique_ptr<mega::MegaSearchFilter> filter(mega::MegaSearchFilter::createInstance());
+        filter->byLocationHandle(n.getHandle());
+        std::unique_ptr<mega::MegaSearchPage> page(mega::MegaSearchPage::createInstance(offset, count));
+        return std::unique_ptr<NodeList>(mApi->getChildren(filter.get(), mega::MegaApi::ORDER_DEFAULT_ASC, nullptr, page.get()));
+    }
+    size_t size(const NodeList &list) { return static_cast<size_t>(list.size()); }
+    Node *get(const NodeList &list, size_t i) { return list.get(static_cast<int>(i)); }
+    bool isFolder(Node &n) { return n.getType() != mega::MegaNode::TYPE_FILE; }
+    std::unique_ptr<Node> copy(Node &n) { return std::unique_ptr<Node>(n.copy()); }
+};
+
 bool nodeNameIsVersion(std::string &nodeName);
 
 std::string handleToBase64(const mega::MegaHandle &handle); //node handles
@@ -19,6 +19,7 @@
 #include "megacmdutils.h"
 #include "megacmdlogger.h"
 #include "configurationmanager.h"
+#include "megacmd_request_pipeline.h"
 
 using std::string;
 
@@ -61,30 +62,53 @@ string getSyncId(mega::MegaSync& sync)
     return syncBackupIdToBase64(sync.getBackupId());
 }
 
-void getInfoFromFolder(mega::MegaNode& n, mega::MegaApi& api, long long& nFiles, long long& nFolders, long long *nVersions = nullptr)
+// Gets the statistics of the folders (zeros for those null or failing), from the cache or else requesting those missing all at once
+std::vector<FolderStats> getFoldersStats(mega::MegaApi& api, const std::vector<mega::MegaNode*>& folders, FolderStatsCache& cache)
 {
-    auto megaCmdListener = std::make_unique<MegaCmdListener>(nullptr);
-    api.getFolderInfo(&n, megaCmdListener.get());
-
-    megaCmdListener->wait();
-    if (megaCmdListener->getError()->getErrorCode() != mega::MegaError::API_OK)
+    std::vector<FolderStats> stats(folders.size());
+    RequestPipeline pipeline(static_cast<size_t>(std::max(1, ConfigurationManager::getConfigurationValue("requests_in_flight", 32))));
+    for (size_t i = 0; i < folders.size(); ++i)
     {
-        LOG_err << "Failed to get folder info for " << n.getName();
-        return;
-    }
+        mega::MegaNode* folder = folders[i];
+        if (!folder)
+        {
+            continue;
+        }
 
-    mega::MegaFolderInfo* mfi = megaCmdListener->getRequest()->getMegaFolderInfo();
-    if (!mfi)
-    {
-        return;
-    }
+        if (auto cached = cache.get(folder->getHandle()))
+        {
+            stats[i] = *cached;
+            continue;
+        }
 
-    nFiles = mfi->getNumFiles();
-    nFolders = mfi->getNumFolders();
-    if (nVersions)
-    {
-        *nVersions = mfi->getNumVersions();
-    }
+        cache.fetchStarted(folder->getHandle());
+        pipeline.submit(string("get folder info for ") + folder->getName(), [&api, &stats, &cache, folder, i](RequestPipeline::Done done)
+        {
+            api.getFolderInfo(folder, new MegaCmdListenerFuncExecuter(
+                [&stats, &cache, handle = folder->getHandle(), i, done](mega::MegaApi*, mega::MegaRequest* request, mega::MegaError* e)
+                {
+                    std::optional<FolderStats> folderStats;
+                    const int errorCode = e ? e->getErrorCode() : mega::MegaError::API_EINTERNAL;
+                    if (errorCode == mega::MegaError::API_OK)
+                    {
+                        if (mega::MegaFolderInfo* mfi = request->getMegaFolderInfo())
+                        {
+                            folderStats = FolderStats{mfi->getNumFiles(), mfi->getNumFolders(), mfi->getNumVersions()};
+                            stats[i] = *folderStats;
+                        }
+                    }
+                    cache.fetchFinished(handle, folderStats);
+                    done(errorCode);
+                }, true));
+        });
+    }
+
+    pipeline.waitAll();
+    for (auto& failure : pipeline.takeFailures())
+    {
+        LOG_err << "Failed to " << failure.mDescription;
+    }
+    return stats;
 }
 
 void printSyncHeader(ColumnDisplayer &cd)
@@ -223,7 +247,7 @@ bool isAnySyncUploadDelayed(mega::MegaApi& api)
     return request->getFlag();
 }
 
-void printSync(mega::MegaApi& api, ColumnDisplayer& cd, bool showHandle, mega::MegaSync& sync,  const SyncIssueList& syncIssues)
+void printSync(mega::MegaApi& api, ColumnDisplayer& cd, bool showHandle, mega::MegaSync& sync,  const SyncIssueList& syncIssues, FolderStatsCache& folderStatsCache)
 {
     std::unique_ptr<mega::MegaNode> node(api.getNodeByHandle(sync.getMegaHandle()));
     if (!node)
@@ -232,42 +256,45 @@ void printSync(mega::MegaApi& api, ColumnDisplayer& cd, bool showHandle, mega::M
         return;
     }
 
-    long long nFiles = 0;
-    long long nFolders = 0;
-    getInfoFromFolder(*node, api, nFiles, nFolders);
+    const FolderStats stats = getFoldersStats(api, {node.get()}, folderStatsCache).front();
 
     printSyncHeader(cd);
 
     unsigned int syncIssuesCount = syncIssues.getSyncIssuesCount(sync);
-    printSingleSync(api, sync, node.get(), nFiles, nFolders, cd, showHandle, syncIssuesCount);
+    printSingleSync(api, sync, node.get(), stats.mFiles, stats.mFolders, cd, showHandle, syncIssuesCount);
 }
 
-void printSyncList(mega::MegaApi& api, ColumnDisplayer& cd, bool showHandles, const mega::MegaSyncList& syncList, const SyncIssueList& syncIssues)
+void printSyncList(mega::MegaApi& api, ColumnDisplayer& cd, bool showHandles, const mega::MegaSyncList& syncList, const SyncIssueList& syncIssues, FolderStatsCache& folderStatsCache)
 {
     if (syncList.size() > 0)
     {
         printSyncHeader(cd);
     }
 
+    std::vector<std::unique_ptr<mega::MegaNode>> nodes;
+    std::vector<mega::MegaNode*> folders;
     for (int i = 0; i < syncList.size(); ++i)
     {
         mega::MegaSync& sync = *syncList.get(i);
 
-        std::unique_ptr<mega::MegaNode> node(api.getNodeByHandle(sync.getMegaHandle()));
-
-        long long nFiles = 0;
-        long long nFolders = 0;
-        if (node)
-        {
-            getInfoFromFolder(*node, api, nFiles, nFolders);
-        }
-        else
+        nodes.emplace_back(api.getNodeByHandle(sync.getMegaHandle()));
+        if (!nodes.back())
         {
             LOG_warn << "Remote node not found for sync " << getSyncId(sync);
         }
+        folders.push_back(nodes.back().get());
+    }
+
+    const auto stats = getFoldersStats(api, folders, folderStatsCache);
+    const auto syncIssuesCounts = syncIssues.getSyncIssuesCountBySync(syncList);
+
+    for (int i = 0; i < syncList.size(); ++i)
+    {
+        mega::MegaSync& sync = *syncList.get(i);
 
-        unsigned int syncIssuesCount = syncIssues.getSyncIssuesCount(sync);
-        printSingleSync(api, sync, node.get(), nFiles, nFolders, cd, showHandles, syncIssuesCount);
+        auto syncIssuesCount = syncIssuesCounts.find(sync.getBackupId());
+        printSingleSync(api, sync, nodes[i].get(), stats[i].mFiles, stats[i].mFolders, cd, showHandles,
+                        syncIssuesCount != syncIssuesCounts.end() ? syncIssuesCount->second : 0);
     }
 }
 
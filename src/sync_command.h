@@ -18,6 +18,7 @@
 #include <memory>
 
 #include "megacmdcommonutils.h"
+#include "megacmd_folder_stats_cache.h"
 #include "sync_issues.h"
 
 using namespace megacmd;
@@ -29,8 +30,9 @@ namespace SyncCommand
 
     bool isAnySyncUploadDelayed(mega::MegaApi& api);
 
-    void printSync(mega::MegaApi& api, ColumnDisplayer& cd, bool showHandle, mega::MegaSync& sync,  const SyncIssueList& syncIssues);
-    void printSyncList(mega::MegaApi& api, ColumnDisplayer& cd, bool showHandles, const mega::MegaSyncList& syncList, const SyncIssueList& syncIssues);
+    // Folder statistics are taken from the cache when there (fetching all those that are not at once)
+    void printSync(mega::MegaApi& api, ColumnDisplayer& cd, bool showHandle, mega::MegaSync& sync,  const SyncIssueList& syncIssues, FolderStatsCache& folderStatsCache);
+    void printSyncList(mega::MegaApi& api, ColumnDisplayer& cd, bool showHandles, const mega::MegaSyncList& syncList, const SyncIssueList& syncIssues, FolderStatsCache& folderStatsCache);
 
     void addSync(mega::MegaApi& api, const fs::path& localPath, mega::MegaNode& node);
 
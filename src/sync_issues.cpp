@@ -15,8 +15,11 @@
 
 #include "sync_issues.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cctype>
 #include <functional>
+#include <iterator>
 
 #include "megacmdlogger.h"
 #include "configurationmanager.h"
@@ -42,6 +45,13 @@ namespace
         return std::strncmp(str, prefix, std::strlen(prefix)) == 0;
     }
 
+    // E.g: "DetectedSymlink" for "mega::PathProblem::DetectedSymlink"
+    std::string_view getEnumValueName(std::string_view qualifiedName)
+    {
+        auto pos = qualifiedName.rfind(':');
+        return pos == std::string_view::npos ? qualifiedName : qualifiedName.substr(pos + 1);
+    }
+
     std::string getPathFileName(const std::string& path)
     {
         auto pos = std::find_if(path.rbegin(), path.rend(), [] (char c)
@@ -116,16 +126,15 @@ class SyncIssuesRequestListener : public mega::SynchronousRequestListener
             SyncIssue syncIssue(*stall);
             syncIssues.mIssuesMap.emplace(syncIssue.getId(), std::move(syncIssue));
         }
-        onSyncIssuesChanged(syncIssues);
-
-        {
-            std::lock_guard lock(mSyncIssuesMtx);
-            mSyncIssues = std::move(syncIssues);
-        }
+        onSyncIssuesFetched(std::move(syncIssues));
     }
 
 protected:
-    virtual void onSyncIssuesChanged(const SyncIssueList& syncIssues) {}
+    virtual void onSyncIssuesFetched(SyncIssueList&& syncIssues)
+    {
+        std::lock_guard lock(mSyncIssuesMtx);
+        mSyncIssues = std::move(syncIssues);
+    }
 
 public:
     virtual ~SyncIssuesRequestListener() = default;
@@ -137,78 +146,32 @@ public:
     }
 };
 
-// Whenever a callback happens we start a timer. Any subsequent callbacks after the first
-// timer restart it. When the timer reaches a certain threshold, the broadcast is triggered.
-// This effectivelly "combines" near callbacks into a single trigger.
+// Compares each list of sync issues with the previous one, to only report what changed.
+// (Fetching the list is what is deferred, so that state changes close in time result in a single fetch)
 class SyncIssuesBroadcastListener : public SyncIssuesRequestListener
 {
-    using SyncStalledChangedCb = std::function<void(unsigned int syncIssuesSize)>;
-    using Clock = std::chrono::high_resolution_clock;
-    using TimePoint = Clock::time_point;
-
-    SyncStalledChangedCb mBroadcastSyncIssuesCb;
-    unsigned int mSyncIssuesSize;
-    bool mRunning;
-    TimePoint mLastTriggerTime;
+    using SyncIssuesChangedCb = std::function<void(std::shared_ptr<const SyncIssueList> syncIssues, const SyncIssuesDiff& diff)>;
 
-    std::mutex mDebouncerMtx;
-    std::condition_variable mDebouncerCv;
-    std::thread mDebouncerThread;
+    SyncIssuesChangedCb mSyncIssuesChangedCb;
+    std::vector<std::string> mPreviousIds; // sorted (only accessed from the request callbacks, which are serialized)
 
-    void onSyncIssuesChanged(const SyncIssueList& syncIssues) override
+    void onSyncIssuesFetched(SyncIssueList&& fetchedSyncIssues) override
     {
-        {
-            std::lock_guard lock(mDebouncerMtx);
-            mSyncIssuesSize = syncIssues.size();
-            mLastTriggerTime = Clock::now();
-        }
+        auto syncIssues = std::make_shared<const SyncIssueList>(std::move(fetchedSyncIssues));
+        std::vector<std::string> ids = syncIssues->getIds();
 
-        mDebouncerCv.notify_one();
-    }
+        SyncIssuesDiff diff;
+        diff.mSize = syncIssues->size();
+        std::set_difference(ids.begin(), ids.end(), mPreviousIds.begin(), mPreviousIds.end(), std::back_inserter(diff.mAdded));
+        mPreviousIds = std::move(ids);
 
-    void debouncerLoop()
-    {
-        while (true)
-        {
-            std::unique_lock lock(mDebouncerMtx);
-            bool stopOrTrigger = mDebouncerCv.wait_for(lock, std::chrono::milliseconds(20), [this]
-            {
-                constexpr auto minTriggerTime = std::chrono::milliseconds(300);
-                return !mRunning || Clock::now() - mLastTriggerTime > minTriggerTime;
-            });
-
-            if (!mRunning) // stop
-            {
-                return;
-            }
-
-            if (stopOrTrigger) // trigger
-            {
-                mBroadcastSyncIssuesCb(mSyncIssuesSize);
-                mLastTriggerTime = TimePoint::max();
-            }
-        }
+        mSyncIssuesChangedCb(std::move(syncIssues), diff);
     }
 
 public:
-    template<typename BroadcastSyncIssuesCb>
-    SyncIssuesBroadcastListener(BroadcastSyncIssuesCb&& broadcastSyncIssuesCb) :
-        mBroadcastSyncIssuesCb(std::move(broadcastSyncIssuesCb)),
-        mSyncIssuesSize(0),
-        mRunning(true),
-        mLastTriggerTime(TimePoint::max()),
-        mDebouncerThread([this] { debouncerLoop(); }) {}
-
-    virtual ~SyncIssuesBroadcastListener()
-    {
-        {
-            std::lock_guard lock(mDebouncerMtx);
-            mRunning = false;
-        }
-
-        mDebouncerCv.notify_one();
-        mDebouncerThread.join();
-    }
+    template<typename SyncIssuesChangedCb>
+    SyncIssuesBroadcastListener(SyncIssuesChangedCb&& syncIssuesChangedCb) :
+        mSyncIssuesChangedCb(std::move(syncIssuesChangedCb)) {}
 };
 
 template<bool isCloud>
@@ -303,20 +266,26 @@ std::string SyncIssue::getId() const
     return id;
 }
 
-SyncInfo SyncIssue::getSyncInfo(mega::MegaSync const* parentSync) const
+mega::SyncWaitReason SyncIssue::getReasonType() const
 {
     assert(mMegaStall);
 
-    SyncInfo info;
-    info.mReasonType = static_cast<mega::SyncWaitReason>(mMegaStall->reason());
-
 #ifdef MEGACMD_TESTING_CODE
     auto reasonTypeOpt = TI::Instance().testValue(TI::TestValue::SYNC_ISSUE_ENFORCE_REASON_TYPE);
     if (reasonTypeOpt)
     {
-        info.mReasonType = static_cast<mega::SyncWaitReason>(std::get<int64_t>(*reasonTypeOpt));
+        return static_cast<mega::SyncWaitReason>(std::get<int64_t>(*reasonTypeOpt));
     }
 #endif
+    return static_cast<mega::SyncWaitReason>(mMegaStall->reason());
+}
+
+SyncInfo SyncIssue::getSyncInfo(mega::MegaSync const* parentSync) const
+{
+    assert(mMegaStall);
+
+    SyncInfo info;
+    info.mReasonType = getReasonType();
 
     switch(info.mReasonType)
     {
@@ -566,6 +535,57 @@ bool SyncIssue::belongsToSync(const mega::MegaSync& sync) const
     return false;
 }
 
+template<bool isCloud>
+std::optional<mega::MegaHandle> SyncIssue::getSyncIdByPath(const PathPrefixIndex<mega::MegaHandle>& syncRoots) const
+{
+    const char* path = mMegaStall->path(isCloud, 0);
+    if (!path || !*path)
+    {
+        return std::nullopt;
+    }
+    return syncRoots.findContaining(path);
+}
+
+IndexedSyncIssue SyncIssue::getIndexedSyncIssue(const PathPrefixIndex<mega::MegaHandle>& cloudRoots,
+                                                const PathPrefixIndex<mega::MegaHandle>& localRoots) const
+{
+    assert(mMegaStall);
+
+    IndexedSyncIssue indexed;
+
+    // as getParentSync, but without going through all the syncs
+    auto syncId = getSyncIdByPath<true>(cloudRoots);
+    if (!syncId)
+    {
+        syncId = getSyncIdByPath<false>(localRoots);
+    }
+    indexed.mSyncId = syncId.value_or(IndexedSyncIssue::UNDEF);
+    indexed.mReason = static_cast<int>(getReasonType());
+
+    for (bool isCloud : {false, true})
+    {
+        for (int i = 0; i < mMegaStall->pathCount(isCloud); ++i)
+        {
+            int pathProblem = std::max(0, mMegaStall->pathProblem(isCloud, i));
+#ifdef MEGACMD_TESTING_CODE
+            auto pathProblemOpt = TI::Instance().testValue(TI::TestValue::SYNC_ISSUE_ENFORCE_PATH_PROBLEM);
+            if (pathProblemOpt)
+            {
+                pathProblem = static_cast<int>(std::get<int64_t>(*pathProblemOpt));
+            }
+#endif
+            indexed.mPathProblems.push_back(pathProblem);
+
+            const char* path = mMegaStall->path(isCloud, i);
+            if (path && *path)
+            {
+                indexed.mPaths.emplace_back(path);
+            }
+        }
+    }
+    return indexed;
+}
+
 SyncIssue const* SyncIssueList::getSyncIssue(const std::string& id) const
 {
     auto it = mIssuesMap.find(id);
@@ -576,6 +596,17 @@ SyncIssue const* SyncIssueList::getSyncIssue(const std::string& id) const
     return &it->second;
 }
 
+std::vector<std::string> SyncIssueList::getIds() const
+{
+    std::vector<std::string> ids;
+    ids.reserve(mIssuesMap.size());
+    for (const auto& [id, syncIssue] : mIssuesMap) // (sorted by id)
+    {
+        ids.push_back(id);
+    }
+    return ids;
+}
+
 unsigned int SyncIssueList::getSyncIssuesCount(const mega::MegaSync& sync) const
 {
     unsigned int count = 0;
@@ -589,10 +620,51 @@ unsigned int SyncIssueList::getSyncIssuesCount(const mega::MegaSync& sync) const
     return count;
 }
 
-void SyncIssuesManager::onSyncIssuesChanged(unsigned int newSyncIssuesSize)
+std::unordered_map<mega::MegaHandle, unsigned int> SyncIssueList::getSyncIssuesCountBySync(const mega::MegaSyncList& syncs) const
 {
+    PathPrefixIndex<mega::MegaHandle> cloudRoots;
+    PathPrefixIndex<mega::MegaHandle> localRoots;
+    std::unordered_map<mega::MegaHandle, unsigned int> counts;
+    for (int i = 0; i < syncs.size(); ++i)
+    {
+        const mega::MegaSync& sync = *syncs.get(i);
+        if (const char* cloudPath = sync.getLastKnownMegaFolder())
+        {
+            cloudRoots.add(cloudPath, sync.getBackupId());
+        }
+        if (const char* localPath = sync.getLocalFolder())
+        {
+            localRoots.add(localPath, sync.getBackupId());
+        }
+        counts[sync.getBackupId()] = 0;
+    }
+
+    for (const auto& [id, syncIssue] : *this)
+    {
+        // as in belongsToSync, an issue belongs to the sync(s) containing either of its first paths
+        auto cloudSync = syncIssue.getSyncIdByPath<true>(cloudRoots);
+        auto localSync = syncIssue.getSyncIdByPath<false>(localRoots);
+        if (cloudSync)
+        {
+            ++counts[*cloudSync];
+        }
+        if (localSync && localSync != cloudSync)
+        {
+            ++counts[*localSync];
+        }
+    }
+    return counts;
+}
+
+void SyncIssuesManager::onSyncIssuesChanged(std::shared_ptr<const SyncIssueList> syncIssues, const SyncIssuesDiff& diff)
+{
+    {
+        auto lock = updateIndex(*syncIssues);
+        mIndexedSyncIssues = std::move(syncIssues);
+    }
+
     std::lock_guard lock(mWarningMtx);
-    if (mWarningEnabled && newSyncIssuesSize > 0)
+    if (mWarningEnabled && !diff.mAdded.empty()) // (not again for the issues already warned about)
     {
         std::string message = "Sync issues detected: your syncs have encountered conflicts that may require your intervention.\n"s +
                               "Use the \"%mega-%sync-issues\" command to display them.\n" +
@@ -601,24 +673,28 @@ void SyncIssuesManager::onSyncIssuesChanged(unsigned int newSyncIssuesSize)
     }
 
 #ifdef MEGACMD_TESTING_CODE
-        TI::Instance().setTestValue(TI::TestValue::SYNC_ISSUES_LIST_SIZE, static_cast<uint64_t>(newSyncIssuesSize));
+        TI::Instance().setTestValue(TI::TestValue::SYNC_ISSUES_LIST_SIZE, static_cast<uint64_t>(diff.mSize));
         TI::Instance().fireEvent(TI::Event::SYNC_ISSUES_LIST_UPDATED);
 #endif
 }
 
 SyncIssuesManager::SyncIssuesManager(mega::MegaApi *api) :
-    mApi(*api)
+    mApi(*api),
+    mStallListFetchTrigger(std::chrono::milliseconds(300), std::chrono::seconds(2))
 {
     // The global listener will be triggered whenever there's a change in the sync state
-    // It'll request the sync issue list from the API (if the stalled state changed)
+    // It'll request the sync issue list from the API (if the stalled state changed), once
+    // there are no further changes for a while (or after some time of constant changes)
     // This will be used to notify the user if they have sync issues
-    mGlobalListener = std::make_unique<SyncIssuesGlobalListener>(
-         [this, api] { api->getMegaSyncStallList(mRequestListener.get()); });
+    mGlobalListener = std::make_unique<SyncIssuesGlobalListener>([this, api]
+    {
+        mStallListFetchTrigger.trigger([this, api] { api->getMegaSyncStallList(mRequestListener.get()); });
+    });
 
     // The broadcast listener will be triggered whenever the api call above finishes
-    // getting the list of stalls; it'll be used to notify the user (and the integration tests)
+    // getting the list of stalls; it'll be used to notify the user of new issues (and the integration tests)
     mRequestListener = std::make_unique<SyncIssuesBroadcastListener>(
-        [this] (unsigned int newSyncIssuesSize) { onSyncIssuesChanged(newSyncIssuesSize); });
+        [this] (std::shared_ptr<const SyncIssueList> syncIssues, const SyncIssuesDiff& diff) { onSyncIssuesChanged(std::move(syncIssues), diff); });
 
     mWarningEnabled = ConfigurationManager::getConfigurationValue("stalled_issues_warning", true);
 }
@@ -632,6 +708,72 @@ SyncIssueList SyncIssuesManager::getSyncIssues() const
     return listener->releaseSyncIssues();
 }
 
+std::unique_lock<std::mutex> SyncIssuesManager::updateIndex(const SyncIssueList& syncIssues)
+{
+    std::unique_ptr<mega::MegaSyncList> syncs(mApi.getSyncs());
+    assert(syncs);
+
+    PathPrefixIndex<mega::MegaHandle> cloudRoots;
+    PathPrefixIndex<mega::MegaHandle> localRoots;
+    std::string syncRoots;
+    for (int i = 0; i < syncs->size(); ++i)
+    {
+        const mega::MegaSync& sync = *syncs->get(i);
+        const char* cloudPath = sync.getLastKnownMegaFolder();
+        const char* localPath = sync.getLocalFolder();
+        if (cloudPath)
+        {
+            cloudRoots.add(cloudPath, sync.getBackupId());
+        }
+        if (localPath)
+        {
+            localRoots.add(localPath, sync.getBackupId());
+        }
+        syncRoots.append(std::to_string(sync.getBackupId())).append(1, '\0')
+                 .append(cloudPath ? cloudPath : "").append(1, '\0')
+                 .append(localPath ? localPath : "").append(1, '\0');
+    }
+
+    std::unique_lock lock(mIndexMtx);
+    if (syncRoots != mIndexedSyncRoots) // the issues might belong to other syncs now
+    {
+        mIndex.clear();
+        mIndexedSyncRoots = std::move(syncRoots);
+    }
+
+    const size_t indexed = mIndex.update(syncIssues.getIds(), [&syncIssues, &cloudRoots, &localRoots] (const std::string& id)
+    {
+        const SyncIssue* syncIssue = syncIssues.getSyncIssue(id);
+        assert(syncIssue);
+        return syncIssue->getIndexedSyncIssue(cloudRoots, localRoots);
+    });
+    if (indexed)
+    {
+        LOG_debug << "Indexed " << indexed << " new sync issues (" << mIndex.size() << " in total)";
+    }
+    return lock;
+}
+
+SyncIssuesPage SyncIssuesManager::querySyncIssues(const SyncIssueQuery& query, bool fetchNow)
+{
+    if (!fetchNow)
+    {
+        std::lock_guard lock(mIndexMtx);
+        if (mIndexedSyncIssues)
+        {
+            return {mIndexedSyncIssues, mIndex.query(query)};
+        }
+    }
+
+    // Never fetched in the background yet (e.g. no change in the sync state since startup): fetch them right away
+    auto syncIssues = std::make_shared<const SyncIssueList>(getSyncIssues());
+
+    // (holding the lock, so that the results are those of syncIssues even if the index is updated concurrently)
+    auto lock = updateIndex(*syncIssues);
+    mIndexedSyncIssues = syncIssues;
+    return {std::move(syncIssues), mIndex.query(query)};
+}
+
 void SyncIssuesManager::disableWarning()
 {
     std::lock_guard lock(mWarningMtx);
@@ -658,25 +800,85 @@ void SyncIssuesManager::enableWarning()
 
 namespace SyncIssuesCommand
 {
-    void printAllIssues(mega::MegaApi& api, ColumnDisplayer& cd, const SyncIssueList& syncIssues, bool disablePathCollapse, int rowCountLimit)
+    bool parseIssueType(const std::string& name, SyncIssueQuery& query)
+    {
+        auto equalsIgnoringCase = [] (std::string_view a, std::string_view b)
+        {
+            return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [] (char ca, char cb)
+            {
+                return std::tolower(static_cast<unsigned char>(ca)) == std::tolower(static_cast<unsigned char>(cb));
+            });
+        };
+
+    #define SOME_GENERATOR_MACRO(reason) \
+        if (equalsIgnoringCase(name, getEnumValueName(#reason))) \
+        { \
+            query.mReason = static_cast<int>(reason); \
+            return true; \
+        }
+        GENERATE_FROM_SYNC_WAIT_REASON(SOME_GENERATOR_MACRO)
+    #undef SOME_GENERATOR_MACRO
+
+    #define SOME_GENERATOR_MACRO(pathProblem, str) \
+        if (equalsIgnoringCase(name, getEnumValueName(#pathProblem))) \
+        { \
+            query.mPathProblem = static_cast<int>(pathProblem); \
+            return true; \
+        }
+        GENERATE_FROM_PATH_PROBLEM(SOME_GENERATOR_MACRO)
+    #undef SOME_GENERATOR_MACRO
+
+        return false;
+    }
+
+    std::vector<std::string> getIssueTypeNames()
+    {
+        std::vector<std::string> names;
+    #define SOME_GENERATOR_MACRO(reason) names.emplace_back(getEnumValueName(#reason));
+        GENERATE_FROM_SYNC_WAIT_REASON(SOME_GENERATOR_MACRO)
+    #undef SOME_GENERATOR_MACRO
+    #define SOME_GENERATOR_MACRO(pathProblem, str) names.emplace_back(getEnumValueName(#pathProblem));
+        GENERATE_FROM_PATH_PROBLEM(SOME_GENERATOR_MACRO)
+    #undef SOME_GENERATOR_MACRO
+        return names;
+    }
+
+    void printIssuesPage(mega::MegaApi& api, ColumnDisplayer& cd, const SyncIssueList& syncIssues, const SyncIssueQueryResult& result,
+                         bool disablePathCollapse, size_t page, size_t pageSize)
     {
         cd.addHeader("PARENT_SYNC", disablePathCollapse);
 
-        syncIssues.forEach([&api, &cd] (const SyncIssue& syncIssue)
+        for (const std::string& id : result.mIds)
         {
-            auto parentSync = syncIssue.getParentSync(api);
+            auto syncIssue = syncIssues.getSyncIssue(id);
+            assert(syncIssue);
+            auto parentSync = syncIssue->getParentSync(api);
 
-            cd.addValue("ISSUE_ID", syncIssue.getId());
+            cd.addValue("ISSUE_ID", id);
             cd.addValue("PARENT_SYNC", parentSync ? parentSync->getName() : "<not found>");
-            cd.addValue("REASON", syncIssue.getSyncInfo(parentSync.get()).mReason);
-        }, rowCountLimit);
+            cd.addValue("REASON", syncIssue->getSyncInfo(parentSync.get()).mReason);
+        }
 
         OUTSTREAM << cd.str();
         OUTSTREAM << endl;
-        if (rowCountLimit < syncIssues.size())
+        if (result.mIds.size() < result.mTotal)
         {
-            OUTSTREAM << "Note: showing " << rowCountLimit << " out of " << syncIssues.size() << " issues. "
-                      << "Use \"" << getCommandPrefixBasedOnMode() << "sync-issues --limit=0\" to see all of them." << endl;
+            const size_t pageCount = (result.mTotal + pageSize - 1) / pageSize;
+            OUTSTREAM << "Note: showing " << result.mIds.size() << " out of " << result.mTotal << " issues";
+            if (pageCount > 1)
+            {
+                OUTSTREAM << " (page " << page << " of " << pageCount << ")";
+            }
+            OUTSTREAM << ". ";
+            if (page < pageCount)
+            {
+                OUTSTREAM << "Use \"" << getCommandPrefixBasedOnMode() << "sync-issues --page=" << page + 1 << "\" to see the next ones, or ";
+            }
+            else
+            {
+                OUTSTREAM << "Use ";
+            }
+            OUTSTREAM << "\"" << getCommandPrefixBasedOnMode() << "sync-issues --limit=0\" to see all of them." << endl;
         }
         OUTSTREAM << "Use \"" << getCommandPrefixBasedOnMode() << "sync-issues --detail <ISSUE_ID>\" to get further details on a specific issue." << endl;
     }
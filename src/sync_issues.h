@@ -19,10 +19,14 @@
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <unordered_map>
 
 #include "megaapi.h"
 #include "mega/types.h"
 #include "megacmdcommonutils.h"
+#include "megacmd_path_prefix_index.h"
+#include "megacmd_sync_issue_index.h"
+#include "deferred_single_trigger.h"
 
 #define GENERATE_FROM_PATH_PROBLEM(GENERATOR_MACRO) \
         GENERATOR_MACRO(mega::PathProblem::NoProblem,                             "-") \
@@ -56,6 +60,22 @@
         GENERATOR_MACRO(mega::PathProblem::UploadDeferredByController,            "Upload deferred by controller") \
         GENERATOR_MACRO(mega::PathProblem::DetectedNestedMount,                   "Nested mount detected")
 
+#define GENERATE_FROM_SYNC_WAIT_REASON(GENERATOR_MACRO) \
+        GENERATOR_MACRO(mega::SyncWaitReason::NoReason) \
+        GENERATOR_MACRO(mega::SyncWaitReason::FileIssue) \
+        GENERATOR_MACRO(mega::SyncWaitReason::MoveOrRenameCannotOccur) \
+        GENERATOR_MACRO(mega::SyncWaitReason::DeleteOrMoveWaitingOnScanning) \
+        GENERATOR_MACRO(mega::SyncWaitReason::DeleteWaitingOnMoves) \
+        GENERATOR_MACRO(mega::SyncWaitReason::UploadIssue) \
+        GENERATOR_MACRO(mega::SyncWaitReason::DownloadIssue) \
+        GENERATOR_MACRO(mega::SyncWaitReason::CannotCreateFolder) \
+        GENERATOR_MACRO(mega::SyncWaitReason::CannotPerformDeletion) \
+        GENERATOR_MACRO(mega::SyncWaitReason::SyncItemExceedsSupportedTreeDepth) \
+        GENERATOR_MACRO(mega::SyncWaitReason::FolderMatchedAgainstFile) \
+        GENERATOR_MACRO(mega::SyncWaitReason::LocalAndRemoteChangedSinceLastSyncedState_userMustChoose) \
+        GENERATOR_MACRO(mega::SyncWaitReason::LocalAndRemotePreviouslyUnsyncedDiffer_userMustChoose) \
+        GENERATOR_MACRO(mega::SyncWaitReason::NamesWouldClashWhenSynced)
+
 struct SyncInfo
 {
     mega::SyncWaitReason mReasonType = mega::SyncWaitReason::NoReason;
@@ -83,6 +103,8 @@ class SyncIssue
     template<bool isCloud>
     std::optional<int> getPathProblem(mega::PathProblem pathProblem) const;
 
+    mega::SyncWaitReason getReasonType() const;
+
 public:
     // We add this prefix at the start to distinguish between cloud and local absolute paths
     inline static const std::string CloudPrefix = "<CLOUD>";
@@ -112,6 +134,14 @@ public:
 
     std::unique_ptr<mega::MegaSync> getParentSync(mega::MegaApi& api) const;
     bool belongsToSync(const mega::MegaSync& sync) const;
+
+    // Returns the id of the sync (among syncRoots) containing the cloud/local path with index 0 (if any)
+    template<bool isCloud>
+    std::optional<mega::MegaHandle> getSyncIdByPath(const megacmd::PathPrefixIndex<mega::MegaHandle>& syncRoots) const;
+
+    // What the sync issue index keeps of this issue (cloudRoots and localRoots are those of the current syncs)
+    megacmd::IndexedSyncIssue getIndexedSyncIssue(const megacmd::PathPrefixIndex<mega::MegaHandle>& cloudRoots,
+                                                  const megacmd::PathPrefixIndex<mega::MegaHandle>& localRoots) const;
 };
 
 class SyncIssueList
@@ -122,17 +152,11 @@ class SyncIssueList
     friend class SyncIssuesRequestListener; // only one that can actually populate this
 
 public:
-    template<typename Cb>
-    void forEach(Cb&& callback, size_t sizeLimit) const
-    {
-        for (auto it = begin(); it != end() && std::distance(begin(), it) < sizeLimit; ++it)
-        {
-            callback(it->second);
-        }
-    }
-
     SyncIssue const* getSyncIssue(const std::string& id) const;
+    std::vector<std::string> getIds() const; // sorted
     unsigned int getSyncIssuesCount(const mega::MegaSync& sync) const;
+    // The number of issues of each of the syncs (by backup id), going through the issues only once
+    std::unordered_map<mega::MegaHandle, unsigned int> getSyncIssuesCountBySync(const mega::MegaSyncList& syncs) const;
 
     bool empty() const { return mIssuesMap.empty(); }
     unsigned int size() const { return mIssuesMap.size(); }
@@ -141,6 +165,20 @@ public:
     SyncIssuesMapT::const_iterator end() const { return mIssuesMap.end(); }
 };
 
+// What changed between two consecutive lists of sync issues
+struct SyncIssuesDiff
+{
+    unsigned int mSize = 0;             // of the new list
+    std::vector<std::string> mAdded;    // ids of the issues not in the previous list
+};
+
+// A page of the results of a query, and the list of sync issues they were taken from
+struct SyncIssuesPage
+{
+    std::shared_ptr<const SyncIssueList> mSyncIssues;
+    megacmd::SyncIssueQueryResult mResult;
+};
+
 class SyncIssuesManager final
 {
     mega::MegaApi& mApi;
@@ -150,14 +188,31 @@ class SyncIssuesManager final
     std::unique_ptr<mega::MegaGlobalListener> mGlobalListener;
     std::unique_ptr<mega::MegaRequestListener> mRequestListener;
 
+    // Index over the latest list of sync issues, to serve the filtered/paged queries of the sync-issues command
+    std::mutex mIndexMtx;
+    megacmd::SyncIssueIndex mIndex;
+    std::string mIndexedSyncRoots; // of the syncs the issues in the index were matched against
+    std::shared_ptr<const SyncIssueList> mIndexedSyncIssues; // the ones in the index (null until first fetched)
+
+    // (after the listeners: destroyed before them, since it uses them)
+    DeferredTrigger mStallListFetchTrigger;
+
 private:
-    void onSyncIssuesChanged(unsigned int newSyncIssuesSize);
+    void onSyncIssuesChanged(std::shared_ptr<const SyncIssueList> syncIssues, const SyncIssuesDiff& diff);
+
+    // Only the issues not in the previous list are indexed (all of them again if the syncs changed).
+    // Returns the lock of the index, still held
+    std::unique_lock<std::mutex> updateIndex(const SyncIssueList& syncIssues);
 
 public:
     SyncIssuesManager(mega::MegaApi *api);
 
     SyncIssueList getSyncIssues() const;
 
+    // The page of the issues matching the query, served from the index (kept up to date by the fetches triggered
+    // by changes in the sync state). The issues are only fetched right away if they were never fetched, or if fetchNow
+    SyncIssuesPage querySyncIssues(const megacmd::SyncIssueQuery& query, bool fetchNow = false);
+
     void disableWarning();
     void enableWarning();
 
@@ -166,7 +221,13 @@ public:
 
 namespace SyncIssuesCommand
 {
-    void printAllIssues(mega::MegaApi& api, megacmd::ColumnDisplayer& cd, const SyncIssueList& syncIssues, bool disablePathCollapse, int rowCountLimit);
+    // Parses a sync issue type for "--type": either the name of a mega::SyncWaitReason or of a mega::PathProblem (case insensitive)
+    bool parseIssueType(const std::string& name, megacmd::SyncIssueQuery& query);
+    std::vector<std::string> getIssueTypeNames();
+
+    // Prints the issues of a page of results (page 1 is the first)
+    void printIssuesPage(mega::MegaApi& api, megacmd::ColumnDisplayer& cd, const SyncIssueList& syncIssues, const megacmd::SyncIssueQueryResult& result,
+                         bool disablePathCollapse, size_t page, size_t pageSize);
 
     void printSingleIssueDetail(mega::MegaApi& api, megacmd::ColumnDisplayer& cd, const SyncIssue& syncIssue, bool disablePathCollapse, int rowCountLimit);
     void printAllIssuesDetail(mega::MegaApi& api, megacmd::ColumnDisplayer& cd, const SyncIssueList& syncIssues, bool disablePathCollapse, int rowCountLimit);
@@ -69,6 +69,20 @@ TEST_F(NOINTERACTIVEReadTest, Find)
     EXPECT_THAT(result_paths, testing::Contains("testReadingFolder01/folder02/subfolder03/file02.txt"));
 }
 
+TEST_F(NOINTERACTIVEReadTest, FindWithLimit)
+{
+    auto r = executeInClient({"find", "--limit=3"});
+    ASSERT_TRUE(r.ok());
+    EXPECT_THAT(splitByNewline(r.out()), testing::SizeIs(3));
+
+    r = executeInClient({"find", "testReadingFolder01", "testReadingFolder01", "--limit=3"});
+    ASSERT_TRUE(r.ok());
+    EXPECT_THAT(splitByNewline(r.out()), testing::SizeIs(3)); // the limit applies to all the paths together
+
+    r = executeInClient({"find", "--limit=0"});
+    EXPECT_FALSE(r.ok());
+}
+
 TEST_F(NOINTERACTIVELoggedInTest, Whoami)
 {
 
@@ -109,6 +123,51 @@ TEST_F(NOINTERACTIVELoggedInTest, Whoami)
     }
 }
 
+TEST_F(NOINTERACTIVELoggedInTest, MoveWildcardToNonExistingTarget)
+{
+    const std::string base = "testMoveWildcard";
+    (void)executeInClient({"rm", "-rf", base});
+    for (const std::string folder : {"folder01", "folder02", "other01"})
+    {
+        auto r = executeInClient({"mkdir", "-p", base + "/" + folder});
+        ASSERT_TRUE(r.ok()) << r.err();
+    }
+
+    auto listBase = [&base](const std::string& subpath = "")
+    {
+        auto r = executeInClient({"ls", base + subpath});
+        EXPECT_TRUE(r.ok()) << r.err();
+        return splitByNewline(r.out());
+    };
+
+    {
+        G_SUBTEST << "Several matches";
+
+        auto r = executeInClient({"mv", base + "/folder0*", base + "/renamed"});
+        EXPECT_FALSE(r.ok());
+        EXPECT_THAT(listBase(), testing::UnorderedElementsAre("folder01", "folder02", "other01"));
+    }
+
+    {
+        G_SUBTEST << "A single match";
+
+        auto r = executeInClient({"mv", base + "/other0*", base + "/renamed"});
+        ASSERT_TRUE(r.ok()) << r.err();
+        EXPECT_THAT(listBase(), testing::UnorderedElementsAre("folder01", "folder02", "renamed"));
+    }
+
+    {
+        G_SUBTEST << "Into an existing folder";
+
+        auto r = executeInClient({"mv", base + "/folder0*", base + "/renamed"});
+        ASSERT_TRUE(r.ok()) << r.err();
+        EXPECT_THAT(listBase(), testing::UnorderedElementsAre("renamed"));
+        EXPECT_THAT(listBase("/renamed"), testing::UnorderedElementsAre("folder01", "folder02"));
+    }
+
+    EXPECT_TRUE(executeInClient({"rm", "-rf", base}).ok());
+}
+
 TEST_F(NOINTERACTIVEBasicTest, EchoInvalidUtf8)
 {
     const std::string validUtf8 = u8"\uc548\uc548\ub155\ud558\uc138\uc694\uc138\uacc4";
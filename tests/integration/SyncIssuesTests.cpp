@@ -261,6 +261,44 @@ TEST_F(SyncIssuesTests, LimitedSyncIssueList)
     EXPECT_THAT(lines.at(lines.size()-2), testing::HasSubstr("showing 3 out of 5 issues"));
 }
 
+TEST_F(SyncIssuesTests, FilteredAndPagedSyncIssueList)
+{
+    const std::string dirPath = syncDirLocal() + "some_dir";
+    ASSERT_TRUE(fs::create_directory(dirPath));
+
+    // Create 5 sync issues
+    for (int i = 1; i <= 5; ++i)
+    {
+        SyncIssueListGuard guard(i);
+        fs::create_directory_symlink(dirPath, syncDirLocal() + "link" + std::to_string(i));
+    }
+
+    auto result = executeInClient({"sync-issues", "--type=DetectedSymlink", "--limit=3", "--page=2"});
+    ASSERT_TRUE(result.ok());
+
+    // Column header + the 2 issues in the second page + newline + limit-specific note + detail usage
+    auto lines = splitByNewline(result.out());
+    EXPECT_THAT(lines, testing::SizeIs(6));
+    EXPECT_THAT(lines.at(lines.size()-2), testing::HasSubstr("showing 2 out of 5 issues (page 2 of 2)"));
+
+    std::string linkPath = syncDirLocal() + "link3";
+#ifdef _WIN32
+    megacmd::replaceAll(linkPath, "/", "\\");
+#endif
+    result = executeInClient({"sync-issues", "--path=" + linkPath});
+    ASSERT_TRUE(result.ok());
+    lines = splitByNewline(result.out());
+    EXPECT_THAT(lines, testing::SizeIs(4)); // Column names + issue + newline + detail usage
+
+    result = executeInClient({"sync-issues", "--type=DetectedHardLink"});
+    ASSERT_TRUE(result.ok());
+    EXPECT_THAT(result.out(), testing::HasSubstr("There are no sync issues matching the given filters"));
+
+    result = executeInClient({"sync-issues", "--type=NotAType"});
+    EXPECT_FALSE(result.ok());
+    EXPECT_THAT(result.err(), testing::HasSubstr("Unknown sync issue type"));
+}
+
 TEST_F(SyncIssuesTests, ShowSyncIssuesInSyncCommand)
 {
     auto result = executeInClient({"sync"});
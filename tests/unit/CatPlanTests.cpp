@@ -0,0 +1,182 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <climits>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_cat_plan.h"
+
+using namespace megacmd;
+
+namespace {
+constexpr long long SEGMENT = static_cast<long long>(CAT_SEGMENT_SIZE);
+
+// The segments are contiguous, sent in order and cover the whole range
+void expectCoversRange(const CatPlan& plan)
+{
+    long long next = plan.mStart;
+    for (size_t i = 0; i < plan.segmentCount(); ++i)
+    {
+        auto [start, end] = plan.segment(i);
+        EXPECT_EQ(start, next) << "segment " << i;
+        EXPECT_LT(start, end) << "segment " << i;
+        EXPECT_LE(end - start, plan.mSegmentSize) << "segment " << i;
+        next = end;
+    }
+    EXPECT_EQ(next, plan.mEnd);
+}
+}
+
+TEST(CatPlanTest, WholeFileInASingleStream)
+{
+    auto plan = planCat(3 * SEGMENT, 0, -1, 1);
+    EXPECT_EQ(plan.mStart, 0);
+    EXPECT_EQ(plan.mEnd, 3 * SEGMENT);
+    EXPECT_EQ(plan.mStreams, 1u);
+    EXPECT_EQ(plan.segmentCount(), 1u);
+    EXPECT_EQ(plan.mBufferCapacity, CAT_BUFFER_CAPACITY);
+    expectCoversRange(plan);
+}
+
+TEST(CatPlanTest, OffsetAndLength)
+{
+    G_SUBTEST << "From an offset";
+    {
+        auto plan = planCat(1000, 100, -1, 1);
+        EXPECT_EQ(plan.mStart, 100);
+        EXPECT_EQ(plan.mEnd, 1000);
+    }
+
+    G_SUBTEST << "Negative offset (from the end)";
+    {
+        auto plan = planCat(1000, -100, 10, 1);
+        EXPECT_EQ(plan.mStart, 900);
+        EXPECT_EQ(plan.mEnd, 910);
+    }
+
+    G_SUBTEST << "Negative offset past the beginning";
+    {
+        auto plan = planCat(1000, -2000, -1, 1);
+        EXPECT_EQ(plan.mStart, 0);
+        EXPECT_EQ(plan.mEnd, 1000);
+    }
+
+    G_SUBTEST << "Length past the end";
+    {
+        auto plan = planCat(1000, 900, 500, 1);
+        EXPECT_EQ(plan.mStart, 900);
+        EXPECT_EQ(plan.mEnd, 1000);
+    }
+
+    G_SUBTEST << "Largest length";
+    {
+        auto plan = planCat(1000, 900, LLONG_MAX, 1);
+        EXPECT_EQ(plan.mStart, 900);
+        EXPECT_EQ(plan.mEnd, 1000);
+        expectCoversRange(plan);
+    }
+}
+
+TEST(CatPlanTest, NothingToStream)
+{
+    G_SUBTEST << "Offset past the end of the file";
+    {
+        auto plan = planCat(1000, 2000, -1, 4);
+        EXPECT_TRUE(plan.empty());
+        EXPECT_EQ(plan.segmentCount(), 0u);
+    }
+
+    G_SUBTEST << "Offset at the end of the file";
+    {
+        auto plan = planCat(1000, 1000, 10, 1);
+        EXPECT_TRUE(plan.empty());
+        EXPECT_EQ(plan.segmentCount(), 0u);
+    }
+
+    G_SUBTEST << "Length 0";
+    {
+        auto plan = planCat(1000, 10, 0, 4);
+        EXPECT_TRUE(plan.empty());
+        EXPECT_EQ(plan.segmentCount(), 0u);
+    }
+
+    G_SUBTEST << "Empty file";
+    {
+        auto plan = planCat(0, 0, -1, 1);
+        EXPECT_TRUE(plan.empty());
+        EXPECT_EQ(plan.segmentCount(), 0u);
+    }
+}
+
+TEST(CatPlanTest, SplitsInSegmentsWithSeveralStreams)
+{
+    G_SUBTEST << "A last partial segment";
+    {
+        auto plan = planCat(10 * SEGMENT, 0, 2 * SEGMENT + 5, 4);
+        EXPECT_EQ(plan.mSegmentSize, SEGMENT);
+        EXPECT_EQ(plan.mBufferCapacity, CAT_SEGMENT_SIZE);
+        ASSERT_EQ(plan.segmentCount(), 3u);
+        EXPECT_EQ(plan.mStreams, 3u);
+        EXPECT_EQ(plan.segment(2), std::make_pair(2 * SEGMENT, 2 * SEGMENT + 5));
+        expectCoversRange(plan);
+    }
+
+    G_SUBTEST << "Exact segments, from an offset";
+    {
+        auto plan = planCat(10 * SEGMENT, 3, 4 * SEGMENT, 2);
+        ASSERT_EQ(plan.segmentCount(), 4u);
+        EXPECT_EQ(plan.mStreams, 2u);
+        EXPECT_EQ(plan.segment(0), std::make_pair(3LL, SEGMENT + 3));
+        EXPECT_EQ(plan.segment(3), std::make_pair(3 * SEGMENT + 3, 4 * SEGMENT + 3));
+        expectCoversRange(plan);
+    }
+}
+
+TEST(CatPlanTest, StreamsBoundBySegments)
+{
+    G_SUBTEST << "More streams than segments";
+    {
+        auto plan = planCat(10 * SEGMENT, 0, 2 * SEGMENT, MAX_CAT_STREAMS);
+        EXPECT_EQ(plan.segmentCount(), 2u);
+        EXPECT_EQ(plan.mStreams, 2u);
+        expectCoversRange(plan);
+    }
+
+    G_SUBTEST << "A range within a segment: a single stream";
+    {
+        auto plan = planCat(10 * SEGMENT, 0, SEGMENT / 2, MAX_CAT_STREAMS);
+        EXPECT_EQ(plan.segmentCount(), 1u);
+        EXPECT_EQ(plan.mStreams, 1u);
+        EXPECT_EQ(plan.mBufferCapacity, CAT_BUFFER_CAPACITY);
+        expectCoversRange(plan);
+    }
+
+    G_SUBTEST << "More than MAX_CAT_STREAMS";
+    {
+        auto plan = planCat(100 * SEGMENT, 0, -1, MAX_CAT_STREAMS + 5);
+        EXPECT_EQ(plan.segmentCount(), 100u);
+        EXPECT_EQ(plan.mStreams, MAX_CAT_STREAMS);
+        expectCoversRange(plan);
+    }
+
+    G_SUBTEST << "No streams";
+    {
+        auto plan = planCat(100 * SEGMENT, 0, -1, 0);
+        EXPECT_EQ(plan.mStreams, 1u);
+        expectCoversRange(plan);
+    }
+}
@@ -0,0 +1,604 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifdef __linux__
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <set>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Instruments.h"
+#include "TestUtils.h"
+#include "comunicationsmanagerepoll.h"
+#include "megacmdcommonutils.h"
+
+using namespace megacmd;
+using namespace std::chrono_literals;
+
+namespace {
+
+// Returns the connected socket, or -1
+int connectClient()
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    auto socketPath = getOrCreateSocketPath(false);
+    strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+std::unique_ptr<CmdPetition> waitAndGetPetition(ComunicationsManagerEpoll &manager)
+{
+    if (manager.waitForPetition() != 0 || !manager.receivedPetition())
+    {
+        return nullptr;
+    }
+    return manager.getPetition();
+}
+
+bool sendAll(int client, const std::string &data)
+{
+    return send(client, data.data(), data.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(data.size());
+}
+
+// Returns false if a whole frame could not be received
+bool receiveSessionFrame(int client, SessionFrameHeader &header, std::string &payload)
+{
+    char headerBuffer[SESSION_FRAME_HEADER_SIZE];
+    if (recv(client, headerBuffer, sizeof(headerBuffer), MSG_WAITALL) != static_cast<ssize_t>(sizeof(headerBuffer))
+            || !parseSessionFrameHeader(std::string_view(headerBuffer, sizeof(headerBuffer)), header))
+    {
+        return false;
+    }
+
+    payload.resize(header.mPayloadSize);
+    return !header.mPayloadSize || recv(client, payload.data(), payload.size(), MSG_WAITALL) == static_cast<ssize_t>(payload.size());
+}
+
+std::string sessionRequest(uint32_t requestId, std::string_view petition)
+{
+    return frameSessionMessage(requestId, 0, petition);
+}
+
+}
+
+class ComunicationsManagerEpollTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        TestInstruments::Instance().clearAll();
+    }
+
+    void TearDown() override
+    {
+        TestInstruments::Instance().clearAll();
+    }
+};
+
+TEST_F(ComunicationsManagerEpollTest, GetPetitionReadsData)
+{
+    ComunicationsManagerEpoll manager;
+
+    int client = connectClient();
+    ASSERT_GE(client, 0);
+    std::string testData = "test command";
+    ASSERT_EQ(send(client, testData.data(), testData.size(), 0), static_cast<ssize_t>(testData.size()));
+
+    auto petition = waitAndGetPetition(manager);
+    ASSERT_NE(petition, nullptr);
+    EXPECT_EQ(petition->getLine(), testData);
+    EXPECT_FALSE(manager.receivedPetition());
+    close(client);
+}
+
+TEST_F(ComunicationsManagerEpollTest, GetPetitionReadsLargeData)
+{
+    ComunicationsManagerEpoll manager;
+
+    int client = connectClient();
+    ASSERT_GE(client, 0);
+    std::string largeData(100000, 'A');
+    auto sender = std::async(std::launch::async, [client, &largeData] {
+        return send(client, largeData.data(), largeData.size(), 0);
+    });
+
+    auto petition = waitAndGetPetition(manager);
+    EXPECT_EQ(sender.get(), static_cast<ssize_t>(largeData.size()));
+    ASSERT_NE(petition, nullptr);
+    EXPECT_EQ(petition->getLine().size(), largeData.size());
+    close(client);
+}
+
+TEST_F(ComunicationsManagerEpollTest, GetPetitionReadsFramedDataSentInPieces)
+{
+    ComunicationsManagerEpoll manager;
+
+    int client = connectClient();
+    ASSERT_GE(client, 0);
+    std::string testData = "find / --pattern=*.jpg";
+    std::string frame = framePetition(testData);
+
+    auto sender = std::async(std::launch::async, [client, &frame] {
+        for (size_t i = 0; i < frame.size(); i += 5)
+        {
+            auto pieceSize = std::min<size_t>(5, frame.size() - i);
+            if (send(client, frame.data() + i, pieceSize, 0) != static_cast<ssize_t>(pieceSize))
+            {
+                return false;
+            }
+            std::this_thread::sleep_for(1ms);
+        }
+        return true;
+    });
+
+    auto petition = waitAndGetPetition(manager);
+    EXPECT_TRUE(sender.get());
+    ASSERT_NE(petition, nullptr);
+    EXPECT_EQ(petition->getLine(), testData);
+
+    // acknowledged as framed
+    char ack[sizeof(PETITION_FRAME_ACK)];
+    ASSERT_EQ(recv(client, ack, sizeof(ack), MSG_WAITALL), static_cast<ssize_t>(sizeof(ack)));
+    EXPECT_EQ(memcmp(ack, PETITION_FRAME_ACK, sizeof(ack)), 0);
+    close(client);
+}
+
+TEST_F(ComunicationsManagerEpollTest, IdleClientDoesNotBlockOthers)
+{
+    ComunicationsManagerEpoll manager;
+
+    int idleClient = connectClient(); // connects, but never sends anything
+    ASSERT_GE(idleClient, 0);
+
+    int client = connectClient();
+    ASSERT_GE(client, 0);
+    ASSERT_GT(send(client, "version", 7, 0), 0);
+
+    auto petition = waitAndGetPetition(manager);
+    ASSERT_NE(petition, nullptr);
+    EXPECT_EQ(petition->getLine(), "version");
+
+    close(idleClient);
+    close(client);
+}
+
+TEST_F(ComunicationsManagerEpollTest, AllConcurrentClientsAreServed)
+{
+    ComunicationsManagerEpoll manager;
+
+    constexpr int numClients = 50;
+    std::vector<int> clients;
+    for (int i = 0; i < numClients; i++)
+    {
+        clients.push_back(connectClient());
+        ASSERT_GE(clients.back(), 0);
+        std::string testData = "test command " + std::to_string(i);
+        ASSERT_GT(send(clients.back(), testData.data(), testData.size(), 0), 0);
+    }
+
+    std::set<std::string> received;
+    while (received.size() < numClients)
+    {
+        auto petition = waitAndGetPetition(manager);
+        ASSERT_NE(petition, nullptr);
+        received.emplace(petition->getLine());
+    }
+
+    for (int i = 0; i < numClients; i++)
+    {
+        EXPECT_EQ(received.count("test command " + std::to_string(i)), 1u);
+        close(clients[i]);
+    }
+}
+
+TEST_F(ComunicationsManagerEpollTest, ReturnAndClosePetitionSendsData)
+{
+    ComunicationsManagerEpoll manager;
+
+    int client = connectClient();
+    ASSERT_GE(client, 0);
+    ASSERT_GT(send(client, "test", 4, 0), 0);
+
+    auto petition = waitAndGetPetition(manager);
+    ASSERT_NE(petition, nullptr);
+
+    OUTSTRINGSTREAM response;
+    response << "response data";
+    manager.returnAndClosePetition(std::move(petition), &response, 0);
+
+    int outCode = -1;
+    ASSERT_EQ(recv(client, &outCode, sizeof(outCode), MSG_WAITALL), static_cast<ssize_t>(sizeof(outCode)));
+    EXPECT_EQ(outCode, 0);
+
+    std::string received;
+    char buffer[64];
+    ssize_t n;
+    while ((n = recv(client, buffer, sizeof(buffer), 0)) > 0)
+    {
+        received.append(buffer, static_cast<size_t>(n));
+    }
+    EXPECT_EQ(received, "response data");
+    close(client);
+}
+
+TEST_F(ComunicationsManagerEpollTest, StopWaitingWakesUpWait)
+{
+    ComunicationsManagerEpoll manager;
+
+    auto waiter = std::async(std::launch::async, [&manager] { return manager.waitForPetition(); });
+    EXPECT_EQ(waiter.wait_for(100ms), std::future_status::timeout);
+
+    manager.stopWaiting();
+    ASSERT_EQ(waiter.wait_for(5s), std::future_status::ready);
+    EXPECT_EQ(waiter.get(), 0);
+    EXPECT_FALSE(manager.receivedPetition());
+}
+
+TEST_F(ComunicationsManagerEpollTest, StateListenersAboveFdSetSize)
+{
+    constexpr int numListeners = FD_SETSIZE + 100;
+
+    struct rlimit limit;
+    ASSERT_EQ(getrlimit(RLIMIT_NOFILE, &limit), 0);
+    const rlim_t required = numListeners * 3;
+    if (limit.rlim_max != RLIM_INFINITY && limit.rlim_max < required)
+    {
+        GTEST_SKIP() << "Not enough file descriptors allowed: " << limit.rlim_max;
+    }
+    const struct rlimit oldLimit = limit;
+    limit.rlim_cur = std::max(limit.rlim_cur, required);
+    ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &limit), 0);
+
+    {
+        ComunicationsManagerEpoll manager;
+        EXPECT_GE(manager.getMaxStateListeners(), numListeners);
+
+        std::vector<int> clients;
+
+        // Every registration sends an "ack" to all listeners: consume them as a client would
+        auto drainClients = [&clients] {
+            char buffer[1024];
+            for (int client : clients)
+            {
+                while (recv(client, buffer, sizeof(buffer), MSG_DONTWAIT) > 0);
+            }
+        };
+
+        for (int i = 0; i < numListeners; i++)
+        {
+            int client = connectClient();
+            ASSERT_GE(client, 0);
+            clients.push_back(client);
+            ASSERT_GT(send(client, "registerstatelistener", 21, 0), 0);
+
+            auto petition = waitAndGetPetition(manager);
+            ASSERT_NE(petition, nullptr);
+            ASSERT_NE(manager.registerStateListener(std::move(petition)), nullptr);
+
+            if (i % 50 == 0)
+            {
+                drainClients();
+            }
+        }
+        drainClients();
+
+        EXPECT_TRUE(manager.informStateListeners("hello"));
+
+        // Even those listening on fds that select could not handle get informed
+        for (int client : {clients.front(), clients.back()})
+        {
+            char buffer[16] = {};
+            EXPECT_EQ(recv(client, buffer, sizeof(buffer), 0), 6);
+            EXPECT_STREQ(buffer, "hello\x1F");
+        }
+
+        // Hung up listeners get removed
+        for (int client : clients)
+        {
+            close(client);
+        }
+        int client = connectClient();
+        ASSERT_GE(client, 0);
+        ASSERT_GT(send(client, "version", 7, 0), 0);
+        auto petition = waitAndGetPetition(manager);
+        ASSERT_NE(petition, nullptr);
+        EXPECT_EQ(petition->getLine(), "version");
+        EXPECT_FALSE(manager.informStateListeners("anybody?"));
+        close(client);
+    }
+
+    setrlimit(RLIMIT_NOFILE, &oldLimit);
+}
+
+TEST_F(ComunicationsManagerEpollTest, SessionServesManyRequestsOverOneConnection)
+{
+    ComunicationsManagerEpoll manager;
+
+    int client = connectClient();
+    ASSERT_GE(client, 0);
+    ASSERT_TRUE(sendAll(client, framePetition(SESSION_PETITION) + sessionRequest(1, "ls") + sessionRequest(2, "pwd")));
+
+    std::vector<std::unique_ptr<CmdPetition>> petitions;
+    while (petitions.size() < 2)
+    {
+        auto petition = waitAndGetPetition(manager);
+        ASSERT_NE(petition, nullptr);
+        petitions.push_back(std::move(petition));
+    }
+    EXPECT_EQ(petitions[0]->getLine(), "ls");
+    EXPECT_EQ(static_cast<CmdPetitionPosixSockets*>(petitions[0].get())->mRequestId, 1u);
+    EXPECT_EQ(petitions[1]->getLine(), "pwd");
+    EXPECT_EQ(static_cast<CmdPetitionPosixSockets*>(petitions[1].get())->mRequestId, 2u);
+
+    SessionFrameHeader header;
+    std::string payload;
+    ASSERT_TRUE(receiveSessionFrame(client, header, payload));
+    EXPECT_EQ(header.mRequestId, 0u);
+    EXPECT_EQ(header.mCode, MCMD_OK);
+
+    // Responses are tagged with their request, whatever the order they are given in
+    OUTSTRING partial = "partial";
+    manager.sendPartialOutput(petitions[1].get(), &partial);
+    manager.flushPartialOutputs(petitions[1].get());
+    OUTSTRINGSTREAM response2;
+    response2 << "/";
+    manager.returnAndClosePetition(std::move(petitions[1]), &response2, MCMD_OK);
+    OUTSTRINGSTREAM response1;
+    response1 << "not logged in";
+    manager.returnAndClosePetition(std::move(petitions[0]), &response1, MCMD_NOTLOGGEDIN);
+
+    ASSERT_TRUE(receiveSessionFrame(client, header, payload));
+    EXPECT_EQ(header.mRequestId, 2u);
+    EXPECT_EQ(header.mCode, MCMD_PARTIALOUT);
+    EXPECT_EQ(payload, "partial");
+    ASSERT_TRUE(receiveSessionFrame(client, header, payload));
+    EXPECT_EQ(header.mRequestId, 2u);
+    EXPECT_EQ(header.mCode, MCMD_OK);
+    EXPECT_EQ(payload, "/");
+    ASSERT_TRUE(receiveSessionFrame(client, header, payload));
+    EXPECT_EQ(header.mRequestId, 1u);
+    EXPECT_EQ(header.mCode, MCMD_NOTLOGGEDIN);
+    EXPECT_EQ(payload, "not logged in");
+
+    // The connection is still open for more requests
+    ASSERT_TRUE(sendAll(client, sessionRequest(3, "whoami")));
+    auto petition = waitAndGetPetition(manager);
+    ASSERT_NE(petition, nullptr);
+    EXPECT_EQ(petition->getLine(), "whoami");
+    OUTSTRINGSTREAM response3;
+    manager.returnAndClosePetition(std::move(petition), &response3, MCMD_OK);
+    ASSERT_TRUE(receiveSessionFrame(client, header, payload));
+    EXPECT_EQ(header.mRequestId, 3u);
+    EXPECT_TRUE(payload.empty());
+
+    close(client);
+}
+
+TEST_F(ComunicationsManagerEpollTest, SessionQuestionsAreDismissed)
+{
+    ComunicationsManagerEpoll manager;
+
+    int client = connectClient();
+    ASSERT_GE(client, 0);
+    ASSERT_TRUE(sendAll(client, framePetition(SESSION_PETITION) + sessionRequest(7, "rm -r /dir")));
+
+    auto petition = waitAndGetPetition(manager);
+    ASSERT_NE(petition, nullptr);
+    EXPECT_EQ(manager.getConfirmation(petition.get(), "Are you sure?"), MCMDCONFIRM_NO);
+    EXPECT_EQ(manager.getUserResponse(petition.get(), "Name?"), "FAILED");
+    OUTSTRINGSTREAM response;
+    manager.returnAndClosePetition(std::move(petition), &response, MCMD_OK);
+
+    SessionFrameHeader header;
+    std::string payload;
+    ASSERT_TRUE(receiveSessionFrame(client, header, payload)); // ack
+    for (auto question : {"Are you sure?", "Name?"})
+    {
+        ASSERT_TRUE(receiveSessionFrame(client, header, payload));
+        EXPECT_EQ(header.mRequestId, 7u);
+        EXPECT_EQ(header.mCode, MCMD_PARTIALERR);
+        EXPECT_EQ(payload.rfind(question, 0), 0u);
+    }
+
+    // and the request fails, as it did not go as the user would have been asked
+    ASSERT_TRUE(receiveSessionFrame(client, header, payload));
+    EXPECT_EQ(header.mRequestId, 7u);
+    EXPECT_EQ(header.mCode, MCMD_NOTPERMITTED);
+    close(client);
+}
+
+TEST_F(ComunicationsManagerEpollTest, SessionRejectsRequestsTakingOverTheConnection)
+{
+    ComunicationsManagerEpoll manager;
+
+    int client = connectClient();
+    ASSERT_GE(client, 0);
+    ASSERT_TRUE(sendAll(client, framePetition(SESSION_PETITION) + sessionRequest(1, "Xregisterstatelistener")
+                                + sessionRequest(2, std::string(SESSION_PETITION)) + sessionRequest(3, "ls")));
+
+    // only the last one becomes a petition
+    auto petition = waitAndGetPetition(manager);
+    ASSERT_NE(petition, nullptr);
+    EXPECT_EQ(petition->getLine(), "ls");
+    EXPECT_EQ(static_cast<CmdPetitionPosixSockets*>(petition.get())->mRequestId, 3u);
+
+    SessionFrameHeader header;
+    std::string payload;
+    ASSERT_TRUE(receiveSessionFrame(client, header, payload)); // ack
+    for (uint32_t requestId : {1u, 2u})
+    {
+        ASSERT_TRUE(receiveSessionFrame(client, header, payload));
+        EXPECT_EQ(header.mRequestId, requestId);
+        EXPECT_EQ(header.mCode, MCMD_NOTPERMITTED);
+        EXPECT_FALSE(payload.empty());
+    }
+
+    // the session goes on
+    OUTSTRINGSTREAM response;
+    response << "file";
+    manager.returnAndClosePetition(std::move(petition), &response, MCMD_OK);
+    ASSERT_TRUE(receiveSessionFrame(client, header, payload));
+    EXPECT_EQ(header.mRequestId, 3u);
+    EXPECT_EQ(header.mCode, MCMD_OK);
+    EXPECT_EQ(payload, "file");
+    close(client);
+}
+
+TEST_F(ComunicationsManagerEpollTest, SessionRequestsAreServedAfterClientStopsSending)
+{
+    ComunicationsManagerEpoll manager;
+
+    int client = connectClient();
+    ASSERT_GE(client, 0);
+    ASSERT_TRUE(sendAll(client, framePetition(SESSION_PETITION) + sessionRequest(1, "version")));
+    ASSERT_EQ(shutdown(client, SHUT_WR), 0);
+
+    auto petition = waitAndGetPetition(manager);
+    ASSERT_NE(petition, nullptr);
+    EXPECT_EQ(petition->getLine(), "version");
+    EXPECT_TRUE(manager.isClientConnected(petition.get())); // still reading the responses
+
+    OUTSTRINGSTREAM response;
+    response << "1.0";
+    manager.returnAndClosePetition(std::move(petition), &response, MCMD_OK);
+
+    SessionFrameHeader header;
+    std::string payload;
+    ASSERT_TRUE(receiveSessionFrame(client, header, payload)); // ack
+    ASSERT_TRUE(receiveSessionFrame(client, header, payload));
+    EXPECT_EQ(header.mRequestId, 1u);
+    EXPECT_EQ(payload, "1.0");
+
+    // Once the last request is done, the session socket gets closed
+    char buffer[16];
+    EXPECT_EQ(recv(client, buffer, sizeof(buffer), 0), 0);
+    close(client);
+}
+
+// Compares a connection per petition (as every mega-* invocation does) against a persistent session
+TEST_F(ComunicationsManagerEpollTest, DISABLED_SessionThroughputBenchmark)
+{
+    constexpr int numPetitions = 5000;
+    constexpr int maxInFlight = 16;
+
+    ComunicationsManagerEpoll manager;
+
+    std::atomic<bool> stop = false;
+    std::thread server([&manager, &stop] {
+        while (!stop)
+        {
+            if (manager.waitForPetition() != 0)
+            {
+                continue;
+            }
+            while (manager.receivedPetition())
+            {
+                OUTSTRINGSTREAM response;
+                response << "ok";
+                manager.returnAndClosePetition(manager.getPetition(), &response, MCMD_OK);
+            }
+        }
+    });
+
+    auto petitionsPerSecond = [](std::chrono::steady_clock::duration elapsed) {
+        return numPetitions / std::chrono::duration<double>(elapsed).count();
+    };
+
+    double connectionPerPetitionRate = 0;
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < numPetitions; ++i)
+        {
+            int client = connectClient();
+            ASSERT_GE(client, 0);
+            ASSERT_TRUE(sendAll(client, framePetition("version")));
+
+            std::string received;
+            char buffer[64];
+            ssize_t n;
+            while ((n = recv(client, buffer, sizeof(buffer), 0)) > 0)
+            {
+                received.append(buffer, static_cast<size_t>(n));
+            }
+            close(client);
+            ASSERT_EQ(received.substr(sizeof(PETITION_FRAME_ACK) + sizeof(int)), "ok");
+        }
+        connectionPerPetitionRate = petitionsPerSecond(std::chrono::steady_clock::now() - start);
+    }
+
+    double sessionRate = 0;
+    {
+        auto start = std::chrono::steady_clock::now();
+        int client = connectClient();
+        ASSERT_GE(client, 0);
+        ASSERT_TRUE(sendAll(client, framePetition(SESSION_PETITION)));
+
+        SessionFrameHeader header;
+        std::string payload;
+        ASSERT_TRUE(receiveSessionFrame(client, header, payload)); // ack
+
+        int sent = 0;
+        int received = 0;
+        while (received < numPetitions)
+        {
+            std::string requests;
+            for (; sent < numPetitions && sent - received < maxInFlight; ++sent)
+            {
+                requests.append(sessionRequest(sent + 1, "version"));
+            }
+            ASSERT_TRUE(requests.empty() || sendAll(client, requests));
+
+            ASSERT_TRUE(receiveSessionFrame(client, header, payload));
+            ASSERT_EQ(payload, "ok");
+            ++received;
+        }
+        close(client);
+        sessionRate = petitionsPerSecond(std::chrono::steady_clock::now() - start);
+    }
+
+    stop = true;
+    manager.stopWaiting();
+    server.join();
+
+    G_TEST_INFO << "Connection per petition: " << static_cast<long long>(connectionPerPetitionRate) << " petitions/sec";
+    G_TEST_INFO << "Persistent session: " << static_cast<long long>(sessionRate) << " petitions/sec";
+}
+
+#endif
@@ -32,6 +32,7 @@
 #include <gtest/gtest.h>
 
 #include "Instruments.h"
+#include "TestUtils.h"
 #include "comunicationsmanagerfilesockets.h"
 #include "megacmdcommonutils.h"
 
@@ -149,6 +150,29 @@ std::unique_ptr<CmdPetition> sendPetition(ComunicationsManagerFileSockets &manag
     return nullptr;
 }
 
+// Reads a whole MCMD_PARTIALOUT/MCMD_PARTIALERR frame: outCode, size and contents
+std::string receivePartialOutputFrame(TestSocketClient &client, int &outCode)
+{
+    outCode = MCMD_OK;
+    if (client.receive(&outCode, sizeof(outCode), MSG_WAITALL) != sizeof(outCode))
+    {
+        return {};
+    }
+
+    size_t size = 0;
+    if (client.receive(&size, sizeof(size), MSG_WAITALL) != sizeof(size))
+    {
+        return {};
+    }
+
+    std::string contents(size, '\0');
+    if (size && client.receive(contents.data(), size, MSG_WAITALL) != static_cast<ssize_t>(size))
+    {
+        return {};
+    }
+    return contents;
+}
+
 #ifdef __MACH__
 // On macOS, MSG_NOSIGNAL doesn't work, so we need to ignore SIGPIPE
 // to prevent the process from being killed when writing to closed socket
@@ -231,6 +255,93 @@ TEST_F(ComunicationsManagerFileSocketsWithClientTest, GetPetitionReadsLargeData)
     EXPECT_EQ(petition->getLine(), largeData);
 }
 
+TEST(PetitionFrameTest, ParseHeader)
+{
+    uint64_t payloadSize = 0;
+    const std::string frame = framePetition("ls -l");
+    ASSERT_EQ(frame.size(), PETITION_FRAME_HEADER_SIZE + 5);
+    EXPECT_EQ(frame.substr(PETITION_FRAME_HEADER_SIZE), "ls -l");
+
+    EXPECT_EQ(parsePetitionFrameHeader(frame, payloadSize), PetitionFrameStatus::FRAMED);
+    EXPECT_EQ(payloadSize, 5u);
+
+    G_SUBTEST << "Incomplete header";
+    EXPECT_EQ(parsePetitionFrameHeader("", payloadSize), PetitionFrameStatus::INCOMPLETE);
+    EXPECT_EQ(parsePetitionFrameHeader(std::string_view(frame.data(), 1), payloadSize), PetitionFrameStatus::INCOMPLETE);
+    EXPECT_EQ(parsePetitionFrameHeader(std::string_view(frame.data(), PETITION_FRAME_HEADER_SIZE - 1), payloadSize), PetitionFrameStatus::INCOMPLETE);
+
+    G_SUBTEST << "Raw petitions";
+    EXPECT_EQ(parsePetitionFrameHeader("ls -l", payloadSize), PetitionFrameStatus::RAW);
+    EXPECT_EQ(parsePetitionFrameHeader("l", payloadSize), PetitionFrameStatus::RAW);
+    EXPECT_EQ(parsePetitionFrameHeader("Xregisterstatelistener", payloadSize), PetitionFrameStatus::RAW);
+
+    G_SUBTEST << "Unsupported version";
+    std::string wrongVersion = frame;
+    wrongVersion[sizeof(PETITION_FRAME_MAGIC)] = 2;
+    EXPECT_EQ(parsePetitionFrameHeader(wrongVersion, payloadSize), PetitionFrameStatus::INVALID);
+}
+
+TEST_F(ComunicationsManagerFileSocketsWithClientTest, GetPetitionReadsFramedData)
+{
+    std::string testData = "put " + std::string(100000, 'f');
+    std::string frame = framePetition(testData);
+
+    // Payload sent after a while: the server must wait for it (legacy reads would stop short)
+    std::thread sender([this, &frame]() {
+        std::this_thread::sleep_for(20ms);
+        mClient->send(frame.data() + PETITION_FRAME_HEADER_SIZE, frame.size() - PETITION_FRAME_HEADER_SIZE);
+    });
+    ASSERT_TRUE(mClient->send(frame.data(), PETITION_FRAME_HEADER_SIZE));
+    auto petition = mManager.getPetition();
+    sender.join();
+
+    ASSERT_NE(petition, nullptr);
+    EXPECT_EQ(petition->getLine(), testData);
+}
+
+TEST_F(ComunicationsManagerFileSocketsWithClientTest, GetPetitionGivesUpOnStalledClients)
+{
+    mManager.setPetitionReadTimeout(100ms);
+    const std::string frame = framePetition("put " + std::string(1000, 'f'));
+
+    G_SUBTEST << "Stalled within the header";
+    {
+        ASSERT_TRUE(mClient->send(frame.data(), PETITION_FRAME_HEADER_SIZE / 2));
+        auto start = std::chrono::steady_clock::now();
+        auto petition = mManager.getPetition();
+        ASSERT_NE(petition, nullptr);
+        EXPECT_EQ(petition->getLine(), "ERROR");
+        EXPECT_LT(std::chrono::steady_clock::now() - start, 5s);
+    }
+
+    G_SUBTEST << "Stalled within the payload";
+    {
+        TestSocketClient client;
+        ASSERT_TRUE(client.send(frame.data(), frame.size() - 10));
+        auto petition = mManager.getPetition();
+        ASSERT_NE(petition, nullptr);
+        EXPECT_EQ(petition->getLine(), "ERROR");
+    }
+
+    G_SUBTEST << "Others are served afterwards";
+    {
+        TestSocketClient client;
+        auto petition = sendPetition(mManager, client, framePetition("version"));
+        ASSERT_NE(petition, nullptr);
+        EXPECT_EQ(petition->getLine(), "version");
+    }
+}
+
+TEST_F(ComunicationsManagerFileSocketsWithClientTest, GetPetitionRejectsUnsupportedFrames)
+{
+    std::string frame = framePetition("version");
+    frame[sizeof(PETITION_FRAME_MAGIC)] = 7;
+    auto petition = sendPetition(mManager, *mClient, frame);
+
+    ASSERT_NE(petition, nullptr);
+    EXPECT_EQ(petition->getLine(), "ERROR");
+}
+
 TEST_F(ComunicationsManagerFileSocketsWithClientTest, ReturnAndClosePetitionSendsData)
 {
     auto petition = sendPetition(mManager, *mClient, "test");
@@ -252,6 +363,34 @@ TEST_F(ComunicationsManagerFileSocketsWithClientTest, ReturnAndClosePetitionSend
     EXPECT_STREQ(buffer, "response data");
 }
 
+TEST_F(ComunicationsManagerFileSocketsWithClientTest, AcknowledgesFramedPetitionsBeforeResponding)
+{
+    auto petition = sendPetition(mManager, *mClient, framePetition("version"));
+    ASSERT_NE(petition, nullptr);
+    EXPECT_EQ(petition->getLine(), "version");
+
+    OUTSTRINGSTREAM response;
+    response << "ok";
+    mManager.returnAndClosePetition(std::move(petition), &response, MCMD_OK);
+
+    char ack[sizeof(PETITION_FRAME_ACK)];
+    ASSERT_EQ(mClient->receive(ack, sizeof(ack), MSG_WAITALL), static_cast<ssize_t>(sizeof(ack)));
+    EXPECT_EQ(memcmp(ack, PETITION_FRAME_ACK, sizeof(ack)), 0);
+
+    int outCode = -1;
+    ASSERT_EQ(mClient->receive(&outCode, sizeof(outCode), MSG_WAITALL), static_cast<ssize_t>(sizeof(outCode)));
+    EXPECT_EQ(outCode, MCMD_OK);
+
+    G_SUBTEST << "Raw petitions are not acknowledged";
+    TestSocketClient rawClient;
+    ASSERT_TRUE(rawClient.isConnected());
+    petition = sendPetition(mManager, rawClient, "version");
+    ASSERT_NE(petition, nullptr);
+    mManager.returnAndClosePetition(std::move(petition), &response, 42);
+    ASSERT_EQ(rawClient.receive(&outCode, sizeof(outCode), MSG_WAITALL), static_cast<ssize_t>(sizeof(outCode)));
+    EXPECT_EQ(outCode, 42);
+}
+
 TEST_F(ComunicationsManagerFileSocketsWithClientTest, ReturnAndClosePetitionWithEmptyResponse)
 {
     auto petition = sendPetition(mManager, *mClient, "test");
@@ -278,6 +417,7 @@ TEST_F(ComunicationsManagerFileSocketsWithClientTest, SendPartialOutput)
 
     std::string partialData = "partial output";
     mManager.sendPartialOutput(petition.get(), partialData.data(), partialData.size(), false);
+    mManager.flushPartialOutputs(petition.get());
 
     int outCode = MCMD_OK;
     mClient->receive(&outCode, sizeof(outCode));
@@ -301,12 +441,98 @@ TEST_F(ComunicationsManagerFileSocketsWithClientTest, SendPartialError)
 
     std::string errorData = "error message";
     mManager.sendPartialError(petition.get(), errorData.data(), errorData.size(), false);
+    mManager.flushPartialOutputs(petition.get());
 
     int outCode = MCMD_OK;
     mClient->receive(&outCode, sizeof(outCode));
     EXPECT_EQ(outCode, MCMD_PARTIALERR);
 }
 
+TEST_F(ComunicationsManagerFileSocketsWithClientTest, PartialOutputsAreCoalescedUntilFlushed)
+{
+    auto petition = sendPetition(mManager, *mClient, "test");
+    ASSERT_NE(petition, nullptr);
+
+    for (std::string piece : {"file1", "\t", "1024", "\n"})
+    {
+        mManager.sendPartialOutput(petition.get(), &piece);
+    }
+
+    char buffer[64];
+    EXPECT_LE(mClient->receive(buffer, sizeof(buffer), MSG_DONTWAIT), 0);
+
+    mManager.flushPartialOutputs(petition.get());
+
+    int outCode = MCMD_OK;
+    EXPECT_EQ(receivePartialOutputFrame(*mClient, outCode), "file1\t1024\n");
+    EXPECT_EQ(outCode, MCMD_PARTIALOUT);
+
+    // nothing else pending
+    EXPECT_LE(mClient->receive(buffer, sizeof(buffer), MSG_DONTWAIT), 0);
+}
+
+TEST_F(ComunicationsManagerFileSocketsWithClientTest, PartialOutputsKeepOrderBetweenOutputsAndErrors)
+{
+    auto petition = sendPetition(mManager, *mClient, "test");
+    ASSERT_NE(petition, nullptr);
+
+    std::string out1 = "out1", err1 = "err1", err2 = "err2", out2 = "out2";
+    mManager.sendPartialOutput(petition.get(), &out1);
+    mManager.sendPartialError(petition.get(), &err1);
+    mManager.sendPartialError(petition.get(), &err2);
+    mManager.sendPartialOutput(petition.get(), &out2);
+    mManager.flushPartialOutputs(petition.get());
+
+    int outCode = MCMD_OK;
+    EXPECT_EQ(receivePartialOutputFrame(*mClient, outCode), "out1");
+    EXPECT_EQ(outCode, MCMD_PARTIALOUT);
+    EXPECT_EQ(receivePartialOutputFrame(*mClient, outCode), "err1err2");
+    EXPECT_EQ(outCode, MCMD_PARTIALERR);
+    EXPECT_EQ(receivePartialOutputFrame(*mClient, outCode), "out2");
+    EXPECT_EQ(outCode, MCMD_PARTIALOUT);
+}
+
+TEST_F(ComunicationsManagerFileSocketsWithClientTest, LargePartialOutputIsSentWithoutFlush)
+{
+    auto petition = sendPetition(mManager, *mClient, "test");
+    ASSERT_NE(petition, nullptr);
+
+    std::string small = "header\n";
+    mManager.sendPartialOutput(petition.get(), &small);
+
+    // Sent from another thread: the socket buffer may not hold the whole frame
+    std::string large(ComunicationsManagerFileSockets::PARTIAL_OUTPUT_FLUSH_THRESHOLD * 4, 'x');
+    std::thread sender([this, &petition, &large]() {
+        mManager.sendPartialOutput(petition.get(), large.data(), large.size(), true);
+    });
+
+    int outCode = MCMD_OK;
+    EXPECT_EQ(receivePartialOutputFrame(*mClient, outCode), small);
+    EXPECT_EQ(receivePartialOutputFrame(*mClient, outCode), large);
+    EXPECT_EQ(outCode, MCMD_PARTIALOUT);
+    sender.join();
+}
+
+TEST_F(ComunicationsManagerFileSocketsWithClientTest, ReturnAndClosePetitionFlushesPartialOutputs)
+{
+    auto petition = sendPetition(mManager, *mClient, "test");
+    ASSERT_NE(petition, nullptr);
+
+    std::string partialData = "partial output";
+    mManager.sendPartialOutput(petition.get(), &partialData);
+
+    OUTSTRINGSTREAM response;
+    mManager.returnAndClosePetition(std::move(petition), &response, MCMD_OK);
+
+    int outCode = MCMD_OK;
+    EXPECT_EQ(receivePartialOutputFrame(*mClient, outCode), partialData);
+    EXPECT_EQ(outCode, MCMD_PARTIALOUT);
+
+    outCode = -1;
+    ASSERT_EQ(mClient->receive(&outCode, sizeof(outCode), MSG_WAITALL), static_cast<ssize_t>(sizeof(outCode)));
+    EXPECT_EQ(outCode, MCMD_OK);
+}
+
 TEST_F(ComunicationsManagerFileSocketsWithClientTest, SendPartialOutputHandlesEPIPE)
 {
     auto petition = sendPetition(mManager, *mClient, "test");
@@ -320,6 +546,7 @@ TEST_F(ComunicationsManagerFileSocketsWithClientTest, SendPartialOutputHandlesEP
 
     std::string data = "test data";
     mManager.sendPartialOutput(petition.get(), data.data(), data.size(), false);
+    mManager.flushPartialOutputs(petition.get());
 
     EXPECT_TRUE(petition->clientDisconnected);
 
@@ -328,6 +555,17 @@ TEST_F(ComunicationsManagerFileSocketsWithClientTest, SendPartialOutputHandlesEP
 #endif
 }
 
+TEST_F(ComunicationsManagerFileSocketsWithClientTest, IsClientConnectedDetectsHangUp)
+{
+    auto petition = sendPetition(mManager, *mClient, "find / --pattern=*.log");
+    ASSERT_NE(petition, nullptr);
+    EXPECT_TRUE(mManager.isClientConnected(petition.get()));
+
+    mClient->close(); // with no output written, it is only noticed checking the connection
+    EXPECT_FALSE(mManager.isClientConnected(petition.get()));
+    EXPECT_TRUE(petition->clientDisconnected);
+}
+
 TEST_F(ComunicationsManagerFileSocketsWithClientTest, SendPartialOutputValidatesUTF8)
 {
     auto petition = sendPetition(mManager, *mClient, "test");
@@ -402,6 +640,34 @@ TEST_F(ComunicationsManagerFileSocketsWithClientTest, InformStateListenerHandles
 #endif
 }
 
+// A client not reading its state messages does not block whoever informs it, and gets evicted once too far behind
+TEST_F(ComunicationsManagerFileSocketsWithClientTest, InformStateListenerDoesNotBlockOnFrozenClient)
+{
+    auto petition = sendPetition(mManager, *mClient, "test");
+    ASSERT_NE(petition, nullptr);
+
+    auto listener = mManager.registerStateListener(std::move(petition));
+    ASSERT_NE(listener, nullptr);
+
+    // superseded progress messages are coalesced: these never get it evicted
+    for (int i = 0; i < 100000; ++i)
+    {
+        ASSERT_EQ(mManager.informStateListener(listener, "progress:" + std::to_string(i) + ":100000\x1F"), 0);
+    }
+
+    const std::string message = "message:" + std::string(4096, 'm') + "\x1F";
+    auto start = std::chrono::steady_clock::now();
+    int result = 0;
+    int informed = 0;
+    for (; informed < 10000 && result == 0; ++informed)
+    {
+        result = mManager.informStateListener(listener, message);
+    }
+    EXPECT_EQ(result, -1);
+    G_TEST_INFO << "Frozen listener evicted after " << informed << " messages, in "
+                << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << " ms";
+}
+
 TEST_F(ComunicationsManagerFileSocketsWithClientTest, InformStateListenerValidatesUTF8)
 {
     auto petition = sendPetition(mManager, *mClient, "test");
@@ -0,0 +1,239 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_config_store.h"
+
+using namespace megacmd;
+using namespace std::chrono_literals;
+
+namespace
+{
+void writeFile(const fs::path &file, const std::string &content)
+{
+    std::ofstream fo(file);
+    fo << content;
+}
+
+std::string readFile(const fs::path &file)
+{
+    std::ifstream fi(file);
+    std::ostringstream content;
+    content << fi.rdbuf();
+    return content.str();
+}
+}
+
+TEST(ConfigStoreTest, ParsesValues)
+{
+    EXPECT_EQ(parseConfigValue<int>("-12"), -12);
+    EXPECT_EQ(parseConfigValue<int>("+12"), 12);
+    EXPECT_EQ(parseConfigValue<int>("12 MB"), 12);
+    EXPECT_EQ(parseConfigValue<int>("abc"), std::nullopt);
+    EXPECT_EQ(parseConfigValue<unsigned long long>("18446744073709551615"), 18446744073709551615ull);
+    EXPECT_EQ(parseConfigValue<long long>("99999999999999999999"), std::nullopt);
+    EXPECT_EQ(parseConfigValue<double>("0.5"), 0.5);
+    EXPECT_EQ(parseConfigValue<double>("x"), std::nullopt);
+    EXPECT_EQ(parseConfigValue<bool>("1"), true);
+    EXPECT_EQ(parseConfigValue<bool>("0"), false);
+    EXPECT_EQ(parseConfigValue<bool>("2"), true);
+    EXPECT_EQ(parseConfigValue<bool>("true"), true);
+    EXPECT_EQ(parseConfigValue<bool>("false"), false);
+    EXPECT_EQ(parseConfigValue<bool>("yes"), std::nullopt);
+    EXPECT_EQ(parseConfigValue<std::string>("a b"), "a b");
+}
+
+TEST(ConfigStoreTest, ReadsLikeThePropertiesFile)
+{
+    SelfDeletingTmpFolder tmpFolder;
+    const fs::path file = tmpFolder.path() / "megacmd.cfg";
+    writeFile(file, "# comment=1\n"
+                    "number=42\n"
+                    "spaced   = 7 \n"
+                    "quoted=\"a value\"\n"
+                    "empty=\n"
+                    "no value here\n"
+                    "twice=first\n"
+                    "twice=second\n");
+
+    ConfigStore store;
+    store.load(file);
+    for (const char *key : {"number", "spaced", "quoted", "empty", "twice", "# comment", "missing"})
+    {
+        auto expected = getPropertyFromFile(file, key);
+        EXPECT_EQ(store.get(key).value_or(""), expected) << key;
+    }
+    EXPECT_EQ(store.getAs<int>("number"), 42);
+    EXPECT_EQ(store.getAs<int>("spaced"), 7);
+    EXPECT_EQ(store.getAs<int>("quoted"), std::nullopt);
+    EXPECT_EQ(store.getAs<int>("empty"), std::nullopt);
+}
+
+TEST(ConfigStoreTest, WritesBackKeepingOtherLines)
+{
+    SelfDeletingTmpFolder tmpFolder;
+    const fs::path file = tmpFolder.path() / "megacmd.cfg";
+    writeFile(file, "# comment\na=1\nb=2\n");
+
+    ConfigStore store;
+    store.load(file);
+    EXPECT_EQ(store.set("a", "3"), "1");
+    EXPECT_EQ(store.set("c", "4"), "");
+    EXPECT_EQ(store.get("a"), "3");
+    EXPECT_TRUE(store.hasPendingChanges());
+
+    EXPECT_TRUE(store.flush());
+    EXPECT_FALSE(store.hasPendingChanges());
+    EXPECT_EQ(readFile(file), "# comment\na=3\nb=2\nc=4\n");
+    EXPECT_FALSE(fs::exists(tmpFolder.path() / "megacmd.cfg.tmp"));
+
+    // setting the same value again is no change
+    store.set("b", "2");
+    EXPECT_FALSE(store.hasPendingChanges());
+
+    store.retainOnly({"b"});
+    EXPECT_EQ(store.get("a"), std::nullopt);
+    EXPECT_TRUE(store.flush());
+    EXPECT_EQ(readFile(file), "# comment\nb=2\n");
+    EXPECT_EQ(store.getWriteCount(), 2u);
+}
+
+TEST(ConfigStoreTest, KeepsChangesPendingWhenTheyCannotBeWritten)
+{
+    SelfDeletingTmpFolder tmpFolder;
+    const fs::path file = tmpFolder.path() / "missing" / "megacmd.cfg";
+
+    std::vector<std::string> errors;
+    ConfigStore store;
+    store.setWriteErrorHandler([&errors](const std::string &error) { errors.push_back(error); });
+    store.load(file);
+    store.set("a", "1");
+
+    EXPECT_FALSE(store.flush());
+    EXPECT_EQ(errors.size(), 1u);
+    EXPECT_TRUE(store.hasPendingChanges());
+    EXPECT_EQ(store.getWriteCount(), 0u);
+
+    // written once possible
+    fs::create_directory(file.parent_path());
+    EXPECT_TRUE(store.flush());
+    EXPECT_EQ(readFile(file), "a=1\n");
+    EXPECT_FALSE(fs::exists(file.parent_path() / "megacmd.cfg.tmp"));
+}
+
+TEST(ConfigStoreTest, CoalescesWriteBacks)
+{
+    SelfDeletingTmpFolder tmpFolder;
+    const fs::path file = tmpFolder.path() / "megacmd.cfg";
+
+    ConfigStore store(50ms, 1s);
+    store.load(file);
+    for (int i = 0; i < 100; ++i)
+    {
+        store.set("key" + std::to_string(i % 10), std::to_string(i));
+    }
+    EXPECT_EQ(store.getWriteCount(), 0u);
+
+    std::this_thread::sleep_for(300ms);
+    EXPECT_EQ(store.getWriteCount(), 1u);
+    EXPECT_FALSE(store.hasPendingChanges());
+    EXPECT_EQ(getPropertyFromFile(file, "key9"), "99");
+}
+
+TEST(ConfigStoreTest, ReloadsExternalEdits)
+{
+    SelfDeletingTmpFolder tmpFolder;
+    const fs::path file = tmpFolder.path() / "megacmd.cfg";
+    writeFile(file, "a=1\nb=2\nc=3\n");
+
+    ConfigStore store;
+    store.load(file);
+    std::vector<std::pair<std::string, std::optional<std::string>>> notified;
+    store.addChangeListener([&notified](const std::string &key, const std::optional<std::string> &value)
+    {
+        notified.emplace_back(key, value);
+    });
+
+    // our own writes are no changes
+    store.set("a", "10");
+    ASSERT_TRUE(store.flush());
+    EXPECT_TRUE(store.reload().empty());
+
+    // a pending change is kept, unless the file changed that same key
+    store.set("b", "20");
+    store.set("c", "30");
+    writeFile(file, "# edited\na=10\nb=2\nc=300\nd=4\n");
+    EXPECT_EQ(store.reload(), (std::vector<std::string>{"c", "d"}));
+    EXPECT_EQ(notified, (decltype(notified){{"c", "300"}, {"d", "4"}}));
+    EXPECT_EQ(store.get("b"), "20");
+    EXPECT_EQ(store.get("c"), "300");
+
+    ASSERT_TRUE(store.flush());
+    EXPECT_EQ(readFile(file), "# edited\na=10\nb=20\nc=300\nd=4\n");
+
+    notified.clear();
+    writeFile(file, "a=10\n");
+    EXPECT_EQ(store.reload(), (std::vector<std::string>{"b", "c", "d"}));
+    EXPECT_EQ(notified.size(), 3u);
+    EXPECT_EQ(notified[0].second, std::nullopt);
+}
+
+// Looking values up in memory vs reading them from the file each time
+TEST(ConfigStoreTest, DISABLED_LookupBenchmark)
+{
+    SelfDeletingTmpFolder tmpFolder;
+    const fs::path file = tmpFolder.path() / "megacmd.cfg";
+    std::string content;
+    for (int i = 0; i < 50; ++i)
+    {
+        content += "key" + std::to_string(i) + "=" + std::to_string(i) + "\n";
+    }
+    writeFile(file, content);
+
+    ConfigStore store;
+    store.load(file);
+
+    constexpr int lookups = 2000;
+    auto start = std::chrono::steady_clock::now();
+    long long inMemorySum = 0;
+    for (int i = 0; i < lookups; ++i)
+    {
+        inMemorySum += store.getAs<int>("key" + std::to_string(i % 50)).value_or(0);
+    }
+    auto inMemory = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    long long fromFileSum = 0;
+    for (int i = 0; i < lookups; ++i)
+    {
+        fromFileSum += getValueFromFile(file, ("key" + std::to_string(i % 50)).c_str(), 0);
+    }
+    auto fromFile = std::chrono::steady_clock::now() - start;
+
+    EXPECT_EQ(inMemorySum, fromFileSum);
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    G_TEST_INFO << lookups << " lookups: " << duration_cast<microseconds>(inMemory).count() << " us in memory vs "
+                << duration_cast<microseconds>(fromFile).count() << " us reading the file";
+}
@@ -0,0 +1,93 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "deferred_single_trigger.h"
+
+using namespace std::chrono_literals;
+
+TEST(DeferredTriggerTest, CoalescesNearTriggers)
+{
+    std::atomic<int> calls{0};
+    std::atomic<int> lastValue{0};
+    DeferredTrigger trigger(50ms);
+
+    for (int i = 1; i <= 10; ++i)
+    {
+        trigger.trigger([&calls, &lastValue, i] { ++calls; lastValue = i; });
+        std::this_thread::sleep_for(2ms);
+    }
+    EXPECT_EQ(calls.load(), 0);
+
+    std::this_thread::sleep_for(200ms);
+    EXPECT_EQ(calls.load(), 1);
+    EXPECT_EQ(lastValue.load(), 10); // the last callback triggered
+
+    auto [triggers, called] = trigger.getCounts();
+    EXPECT_EQ(triggers, 10u);
+    EXPECT_EQ(called, 1u);
+
+    // and again once served
+    trigger.trigger([&calls] { ++calls; });
+    std::this_thread::sleep_for(200ms);
+    EXPECT_EQ(calls.load(), 2);
+}
+
+TEST(DeferredTriggerTest, FiresAfterMaxDelayUnderConstantTriggers)
+{
+    std::atomic<int> calls{0};
+    DeferredTrigger trigger(50ms, 100ms);
+
+    const auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < 400ms)
+    {
+        trigger.trigger([&calls] { ++calls; });
+        std::this_thread::sleep_for(5ms);
+    }
+    // without the max delay, none would have been called yet
+    EXPECT_GE(calls.load(), 2);
+}
+
+TEST(DeferredTriggerTest, CancelsPendingCallbacks)
+{
+    std::atomic<int> calls{0};
+    {
+        DeferredTrigger trigger(50ms);
+        trigger.trigger([&calls] { ++calls; });
+        trigger.cancel();
+        std::this_thread::sleep_for(100ms);
+        EXPECT_EQ(calls.load(), 0);
+
+        trigger.trigger([&calls] { ++calls; });
+    }
+    // destroyed before the deadline
+    std::this_thread::sleep_for(100ms);
+    EXPECT_EQ(calls.load(), 0);
+}
+
+TEST(DeferredTriggerTest, DeferredSingleTriggerCallsTheLastCallback)
+{
+    std::atomic<int> value{0};
+    DeferredSingleTrigger trigger(std::chrono::seconds(1));
+    trigger.triggerDeferredSingleShot([&value] { value = 1; });
+    trigger.triggerDeferredSingleShot([&value] { value = 2; });
+    std::this_thread::sleep_for(1500ms);
+    EXPECT_EQ(value.load(), 2);
+}
@@ -0,0 +1,321 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_elastic_pool.h"
+
+using megacmd::ElasticPool;
+using namespace std::chrono_literals;
+
+namespace
+{
+struct Instance
+{
+    size_t mSlot;
+    std::atomic<int> &mAlive;
+
+    Instance(size_t slot, std::atomic<int> &alive) : mSlot(slot), mAlive(alive) { ++mAlive; }
+    ~Instance() { --mAlive; }
+};
+
+struct ElasticPoolTest : public ::testing::Test
+{
+    std::atomic<int> mAlive{0};
+    std::atomic<int> mCreated{0};
+
+    ElasticPool<Instance>::Factory factory(std::chrono::milliseconds creationTime = 0ms)
+    {
+        return [this, creationTime](size_t slot)
+        {
+            std::this_thread::sleep_for(creationTime);
+            ++mCreated;
+            return std::make_unique<Instance>(slot, mAlive);
+        };
+    }
+};
+}
+
+TEST_F(ElasticPoolTest, CreatesOnDemand)
+{
+    ElasticPool<Instance> pool(3, 10s, factory());
+    EXPECT_EQ(mAlive, 0);
+
+    auto first = pool.acquire();
+    ASSERT_NE(first, nullptr);
+    EXPECT_EQ(first->mSlot, 0u);
+    pool.release(first);
+
+    // released ones are reused
+    auto second = pool.acquire();
+    EXPECT_EQ(second, first);
+    auto third = pool.acquire();
+    ASSERT_NE(third, nullptr);
+    EXPECT_EQ(third->mSlot, 1u);
+    EXPECT_EQ(mCreated, 2);
+
+    pool.release(second);
+    pool.release(third);
+    auto stats = pool.getStats();
+    EXPECT_EQ(stats.mInstances, 2u);
+    EXPECT_EQ(stats.mBusyInstances, 0u);
+    EXPECT_EQ(stats.mMaxBusyInstances, 2u);
+    EXPECT_EQ(stats.mAcquisitions, 3u);
+    EXPECT_EQ(stats.mWaits, 0u);
+
+    ElasticPool<Instance> none(0, 10s, factory());
+    EXPECT_EQ(none.acquire(), nullptr);
+}
+
+TEST_F(ElasticPoolTest, WaitsAtTheLimit)
+{
+    ElasticPool<Instance> pool(2, 10s, factory());
+    auto a = pool.acquire();
+    auto b = pool.acquire();
+
+    auto waiting = std::async(std::launch::async, [&pool] { return pool.acquire(); });
+    EXPECT_EQ(waiting.wait_for(100ms), std::future_status::timeout);
+
+    pool.release(b);
+    ASSERT_EQ(waiting.wait_for(5s), std::future_status::ready);
+    EXPECT_EQ(waiting.get(), b);
+    EXPECT_EQ(pool.getStats().mWaits, 1u);
+    EXPECT_EQ(mCreated, 2);
+
+    // growing the limit lets waiters create more
+    waiting = std::async(std::launch::async, [&pool] { return pool.acquire(); });
+    EXPECT_EQ(waiting.wait_for(100ms), std::future_status::timeout);
+    pool.setMaxInstances(3);
+    ASSERT_EQ(waiting.wait_for(5s), std::future_status::ready);
+    auto c = waiting.get();
+    ASSERT_NE(c, nullptr);
+    EXPECT_EQ(c->mSlot, 2u);
+
+    // ...and shrinking it to none makes them give up
+    waiting = std::async(std::launch::async, [&pool] { return pool.acquire(); });
+    EXPECT_EQ(waiting.wait_for(100ms), std::future_status::timeout);
+    pool.setMaxInstances(0);
+    ASSERT_EQ(waiting.wait_for(5s), std::future_status::ready);
+    EXPECT_EQ(waiting.get(), nullptr);
+
+    // busy ones are destroyed once released
+    for (auto instance : {a, b, c})
+    {
+        pool.release(instance);
+    }
+    EXPECT_EQ(mAlive, 0);
+    EXPECT_EQ(pool.getStats().mDestroyed, 3u);
+}
+
+TEST_F(ElasticPoolTest, ShrinksLive)
+{
+    ElasticPool<Instance> pool(4, 10s, factory());
+    std::vector<Instance *> instances;
+    for (int i = 0; i < 4; ++i)
+    {
+        instances.push_back(pool.acquire());
+    }
+    pool.release(instances[0]);
+    pool.release(instances[1]);
+
+    pool.setMaxInstances(3);
+    EXPECT_EQ(mAlive, 3); // an idle one
+    pool.setMaxInstances(1);
+    EXPECT_EQ(mAlive, 2); // the other idle one: the rest are busy
+    pool.release(instances[2]);
+    EXPECT_EQ(mAlive, 1);
+    pool.release(instances[3]);
+    EXPECT_EQ(mAlive, 1); // within the limit: kept
+
+    // slots are reused
+    pool.setMaxInstances(2);
+    auto a = pool.acquire();
+    auto b = pool.acquire();
+    EXPECT_EQ(a, instances[3]);
+    EXPECT_EQ(b->mSlot, 0u);
+    pool.release(a);
+    pool.release(b);
+}
+
+TEST_F(ElasticPoolTest, ReapsIdleInstances)
+{
+    ElasticPool<Instance> pool(3, 200ms, factory());
+    auto a = pool.acquire();
+    auto b = pool.acquire();
+    pool.release(a);
+
+    const auto now = std::chrono::steady_clock::now();
+    EXPECT_EQ(pool.reapIdle(now), 0u);
+    EXPECT_EQ(pool.reapIdle(now + 1s), 1u); // the busy one stays
+    EXPECT_EQ(mAlive, 1);
+
+    // and on its own after the timeout
+    pool.release(b);
+    std::this_thread::sleep_for(600ms);
+    EXPECT_EQ(mAlive, 0);
+    EXPECT_EQ(pool.getStats().mInstances, 0u);
+
+    // another one is created when needed again
+    auto c = pool.acquire();
+    ASSERT_NE(c, nullptr);
+    EXPECT_EQ(c->mSlot, 0u);
+    pool.release(c);
+}
+
+TEST_F(ElasticPoolTest, SlotsAreFreedOnceDestroyed)
+{
+    // Instances of a slot must never overlap (e.g. they would share a cache folder)
+    struct SlowInstance
+    {
+        size_t mSlot;
+        std::function<void(size_t)> mOnDestroyed;
+        ~SlowInstance() { mOnDestroyed(mSlot); }
+    };
+
+    std::mutex slotsMutex;
+    std::vector<bool> slotsAlive(2, false);
+    bool overlapped = false;
+
+    std::promise<void> destroying;
+    std::promise<void> finishDestroying;
+    std::shared_future<void> destroyGate = finishDestroying.get_future().share();
+    std::promise<size_t> creating;
+    std::promise<void> finishCreating;
+    std::shared_future<void> createGate = finishCreating.get_future().share();
+    std::atomic<int> created{0};
+
+    std::atomic_bool destroyedOnce{false};
+    auto onDestroyed = [&](size_t slot)
+    {
+        if (slot == 0 && !destroyedOnce.exchange(true))
+        {
+            destroying.set_value();
+            destroyGate.wait();
+        }
+        std::lock_guard<std::mutex> g(slotsMutex);
+        slotsAlive[slot] = false;
+    };
+
+    ElasticPool<SlowInstance> pool(2, 10s, [&](size_t slot)
+    {
+        {
+            std::lock_guard<std::mutex> g(slotsMutex);
+            overlapped = overlapped || slotsAlive[slot];
+            slotsAlive[slot] = true;
+        }
+        if (++created == 2)
+        {
+            creating.set_value(slot);
+            createGate.wait();
+        }
+        return std::unique_ptr<SlowInstance>(new SlowInstance{slot, onDestroyed});
+    });
+
+    auto a = pool.acquire();
+    ASSERT_NE(a, nullptr);
+    EXPECT_EQ(a->mSlot, 0u);
+    pool.release(a);
+
+    // slot 0 is being destroyed...
+    auto reaping = std::async(std::launch::async, [&pool] { return pool.reapIdle(std::chrono::steady_clock::now() + 1h); });
+    destroying.get_future().wait();
+
+    // ...so a new instance is created for another one (and the factory is slow)
+    auto b = std::async(std::launch::async, [&pool] { return pool.acquire(); });
+    auto creatingSlot = creating.get_future();
+    ASSERT_EQ(creatingSlot.wait_for(5s), std::future_status::ready);
+    EXPECT_EQ(creatingSlot.get(), 1u);
+
+    // and the one being destroyed still counts towards the maximum
+    auto c = std::async(std::launch::async, [&pool] { return pool.acquire(); });
+    EXPECT_EQ(c.wait_for(100ms), std::future_status::timeout);
+    EXPECT_EQ(pool.getStats().mInstances, 2u);
+
+    finishDestroying.set_value();
+    EXPECT_EQ(reaping.get(), 1u);
+    ASSERT_EQ(c.wait_for(5s), std::future_status::ready);
+    auto cInstance = c.get();
+    ASSERT_NE(cInstance, nullptr);
+    EXPECT_EQ(cInstance->mSlot, 0u);
+
+    finishCreating.set_value();
+    auto bInstance = b.get();
+    ASSERT_NE(bInstance, nullptr);
+    EXPECT_EQ(bInstance->mSlot, 1u);
+
+    pool.release(bInstance);
+    pool.release(cInstance);
+    std::lock_guard<std::mutex> g(slotsMutex);
+    EXPECT_FALSE(overlapped);
+}
+
+// Instances used by a few concurrent users, vs creating all of them up front (as the auxiliary MegaApi folders were)
+TEST_F(ElasticPoolTest, DISABLED_LazyCreationBenchmark)
+{
+    constexpr size_t maxInstances = 20;
+    constexpr auto creationTime = 5ms;
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::vector<std::unique_ptr<Instance>> eager;
+        for (size_t i = 0; i < maxInstances; ++i)
+        {
+            eager.push_back(factory(creationTime)(i));
+        }
+    }
+    auto eagerStartup = std::chrono::steady_clock::now() - start;
+    mCreated = 0;
+
+    start = std::chrono::steady_clock::now();
+    ElasticPool<Instance> pool(maxInstances, 10s, factory(creationTime));
+    auto lazyStartup = std::chrono::steady_clock::now() - start;
+
+    std::vector<std::thread> users;
+    for (int user = 0; user < 3; ++user)
+    {
+        users.emplace_back([&pool]
+        {
+            for (int i = 0; i < 50; ++i)
+            {
+                auto instance = pool.acquire();
+                std::this_thread::sleep_for(100us);
+                pool.release(instance);
+            }
+        });
+    }
+    for (auto &user : users)
+    {
+        user.join();
+    }
+
+    auto stats = pool.getStats();
+    EXPECT_LE(stats.mCreated, 3u);
+    EXPECT_EQ(stats.mAcquisitions, 150u);
+
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    G_TEST_INFO << "Startup: " << duration_cast<microseconds>(lazyStartup).count() << " us lazily vs "
+                << duration_cast<microseconds>(eagerStartup).count() << " us creating " << maxInstances
+                << " instances. Instances created for 3 concurrent users: " << stats.mCreated;
+}
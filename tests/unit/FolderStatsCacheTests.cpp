@@ -0,0 +1,164 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_folder_stats_cache.h"
+
+using namespace megacmd;
+
+namespace
+{
+// 1 is the root; 2 and 3 are folders in it (e.g: sync roots); 4 is in 2 and 5 in 4
+const std::map<FolderStatsCache::Handle, FolderStatsCache::Handle> parents = {{1, FolderStatsCache::UNDEF}, {2, 1}, {3, 1}, {4, 2}, {5, 4}};
+
+FolderStatsCache::Handle getParent(FolderStatsCache::Handle handle)
+{
+    auto it = parents.find(handle);
+    return it == parents.end() ? FolderStatsCache::UNDEF : it->second;
+}
+
+void fetch(FolderStatsCache &cache, FolderStatsCache::Handle folder, long long files)
+{
+    cache.fetchStarted(folder);
+    cache.fetchFinished(folder, FolderStats{files, 1, 0});
+}
+}
+
+TEST(FolderStatsCacheTest, ServesFetchedStats)
+{
+    FolderStatsCache cache;
+    EXPECT_TRUE(cache.empty());
+    EXPECT_FALSE(cache.get(2));
+
+    fetch(cache, 2, 7);
+    auto stats = cache.get(2);
+    ASSERT_TRUE(stats);
+    EXPECT_EQ(stats->mFiles, 7);
+    EXPECT_EQ(stats->mFolders, 1);
+
+    // failures are not cached
+    cache.fetchStarted(3);
+    cache.fetchFinished(3, std::nullopt);
+    EXPECT_FALSE(cache.get(3));
+
+    auto cacheStats = cache.getStats();
+    EXPECT_EQ(cacheStats.mEntries, 1u);
+    EXPECT_EQ(cacheStats.mHits, 1u);
+    EXPECT_EQ(cacheStats.mMisses, 2u);
+}
+
+TEST(FolderStatsCacheTest, InvalidatesTheFoldersContainingChanges)
+{
+    FolderStatsCache cache;
+    fetch(cache, 2, 7);
+    fetch(cache, 3, 8);
+
+    std::map<FolderStatsCache::Handle, int> lookups;
+    cache.invalidateAncestors({5, 4}, [&lookups](FolderStatsCache::Handle handle) {
+        ++lookups[handle];
+        return getParent(handle);
+    });
+
+    EXPECT_FALSE(cache.get(2));
+    EXPECT_TRUE(cache.get(3));
+    EXPECT_EQ(cache.getStats().mInvalidations, 1u);
+
+    // each ancestor is looked up once
+    for (auto &lookup : lookups)
+    {
+        EXPECT_EQ(lookup.second, 1) << lookup.first;
+    }
+
+    cache.invalidateAncestors({3}, getParent);
+    EXPECT_FALSE(cache.get(3));
+    EXPECT_TRUE(cache.empty()); // (nothing left to invalidate)
+}
+
+TEST(FolderStatsCacheTest, DoesNotStoreStatsInvalidatedWhileFetching)
+{
+    FolderStatsCache cache;
+    cache.fetchStarted(2);
+    cache.fetchStarted(3);
+    cache.invalidateAncestors({4}, getParent);
+    cache.fetchFinished(2, FolderStats{7, 1, 0});
+    cache.fetchFinished(3, FolderStats{8, 1, 0});
+    EXPECT_FALSE(cache.get(2));
+    EXPECT_TRUE(cache.get(3));
+
+    cache.fetchStarted(3);
+    cache.clear();
+    cache.fetchFinished(3, FolderStats{9, 1, 0});
+    EXPECT_FALSE(cache.get(3));
+
+    // once no longer being fetched, later fetches are stored
+    fetch(cache, 2, 10);
+    ASSERT_TRUE(cache.get(2));
+    EXPECT_EQ(cache.get(2)->mFiles, 10);
+}
+
+TEST(FolderStatsCacheTest, LooksUpTheFoldersOfChangesWhenRead)
+{
+    std::map<FolderStatsCache::Handle, int> lookups;
+    FolderStatsCache cache([&lookups](FolderStatsCache::Handle handle) {
+        ++lookups[handle];
+        return getParent(handle);
+    });
+    fetch(cache, 2, 7);
+    fetch(cache, 3, 8);
+
+    G_SUBTEST << "Changes are only recorded";
+    cache.nodesChanged({5, 4});
+    cache.nodesChanged({4, 2});
+    EXPECT_TRUE(lookups.empty());
+    EXPECT_EQ(cache.getStats().mInvalidations, 0u);
+
+    G_SUBTEST << "And looked up, all at once, by the next read";
+    EXPECT_TRUE(cache.get(3));
+    EXPECT_FALSE(cache.get(2));
+    EXPECT_EQ(cache.getStats().mInvalidations, 1u);
+    for (auto &lookup : lookups)
+    {
+        EXPECT_EQ(lookup.second, 1) << lookup.first;
+    }
+
+    G_SUBTEST << "Fetches in flight are not stored";
+    cache.fetchStarted(2);
+    cache.nodesChanged({3});
+    cache.fetchFinished(2, FolderStats{9, 1, 0});
+    EXPECT_FALSE(cache.get(2));
+    EXPECT_FALSE(cache.get(3));
+}
+
+TEST(FolderStatsCacheTest, DropsEverythingWithTooManyPendingChanges)
+{
+    size_t lookups = 0;
+    FolderStatsCache cache([&lookups](FolderStatsCache::Handle handle) {
+        ++lookups;
+        return getParent(handle);
+    });
+    fetch(cache, 2, 7);
+    fetch(cache, 3, 8);
+
+    cache.nodesChanged(std::vector<FolderStatsCache::Handle>(FolderStatsCache::MAX_PENDING_CHANGES + 1, 5));
+    EXPECT_FALSE(cache.get(2));
+    EXPECT_FALSE(cache.get(3));
+    EXPECT_EQ(lookups, 0u);
+    EXPECT_TRUE(cache.empty());
+}
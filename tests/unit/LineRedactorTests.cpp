@@ -0,0 +1,167 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <chrono>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_redaction.h"
+
+using megacmd::LineRedactor;
+
+namespace
+{
+// What CmdPetition::getRedactedLine used to do
+std::string redactWithRegexes(const std::string &line)
+{
+    static const std::string redacted = "$1<REDACTED>";
+    static const std::string asterisks = "$1********";
+
+    static const std::regex fullCommandRegex(R"(^((X?)(passwd|login|confirm|confirmcancel)\s+).*$)");
+    static const std::regex passwordRegex(R"((--password=)("[^"]+"|'[^']+'|\S+))");
+    static const std::regex authRegex(R"((--auth-(code|key)=)\S+)");
+    static const std::regex linkRegex(R"((https://mega\.nz/(file|folder)/[^#]+#)\S+)");
+    static const std::regex oldLinkRegex(R"((https://mega\.nz/#F?![^!]+#)\S+)");
+    static const std::regex encryptedLinkRegex(R"((https://mega\.nz/#P!)\S+)");
+
+    if (std::regex_match(line, fullCommandRegex))
+    {
+        return std::regex_replace(line, fullCommandRegex, redacted);
+    }
+
+    std::string output = line;
+    output = std::regex_replace(output, passwordRegex, asterisks);
+    output = std::regex_replace(output, authRegex, asterisks);
+    output = std::regex_replace(output, linkRegex, asterisks);
+    output = std::regex_replace(output, oldLinkRegex, asterisks);
+    output = std::regex_replace(output, encryptedLinkRegex, asterisks);
+    return output;
+}
+
+// Pieces of the things redacted (and of their near misses), to build lines with
+const std::vector<std::string> &getTokens()
+{
+    static const std::vector<std::string> tokens{
+        "--password=", "--auth-code=", "--auth-key=", "--auth-", "https://mega.nz/", "file/", "folder/",
+        "#", "#!", "#F!", "#P!", "!", "\"", "'", " ", "\t", "a", "X", "login", "passwd", "confirm", "cancel"};
+    return tokens;
+}
+}
+
+TEST(LineRedactorTest, Redacts)
+{
+    EXPECT_EQ(LineRedactor::redact("login some-email@real-website.com SuperSecret1234!'"), "login <REDACTED>");
+    EXPECT_EQ(LineRedactor::redact("Xconfirmcancel \t link Password"), "Xconfirmcancel \t <REDACTED>");
+    EXPECT_EQ(LineRedactor::redact("loginx --password=a"), "loginx --password=********");
+    EXPECT_EQ(LineRedactor::redact("cmd --password=\"a b\" --auth-key=k --auth-code=c"),
+              "cmd --password=******** --auth-key=******** --auth-code=********");
+    EXPECT_EQ(LineRedactor::redact("cmd --password=\"unterminated quote"), "cmd --password=******** quote");
+    EXPECT_EQ(LineRedactor::redact("get https://mega.nz/folder/h#k/sub https://mega.nz/#F!h!k https://mega.nz/#!h#k"),
+              "get https://mega.nz/folder/h#******** https://mega.nz/#F!h!k https://mega.nz/#!h#********");
+    EXPECT_EQ(LineRedactor::redact("get https://mega.nz/#P!k"), "get https://mega.nz/#P!********");
+    EXPECT_EQ(LineRedactor::redact("ls /some/path --password"), "ls /some/path --password");
+
+    // (the former regex did not redact these: its ".*$" stopped at the first line break)
+    EXPECT_EQ(LineRedactor::redact("login user@mega.nz\nSecret"), "login <REDACTED>");
+    EXPECT_EQ(LineRedactor::redact("passwd a\rb"), "passwd <REDACTED>");
+}
+
+// Every line of up to 3 tokens (and many random longer ones) is redacted as the former regexes did
+TEST(LineRedactorTest, EquivalentToTheRegexes)
+{
+    const auto &tokens = getTokens();
+    size_t checked = 0;
+    auto check = [&checked](const std::string &line)
+    {
+        ++checked;
+        ASSERT_EQ(LineRedactor::redact(line), redactWithRegexes(line)) << "Line: \"" << line << "\"";
+    };
+
+    for (const std::string &first : tokens)
+    {
+        check(first);
+        for (const std::string &second : tokens)
+        {
+            check(first + second);
+            for (const std::string &third : tokens)
+            {
+                check(first + second + third);
+                if (HasFatalFailure())
+                {
+                    return;
+                }
+            }
+        }
+    }
+
+    std::mt19937 random(27);
+    std::uniform_int_distribution<size_t> tokenDistribution(0, tokens.size() - 1);
+    std::uniform_int_distribution<int> lengthDistribution(4, 12);
+    for (int i = 0; i < 50000 && !HasFatalFailure(); ++i)
+    {
+        std::string line;
+        for (int length = lengthDistribution(random); length > 0; --length)
+        {
+            line += tokens[tokenDistribution(random)];
+        }
+        check(line);
+    }
+    G_TEST_INFO << checked << " lines checked";
+}
+
+// Redacting some usual lines vs the former regexes
+TEST(LineRedactorTest, DISABLED_RedactionBenchmark)
+{
+    const std::vector<std::string> lines{
+        "ls -lh --tree /some/folder/with/a/long/name",
+        "Xput --print-tag-at-start --ignore-quota-warn /home/user/Documents/report.pdf /backups/",
+        "get https://mega.nz/folder/bxomFKwL#3V1dUJFzL98t1GqXX29IXg /home/user/Downloads",
+        "export -a /shared --password=\"My Secret Password\" --expire=1d",
+        "login user@mega.nz SuperSecret1234"};
+
+    constexpr int repetitions = 2000;
+    size_t scannedLength = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; ++i)
+    {
+        for (const std::string &line : lines)
+        {
+            scannedLength += LineRedactor::redact(line).size();
+        }
+    }
+    auto scanning = std::chrono::steady_clock::now() - start;
+
+    size_t regexLength = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; ++i)
+    {
+        for (const std::string &line : lines)
+        {
+            regexLength += redactWithRegexes(line).size();
+        }
+    }
+    auto regexes = std::chrono::steady_clock::now() - start;
+
+    EXPECT_EQ(scannedLength, regexLength);
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    G_TEST_INFO << repetitions * lines.size() << " lines: " << duration_cast<microseconds>(scanning).count() << " us scanning vs "
+                << duration_cast<microseconds>(regexes).count() << " us with regexes";
+}
@@ -550,6 +550,81 @@ TEST(OptionsFlagsUtilsTest, getIntOptional)
     }
 }
 
+TEST(OptionsFlagsUtilsTest, getLongLongOptional)
+{
+    using megacmd::getLongLongOptional;
+
+    G_SUBTEST << "Basic case";
+    {
+        std::map<std::string, std::string> options = {{"offset", "1024"}, {"length", "10"}};
+        auto result = getLongLongOptional(options, "offset");
+        ASSERT_TRUE(result.has_value());
+        EXPECT_EQ(*result, 1024);
+        result = getLongLongOptional(options, "length");
+        ASSERT_TRUE(result.has_value());
+        EXPECT_EQ(*result, 10);
+    }
+
+    G_SUBTEST << "Option does not exist";
+    {
+        std::map<std::string, std::string> options = {{"offset", "1024"}};
+        EXPECT_FALSE(getLongLongOptional(options, "length").has_value());
+    }
+
+    G_SUBTEST << "Invalid number";
+    {
+        std::map<std::string, std::string> options = {{"offset", "abc"}};
+        EXPECT_FALSE(getLongLongOptional(options, "offset").has_value());
+    }
+
+    G_SUBTEST << "Empty string";
+    {
+        std::map<std::string, std::string> options = {{"offset", ""}};
+        EXPECT_FALSE(getLongLongOptional(options, "offset").has_value());
+    }
+
+    G_SUBTEST << "Negative number";
+    {
+        std::map<std::string, std::string> options = {{"offset", "-100"}};
+        auto result = getLongLongOptional(options, "offset");
+        ASSERT_TRUE(result.has_value());
+        EXPECT_EQ(*result, -100);
+    }
+
+    G_SUBTEST << "Number exceeding INT_MAX";
+    {
+        std::map<std::string, std::string> options = {{"offset", "2147483648"}};
+        auto result = getLongLongOptional(options, "offset");
+        ASSERT_TRUE(result.has_value());
+        EXPECT_EQ(*result, 2147483648LL);
+    }
+
+    G_SUBTEST << "LLONG_MAX and LLONG_MIN values";
+    {
+        std::map<std::string, std::string> options = {{"max", "9223372036854775807"}, {"min", "-9223372036854775808"}};
+        auto result = getLongLongOptional(options, "max");
+        ASSERT_TRUE(result.has_value());
+        EXPECT_EQ(*result, LLONG_MAX);
+        result = getLongLongOptional(options, "min");
+        ASSERT_TRUE(result.has_value());
+        EXPECT_EQ(*result, LLONG_MIN);
+    }
+
+    G_SUBTEST << "Number exceeding LLONG_MAX";
+    {
+        std::map<std::string, std::string> options = {{"offset", "9223372036854775808"}};
+        EXPECT_FALSE(getLongLongOptional(options, "offset").has_value());
+    }
+
+    G_SUBTEST << "Partial number string";
+    {
+        std::map<std::string, std::string> options = {{"offset", "123abc"}};
+        auto result = getLongLongOptional(options, "offset");
+        ASSERT_TRUE(result.has_value());
+        EXPECT_EQ(*result, 123);
+    }
+}
+
 TEST(OptionsFlagsUtilsTest, discardOptionsAndFlags)
 {
     using megacmd::discardOptionsAndFlags;
@@ -0,0 +1,109 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_path_prefix_index.h"
+
+using namespace megacmd;
+
+TEST(PathPrefixIndexTest, FindsTheContainingRoot)
+{
+    PathPrefixIndex<int> index;
+    EXPECT_FALSE(index.findContaining("/a"));
+
+    index.add("/a/foo", 1);
+    index.add("/b/", 2);
+    index.add("/a/foo/nested", 3);
+
+    EXPECT_EQ(index.findContaining("/a/foo"), 1);
+    EXPECT_EQ(index.findContaining("/a/foo/"), 1);
+    EXPECT_EQ(index.findContaining("/a/foo/x/y.txt"), 1);
+    EXPECT_EQ(index.findContaining("/a/foo/nested/z"), 3); // the closest one
+    EXPECT_EQ(index.findContaining("/b/c"), 2);
+    EXPECT_FALSE(index.findContaining("/a/foobar/x")); // not a plain string prefix
+    EXPECT_FALSE(index.findContaining("/a"));
+    EXPECT_FALSE(index.findContaining("a/foo"));
+    EXPECT_FALSE(index.findContaining(""));
+}
+
+TEST(PathPrefixIndexTest, HandlesRootsAndBackslashes)
+{
+    PathPrefixIndex<int> index;
+    index.add("/", 1);
+    index.add("C:\\Users\\me\\sync", 2);
+    index.add("D:\\", 3);
+
+    EXPECT_EQ(index.findContaining("/anything/at/all"), 1);
+    EXPECT_EQ(index.findContaining("/"), 1);
+    EXPECT_EQ(index.findContaining("C:\\Users\\me\\sync\\file.txt"), 2);
+    EXPECT_FALSE(index.findContaining("C:\\Users\\me\\other"));
+    EXPECT_EQ(index.findContaining("D:\\x\\y"), 3);
+}
+
+// Grouping many paths by many roots, compared to checking each path against every root
+TEST(PathPrefixIndexTest, DISABLED_GroupingBenchmark)
+{
+    constexpr int roots = 60;
+    constexpr int paths = 20000;
+
+    PathPrefixIndex<int> index;
+    std::vector<std::string> rootPaths;
+    for (int r = 0; r < roots; ++r)
+    {
+        rootPaths.push_back("/home/user/sync" + std::to_string(r));
+        index.add(rootPaths.back(), r);
+    }
+    std::vector<std::string> issuePaths;
+    for (int p = 0; p < paths; ++p)
+    {
+        issuePaths.push_back(rootPaths[p % roots] + "/folder" + std::to_string(p % 97) + "/sub/file" + std::to_string(p) + ".txt");
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<int> indexed(roots);
+    for (const auto &path : issuePaths)
+    {
+        if (auto root = index.findContaining(path))
+        {
+            ++indexed[*root];
+        }
+    }
+    auto indexedElapsed = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    std::vector<int> scanned(roots);
+    for (int r = 0; r < roots; ++r)
+    {
+        for (const auto &path : issuePaths)
+        {
+            if (path.compare(0, rootPaths[r].size() + 1, rootPaths[r] + "/") == 0)
+            {
+                ++scanned[r];
+            }
+        }
+    }
+    auto scannedElapsed = std::chrono::steady_clock::now() - start;
+
+    EXPECT_EQ(indexed, scanned);
+    G_TEST_INFO << roots << " roots, " << paths << " paths: indexed "
+                << std::chrono::duration_cast<std::chrono::microseconds>(indexedElapsed).count() << " us, scanning per root "
+                << std::chrono::duration_cast<std::chrono::microseconds>(scannedElapsed).count() << " us";
+}
@@ -0,0 +1,98 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <gtest/gtest.h>
+
+#include "megacmd_path_cache.h"
+
+using namespace megacmd;
+
+TEST(PathResolutionCacheTest, FindsTheLongestCachedPrefix)
+{
+    PathResolutionCache cache;
+    cache.put(1, "a", 10, cache.generation());
+    cache.put(1, "a/b", 11, cache.generation());
+
+    auto found = cache.findLongestPrefix(1, "a/b/c/d");
+    ASSERT_TRUE(found);
+    EXPECT_EQ(found->first, 3u);
+    EXPECT_EQ(found->second, 11u);
+
+    found = cache.findLongestPrefix(1, "a/b");
+    ASSERT_TRUE(found);
+    EXPECT_EQ(found->first, 3u);
+
+    found = cache.findLongestPrefix(1, "a/b/");
+    ASSERT_TRUE(found);
+    EXPECT_EQ(found->first, 3u);
+
+    found = cache.findLongestPrefix(1, "a/bc");
+    ASSERT_TRUE(found);
+    EXPECT_EQ(found->first, 1u);
+    EXPECT_EQ(found->second, 10u);
+
+    EXPECT_FALSE(cache.findLongestPrefix(1, "ab/c"));
+    EXPECT_FALSE(cache.findLongestPrefix(2, "a/b")); // another base node
+
+    auto stats = cache.getStats();
+    EXPECT_EQ(stats.mHits, 4u);
+    EXPECT_EQ(stats.mMisses, 2u);
+    EXPECT_EQ(stats.mEntries, 2u);
+}
+
+TEST(PathResolutionCacheTest, EvictsTheLeastRecentlyUsed)
+{
+    PathResolutionCache cache(2);
+    cache.put(1, "a", 10, cache.generation());
+    cache.put(1, "b", 11, cache.generation());
+    EXPECT_TRUE(cache.findLongestPrefix(1, "a")); // "b" is now the least recently used
+    cache.put(1, "c", 12, cache.generation());
+
+    EXPECT_TRUE(cache.findLongestPrefix(1, "a"));
+    EXPECT_FALSE(cache.findLongestPrefix(1, "b"));
+    EXPECT_TRUE(cache.findLongestPrefix(1, "c"));
+    EXPECT_EQ(cache.getStats().mEntries, 2u);
+}
+
+TEST(PathResolutionCacheTest, ForgetsEverythingWhenCleared)
+{
+    PathResolutionCache cache;
+    const auto generation = cache.generation();
+    cache.put(1, "a", 10, generation);
+    cache.clear();
+
+    EXPECT_FALSE(cache.findLongestPrefix(1, "a"));
+
+    // resolved before the clear: not stored
+    cache.put(1, "a", 10, generation);
+    EXPECT_FALSE(cache.findLongestPrefix(1, "a"));
+
+    cache.put(1, "a", 10, cache.generation());
+    EXPECT_TRUE(cache.findLongestPrefix(1, "a"));
+    EXPECT_EQ(cache.getStats().mInvalidations, 1u);
+}
+
+TEST(PathResolutionCacheTest, ErasesEntries)
+{
+    PathResolutionCache cache;
+    cache.put(1, "a", 10, cache.generation());
+    cache.put(1, "a/b", 11, cache.generation());
+    cache.erase(1, "a/b");
+
+    auto found = cache.findLongestPrefix(1, "a/b");
+    ASSERT_TRUE(found);
+    EXPECT_EQ(found->second, 10u);
+    EXPECT_EQ(cache.getStats().mEntries, 1u);
+}
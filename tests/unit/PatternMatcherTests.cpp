@@ -0,0 +1,146 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmdutils.h"
+
+using namespace megacmd;
+
+namespace
+{
+const std::vector<std::string> names = {
+    "", "a", "ab", "abc", "abcabc", "photo.jpg", "photo.jpg.bak", ".jpg", "jpg", "IMG_0001.JPG",
+    "report 2024.pdf", "*", "?", "a*b", "aaa", "aXbXc", "folder", "my folder (1)", "ñandú.txt",
+};
+
+const std::vector<std::string> wildcardPatterns = {
+    "", "*", "**", "?", "a", "abc", "a*", "*c", "a*c", "a**c", "*.jpg", "photo*", "photo*.jpg", "*b*", "**b**",
+    "*abc*", "a?c", "?b*", "*?", "a*b*c", "*a*b", "a*bc*", "*folder", "*(1)", "*.JPG", "ñ*", "*ú.txt",
+};
+}
+
+TEST(PatternMatcherTest, WildcardsMatchAsPatternMatches)
+{
+    for (const auto& pattern : wildcardPatterns)
+    {
+        PatternMatcher matcher(pattern, false);
+        for (const auto& name : names)
+        {
+            EXPECT_EQ(matcher.matches(name.c_str()), patternMatches(name.c_str(), pattern.c_str(), false))
+                    << "name: \"" << name << "\" pattern: \"" << pattern << "\"";
+        }
+    }
+}
+
+TEST(PatternMatcherTest, RandomWildcardsMatchAsPatternMatches)
+{
+    std::mt19937 rng(1234);
+    auto randomString = [&rng](std::string_view alphabet, size_t maxLength) {
+        std::string s(std::uniform_int_distribution<size_t>(0, maxLength)(rng), ' ');
+        for (auto& c : s)
+        {
+            c = alphabet[std::uniform_int_distribution<size_t>(0, alphabet.size() - 1)(rng)];
+        }
+        return s;
+    };
+
+    for (int i = 0; i < 5000; ++i)
+    {
+        const std::string pattern = randomString("ab*?", 6);
+        const std::string name = randomString("ab", 8);
+        EXPECT_EQ(PatternMatcher(pattern, false).matches(name.c_str()), patternMatches(name.c_str(), pattern.c_str(), false))
+                << "name: \"" << name << "\" pattern: \"" << pattern << "\"";
+    }
+}
+
+TEST(PatternMatcherTest, RegexMatchesAsPatternMatches)
+{
+    const std::vector<std::string> regexPatterns = {
+        ".*", "a.*", ".*\\.jpg", "(?i).*\\.jpg", "[a-c]+", "photo\\.(jpg|png)", "a|ab", "abc(abc)?", "b",
+        "*.jpg", // not a valid regular expression (retried as wildcards with PCRE)
+        "(", // invalid: matches nothing
+    };
+
+    for (const auto& pattern : regexPatterns)
+    {
+        PatternMatcher matcher(pattern, true);
+        for (const auto& name : names)
+        {
+            EXPECT_EQ(matcher.matches(name.c_str()), patternMatches(name.c_str(), pattern.c_str(), true))
+                    << "name: \"" << name << "\" pattern: \"" << pattern << "\"";
+        }
+    }
+}
+
+TEST(PatternMatcherTest, MatchesWholeNames)
+{
+    EXPECT_TRUE(PatternMatcher("photo*.jpg", false).matches("photo 1.jpg"));
+    EXPECT_FALSE(PatternMatcher("photo*.jpg", false).matches("photo 1.jpg.bak"));
+    EXPECT_TRUE(PatternMatcher("*oto*", false).matches("photo.jpg"));
+    EXPECT_FALSE(PatternMatcher("abc", false).matches("abcd"));
+
+    EXPECT_TRUE(PatternMatcher("photo.*", true).matches("photo.jpg"));
+    EXPECT_FALSE(PatternMatcher("photo", true).matches("photo.jpg"));
+    EXPECT_FALSE(PatternMatcher("jpg", true).matches("photo.jpg"));
+}
+
+// Compares compiling the pattern for each name (patternMatches, as find used to) against compiling it once
+TEST(PatternMatcherTest, DISABLED_MatchingBenchmark)
+{
+    constexpr int numNames = 20000;
+    std::vector<std::string> manyNames;
+    manyNames.reserve(numNames);
+    for (int i = 0; i < numNames; ++i)
+    {
+        manyNames.push_back("file_" + std::to_string(i) + (i % 3 ? ".jpg" : ".txt"));
+    }
+
+    auto namesPerSecond = [](std::chrono::steady_clock::duration elapsed) {
+        return numNames / std::max(std::chrono::duration<double>(elapsed).count(), 1e-9);
+    };
+
+    for (auto [pattern, usepcre] : {std::pair<const char*, bool>{"*.jpg", false}, {"file_.*[0-9]\\.jpg", true}})
+    {
+        int perNameMatches = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& name : manyNames)
+        {
+            perNameMatches += patternMatches(name.c_str(), pattern, usepcre);
+        }
+        const double perNameRate = namesPerSecond(std::chrono::steady_clock::now() - start);
+
+        int compiledMatches = 0;
+        start = std::chrono::steady_clock::now();
+        PatternMatcher matcher(pattern, usepcre);
+        for (const auto& name : manyNames)
+        {
+            compiledMatches += matcher.matches(name.c_str());
+        }
+        const double compiledRate = namesPerSecond(std::chrono::steady_clock::now() - start);
+
+        EXPECT_EQ(perNameMatches, compiledMatches);
+        EXPECT_EQ(compiledMatches, numNames - (numNames + 2) / 3);
+
+        G_TEST_INFO << "Pattern " << pattern << ": compiled per name: " << static_cast<long long>(perNameRate)
+                    << " names/sec. Compiled once: " << static_cast<long long>(compiledRate) << " names/sec";
+    }
+}
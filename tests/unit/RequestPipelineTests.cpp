@@ -0,0 +1,238 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_request_pipeline.h"
+
+using namespace megacmd;
+
+namespace
+{
+// Stands for the SDK: requests finish after some latency, and their callbacks are called from a single thread
+class StubRequestExecutor
+{
+public:
+    explicit StubRequestExecutor(std::chrono::milliseconds latency) :
+        mLatency(latency),
+        mThread([this]() { loop(); })
+    {
+    }
+
+    ~StubRequestExecutor()
+    {
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            mExit = true;
+        }
+        mCv.notify_all();
+        mThread.join();
+    }
+
+    void issue(RequestPipeline::Done done, int errorCode = 0, std::chrono::milliseconds extraLatency = {})
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        mInFlight++;
+        mMaxInFlight = std::max(mMaxInFlight, mInFlight);
+        mPending.emplace(std::chrono::steady_clock::now() + mLatency + extraLatency, std::make_pair(std::move(done), errorCode));
+        mCv.notify_all();
+    }
+
+    int maxInFlight()
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return mMaxInFlight;
+    }
+
+private:
+    void loop()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (!mExit)
+        {
+            if (mPending.empty())
+            {
+                mCv.wait(lock);
+                continue;
+            }
+            auto next = mPending.begin();
+            if (mCv.wait_until(lock, next->first) == std::cv_status::no_timeout)
+            {
+                continue; // something new, or exiting
+            }
+            auto request = std::move(next->second);
+            mPending.erase(next);
+            mInFlight--;
+            lock.unlock();
+            request.first(request.second);
+            lock.lock();
+        }
+    }
+
+    const std::chrono::milliseconds mLatency;
+    std::mutex mMutex;
+    std::condition_variable mCv;
+    std::multimap<std::chrono::steady_clock::time_point, std::pair<RequestPipeline::Done, int>> mPending;
+    int mInFlight = 0;
+    int mMaxInFlight = 0;
+    bool mExit = false;
+    std::thread mThread;
+};
+
+std::chrono::steady_clock::duration removeAll(StubRequestExecutor &executor, size_t window, int requests)
+{
+    auto start = std::chrono::steady_clock::now();
+    RequestPipeline pipeline(window);
+    for (int i = 0; i < requests; ++i)
+    {
+        pipeline.submit("delete node " + std::to_string(i), [&executor](RequestPipeline::Done done) {
+            executor.issue(std::move(done));
+        });
+    }
+    pipeline.waitAll();
+    return std::chrono::steady_clock::now() - start;
+}
+}
+
+TEST(RequestPipelineTest, CollectsFailures)
+{
+    StubRequestExecutor executor(std::chrono::milliseconds(1));
+    std::atomic<size_t> lastFinished{0};
+    RequestPipeline pipeline(4, [&lastFinished](size_t finished, size_t) { lastFinished = finished; });
+
+    for (int i = 0; i < 20; ++i)
+    {
+        // the later ones finish first
+        pipeline.submit("request " + std::to_string(i), [&executor, i](RequestPipeline::Done done) {
+            executor.issue(std::move(done), i % 5 ? 0 : -9, std::chrono::milliseconds(20 - i));
+        });
+    }
+    pipeline.waitAll();
+
+    EXPECT_EQ(pipeline.submitted(), 20u);
+    EXPECT_EQ(lastFinished.load(), 20u);
+
+    auto failures = pipeline.takeFailures();
+    ASSERT_EQ(failures.size(), 4u);
+    std::vector<std::string> descriptions;
+    for (auto &failure : failures)
+    {
+        EXPECT_EQ(failure.mErrorCode, -9);
+        descriptions.push_back(failure.mDescription);
+    }
+    // in order of submission
+    EXPECT_EQ(descriptions, (std::vector<std::string>{"request 0", "request 5", "request 10", "request 15"}));
+    EXPECT_TRUE(pipeline.takeFailures().empty());
+}
+
+TEST(RequestPipelineTest, RespectsTheWindow)
+{
+    StubRequestExecutor executor(std::chrono::milliseconds(2));
+    removeAll(executor, 8, 100);
+    EXPECT_LE(executor.maxInFlight(), 8);
+    EXPECT_GT(executor.maxInFlight(), 1);
+}
+
+TEST(RequestPipelineTest, ChainsDependentSteps)
+{
+    // as copying and then renaming: the second step is issued from the callback of the first one
+    StubRequestExecutor executor(std::chrono::milliseconds(1));
+    std::mutex stepsMutex;
+    std::vector<std::vector<std::string>> steps(50);
+    {
+        RequestPipeline pipeline(4);
+        for (int i = 0; i < 50; ++i)
+        {
+            pipeline.submit("copy " + std::to_string(i), [&executor, &stepsMutex, &steps, i](RequestPipeline::Done done) {
+                executor.issue([&executor, &stepsMutex, &steps, i, done](int errorCode) {
+                    {
+                        std::lock_guard<std::mutex> g(stepsMutex);
+                        steps[i].push_back("copy");
+                    }
+                    if (errorCode)
+                    {
+                        done(errorCode);
+                        return;
+                    }
+                    executor.issue([&stepsMutex, &steps, i, done](int errorCode) {
+                        {
+                            std::lock_guard<std::mutex> g(stepsMutex);
+                            steps[i].push_back("rename");
+                        }
+                        done(errorCode);
+                    }, i % 10 == 3 ? -2 : 0);
+                }, i % 10 == 7 ? -1 : 0);
+            });
+        }
+
+        pipeline.waitAll();
+        auto failures = pipeline.takeFailures();
+        ASSERT_EQ(failures.size(), 10u);
+        for (size_t f = 0; f < failures.size(); ++f)
+        {
+            const int i = static_cast<int>(failures[f].mIndex);
+            EXPECT_EQ(failures[f].mDescription, "copy " + std::to_string(i));
+            EXPECT_EQ(failures[f].mErrorCode, i % 10 == 7 ? -1 : -2);
+            EXPECT_TRUE(!f || failures[f - 1].mIndex < failures[f].mIndex);
+        }
+    }
+
+    // the window accounts for whole operations, and every one got to its last step before finishing
+    EXPECT_LE(executor.maxInFlight(), 4);
+    for (int i = 0; i < 50; ++i)
+    {
+        EXPECT_EQ(steps[i], i % 10 == 7 ? std::vector<std::string>{"copy"} : (std::vector<std::string>{"copy", "rename"})) << i;
+    }
+}
+
+TEST(RequestPipelineTest, CompletesSynchronously)
+{
+    RequestPipeline pipeline(2);
+    int issued = 0;
+    for (int i = 0; i < 10; ++i)
+    {
+        pipeline.submit("request", [&issued](RequestPipeline::Done done) {
+            ++issued;
+            done(-1);
+        });
+    }
+    pipeline.waitAll();
+    EXPECT_EQ(issued, 10);
+    EXPECT_EQ(pipeline.takeFailures().size(), 10u);
+}
+
+// Completion time of many requests with some latency (as deleting many nodes) depending on the window
+TEST(RequestPipelineTest, DISABLED_WindowSizeBenchmark)
+{
+    constexpr int requests = 200;
+    StubRequestExecutor executor(std::chrono::milliseconds(2));
+
+    for (size_t window : {1, 4, 32, 128})
+    {
+        auto elapsed = removeAll(executor, window, requests);
+        G_TEST_INFO << "Window " << window << ": " << requests << " requests in "
+                    << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << " ms";
+    }
+}
@@ -0,0 +1,113 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "megacmd_startup_profiler.h"
+
+using megacmd::StartupProfiler;
+using namespace std::chrono_literals;
+
+TEST(StartupProfilerTest, SequentialPhases)
+{
+    const auto start = StartupProfiler::Clock::now();
+    StartupProfiler profiler(start);
+
+    EXPECT_EQ(profiler.endSequentialPhase("configuration", start + 10ms), 10ms);
+    EXPECT_EQ(profiler.endSequentialPhase("logger", start + 15ms), 5ms);
+    EXPECT_EQ(profiler.endSequentialPhase("communications", start + 45ms), 30ms);
+
+    auto phases = profiler.getPhases(start + 1s);
+    ASSERT_EQ(phases.size(), 3u);
+    EXPECT_EQ(phases[0].mName, "configuration");
+    EXPECT_EQ(phases[0].mStart, 0ms);
+    EXPECT_EQ(phases[1].mName, "logger");
+    EXPECT_EQ(phases[1].mStart, 10ms);
+    EXPECT_EQ(phases[1].mDuration, 5ms);
+    EXPECT_EQ(phases[2].mStart, 15ms);
+    EXPECT_EQ(phases[2].mDuration, 30ms);
+    for (const auto &phase : phases)
+    {
+        EXPECT_FALSE(phase.mOngoing);
+    }
+}
+
+TEST(StartupProfilerTest, BackgroundPhases)
+{
+    const auto start = StartupProfiler::Clock::now();
+    StartupProfiler profiler(start);
+
+    EXPECT_TRUE(profiler.startPhase("session resume", start + 20ms));
+    EXPECT_FALSE(profiler.startPhase("session resume", start + 30ms)); // (timed only once)
+    profiler.endSequentialPhase("serving", start + 25ms);
+    EXPECT_TRUE(profiler.isOngoing("session resume"));
+
+    // ongoing ones are reported as long as they have lasted so far
+    auto phases = profiler.getPhases(start + 100ms);
+    ASSERT_EQ(phases.size(), 2u);
+    EXPECT_EQ(phases[0].mName, "serving"); // (by start)
+    EXPECT_EQ(phases[1].mName, "session resume");
+    EXPECT_TRUE(phases[1].mOngoing);
+    EXPECT_EQ(phases[1].mDuration, 80ms);
+
+    EXPECT_EQ(profiler.endPhase("session resume", start + 220ms), StartupProfiler::Clock::duration(200ms));
+    EXPECT_EQ(profiler.endPhase("session resume", start + 300ms), std::nullopt);
+    EXPECT_EQ(profiler.endPhase("nodes current", start + 300ms), std::nullopt); // never started
+    EXPECT_FALSE(profiler.isOngoing("session resume"));
+
+    phases = profiler.getPhases(start + 1s);
+    EXPECT_FALSE(phases[1].mOngoing);
+    EXPECT_EQ(phases[1].mDuration, 200ms);
+}
+
+TEST(StartupProfilerTest, ConcurrentPhases)
+{
+    StartupProfiler profiler;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&profiler, t]
+        {
+            for (int i = 0; i < 100; ++i)
+            {
+                const std::string name = std::to_string(t) + "-" + std::to_string(i);
+                profiler.startPhase(name);
+                profiler.getPhases();
+                profiler.endPhase(name);
+            }
+        });
+    }
+    for (int i = 0; i < 100; ++i)
+    {
+        profiler.endSequentialPhase("sequential-" + std::to_string(i));
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    auto phases = profiler.getPhases();
+    EXPECT_EQ(phases.size(), 500u);
+    for (size_t i = 1; i < phases.size(); ++i)
+    {
+        EXPECT_LE(phases[i - 1].mStart, phases[i].mStart);
+        EXPECT_FALSE(phases[i].mOngoing);
+    }
+}
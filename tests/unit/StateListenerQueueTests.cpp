@@ -0,0 +1,238 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_state_listener_queue.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using megacmd::StateListenerQueue;
+using namespace std::chrono_literals;
+
+namespace
+{
+const std::string separator(1, (char) 0x1F);
+
+std::string progress(long long transferred, long long total, const std::string &title = "")
+{
+    std::string s = "progress:" + std::to_string(transferred) + ":" + std::to_string(total);
+    if (!title.empty())
+    {
+        s += ":" + title;
+    }
+    return s + separator;
+}
+
+// Takes up to `capacity` bytes each time, as a socket whose buffer is that size and read in between
+struct FakeSocket
+{
+    std::string mWritten;
+    size_t mCapacity = std::string::npos;
+    bool mFailing = false;
+
+    auto writer()
+    {
+        return [this](const char *data, size_t size) -> long
+        {
+            if (mFailing)
+            {
+                errno = EPIPE;
+                return -1;
+            }
+            size = std::min(size, mCapacity);
+            if (!size)
+            {
+                errno = EAGAIN;
+                return -1;
+            }
+            mCapacity -= mCapacity == std::string::npos ? 0 : size;
+            mWritten.append(data, size);
+            return static_cast<long>(size);
+        };
+    }
+};
+}
+
+TEST(StateListenerQueueTest, SupersedingKeys)
+{
+    using Key = std::optional<std::string_view>;
+    EXPECT_EQ(StateListenerQueue::getSupersedingKey(progress(1, 10, "Fetching nodes")), Key(":Fetching nodes" + separator));
+    EXPECT_EQ(StateListenerQueue::getSupersedingKey(progress(1, 10)), Key("progress:"));
+    EXPECT_EQ(StateListenerQueue::getSupersedingKey("prompt:user@/folder$ " + separator), Key("prompt:"));
+    EXPECT_EQ(StateListenerQueue::getSupersedingKey("message:hello" + separator), std::nullopt);
+    EXPECT_EQ(StateListenerQueue::getSupersedingKey("ack" + separator), std::nullopt);
+}
+
+TEST(StateListenerQueueTest, CoalescesSupersededMessages)
+{
+    StateListenerQueue queue;
+    EXPECT_TRUE(queue.push(progress(1, 10)));
+    EXPECT_TRUE(queue.push(progress(2, 10)));
+    EXPECT_TRUE(queue.push(progress(3, 10, "Fetching nodes"))); // another transfer
+    EXPECT_TRUE(queue.push(progress(4, 10, "Fetching nodes")));
+    EXPECT_TRUE(queue.push(progress(-2, 10, "Fetching nodes"))); // completion supersedes it too...
+    EXPECT_TRUE(queue.push(progress(5, 10, "Fetching nodes"))); // ...but is not superseded
+    EXPECT_TRUE(queue.push("message:hello" + separator));
+    EXPECT_TRUE(queue.push("message:hello" + separator)); // (messages are never coalesced)
+    EXPECT_TRUE(queue.push("prompt:a$ " + separator));
+    EXPECT_TRUE(queue.push("prompt:b$ " + separator));
+    EXPECT_EQ(queue.getQueuedMessages(), 6u);
+    EXPECT_EQ(queue.getCoalescedCount(), 4u);
+
+    FakeSocket socket;
+    EXPECT_EQ(queue.drain(socket.writer()), StateListenerQueue::DrainResult::DRAINED);
+    EXPECT_EQ(socket.mWritten, progress(2, 10) + progress(-2, 10, "Fetching nodes") + progress(5, 10, "Fetching nodes")
+                               + "message:hello" + separator + "message:hello" + separator + "prompt:b$ " + separator);
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(queue.getQueuedBytes(), 0u);
+}
+
+TEST(StateListenerQueueTest, ResumesPartialWrites)
+{
+    StateListenerQueue queue;
+    FakeSocket socket;
+    socket.mCapacity = 5;
+
+    ASSERT_TRUE(queue.push(progress(1, 10)));
+    EXPECT_EQ(queue.drain(socket.writer()), StateListenerQueue::DrainResult::PENDING);
+    EXPECT_EQ(socket.mWritten, "progr");
+
+    // the one being written cannot be replaced anymore
+    ASSERT_TRUE(queue.push(progress(2, 10)));
+    ASSERT_TRUE(queue.push(progress(3, 10)));
+    EXPECT_EQ(queue.getQueuedMessages(), 2u);
+
+    socket.mCapacity = std::string::npos;
+    EXPECT_EQ(queue.drain(socket.writer()), StateListenerQueue::DrainResult::DRAINED);
+    EXPECT_EQ(socket.mWritten, progress(1, 10) + progress(3, 10));
+
+    ASSERT_TRUE(queue.push("ack" + separator));
+    socket.mFailing = true;
+    EXPECT_EQ(queue.drain(socket.writer()), StateListenerQueue::DrainResult::FAILED);
+}
+
+TEST(StateListenerQueueTest, BoundedAndStalled)
+{
+    StateListenerQueue queue(100, 10s);
+    const auto start = StateListenerQueue::Clock::now();
+
+    ASSERT_TRUE(queue.push(std::string(60, 'a'), start));
+    EXPECT_FALSE(queue.push(std::string(60, 'b'), start));
+    EXPECT_EQ(queue.getQueuedBytes(), 60u);
+
+    EXPECT_FALSE(queue.isStalled(start + 9s));
+    EXPECT_TRUE(queue.isStalled(start + 11s));
+
+    // anything written is progress
+    FakeSocket socket;
+    socket.mCapacity = 10;
+    EXPECT_EQ(queue.drain(socket.writer(), start + 11s), StateListenerQueue::DrainResult::PENDING);
+    EXPECT_FALSE(queue.isStalled(start + 12s));
+    EXPECT_TRUE(queue.isStalled(start + 22s));
+
+    socket.mCapacity = std::string::npos;
+    EXPECT_EQ(queue.drain(socket.writer(), start + 22s), StateListenerQueue::DrainResult::DRAINED);
+    EXPECT_FALSE(queue.isStalled(start + 100s)); // nothing queued
+}
+
+#ifndef _WIN32
+// Informing a listener whose client does not read (as a frozen shell) vs one that does, through actual sockets
+TEST(StateListenerQueueTest, DISABLED_FrozenListenerBenchmark)
+{
+    int frozen[2];
+    int reading[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, frozen), 0);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, reading), 0);
+    for (int fd : {frozen[0], reading[0]})
+    {
+        ASSERT_NE(fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK), -1);
+    }
+
+    StateListenerQueue frozenQueue;
+    StateListenerQueue readingQueue;
+    auto sender = [](int fd)
+    {
+        return [fd](const char *data, size_t size) { return send(fd, data, size, 0); };
+    };
+
+    constexpr long long updates = 200000;
+    const std::string title(40, 't');
+    std::string received;
+    char buffer[65536];
+
+    auto start = std::chrono::steady_clock::now();
+    for (long long i = 0; i < updates; ++i)
+    {
+        const std::string message = progress(i, updates, title);
+        ASSERT_TRUE(frozenQueue.push(message));
+        frozenQueue.drain(sender(frozen[0]));
+        ASSERT_TRUE(readingQueue.push(message));
+        readingQueue.drain(sender(reading[0]));
+
+        if (i % 64 == 0)
+        {
+            auto n = recv(reading[1], buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (n > 0)
+            {
+                received.append(buffer, static_cast<size_t>(n));
+            }
+        }
+    }
+    while (readingQueue.drain(sender(reading[0])) != StateListenerQueue::DrainResult::DRAINED)
+    {
+        auto n = recv(reading[1], buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (n > 0)
+        {
+            received.append(buffer, static_cast<size_t>(n));
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    // whatever the frozen one could not take was coalesced in a single message
+    EXPECT_LE(frozenQueue.getQueuedMessages(), 2u);
+    EXPECT_GT(frozenQueue.getCoalescedCount(), 0u);
+
+    // the reading one got the last update (drain what was left in its socket)
+    for (ssize_t n; (n = recv(reading[1], buffer, sizeof(buffer), MSG_DONTWAIT)) > 0;)
+    {
+        received.append(buffer, static_cast<size_t>(n));
+    }
+    const std::string last = progress(updates - 1, updates, title);
+    ASSERT_GE(received.size(), last.size());
+    EXPECT_EQ(received.substr(received.size() - last.size()), last);
+
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    G_TEST_INFO << updates << " updates to a frozen and a reading listener: " << duration_cast<microseconds>(elapsed).count()
+                << " us. Frozen one: " << frozenQueue.getCoalescedCount() << " coalesced, "
+                << frozenQueue.getQueuedBytes() << " bytes queued. Reading one: " << readingQueue.getCoalescedCount()
+                << " coalesced, " << received.size() << " bytes received";
+
+    for (int fd : {frozen[0], frozen[1], reading[0], reading[1]})
+    {
+        close(fd);
+    }
+}
+#endif
@@ -0,0 +1,279 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_stream_buffer.h"
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace megacmd;
+
+namespace
+{
+std::string contentsOfSize(size_t size)
+{
+    std::string contents(size, ' ');
+    for (size_t i = 0; i < size; ++i)
+    {
+        contents[i] = static_cast<char>('a' + i % 26);
+    }
+    return contents;
+}
+
+// Delivers contents from offset in chunks, as the SDK does with a streaming transfer: it stops as soon as it
+// is told to, and closes the input when done. The time spent handing the chunks is added to blocked (if any)
+void fakeStreaming(StreamBuffer &buffer, const std::string &contents, size_t offset, size_t chunkSize,
+                   std::chrono::steady_clock::duration *blocked)
+{
+    for (size_t pos = offset; pos < contents.size(); pos += chunkSize)
+    {
+        const size_t size = std::min(chunkSize, contents.size() - pos);
+        auto start = std::chrono::steady_clock::now();
+        const bool keepGoing = buffer.write(contents.data() + pos, size);
+        if (blocked)
+        {
+            *blocked += std::chrono::steady_clock::now() - start;
+        }
+        if (!keepGoing)
+        {
+            break;
+        }
+    }
+    buffer.closeInput();
+}
+
+// Reads everything as cat does: restarting the (fake) streaming whenever it was paused, as soon as it can
+std::string readAll(StreamBuffer &buffer, const std::string &contents, size_t chunkSize,
+                    const std::function<void(const std::string &)> &send = nullptr,
+                    std::chrono::steady_clock::duration *producerBlocked = nullptr)
+{
+    std::string received;
+    std::thread producer(fakeStreaming, std::ref(buffer), std::cref(contents), 0, chunkSize, producerBlocked);
+
+    std::vector<std::string> chunks;
+    for (;;)
+    {
+        if (buffer.read(chunks))
+        {
+            for (auto &chunk : chunks)
+            {
+                if (send)
+                {
+                    send(chunk);
+                }
+                received += chunk;
+            }
+            buffer.recycle(chunks);
+
+            if (buffer.canResume() && buffer.totalWritten() < contents.size())
+            {
+                producer.join();
+                buffer.reopenInput();
+                producer = std::thread(fakeStreaming, std::ref(buffer), std::cref(contents), buffer.totalWritten(), chunkSize, producerBlocked);
+            }
+            continue;
+        }
+
+        producer.join();
+        if (buffer.isPaused() && buffer.totalWritten() < contents.size())
+        {
+            buffer.reopenInput();
+            producer = std::thread(fakeStreaming, std::ref(buffer), std::cref(contents), buffer.totalWritten(), chunkSize, producerBlocked);
+            continue;
+        }
+        break;
+    }
+    return received;
+}
+}
+
+TEST(StreamBufferTest, DeliversEverythingInOrder)
+{
+    const std::string contents = contentsOfSize(1000 * 1000 + 7);
+    StreamBuffer buffer(1024 * 1024);
+    EXPECT_EQ(readAll(buffer, contents, 1000), contents);
+    EXPECT_EQ(buffer.getStats().mPauses, 0u);
+}
+
+TEST(StreamBufferTest, ResumesWhenPaused)
+{
+    const std::string contents = contentsOfSize(1000 * 1000 + 7);
+    StreamBuffer buffer(10 * 1000);
+    EXPECT_EQ(readAll(buffer, contents, 1000), contents);
+    EXPECT_LE(buffer.getStats().mMaxInFlight, 10u * 1000u);
+    EXPECT_EQ(buffer.inFlight(), 0u);
+}
+
+TEST(StreamBufferTest, CountsWhatTheConsumerHolds)
+{
+    StreamBuffer buffer(10);
+    EXPECT_TRUE(buffer.write("abcd", 4));
+
+    std::vector<std::string> chunks;
+    EXPECT_TRUE(buffer.read(chunks));
+    EXPECT_EQ(buffer.inFlight(), 4u); // still being sent
+    EXPECT_TRUE(buffer.write("efgh", 4));
+    EXPECT_FALSE(buffer.write("ijkl", 4)); // full: 12 bytes in memory
+    EXPECT_EQ(buffer.getStats().mMaxInFlight, 12u);
+    buffer.closeInput();
+    EXPECT_FALSE(buffer.canResume()); // the consumer is still behind
+
+    buffer.recycle(chunks);
+    EXPECT_EQ(buffer.inFlight(), 8u);
+    EXPECT_FALSE(buffer.canResume());
+    EXPECT_TRUE(buffer.read(chunks));
+    ASSERT_EQ(chunks.size(), 2u);
+    std::vector<std::string> sent{std::move(chunks[0])};
+    chunks.erase(chunks.begin());
+    buffer.recycle(sent);
+    EXPECT_EQ(buffer.inFlight(), 4u);
+    EXPECT_TRUE(buffer.canResume()); // caught up, with data still to be sent
+
+    buffer.reopenInput();
+    EXPECT_FALSE(buffer.canResume());
+    EXPECT_TRUE(buffer.write("mnop", 4));
+    buffer.recycle(chunks);
+    buffer.abort();
+    EXPECT_EQ(buffer.inFlight(), 0u);
+}
+
+TEST(StreamBufferTest, StopsTheProducerWhenFull)
+{
+    StreamBuffer buffer(10);
+    EXPECT_TRUE(buffer.write("abcd", 4));
+    EXPECT_TRUE(buffer.write("efgh", 4));
+    EXPECT_FALSE(buffer.write("ijkl", 4)); // taken, but full
+    EXPECT_TRUE(buffer.isPaused());
+    EXPECT_FALSE(buffer.write("mnop", 4)); // discarded
+    EXPECT_EQ(buffer.totalWritten(), 12u);
+    buffer.closeInput();
+
+    std::vector<std::string> chunks;
+    EXPECT_TRUE(buffer.read(chunks));
+    EXPECT_EQ(chunks, (std::vector<std::string>{"abcd", "efgh", "ijkl"}));
+    buffer.recycle(chunks);
+    EXPECT_FALSE(buffer.read(chunks));
+
+    buffer.reopenInput();
+    EXPECT_FALSE(buffer.isPaused());
+    EXPECT_TRUE(buffer.write("mnop", 4));
+    EXPECT_EQ(buffer.totalWritten(), 16u);
+}
+
+TEST(StreamBufferTest, AbortStopsBothSides)
+{
+    StreamBuffer buffer(1024);
+    EXPECT_TRUE(buffer.write("abcd", 4));
+
+    std::vector<std::string> chunks;
+    std::thread consumer([&]() {
+        while (buffer.read(chunks))
+        {
+            chunks.clear();
+        }
+    });
+
+    buffer.abort();
+    consumer.join(); // no longer waiting
+    EXPECT_FALSE(buffer.write("efgh", 4));
+    EXPECT_TRUE(buffer.isAborted());
+}
+
+#ifndef _WIN32
+// Streams through a socket read by a slow client: compares the time the producer (i.e: the SDK thread) was
+// kept waiting when sending straight from it (as cat used to) against handing the data to the buffer
+TEST(StreamBufferTest, DISABLED_SlowClientBenchmark)
+{
+    constexpr size_t chunkSize = 64 * 1024;
+    const std::string contents = contentsOfSize(16 * 1024 * 1024);
+
+    auto runWithSlowClient = [&](const std::function<std::chrono::steady_clock::duration(int socket)> &stream)
+    {
+        int sockets[2];
+        EXPECT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+
+        size_t received = 0;
+        std::thread client([&]() {
+            std::vector<char> readBuffer(chunkSize);
+            ssize_t n;
+            while ((n = read(sockets[1], readBuffer.data(), readBuffer.size())) > 0)
+            {
+                received += static_cast<size_t>(n);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+
+        auto start = std::chrono::steady_clock::now();
+        auto producerBlocked = stream(sockets[0]);
+        close(sockets[0]);
+        client.join();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        close(sockets[1]);
+
+        EXPECT_EQ(received, contents.size());
+        return std::make_pair(producerBlocked, elapsed);
+    };
+
+    auto sendAll = [](int socket, const char *data, size_t size) {
+        while (size)
+        {
+            auto n = send(socket, data, size, 0);
+            ASSERT_GT(n, 0);
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+    };
+
+    auto [directBlocked, directElapsed] = runWithSlowClient([&](int socket) {
+        std::chrono::steady_clock::duration blocked{};
+        for (size_t pos = 0; pos < contents.size(); pos += chunkSize)
+        {
+            auto start = std::chrono::steady_clock::now();
+            sendAll(socket, contents.data() + pos, std::min(chunkSize, contents.size() - pos));
+            blocked += std::chrono::steady_clock::now() - start;
+        }
+        return blocked;
+    });
+
+    auto [bufferedBlocked, bufferedElapsed] = runWithSlowClient([&](int socket) {
+        StreamBuffer buffer(4 * 1024 * 1024);
+        std::chrono::steady_clock::duration blocked{};
+        readAll(buffer, contents, chunkSize, [&](const std::string &chunk) { sendAll(socket, chunk.data(), chunk.size()); }, &blocked);
+        return blocked;
+    });
+
+    auto ms = [](std::chrono::steady_clock::duration d) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+    };
+    auto mbPerSecond = [&contents](std::chrono::steady_clock::duration d) {
+        return static_cast<long long>(contents.size() / (1024.0 * 1024.0) / std::max(std::chrono::duration<double>(d).count(), 1e-9));
+    };
+
+    G_TEST_INFO << "Sending from the producer: producer blocked " << ms(directBlocked) << " ms, " << mbPerSecond(directElapsed) << " MB/s";
+    G_TEST_INFO << "Through the buffer: producer blocked " << ms(bufferedBlocked) << " ms, " << mbPerSecond(bufferedElapsed) << " MB/s";
+}
+#endif
@@ -1923,3 +1923,20 @@ TEST(StringUtilsTest, toLower)
         EXPECT_EQ(original, "HELLO");
     }
 }
+
+TEST(StringUtilsTest, isSideEffectFreeCommand)
+{
+    using megacmd::isSideEffectFreeCommand;
+
+    EXPECT_TRUE(isSideEffectFreeCommand("ls"));
+    EXPECT_TRUE(isSideEffectFreeCommand("ls -l /some/folder"));
+    EXPECT_TRUE(isSideEffectFreeCommand("  find\t--pattern=*.txt"));
+    EXPECT_TRUE(isSideEffectFreeCommand("pwd"));
+
+    EXPECT_FALSE(isSideEffectFreeCommand("cd /some/folder"));
+    EXPECT_FALSE(isSideEffectFreeCommand("mkdir dir"));
+    EXPECT_FALSE(isSideEffectFreeCommand("put file dir"));
+    EXPECT_FALSE(isSideEffectFreeCommand("lsx"));
+    EXPECT_FALSE(isSideEffectFreeCommand(""));
+    EXPECT_FALSE(isSideEffectFreeCommand("   "));
+}
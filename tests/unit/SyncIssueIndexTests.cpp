@@ -0,0 +1,282 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_sync_issue_index.h"
+
+using namespace megacmd;
+
+namespace
+{
+std::string makeId(int i)
+{
+    char id[16];
+    snprintf(id, sizeof(id), "id%06d", i);
+    return id;
+}
+
+// Issue i belongs to sync i % 4, has reason i % 3, and a local path in folder i % 10 (and its subfolder i % 100)
+IndexedSyncIssue makeIssue(int i)
+{
+    IndexedSyncIssue issue;
+    issue.mSyncId = static_cast<uint64_t>(i % 4);
+    issue.mReason = i % 3;
+    issue.mPathProblems = {i % 5, 100};
+    issue.mPaths = {"/local/dir" + std::to_string(i % 10) + "/sub" + std::to_string(i % 100) + "/file" + std::to_string(i), "/cloud/file" + std::to_string(i)};
+    return issue;
+}
+
+std::vector<std::string> makeIds(int begin, int end)
+{
+    std::vector<std::string> ids;
+    for (int i = begin; i < end; ++i)
+    {
+        ids.push_back(makeId(i));
+    }
+    return ids;
+}
+
+std::map<std::string, IndexedSyncIssue> makeIssues(const std::vector<std::string> &ids)
+{
+    std::map<std::string, IndexedSyncIssue> issues;
+    for (const std::string &id : ids)
+    {
+        issues.emplace(id, makeIssue(std::stoi(id.substr(2))));
+    }
+    return issues;
+}
+
+size_t update(SyncIssueIndex &index, const std::vector<std::string> &ids)
+{
+    return index.update(ids, [](const std::string &id) { return makeIssue(std::stoi(id.substr(2))); });
+}
+
+// What the index should answer: going through all the issues
+std::vector<std::string> scan(const std::map<std::string, IndexedSyncIssue> &issues, const SyncIssueQuery &query)
+{
+    std::vector<std::string> matching;
+    for (const auto &[id, issue] : issues)
+    {
+        if ((query.mSyncId && issue.mSyncId != *query.mSyncId)
+            || (query.mReason && issue.mReason != *query.mReason)
+            || (query.mPathProblem && std::count(issue.mPathProblems.begin(), issue.mPathProblems.end(), *query.mPathProblem) == 0)
+            || (query.mPathPrefix && std::none_of(issue.mPaths.begin(), issue.mPaths.end(),
+                    [&query](const std::string &path) { return SyncIssueIndex::isWithin(path, *query.mPathPrefix); })))
+        {
+            continue;
+        }
+        matching.push_back(id);
+    }
+    return matching;
+}
+}
+
+TEST(SyncIssueIndexTest, IsWithin)
+{
+    EXPECT_TRUE(SyncIssueIndex::isWithin("/a/foo", "/a/foo"));
+    EXPECT_TRUE(SyncIssueIndex::isWithin("/a/foo/b", "/a/foo"));
+    EXPECT_TRUE(SyncIssueIndex::isWithin("/a/foo/b", "/a/foo/"));
+    EXPECT_TRUE(SyncIssueIndex::isWithin("C:\\a\\foo\\b", "C:\\a\\foo"));
+    EXPECT_TRUE(SyncIssueIndex::isWithin("/a/foo", "/"));
+    EXPECT_FALSE(SyncIssueIndex::isWithin("/a/foobar", "/a/foo"));
+    EXPECT_FALSE(SyncIssueIndex::isWithin("/a", "/a/foo"));
+}
+
+TEST(SyncIssueIndexTest, UpdatesIncrementally)
+{
+    SyncIssueIndex index;
+    EXPECT_EQ(update(index, makeIds(0, 100)), 100u);
+    EXPECT_EQ(index.size(), 100u);
+
+    // only the new ones are indexed
+    EXPECT_EQ(update(index, makeIds(0, 100)), 0u);
+    EXPECT_EQ(update(index, makeIds(50, 120)), 20u);
+    EXPECT_EQ(index.size(), 70u);
+
+    // the removed ones are no longer found through any of the secondary indexes
+    auto issues = makeIssues(makeIds(50, 120));
+    std::vector<SyncIssueQuery> queries(5);
+    queries[0].mSyncId = 0;
+    queries[1].mReason = 1;
+    queries[2].mPathProblem = 100;
+    queries[3].mPathPrefix = "/local/dir3";
+    queries[4].mPathPrefix = "/cloud";
+    for (const SyncIssueQuery &query : queries)
+    {
+        auto result = index.query(query);
+        EXPECT_EQ(result.mIds, scan(issues, query));
+        EXPECT_EQ(result.mTotal, result.mIds.size());
+    }
+
+    EXPECT_EQ(update(index, {}), 0u);
+    EXPECT_TRUE(index.empty());
+    EXPECT_EQ(index.query({}).mTotal, 0u);
+}
+
+TEST(SyncIssueIndexTest, CombinesFilters)
+{
+    SyncIssueIndex index;
+    auto ids = makeIds(0, 1000);
+    update(index, ids);
+    auto issues = makeIssues(ids);
+
+    for (uint64_t syncId : {0, 3, 7})
+    {
+        for (int reason : {0, 2})
+        {
+            for (std::string prefix : {"/local/dir1", "/local/dir1/", "/local/dir", "/cloud/file12", "/"})
+            {
+                SyncIssueQuery query;
+                query.mSyncId = syncId;
+                query.mReason = reason;
+                query.mPathPrefix = prefix;
+                EXPECT_EQ(index.query(query).mIds, scan(issues, query)) << syncId << " " << reason << " " << prefix;
+
+                query.mPathProblem = 4;
+                EXPECT_EQ(index.query(query).mIds, scan(issues, query)) << syncId << " " << reason << " " << prefix;
+            }
+        }
+    }
+}
+
+TEST(SyncIssueIndexTest, PathPrefixIsAFolder)
+{
+    SyncIssueIndex index;
+    std::map<std::string, std::vector<std::string>> paths{
+        {"a", {"/a/foo"}}, {"b", {"/a/foo bar/x"}}, {"c", {"/a/foo/x"}}, {"d", {"/a/foobar"}}, {"e", {"/a/fo", "/a/foo/y"}}};
+    std::vector<std::string> ids;
+    for (const auto &[id, issuePaths] : paths)
+    {
+        ids.push_back(id);
+    }
+    index.update(ids, [&paths](const std::string &id)
+    {
+        IndexedSyncIssue issue;
+        issue.mPaths = paths[id];
+        return issue;
+    });
+
+    SyncIssueQuery query;
+    query.mPathPrefix = "/a/foo";
+    EXPECT_EQ(index.query(query).mIds, (std::vector<std::string>{"a", "c", "e"}));
+    query.mReason = 0; // (going through the issues of the reason instead)
+    EXPECT_EQ(index.query(query).mIds, (std::vector<std::string>{"a", "c", "e"}));
+}
+
+TEST(SyncIssueIndexTest, Pages)
+{
+    SyncIssueIndex index;
+    auto ids = makeIds(0, 95);
+    update(index, ids);
+    auto issues = makeIssues(ids);
+
+    SyncIssueQuery query;
+    query.mReason = 1;
+    auto matching = scan(issues, query);
+    ASSERT_EQ(matching.size(), 32u);
+
+    std::vector<std::string> paged;
+    query.mLimit = 10;
+    for (query.mOffset = 0; query.mOffset < 40; query.mOffset += query.mLimit)
+    {
+        auto result = index.query(query);
+        EXPECT_EQ(result.mTotal, matching.size());
+        EXPECT_EQ(result.mIds.size(), std::min<size_t>(10, matching.size() - std::min(matching.size(), query.mOffset)));
+        paged.insert(paged.end(), result.mIds.begin(), result.mIds.end());
+    }
+    EXPECT_EQ(paged, matching);
+}
+
+// Filtering and paging through many issues with the index vs going through all of them
+TEST(SyncIssueIndexTest, DISABLED_QueryBenchmark)
+{
+    constexpr int issues = 100000;
+    auto ids = makeIds(0, issues);
+    auto allIssues = makeIssues(ids);
+
+    SyncIssueIndex index;
+    auto start = std::chrono::steady_clock::now();
+    update(index, ids);
+    auto indexing = std::chrono::steady_clock::now() - start;
+
+    // a later list of issues, with a few changes, is indexed incrementally
+    start = std::chrono::steady_clock::now();
+    EXPECT_EQ(update(index, makeIds(100, issues + 100)), 100u);
+    auto reindexing = std::chrono::steady_clock::now() - start;
+    allIssues = makeIssues(makeIds(100, issues + 100));
+
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    using std::chrono::milliseconds;
+    G_TEST_INFO << "Indexing " << issues << " issues: " << duration_cast<milliseconds>(indexing).count() << " ms; "
+                << "updating with 100 new ones: " << duration_cast<milliseconds>(reindexing).count() << " ms";
+
+    std::vector<std::pair<std::string, SyncIssueQuery>> queries(4);
+    queries[0].first = "3rd page";
+    queries[1].first = "3rd page of a sync and path problem";
+    queries[1].second.mSyncId = 2;
+    queries[1].second.mPathProblem = 1;
+    queries[2].first = "a folder";
+    queries[2].second.mPathPrefix = "/local/dir6/sub16";
+    queries[3].first = "a reason within a folder";
+    queries[3].second.mReason = 1;
+    queries[3].second.mPathPrefix = "/local/dir6";
+
+    std::chrono::steady_clock::duration totalIndexed{}, totalScanning{};
+    for (auto &[description, query] : queries)
+    {
+        query.mOffset = 20;
+        query.mLimit = 10;
+
+        constexpr int repetitions = 20;
+        start = std::chrono::steady_clock::now();
+        SyncIssueQueryResult result;
+        for (int i = 0; i < repetitions; ++i)
+        {
+            result = index.query(query);
+        }
+        auto indexed = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        std::vector<std::string> matching;
+        for (int i = 0; i < repetitions; ++i)
+        {
+            matching = scan(allIssues, query);
+        }
+        auto scanning = std::chrono::steady_clock::now() - start;
+
+        ASSERT_EQ(result.mTotal, matching.size()) << description;
+        ASSERT_GT(matching.size(), 20u) << description;
+        EXPECT_EQ(result.mIds, std::vector<std::string>(matching.begin() + 20, matching.begin() + std::min<size_t>(30, matching.size())))
+            << description;
+
+        G_TEST_INFO << description << " (" << matching.size() << " matching), " << repetitions << " times: "
+                    << duration_cast<microseconds>(indexed).count() << " us indexed vs "
+                    << duration_cast<microseconds>(scanning).count() << " us scanning";
+        totalIndexed += indexed;
+        totalScanning += scanning;
+    }
+    G_TEST_INFO << "In total: " << duration_cast<microseconds>(totalIndexed).count() << " us indexed vs "
+                << duration_cast<microseconds>(totalScanning).count() << " us scanning";
+}
@@ -0,0 +1,313 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_transfer_history.h"
+
+using namespace megacmd;
+
+namespace fs = std::filesystem;
+
+namespace
+{
+constexpr int TYPE_DOWNLOAD = 0;
+constexpr int TYPE_UPLOAD = 1;
+
+CompletedTransfer makeCompleted(int tag, int type = TYPE_DOWNLOAD)
+{
+    CompletedTransfer t;
+    t.mTag = tag;
+    t.mType = type;
+    t.mLocalPath = "/local/file" + std::to_string(tag);
+    t.mFileName = "file" + std::to_string(tag);
+    t.mTotal = tag;
+    t.mTransferred = tag;
+    return t;
+}
+
+std::vector<int> tagsOf(const std::vector<CompletedTransfer> &transfers)
+{
+    std::vector<int> tags;
+    for (auto &t : transfers)
+    {
+        tags.push_back(t.mTag);
+    }
+    return tags;
+}
+
+auto all = [](const CompletedTransfer &) { return true; };
+
+template <typename Condition>
+bool eventually(Condition &&condition)
+{
+    for (int i = 0; i < 1000 && !condition(); ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return condition();
+}
+
+class TransferHistoryDiskTest : public ::testing::Test
+{
+protected:
+    fs::path mSpillFile;
+
+    void SetUp() override
+    {
+        mSpillFile = fs::temp_directory_path() / ("megacmd_history_test_" + std::to_string(::testing::UnitTest::GetInstance()->random_seed()));
+    }
+
+    void TearDown() override
+    {
+        std::error_code ec;
+        fs::remove(mSpillFile, ec);
+        fs::remove(fs::path(mSpillFile).concat(".1"), ec);
+    }
+};
+}
+
+TEST(TransferHistoryTest, KeepsTheMostRecent)
+{
+    CompletedTransferHistory history(3);
+    EXPECT_EQ(history.size(), 0u);
+    EXPECT_TRUE(history.get(0, 10, all).empty());
+
+    for (int tag = 1; tag <= 5; ++tag)
+    {
+        history.add(makeCompleted(tag));
+    }
+    EXPECT_EQ(history.size(), 3u);
+    EXPECT_EQ(tagsOf(history.get(0, 10, all)), (std::vector<int>{5, 4, 3}));
+    EXPECT_EQ(tagsOf(history.get(1, 1, all)), (std::vector<int>{4}));
+    EXPECT_EQ(history.get(0, 1, all).front().mLocalPath, "/local/file5");
+}
+
+TEST(TransferHistoryTest, FiltersAndPages)
+{
+    CompletedTransferHistory history(100);
+    for (int tag = 1; tag <= 10; ++tag)
+    {
+        history.add(makeCompleted(tag, tag % 2 ? TYPE_UPLOAD : TYPE_DOWNLOAD));
+    }
+
+    auto uploads = [](const CompletedTransfer &t) { return t.mType == TYPE_UPLOAD; };
+    EXPECT_EQ(tagsOf(history.get(0, 3, uploads)), (std::vector<int>{9, 7, 5}));
+    EXPECT_EQ(tagsOf(history.get(3, 3, uploads)), (std::vector<int>{3, 1}));
+    EXPECT_TRUE(history.get(5, 3, uploads).empty());
+}
+
+TEST(TransferHistoryTest, KeepsResolvedPaths)
+{
+    CompletedTransferHistory history(2);
+    history.add(makeCompleted(1));
+    history.add(makeCompleted(2));
+
+    auto records = history.get(0, 2, all);
+    history.setRemotePath(records[1].mId, "/remote/file1");
+    EXPECT_EQ(history.get(1, 1, all).front().mRemotePath, "/remote/file1");
+
+    history.add(makeCompleted(3)); // 1 is gone
+    history.setRemotePath(records[1].mId, "/somewhere/else");
+    for (auto &record : history.get(0, 2, all))
+    {
+        EXPECT_NE(record.mRemotePath, "/somewhere/else");
+    }
+}
+
+TEST(TransferHistoryTest, NoCapacity)
+{
+    CompletedTransferHistory history(0);
+    history.add(makeCompleted(1));
+    EXPECT_EQ(history.size(), 0u);
+    EXPECT_TRUE(history.get(0, 10, all).empty());
+}
+
+TEST(TransferHistoryTest, ChangesCapacity)
+{
+    CompletedTransferHistory history(4);
+    for (int tag = 1; tag <= 6; ++tag) // (wrapping around)
+    {
+        history.add(makeCompleted(tag));
+    }
+
+    history.setCapacity(2);
+    EXPECT_EQ(history.size(), 2u);
+    EXPECT_EQ(tagsOf(history.get(0, 10, all)), (std::vector<int>{6, 5}));
+
+    history.setCapacity(5);
+    for (int tag = 7; tag <= 10; ++tag)
+    {
+        history.add(makeCompleted(tag));
+    }
+    EXPECT_EQ(tagsOf(history.get(0, 10, all)), (std::vector<int>{10, 9, 8, 7, 6}));
+
+    history.setCapacity(0);
+    EXPECT_EQ(history.size(), 0u);
+    history.add(makeCompleted(11));
+    EXPECT_TRUE(history.get(0, 10, all).empty());
+}
+
+TEST_F(TransferHistoryDiskTest, ShrinkingSpillsToDisk)
+{
+    CompletedTransferHistory history(10);
+    history.enableSpill(mSpillFile, 1000);
+    for (int tag = 1; tag <= 10; ++tag)
+    {
+        history.add(makeCompleted(tag));
+    }
+
+    history.setCapacity(3);
+    EXPECT_EQ(history.size(), 10u);
+    EXPECT_EQ(tagsOf(history.get(0, 10, all)), (std::vector<int>{10, 9, 8, 7, 6, 5, 4, 3, 2, 1}));
+}
+
+TEST_F(TransferHistoryDiskTest, SpillsEvictedToDisk)
+{
+    CompletedTransferHistory history(10);
+    history.enableSpill(mSpillFile, 1000);
+
+    constexpr int added = 500;
+    for (int tag = 1; tag <= added; ++tag)
+    {
+        history.add(makeCompleted(tag));
+    }
+    EXPECT_EQ(history.size(), static_cast<size_t>(added));
+
+    auto records = history.get(0, added, all);
+    ASSERT_EQ(records.size(), static_cast<size_t>(added));
+    for (int i = 0; i < added; ++i)
+    {
+        EXPECT_EQ(records[i].mTag, added - i);
+        EXPECT_EQ(records[i].mLocalPath, "/local/file" + std::to_string(added - i));
+        EXPECT_EQ(records[i].mTotal, added - i);
+    }
+
+    // paging through the ones on disk
+    EXPECT_EQ(tagsOf(history.get(400, 3, all)), (std::vector<int>{100, 99, 98}));
+}
+
+TEST_F(TransferHistoryDiskTest, DiskIsBounded)
+{
+    CompletedTransferHistory history(10);
+    history.enableSpill(mSpillFile, 100);
+
+    for (int tag = 1; tag <= 1000; ++tag)
+    {
+        history.add(makeCompleted(tag));
+    }
+
+    // in memory, plus between half and all of the maximum on disk (the current file and the previous one)
+    auto size = history.size();
+    EXPECT_GE(size, 10u + 50u);
+    EXPECT_LE(size, 10u + 100u);
+
+    auto records = history.get(0, 1000, all);
+    ASSERT_EQ(records.size(), size);
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        EXPECT_EQ(records[i].mTag, static_cast<int>(1000 - i));
+    }
+}
+
+TEST_F(TransferHistoryDiskTest, AddsWhileReading)
+{
+    CompletedTransferHistory history(64);
+    history.enableSpill(mSpillFile, 100000);
+
+    constexpr int added = 20000;
+    std::atomic_bool done{false};
+    std::thread reader([&]() {
+        while (!done)
+        {
+            auto records = history.get(0, 100, all);
+            for (size_t i = 1; i < records.size(); ++i)
+            {
+                EXPECT_GT(records[i - 1].mId, records[i].mId);
+            }
+        }
+    });
+
+    for (int tag = 1; tag <= added; ++tag)
+    {
+        history.add(makeCompleted(tag));
+    }
+    done = true;
+    reader.join();
+
+    EXPECT_EQ(history.size(), static_cast<size_t>(added));
+    EXPECT_EQ(tagsOf(history.get(added - 2, 5, all)), (std::vector<int>{2, 1}));
+}
+
+TEST(TransferHistoryTest, ResolvesRemotePathsInTheBackground)
+{
+    CompletedTransferHistory history(10);
+    const auto callerThread = std::this_thread::get_id();
+    std::atomic_bool resolvedFromTheCaller{false};
+    history.setRemotePathResolver([&](const CompletedTransfer &transfer) {
+        resolvedFromTheCaller = resolvedFromTheCaller || std::this_thread::get_id() == callerThread;
+        return "/remote/" + transfer.mFileName;
+    });
+
+    auto download = makeCompleted(1);
+    download.mNodeHandle = 42;
+    history.add(download);
+    history.add(makeCompleted(2, TYPE_UPLOAD));
+
+    EXPECT_TRUE(eventually([&history]() { return history.findDownloadRemotePath(42, TYPE_DOWNLOAD).has_value(); }));
+    EXPECT_EQ(history.findDownloadRemotePath(42, TYPE_DOWNLOAD), "/remote/file1");
+    EXPECT_EQ(history.findDownloadRemotePath(42, TYPE_UPLOAD), std::nullopt);
+    EXPECT_EQ(history.findDownloadRemotePath(43, TYPE_DOWNLOAD), std::nullopt);
+    EXPECT_FALSE(resolvedFromTheCaller);
+}
+
+TEST_F(TransferHistoryDiskTest, AddDoesNotWriteToDisk)
+{
+    CompletedTransferHistory history(10);
+    history.enableSpill(mSpillFile, 100000);
+
+    // the background thread is kept busy while adding
+    std::mutex resolverMutex;
+    std::unique_lock<std::mutex> holdResolver(resolverMutex);
+    std::atomic_bool resolving{false};
+    history.setRemotePathResolver([&](const CompletedTransfer &) {
+        resolving = true;
+        std::lock_guard<std::mutex> g(resolverMutex);
+        return std::string();
+    });
+    history.add(makeCompleted(0));
+    ASSERT_TRUE(eventually([&resolving]() { return resolving.load(); }));
+
+    constexpr int added = 1000;
+    for (int tag = 1; tag <= added; ++tag)
+    {
+        history.add(makeCompleted(tag));
+    }
+    EXPECT_EQ(fs::file_size(mSpillFile), 0u);
+
+    holdResolver.unlock();
+    EXPECT_EQ(history.size(), static_cast<size_t>(added + 1));
+    EXPECT_GT(fs::file_size(mSpillFile), 0u);
+    EXPECT_EQ(tagsOf(history.get(added - 1, 5, all)), (std::vector<int>{1, 0}));
+}
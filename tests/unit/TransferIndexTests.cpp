@@ -0,0 +1,174 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_transfer_index.h"
+
+using namespace megacmd;
+
+namespace
+{
+constexpr int STATE_QUEUED = 1;
+constexpr int STATE_ACTIVE = 2;
+constexpr int STATE_COMPLETED = 6;
+
+IndexedTransfer makeTransfer(int tag, bool upload, uint64_t priority, long long transferred = 0, long long total = 100,
+                             int state = STATE_QUEUED, bool sync = false)
+{
+    IndexedTransfer t;
+    t.mTag = tag;
+    t.mUpload = upload;
+    t.mSync = sync;
+    t.mState = state;
+    t.mPriority = priority;
+    t.mTransferred = transferred;
+    t.mTotal = total;
+    return t;
+}
+
+std::vector<int> tagsOf(const std::vector<IndexedTransfer> &transfers)
+{
+    std::vector<int> tags;
+    for (auto &t : transfers)
+    {
+        tags.push_back(t.mTag);
+    }
+    return tags;
+}
+
+auto skipNone = [](const IndexedTransfer &) { return false; };
+}
+
+TEST(TransferIndexTest, KeepsTotalsPerDirection)
+{
+    TransferIndex index;
+    index.upsert(makeTransfer(1, false, 10, 0, 100));
+    index.upsert(makeTransfer(2, false, 20, 0, 50));
+    index.upsert(makeTransfer(3, true, 30, 0, 10));
+
+    index.upsert(makeTransfer(1, false, 10, 40, 100, STATE_ACTIVE));
+
+    auto downloads = index.getStats(false);
+    EXPECT_EQ(downloads.mCount, 2u);
+    EXPECT_EQ(downloads.mTransferred, 40);
+    EXPECT_EQ(downloads.mTotal, 150);
+    EXPECT_EQ(downloads.mCountByState, (std::map<int, size_t>{{STATE_QUEUED, 1}, {STATE_ACTIVE, 1}}));
+
+    auto uploads = index.getStats(true);
+    EXPECT_EQ(uploads.mCount, 1u);
+    EXPECT_EQ(uploads.mTotal, 10);
+
+    index.erase(1);
+    index.erase(42); // unknown
+    downloads = index.getStats(false);
+    EXPECT_EQ(downloads.mCount, 1u);
+    EXPECT_EQ(downloads.mTransferred, 0);
+    EXPECT_EQ(downloads.mTotal, 50);
+    EXPECT_EQ(downloads.mCountByState, (std::map<int, size_t>{{STATE_QUEUED, 1}}));
+
+    index.clear();
+    EXPECT_EQ(index.size(), 0u);
+    EXPECT_EQ(index.getStats(true).mCount, 0u);
+}
+
+TEST(TransferIndexTest, ListsInQueueOrder)
+{
+    TransferIndex index;
+    index.upsert(makeTransfer(1, false, 30));
+    index.upsert(makeTransfer(2, false, 10));
+    index.upsert(makeTransfer(3, false, 20));
+    index.upsert(makeTransfer(4, true, 5));
+
+    EXPECT_EQ(tagsOf(index.first(false, 10, false, skipNone)), (std::vector<int>{2, 3, 1}));
+    EXPECT_EQ(tagsOf(index.first(false, 2, false, skipNone)), (std::vector<int>{2, 3}));
+    EXPECT_EQ(tagsOf(index.first(true, 10, false, skipNone)), (std::vector<int>{4}));
+
+    index.upsert(makeTransfer(1, false, 1)); // moved to the top
+    EXPECT_EQ(tagsOf(index.first(false, 10, false, skipNone)), (std::vector<int>{1, 2, 3}));
+}
+
+TEST(TransferIndexTest, FiltersSyncsAndSkipped)
+{
+    TransferIndex index;
+    index.upsert(makeTransfer(1, true, 10));
+    index.upsert(makeTransfer(2, true, 20, 0, 100, STATE_QUEUED, true));
+    index.upsert(makeTransfer(3, true, 30, 100, 100, STATE_COMPLETED));
+    index.upsert(makeTransfer(4, true, 40, 0, 100, STATE_QUEUED, true));
+    index.upsert(makeTransfer(5, true, 50));
+
+    EXPECT_EQ(tagsOf(index.first(true, 10, false, skipNone)), (std::vector<int>{1, 3, 5}));
+    EXPECT_EQ(tagsOf(index.first(true, 10, true, skipNone)), (std::vector<int>{1, 2, 3, 4, 5}));
+    EXPECT_EQ(tagsOf(index.first(true, 3, true, skipNone)), (std::vector<int>{1, 2, 3}));
+
+    auto skipCompleted = [](const IndexedTransfer &t) { return t.mState == STATE_COMPLETED; };
+    EXPECT_EQ(tagsOf(index.first(true, 10, true, skipCompleted)), (std::vector<int>{1, 2, 4, 5}));
+    EXPECT_EQ(index.getStats(true).mCount, 5u);
+}
+
+// Compares listing the first rows and a summary of many queued transfers from the index against going through
+// a copy of each of them (as transfers used to, getting every transfer from the SDK)
+TEST(TransferIndexTest, DISABLED_ManyTransfersBenchmark)
+{
+    constexpr int transfers = 50000;
+    constexpr size_t rows = 10;
+
+    struct TransferCopy
+    {
+        IndexedTransfer mTransfer;
+        std::string mPath;
+    };
+    std::vector<IndexedTransfer> queue;
+    TransferIndex index;
+    for (int tag = 0; tag < transfers; ++tag)
+    {
+        queue.push_back(makeTransfer(tag, tag % 2, static_cast<uint64_t>(tag), tag % 100, 100));
+        index.upsert(queue.back());
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    long long total = 0;
+    std::vector<std::unique_ptr<TransferCopy>> shown;
+    for (auto &transfer : queue)
+    {
+        auto copy = std::make_unique<TransferCopy>(TransferCopy{transfer, "/some/local/path/to/the/file" + std::to_string(transfer.mTag)});
+        total += copy->mTransfer.mTotal;
+        if (shown.size() < rows)
+        {
+            shown.push_back(std::move(copy));
+        }
+    }
+    auto copyingElapsed = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    long long indexedTotal = index.getStats(false).mTotal + index.getStats(true).mTotal;
+    auto firstRows = index.first(false, rows, false, skipNone);
+    auto indexedElapsed = std::chrono::steady_clock::now() - start;
+
+    EXPECT_EQ(indexedTotal, total);
+    EXPECT_EQ(firstRows.size(), rows);
+
+    auto us = [](std::chrono::steady_clock::duration d) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    };
+    G_TEST_INFO << "Going through " << transfers << " transfers: " << us(copyingElapsed) << " us";
+    G_TEST_INFO << "From the index: " << us(indexedElapsed) << " us";
+}
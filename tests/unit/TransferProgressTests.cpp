@@ -0,0 +1,163 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <chrono>
+#include <map>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_transfer_progress.h"
+
+using namespace megacmd;
+
+namespace
+{
+// The way progress used to be aggregated: summing the bytes of every ongoing transfer on each update
+class SummingProgress
+{
+public:
+    void update(int tag, long long transferred, long long total)
+    {
+        mOngoingTransferred[tag] = transferred;
+        mOngoingTotal[tag] = total;
+    }
+
+    long long transferred() const { return sum(mOngoingTransferred); }
+    long long total() const { return sum(mOngoingTotal); }
+
+private:
+    static long long sum(const std::map<int, long long> &bytes)
+    {
+        long long total = 0;
+        for (auto &tagAndBytes : bytes)
+        {
+            total += tagAndBytes.second;
+        }
+        return total;
+    }
+
+    std::map<int, long long> mOngoingTransferred;
+    std::map<int, long long> mOngoingTotal;
+};
+
+// Starts `transfers` transfers and updates each of them a few times, reading the totals after each update
+template <typename Progress>
+std::pair<std::chrono::steady_clock::duration, long long> simulateUpdates(Progress &progress, int transfers, int updatesPerTransfer)
+{
+    constexpr long long fileSize = 1000;
+    long long checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int update = 1; update <= updatesPerTransfer; ++update)
+    {
+        for (int tag = 0; tag < transfers; ++tag)
+        {
+            progress.update(tag, fileSize * update / updatesPerTransfer, fileSize);
+            checksum += progress.transferred() + progress.total();
+        }
+    }
+    return {std::chrono::steady_clock::now() - start, checksum};
+}
+}
+
+TEST(TransferProgressTest, AggregatesOngoingAndFinished)
+{
+    TransferProgress progress;
+    EXPECT_EQ(progress.transferred(), 0);
+    EXPECT_EQ(progress.total(), 0);
+
+    progress.update(1, 10, 100);
+    progress.update(2, 0, 50);
+    EXPECT_EQ(progress.transferred(), 10);
+    EXPECT_EQ(progress.total(), 150);
+
+    progress.update(1, 60, 100);
+    progress.update(2, 20, 50);
+    EXPECT_EQ(progress.transferred(), 80);
+    EXPECT_EQ(progress.total(), 150);
+
+    progress.finish(1, 100, 100);
+    EXPECT_EQ(progress.transferred(), 120);
+    EXPECT_EQ(progress.total(), 150);
+    EXPECT_EQ(progress.finishedTransferred(), 100);
+    EXPECT_EQ(progress.finishedTotal(), 100);
+
+    // a transfer may finish without any update
+    progress.finish(3, 5, 5);
+    progress.finish(2, 50, 50);
+    EXPECT_EQ(progress.transferred(), 155);
+    EXPECT_EQ(progress.total(), 155);
+    EXPECT_EQ(progress.finishedTotal(), 155);
+}
+
+TEST(TransferProgressTest, TotalsMayChange)
+{
+    TransferProgress progress;
+    progress.update(1, 0, 100);
+    progress.update(1, 0, 80); // e.g: a transfer restarted
+    progress.update(1, 40, 80);
+    EXPECT_EQ(progress.transferred(), 40);
+    EXPECT_EQ(progress.total(), 80);
+
+    progress.finish(1, 0, 0); // failed
+    EXPECT_EQ(progress.transferred(), 0);
+    EXPECT_EQ(progress.total(), 0);
+}
+
+TEST(TransferProgressTest, ThrottlesRendering)
+{
+    ProgressThrottle throttle(10);
+    auto now = std::chrono::steady_clock::now();
+
+    EXPECT_TRUE(throttle.shouldRender(now)); // the first one
+    EXPECT_FALSE(throttle.shouldRender(now + std::chrono::milliseconds(50)));
+    EXPECT_TRUE(throttle.shouldRender(now + std::chrono::milliseconds(50), true));
+    EXPECT_FALSE(throttle.shouldRender(now + std::chrono::milliseconds(149)));
+    EXPECT_TRUE(throttle.shouldRender(now + std::chrono::milliseconds(150)));
+
+    unsigned rendered = 0;
+    for (int ms = 0; ms < 1000; ++ms)
+    {
+        rendered += throttle.shouldRender(now + std::chrono::milliseconds(1000 + ms));
+    }
+    EXPECT_EQ(rendered, 10u);
+}
+
+// Compares the cost of aggregating the progress of many concurrent transfers summing them all on each update (as it used to)
+// against keeping the totals. The former is quadratic, so it is measured with fewer transfers
+TEST(TransferProgressTest, DISABLED_ManyTransfersBenchmark)
+{
+    constexpr int updatesPerTransfer = 4;
+    constexpr int summedTransfers = 5000;
+    constexpr int transfers = 100000;
+
+    SummingProgress summing;
+    auto [summingElapsed, summingChecksum] = simulateUpdates(summing, summedTransfers, updatesPerTransfer);
+
+    TransferProgress sameTransfers;
+    auto [unused, checksum] = simulateUpdates(sameTransfers, summedTransfers, updatesPerTransfer);
+    EXPECT_EQ(checksum, summingChecksum);
+
+    TransferProgress progress;
+    auto [elapsed, unusedChecksum] = simulateUpdates(progress, transfers, updatesPerTransfer);
+    EXPECT_EQ(progress.transferred(), progress.total());
+    EXPECT_EQ(progress.total(), 1000LL * transfers);
+
+    auto nsPerUpdate = [](std::chrono::steady_clock::duration d, int updates) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count() / updates;
+    };
+    G_TEST_INFO << "Summing " << summedTransfers << " transfers: " << nsPerUpdate(summingElapsed, summedTransfers * updatesPerTransfer) << " ns per update";
+    G_TEST_INFO << "Keeping the totals of " << transfers << " transfers: " << nsPerUpdate(elapsed, transfers * updatesPerTransfer) << " ns per update";
+}
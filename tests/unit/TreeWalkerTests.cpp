@@ -0,0 +1,637 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_tree_walker.h"
+
+using namespace megacmd;
+
+namespace
+{
+struct TestNode
+{
+    std::string mName;
+    bool mFolder = false;
+    std::vector<std::shared_ptr<TestNode>> mChildren;
+};
+
+using TestNodePtr = std::shared_ptr<TestNode>;
+
+// A folder with `width` files and `width` subfolders per level
+TestNodePtr buildTree(int depth, int width, const std::string& name = "root")
+{
+    auto node = std::make_shared<TestNode>();
+    node->mName = name;
+    node->mFolder = true;
+    for (int i = 0; i < width; ++i)
+    {
+        auto file = std::make_shared<TestNode>();
+        file->mName = name + "/file" + std::to_string(i);
+        node->mChildren.push_back(std::move(file));
+    }
+    if (depth > 0)
+    {
+        for (int i = 0; i < width; ++i)
+        {
+            node->mChildren.push_back(buildTree(depth - 1, width, name + "/folder" + std::to_string(i)));
+        }
+    }
+    return node;
+}
+
+// The order of a sequential walk: the children (after their own subtree), then the folder
+void sequentialWalk(const TestNodePtr& node, std::vector<std::string>& names)
+{
+    for (const auto& child : node->mChildren)
+    {
+        sequentialWalk(child, names);
+    }
+    names.push_back(node->mName);
+}
+
+std::vector<TestNodePtr> getChildren(TestNode& node)
+{
+    return node.mChildren;
+}
+
+bool isFolder(TestNode& node)
+{
+    return node.mFolder;
+}
+
+std::optional<std::string> visitName(const TestNodePtr& node)
+{
+    return node->mName;
+}
+
+TreeWalkOptions withThreads(size_t threads, bool ordered = false)
+{
+    TreeWalkOptions options;
+    options.mThreads = threads;
+    options.mOrdered = ordered;
+    return options;
+}
+}
+
+TEST(TreeWalkerTest, VisitsEveryNodeOnce)
+{
+    auto root = buildTree(4, 4);
+    std::vector<std::string> expected;
+    sequentialWalk(root, expected);
+
+    ParallelTreeWalker<TestNode, std::string> walker(withThreads(8), getChildren, isFolder, visitName);
+
+    std::multiset<std::string> visited;
+    EXPECT_TRUE(walker.walk(root, [&visited](std::string&& name) { visited.insert(std::move(name)); return true; }));
+
+    EXPECT_EQ(visited, std::multiset<std::string>(expected.begin(), expected.end()));
+    EXPECT_EQ(walker.getStats().mNodes, expected.size());
+}
+
+TEST(TreeWalkerTest, OrderedWalkMatchesSequentialOrder)
+{
+    auto root = buildTree(4, 4);
+    std::vector<std::string> expected;
+    sequentialWalk(root, expected);
+
+    for (size_t threads : {1, 2, 8})
+    {
+        ParallelTreeWalker<TestNode, std::string> walker(withThreads(threads, true), getChildren, isFolder, visitName);
+
+        std::vector<std::string> visited;
+        EXPECT_TRUE(walker.walk(root, [&visited](std::string&& name) { visited.push_back(std::move(name)); return true; }));
+        EXPECT_EQ(visited, expected) << threads << " threads";
+    }
+}
+
+TEST(TreeWalkerTest, OnlyVisitResultsAreConsumed)
+{
+    auto root = buildTree(3, 3);
+
+    auto visitFolders = [](const TestNodePtr& node) -> std::optional<std::string>
+    {
+        if (!node->mFolder)
+        {
+            return std::nullopt;
+        }
+        return node->mName;
+    };
+    ParallelTreeWalker<TestNode, std::string> walker(withThreads(4), getChildren, isFolder, visitFolders);
+
+    size_t consumed = 0;
+    EXPECT_TRUE(walker.walk(root, [&consumed](std::string&&) { ++consumed; return true; }));
+    EXPECT_EQ(consumed, 1u + 3u + 9u + 27u);
+}
+
+TEST(TreeWalkerTest, WalkingAFile)
+{
+    auto file = std::make_shared<TestNode>();
+    file->mName = "lonely";
+
+    ParallelTreeWalker<TestNode, std::string> walker(withThreads(4, true), getChildren, isFolder, visitName);
+
+    std::vector<std::string> visited;
+    EXPECT_TRUE(walker.walk(file, [&visited](std::string&& name) { visited.push_back(std::move(name)); return true; }));
+    EXPECT_EQ(visited, std::vector<std::string>{"lonely"});
+}
+
+TEST(TreeWalkerTest, StopsWhenConsumeReturnsFalse)
+{
+    auto root = buildTree(5, 4);
+
+    for (bool ordered : {false, true})
+    {
+        ParallelTreeWalker<TestNode, std::string> walker(withThreads(4, ordered), getChildren, isFolder, visitName);
+
+        size_t consumed = 0;
+        EXPECT_FALSE(walker.walk(root, [&consumed](std::string&&) { return ++consumed < 10; }));
+        EXPECT_EQ(consumed, 10u);
+    }
+}
+
+TEST(TreeWalkerTest, StopsWhenRequested)
+{
+    auto root = buildTree(5, 4);
+
+    auto slowVisit = [](const TestNodePtr& node) -> std::optional<std::string>
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return node->mName;
+    };
+
+    TreeWalkOptions options = withThreads(2);
+    options.mPollPeriod = std::chrono::milliseconds(10);
+    const auto start = std::chrono::steady_clock::now();
+    options.mShouldStop = [start] { return std::chrono::steady_clock::now() - start > std::chrono::milliseconds(50); };
+
+    ParallelTreeWalker<TestNode, std::string> walker(options, getChildren, isFolder, slowVisit);
+    EXPECT_FALSE(walker.walk(root, [](std::string&&) { return true; }));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
+
+TEST(TreeWalkerTest, QueuedFoldersAreBounded)
+{
+    auto root = buildTree(4, 6);
+    std::vector<std::string> expected;
+    sequentialWalk(root, expected);
+
+    TreeWalkOptions options = withThreads(4, true);
+    options.mMaxQueuedFolders = 3;
+    ParallelTreeWalker<TestNode, std::string> walker(options, getChildren, isFolder, visitName);
+
+    std::vector<std::string> visited;
+    EXPECT_TRUE(walker.walk(root, [&visited](std::string&& name) { visited.push_back(std::move(name)); return true; }));
+    EXPECT_EQ(visited, expected);
+
+    auto stats = walker.getStats();
+    EXPECT_LE(stats.mMaxQueuedFolders, options.mMaxQueuedFolders + options.mThreads);
+    EXPECT_GT(stats.mInlineFolders, 0u);
+}
+
+TEST(TreeWalkerTest, QueuedResultsAreBoundedWhileTheConsumerIsStalled)
+{
+    constexpr int depth = 4;
+    constexpr int width = 6;
+    auto root = buildTree(depth, width);
+    std::vector<std::string> expected;
+    sequentialWalk(root, expected);
+
+    for (bool ordered : {false, true})
+    {
+        TreeWalkOptions options = withThreads(4, ordered);
+        options.mMaxQueuedResults = 50;
+        options.mPollPeriod = std::chrono::milliseconds(10);
+        ParallelTreeWalker<TestNode, std::string> walker(options, getChildren, isFolder, visitName);
+
+        // The consumer stalls for a while at the beginning (as a blocked output would), then keeps up
+        std::vector<std::string> visited;
+        EXPECT_TRUE(walker.walk(root, [&visited](std::string&& name)
+        {
+            if (visited.empty())
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            }
+            visited.push_back(std::move(name));
+            return true;
+        }));
+
+        if (ordered)
+        {
+            EXPECT_EQ(visited, expected);
+        }
+        else
+        {
+            EXPECT_EQ(std::multiset<std::string>(visited.begin(), visited.end()), std::multiset<std::string>(expected.begin(), expected.end()));
+        }
+
+        // In ordered walks, the children of the folders in the path being consumed may go beyond the limit
+        auto stats = walker.getStats();
+        const size_t path = ordered ? (depth + 1) * (2 * width + 1) : 0;
+        EXPECT_LE(stats.mMaxQueuedResults, options.mMaxQueuedResults + path) << "ordered: " << ordered;
+        EXPECT_GT(stats.mResultWaits, 0u) << "ordered: " << ordered;
+        G_TEST_INFO << (ordered ? "Ordered" : "Unordered") << " walk: max queued results: " << stats.mMaxQueuedResults
+                    << ", waits: " << stats.mResultWaits << ", folders listed by waiting workers: " << stats.mHelpedFolders;
+    }
+}
+
+// Compares walking a synthetic tree with a single worker against several ones, with some work per node.
+// Disabled, as it takes a while: run it with --gtest_also_run_disabled_tests
+TEST(TreeWalkerTest, DISABLED_WalkBenchmark)
+{
+    auto root = buildTree(5, 7); // ~230k nodes
+
+    auto busyVisit = [](const TestNodePtr& node) -> std::optional<std::string>
+    {
+        size_t hash = 0;
+        for (int i = 0; i < 20; ++i)
+        {
+            hash = std::hash<std::string>{}(node->mName + std::to_string(hash));
+        }
+        if (hash % 10)
+        {
+            return std::nullopt;
+        }
+        return node->mName;
+    };
+
+    const size_t cores = std::max(2u, std::thread::hardware_concurrency());
+    for (auto [threads, ordered] : {std::pair<size_t, bool>{1, false}, {cores, false}, {cores, true}})
+    {
+        ParallelTreeWalker<TestNode, std::string> walker(withThreads(threads, ordered), getChildren, isFolder, busyVisit);
+
+        size_t consumed = 0;
+        const auto start = std::chrono::steady_clock::now();
+        EXPECT_TRUE(walker.walk(root, [&consumed](std::string&&) { ++consumed; return true; }));
+        const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        const auto stats = walker.getStats();
+        G_TEST_INFO << threads << " thread(s)" << (ordered ? ", ordered" : "") << ": "
+                    << static_cast<long long>(stats.mNodes / std::max(elapsed, 1e-9)) << " nodes/sec. "
+                    << consumed << " results. Stolen folders: " << stats.mStolenFolders
+                    << ". Max queued folders: " << stats.mMaxQueuedFolders;
+    }
+}
+
+namespace
+{
+// A tree kept in a "database", handing out node copies (counted) as the SDK does
+class CountingSource
+{
+public:
+    struct Node
+    {
+        int mHandle;
+        std::string mName;
+        bool mFolder;
+        CountingSource* mSource;
+
+        Node(const Node& other) : mHandle(other.mHandle), mName(other.mName), mFolder(other.mFolder), mSource(other.mSource) { mSource->copyCreated(); }
+        Node(int handle, std::string name, bool folder, CountingSource* source) : mHandle(handle), mName(std::move(name)), mFolder(folder), mSource(source) { mSource->copyCreated(); }
+        ~Node() { --mSource->mLiveCopies; }
+    };
+    using NodeList = std::vector<std::unique_ptr<Node>>;
+
+    size_t mLiveCopies = 0;
+    size_t mPeakCopies = 0;
+
+    int addNode(int parent, const std::string& name, bool folder)
+    {
+        const int handle = static_cast<int>(mNodes.size());
+        mNodes.push_back({name, folder, {}});
+        if (parent >= 0)
+        {
+            mNodes[parent].mChildren.push_back(handle);
+        }
+        return handle;
+    }
+
+    void removeNode(int handle)
+    {
+        mRemoved.insert(handle);
+    }
+
+    void restoreNode(int handle)
+    {
+        mRemoved.erase(handle);
+    }
+
+    std::unique_ptr<Node> getRoot()
+    {
+        return makeCopy(0);
+    }
+
+    // DepthFirstTreeVisitor's requirements:
+    size_t countChildren(Node& n)
+    {
+        return liveChildren(n).size();
+    }
+    std::unique_ptr<NodeList> getChildren(Node& n, size_t offset, size_t count)
+    {
+        auto list = std::make_unique<NodeList>();
+        const auto children = liveChildren(n);
+        for (size_t i = offset; i < children.size() && i - offset < count; ++i)
+        {
+            list->push_back(makeCopy(children[i]));
+        }
+        return list;
+    }
+    size_t size(const NodeList& list) { return list.size(); }
+    Node* get(const NodeList& list, size_t i) { return list[i].get(); }
+    bool isFolder(Node& n) { return n.mFolder; }
+    std::unique_ptr<Node> copy(Node& n) { return std::make_unique<Node>(n); }
+
+private:
+    struct StoredNode
+    {
+        std::string mName;
+        bool mFolder;
+        std::vector<int> mChildren;
+    };
+    std::vector<StoredNode> mNodes;
+    std::set<int> mRemoved;
+
+    std::vector<int> liveChildren(Node& n)
+    {
+        std::vector<int> children;
+        for (int child : mNodes[n.mHandle].mChildren)
+        {
+            if (!mRemoved.count(child))
+            {
+                children.push_back(child);
+            }
+        }
+        return children;
+    }
+
+    std::unique_ptr<Node> makeCopy(int handle)
+    {
+        return std::make_unique<Node>(handle, mNodes[handle].mName, mNodes[handle].mFolder, this);
+    }
+
+    void copyCreated()
+    {
+        mPeakCopies = std::max(mPeakCopies, ++mLiveCopies);
+    }
+};
+
+using Visitor = DepthFirstTreeVisitor<CountingSource>;
+
+// Every level with a subfolder (listed first, as the SDK does by default) and `files` files
+void buildDeepAndWideTree(CountingSource& source, int depth, int files)
+{
+    int parent = source.addNode(-1, "root", true);
+    for (int level = 0; level < depth; ++level)
+    {
+        int folder = source.addNode(parent, "folder" + std::to_string(level), true);
+        for (int i = 0; i < files; ++i)
+        {
+            source.addNode(parent, "file" + std::to_string(level) + "_" + std::to_string(i), false);
+        }
+        parent = folder;
+    }
+}
+
+// The former recursive walk, keeping the children of every folder in the path
+void recursiveWalk(CountingSource& source, CountingSource::Node& node, std::vector<std::string>& leaveOrder)
+{
+    if (node.mFolder)
+    {
+        auto children = source.getChildren(node, 0, source.countChildren(node));
+        for (auto& child : *children)
+        {
+            recursiveWalk(source, *child, leaveOrder);
+        }
+    }
+    leaveOrder.push_back(node.mName);
+}
+
+Visitor::Callbacks recordingCallbacks(std::vector<std::string>& enterOrder, std::vector<std::string>& leaveOrder)
+{
+    Visitor::Callbacks callbacks;
+    callbacks.mOnEnter = [&enterOrder](CountingSource::Node& n, const NodeVisitContext&) { enterOrder.push_back(n.mName); return true; };
+    callbacks.mOnLeave = [&leaveOrder](CountingSource::Node& n, const NodeVisitContext&) { leaveOrder.push_back(n.mName); };
+    return callbacks;
+}
+}
+
+TEST(TreeVisitorTest, VisitsInTheOrderOfARecursiveWalk)
+{
+    CountingSource source;
+    const int root = source.addNode(-1, "root", true);
+    const int a = source.addNode(root, "a", true);
+    source.addNode(a, "a1", false);
+    const int b = source.addNode(a, "b", true);
+    source.addNode(b, "b1", false);
+    source.addNode(a, "a2", false);
+    source.addNode(root, "r1", false);
+    source.addNode(root, "empty", true);
+
+    auto rootNode = source.getRoot();
+    std::vector<std::string> recursiveOrder;
+    recursiveWalk(source, *rootNode, recursiveOrder);
+
+    for (size_t batchSize : {1, 2, 256})
+    {
+        G_SUBTEST << "Batches of " << batchSize;
+        std::vector<std::string> enterOrder, leaveOrder;
+        EXPECT_TRUE(Visitor(source, batchSize).walk(*rootNode, recordingCallbacks(enterOrder, leaveOrder)));
+
+        EXPECT_EQ(enterOrder, (std::vector<std::string>{"root", "a", "a1", "b", "b1", "a2", "r1", "empty"}));
+        EXPECT_EQ(leaveOrder, (std::vector<std::string>{"a1", "b1", "b", "a2", "a", "r1", "empty", "root"}));
+        EXPECT_EQ(leaveOrder, recursiveOrder);
+    }
+}
+
+TEST(TreeVisitorTest, ReportsDepthAndLastSiblings)
+{
+    CountingSource source;
+    const int root = source.addNode(-1, "root", true);
+    const int a = source.addNode(root, "a", true);
+    source.addNode(a, "a1", false);
+    source.addNode(a, "a2", false);
+    source.addNode(a, "a3", false);
+    source.addNode(root, "r1", false);
+
+    auto rootNode = source.getRoot();
+    for (size_t batchSize : {1, 2, 256})
+    {
+        G_SUBTEST << "Batches of " << batchSize;
+
+        std::map<std::string, std::pair<size_t, bool>> contexts;
+        std::map<std::string, std::vector<std::string>> listed; // every child, with the offset of its batch
+        std::map<std::string, size_t> lastBatches;
+        Visitor::Callbacks callbacks;
+        callbacks.mOnEnter = [&contexts](CountingSource::Node& n, const NodeVisitContext& context)
+        {
+            contexts[n.mName] = {context.mDepth, context.mIsLast};
+            return true;
+        };
+        callbacks.mOnChildrenListed = [&](CountingSource::Node& n, const CountingSource::NodeList& children,
+                                          size_t offset, bool last, const NodeVisitContext&)
+        {
+            EXPECT_EQ(offset, listed[n.mName].size());
+            EXPECT_LE(children.size(), batchSize);
+            for (auto& child : children)
+            {
+                listed[n.mName].push_back(child->mName);
+            }
+            lastBatches[n.mName] += last;
+        };
+
+        EXPECT_TRUE(Visitor(source, batchSize).walk(*rootNode, callbacks));
+        EXPECT_EQ(contexts["root"], std::make_pair(size_t(0), true));
+        EXPECT_EQ(contexts["a"], std::make_pair(size_t(1), false));
+        EXPECT_EQ(contexts["a1"], std::make_pair(size_t(2), false));
+        EXPECT_EQ(contexts["a2"], std::make_pair(size_t(2), false));
+        EXPECT_EQ(contexts["a3"], std::make_pair(size_t(2), true));
+        EXPECT_EQ(contexts["r1"], std::make_pair(size_t(1), true));
+        EXPECT_EQ(listed, (std::map<std::string, std::vector<std::string>>{{"root", {"a", "r1"}}, {"a", {"a1", "a2", "a3"}}}));
+        EXPECT_EQ(lastBatches, (std::map<std::string, size_t>{{"root", 1}, {"a", 1}}));
+    }
+}
+
+TEST(TreeVisitorTest, SkipsFoldersNotEntered)
+{
+    CountingSource source;
+    buildDeepAndWideTree(source, 3, 2);
+
+    Visitor::Callbacks callbacks;
+    size_t entered = 0;
+    callbacks.mOnEnter = [&entered](CountingSource::Node&, const NodeVisitContext& context)
+    {
+        ++entered;
+        return context.mDepth == 0; // only the children of the root
+    };
+
+    auto rootNode = source.getRoot();
+    EXPECT_TRUE(Visitor(source).walk(*rootNode, callbacks));
+    EXPECT_EQ(entered, 1u + 3u);
+}
+
+TEST(TreeVisitorTest, SkipsNodesGoneWhileWalking)
+{
+    CountingSource source;
+    const int root = source.addNode(-1, "root", true);
+    const int a = source.addNode(root, "a", true);
+    source.addNode(a, "a1", false);
+    const int gone = source.addNode(root, "gone", false);
+    source.addNode(root, "r1", false);
+
+    std::vector<std::string> enterOrder, leaveOrder;
+    auto callbacks = recordingCallbacks(enterOrder, leaveOrder);
+    auto onEnter = callbacks.mOnEnter;
+    callbacks.mOnEnter = [&](CountingSource::Node& n, const NodeVisitContext& context)
+    {
+        if (n.mName == "a")
+        {
+            source.removeNode(gone);
+        }
+        return onEnter(n, context);
+    };
+
+    auto rootNode = source.getRoot();
+    for (size_t batchSize : {1, 256})
+    {
+        G_SUBTEST << "Batches of " << batchSize;
+        source.restoreNode(gone);
+        enterOrder.clear();
+        EXPECT_TRUE(Visitor(source, batchSize).walk(*rootNode, callbacks));
+        EXPECT_EQ(enterOrder, (std::vector<std::string>{"root", "a", "a1", "r1"}));
+    }
+}
+
+TEST(TreeVisitorTest, StopsWhenRequested)
+{
+    CountingSource source;
+    buildDeepAndWideTree(source, 10, 10);
+
+    std::vector<std::string> enterOrder, leaveOrder;
+    auto callbacks = recordingCallbacks(enterOrder, leaveOrder);
+    callbacks.mShouldStop = [&enterOrder] { return enterOrder.size() >= 5; };
+
+    auto rootNode = source.getRoot();
+    EXPECT_FALSE(Visitor(source).walk(*rootNode, callbacks));
+    EXPECT_EQ(enterOrder.size(), 5u);
+}
+
+TEST(TreeVisitorTest, WalksVeryDeepTrees)
+{
+    CountingSource source;
+    buildDeepAndWideTree(source, 200000, 1);
+
+    size_t entered = 0;
+    Visitor::Callbacks callbacks;
+    callbacks.mOnEnter = [&entered](CountingSource::Node&, const NodeVisitContext&) { ++entered; return true; };
+
+    auto rootNode = source.getRoot();
+    EXPECT_TRUE(Visitor(source).walk(*rootNode, callbacks));
+    EXPECT_EQ(entered, 1u + 2u * 200000u);
+}
+
+// The visitor keeps a node copy per level of the path being walked, plus a batch of children
+TEST(TreeVisitorTest, KeepsCopiesBoundByDepthAndBatch)
+{
+    constexpr size_t batchSize = 16;
+
+    auto expectBound = [](CountingSource& source, size_t depth, bool listChildren)
+    {
+        auto rootNode = source.getRoot();
+
+        std::vector<std::string> recursiveOrder;
+        recursiveWalk(source, *rootNode, recursiveOrder);
+
+        std::vector<std::string> enterOrder, leaveOrder;
+        auto callbacks = recordingCallbacks(enterOrder, leaveOrder);
+        if (listChildren)
+        {
+            callbacks.mOnChildrenListed = [](CountingSource::Node&, const CountingSource::NodeList&, size_t, bool, const NodeVisitContext&) {};
+        }
+
+        source.mPeakCopies = source.mLiveCopies;
+        EXPECT_TRUE(Visitor(source, batchSize).walk(*rootNode, callbacks));
+        EXPECT_EQ(leaveOrder, recursiveOrder);
+
+        // the root, the folders in the path, a batch, and the copy of the folder being entered
+        EXPECT_LE(source.mPeakCopies, 1 + depth + batchSize + 1);
+    };
+
+    for (bool listChildren : {false, true})
+    {
+        G_SUBTEST << "Deep and wide" << (listChildren ? ", listing children" : "");
+        {
+            CountingSource source;
+            buildDeepAndWideTree(source, 200, 500);
+            expectBound(source, 200, listChildren);
+        }
+
+        G_SUBTEST << "A single wide folder" << (listChildren ? ", listing children" : "");
+        {
+            CountingSource source;
+            buildDeepAndWideTree(source, 1, 20000);
+            expectBound(source, 1, listChildren);
+        }
+    }
+}
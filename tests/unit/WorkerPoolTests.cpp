@@ -0,0 +1,171 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_worker_pool.h"
+
+using namespace megacmd;
+using namespace std::chrono_literals;
+
+TEST(WorkerPoolTest, AllTasksAreProcessed)
+{
+    std::atomic<int> processed = 0;
+    {
+        WorkerPool pool(4, 4);
+        for (int i = 0; i < 1000; ++i)
+        {
+            ASSERT_TRUE(pool.push([&processed] { ++processed; }));
+        }
+        EXPECT_TRUE(pool.waitUntilIdle(10s));
+
+        auto stats = pool.getStats();
+        EXPECT_EQ(stats.mProcessed, 1000u);
+        EXPECT_EQ(stats.pending(), 0u);
+        EXPECT_LE(stats.mMaxQueueDepth, 4u);
+    }
+    EXPECT_EQ(processed, 1000);
+}
+
+TEST(WorkerPoolTest, ThreadsAreReusedAndBounded)
+{
+    constexpr size_t maxWorkers = 3;
+    WorkerPool pool(maxWorkers, 10);
+
+    std::mutex idsMutex;
+    std::set<std::thread::id> ids;
+    std::atomic<int> running = 0;
+    std::atomic<int> maxRunning = 0;
+
+    for (int i = 0; i < 200; ++i)
+    {
+        pool.push([&] {
+            int nowRunning = ++running;
+            int prevMax = maxRunning;
+            while (nowRunning > prevMax && !maxRunning.compare_exchange_weak(prevMax, nowRunning));
+
+            std::this_thread::sleep_for(100us);
+            {
+                std::lock_guard<std::mutex> g(idsMutex);
+                ids.insert(std::this_thread::get_id());
+            }
+            --running;
+        });
+    }
+    EXPECT_TRUE(pool.waitUntilIdle(10s));
+
+    EXPECT_LE(ids.size(), maxWorkers);
+    EXPECT_LE(maxRunning.load(), static_cast<int>(maxWorkers));
+    EXPECT_LE(pool.getStats().mWorkers, maxWorkers);
+}
+
+TEST(WorkerPoolTest, PushBlocksWhenQueueIsFull)
+{
+    WorkerPool pool(1, 1);
+
+    std::promise<void> release;
+    auto releaseFuture = release.get_future().share();
+
+    pool.push([releaseFuture] { releaseFuture.wait(); }); // occupies the only worker
+    timelyRetry(5s, 10ms, [&pool] { return pool.getStats().mBusyWorkers == 1; }, [] {});
+    ASSERT_EQ(pool.getStats().mBusyWorkers, 1u);
+    pool.push([] {}); // fills the queue
+
+    auto blockedPush = std::async(std::launch::async, [&pool] { return pool.push([] {}); });
+    EXPECT_EQ(blockedPush.wait_for(200ms), std::future_status::timeout);
+
+    release.set_value();
+    ASSERT_EQ(blockedPush.wait_for(5s), std::future_status::ready);
+    EXPECT_TRUE(blockedPush.get());
+    EXPECT_TRUE(pool.waitUntilIdle(5s));
+    EXPECT_EQ(pool.getStats().mProcessed, 3u);
+}
+
+TEST(WorkerPoolTest, WaitUntilIdleFromWithinAWorker)
+{
+    WorkerPool pool(2, 2);
+
+    std::promise<bool> result;
+    pool.push([&pool, &result] { result.set_value(pool.waitUntilIdle(5s)); });
+
+    auto resultFuture = result.get_future();
+    ASSERT_EQ(resultFuture.wait_for(10s), std::future_status::ready);
+    EXPECT_TRUE(resultFuture.get());
+}
+
+// Compares the pool against spawning a thread per petition (the former approach)
+TEST(WorkerPoolTest, DISABLED_ThroughputBenchmark)
+{
+    constexpr int numPetitions = 20000;
+    constexpr size_t numWorkers = 100;
+
+    auto shortPetition = [](std::atomic<int>& done) {
+        volatile int work = 0;
+        for (int i = 0; i < 100; ++i) work = work + i;
+        ++done;
+    };
+
+    auto petitionsPerSecond = [](std::chrono::steady_clock::duration elapsed) {
+        return numPetitions / std::chrono::duration<double>(elapsed).count();
+    };
+
+    double threadPerPetitionRate = 0;
+    {
+        std::atomic<int> done = 0;
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < numPetitions; ++i)
+        {
+            if (threads.size() == numWorkers) // the former semaphore
+            {
+                for (auto& t : threads) t.join();
+                threads.clear();
+            }
+            threads.emplace_back([&] { shortPetition(done); });
+        }
+        for (auto& t : threads) t.join();
+        threadPerPetitionRate = petitionsPerSecond(std::chrono::steady_clock::now() - start);
+        EXPECT_EQ(done, numPetitions);
+    }
+
+    double poolRate = 0;
+    {
+        std::atomic<int> done = 0;
+        WorkerPool pool(numWorkers, numWorkers);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < numPetitions; ++i)
+        {
+            pool.push([&] { shortPetition(done); });
+        }
+        EXPECT_TRUE(pool.waitUntilIdle(60s));
+        poolRate = petitionsPerSecond(std::chrono::steady_clock::now() - start);
+        EXPECT_EQ(done, numPetitions);
+
+        auto stats = pool.getStats();
+        G_TEST_INFO << "Pool used " << stats.mWorkers << " threads. Max queue depth: " << stats.mMaxQueueDepth
+                    << ". Avg queue wait: " << stats.mAvgQueueWait.count() << " us";
+    }
+
+    G_TEST_INFO << "Thread per petition: " << static_cast<long long>(threadPerPetitionRate) << " petitions/sec";
+    G_TEST_INFO << "Worker pool: " << static_cast<long long>(poolRate) << " petitions/sec";
+}